@@ -0,0 +1,130 @@
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <thread>
+#include <vector>
+#include "autotune.h"
+#include "vulkan_dispatch.h"
+
+const char* tune_objective_name(TuneObjective objective) {
+	switch (objective) {
+		case TuneObjective::THROUGHPUT: return "throughput";
+		case TuneObjective::P99_FRAME_TIME: return "p99";
+		case TuneObjective::POWER: return "power";
+	}
+	return "unknown";
+}
+
+bool parse_tune_objective(const std::string &name, TuneObjective &objective) {
+	for (const auto o : { TuneObjective::THROUGHPUT, TuneObjective::P99_FRAME_TIME, TuneObjective::POWER }) {
+		if (name == tune_objective_name(o)) {
+			objective = o;
+			return true;
+		}
+	}
+	return false;
+}
+
+float tune_cost(const FrameBenchmarkResult &result, uint32_t num_threads, TuneObjective objective) {
+	switch (objective) {
+		case TuneObjective::THROUGHPUT: return result.avg_frame_ms;
+		case TuneObjective::P99_FRAME_TIME: return result.p99_frame_ms;
+		// Each recording thread is busy for about the frame's CPU time
+		case TuneObjective::POWER: return result.cpu_ms * num_threads + result.gpu_ms;
+	}
+	return result.avg_frame_ms;
+}
+
+std::string device_uuid(VkPhysicalDevice physical_device) {
+	VkPhysicalDeviceIDProperties id_props = {};
+	id_props.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_ID_PROPERTIES;
+
+	VkPhysicalDeviceProperties2 props = {};
+	props.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+	props.pNext = &id_props;
+	vkGetPhysicalDeviceProperties2(physical_device, &props);
+
+	std::string uuid;
+	for (uint32_t i = 0; i < VK_UUID_SIZE; ++i) {
+		char hex[3] = {};
+		std::snprintf(hex, sizeof(hex), "%02x", id_props.deviceUUID[i]);
+		uuid += hex;
+	}
+	return uuid;
+}
+
+std::string tuned_config_path(VkPhysicalDevice physical_device) {
+	return "autotune-" + device_uuid(physical_device) + ".cfg";
+}
+
+FrameBenchmarkParams run_autotune(VkDevice device, VkPhysicalDevice physical_device, VkQueue queue,
+		uint32_t queue_family, TuneObjective objective, const FrameBenchmarkParams &base)
+{
+	std::vector<uint32_t> thread_counts;
+	const uint32_t max_threads = std::max(std::thread::hardware_concurrency(), 1u);
+	for (uint32_t t = 1; t < max_threads; t *= 2) {
+		thread_counts.push_back(t);
+	}
+	thread_counts.push_back(max_threads);
+
+	std::vector<FrameBenchmarkParams> candidates;
+	for (uint32_t frames_in_flight = 1; frames_in_flight <= MAX_FRAMES_IN_FLIGHT; ++frames_in_flight) {
+		for (const auto batch_size : { 64u, 256u, 1024u }) {
+			FrameBenchmarkParams params = base;
+			params.frames_in_flight = frames_in_flight;
+			params.batch_size = batch_size;
+
+			// Pre-recorded frames are recorded once, so the thread count doesn't matter
+			params.recording_mode = RecordingMode::PRERECORDED;
+			params.num_threads = 1;
+			candidates.push_back(params);
+
+			params.recording_mode = RecordingMode::PER_FRAME;
+			for (const auto t : thread_counts) {
+				params.num_threads = t;
+				candidates.push_back(params);
+			}
+		}
+	}
+
+	VkPhysicalDeviceProperties properties = {};
+	vkGetPhysicalDeviceProperties(physical_device, &properties);
+	std::cout << "Autotuning for " << tune_objective_name(objective) << " on " << properties.deviceName
+		<< ", " << candidates.size() << " configurations of " << base.draws_per_frame << " draws\n";
+
+	FrameBenchmarkParams best = base;
+	FrameBenchmarkResult best_result;
+	float best_cost = std::numeric_limits<float>::max();
+	for (const auto &params : candidates) {
+		const FrameBenchmarkResult result = run_frame_benchmark(device, physical_device, queue, queue_family, params);
+		print_frame_benchmark_result(params, result);
+		const float cost = tune_cost(result, params.num_threads, objective);
+		if (cost < best_cost) {
+			best_cost = cost;
+			best = params;
+			best_result = result;
+		}
+	}
+
+	std::cout << "Best: ";
+	print_frame_benchmark_result(best, best_result);
+
+	// Saved in the config file format so it can be loaded like any other config
+	const std::string path = tuned_config_path(physical_device);
+	std::ofstream fout(path.c_str());
+	fout << "# Tuned for " << tune_objective_name(objective) << " on " << properties.deviceName << "\n"
+		<< "# " << best_result.avg_frame_ms << " ms avg, " << best_result.p99_frame_ms << " ms p99, "
+		<< best_result.cpu_ms << " ms CPU, " << best_result.gpu_ms << " ms GPU\n"
+		<< "frames-in-flight = " << best.frames_in_flight << "\n"
+		<< "recording = " << recording_mode_name(best.recording_mode) << "\n"
+		<< "threads = " << best.num_threads << "\n"
+		<< "batch-size = " << best.batch_size << "\n";
+	if (fout) {
+		std::cout << "Saved tuned settings to " << path << "\n";
+	} else {
+		std::cout << "Failed to save tuned settings to " << path << "\n";
+	}
+	return best;
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <string>
+#include <vulkan/vulkan.h>
+#include "frame_benchmark.h"
+
+enum class TuneObjective {
+	// Highest average frame rate
+	THROUGHPUT,
+	// Lowest 99th percentile frame time
+	P99_FRAME_TIME,
+	// Least CPU and GPU busy time per frame, as a proxy for power use
+	POWER
+};
+
+const char* tune_objective_name(TuneObjective objective);
+
+bool parse_tune_objective(const std::string &name, TuneObjective &objective);
+
+// Lower is better
+float tune_cost(const FrameBenchmarkResult &result, uint32_t num_threads, TuneObjective objective);
+
+// Hex string of the device UUID, which identifies the GPU model and driver
+std::string device_uuid(VkPhysicalDevice physical_device);
+
+// The config file the tuned settings for the device are saved in
+std::string tuned_config_path(VkPhysicalDevice physical_device);
+
+// Run the frame benchmark across frames in flight, recording modes, thread counts and batch
+// sizes, save the best settings for the objective to the device's tuned config file and
+// return them. The draw count and frames per run are taken from base
+FrameBenchmarkParams run_autotune(VkDevice device, VkPhysicalDevice physical_device, VkQueue queue,
+		uint32_t queue_family, TuneObjective objective, const FrameBenchmarkParams &base);
+
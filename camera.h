@@ -0,0 +1,22 @@
+#pragma once
+
+#include "linalg.h"
+
+struct Camera {
+	vec3 position = vec3(0.f, 2.f, 6.f);
+	vec3 target = vec3(0.f, 0.f, 0.f);
+	vec3 up = vec3(0.f, 1.f, 0.f);
+	float fovy = 0.8f;
+	float aspect = 16.f / 9.f;
+	float near_plane = 0.1f;
+	float far_plane = 100.f;
+
+	mat4 view() const {
+		return look_at(position, target, up);
+	}
+
+	mat4 proj() const {
+		return perspective(fovy, aspect, near_plane, far_plane);
+	}
+};
+
@@ -0,0 +1,40 @@
+# Locate the SDL2_ttf library
+# This module defines
+# SDL2_TTF_LIBRARY, the library to link against
+# SDL2_TTF_INCLUDE_DIR, where to find SDL_ttf.h
+# SDL2_TTF_FOUND, if false, do not try to link to SDL2_ttf
+#
+# $SDL2TTFDIR or $SDL2 are environment variables pointing to the prefix SDL2_ttf
+# was installed to, the same as the ./configure --prefix used when building it.
+
+find_path(SDL2_TTF_INCLUDE_DIR SDL_ttf.h
+	HINTS
+	$ENV{SDL2TTFDIR}
+	$ENV{SDL2}
+	PATH_SUFFIXES include/SDL2 include
+	PATHS
+	~/Library/Frameworks
+	/Library/Frameworks
+	/usr/local/include/SDL2
+	/usr/include/SDL2
+	/sw
+	/opt/local
+	/opt/csw
+	/opt
+)
+
+find_library(SDL2_TTF_LIBRARY
+	NAMES SDL2_ttf
+	HINTS
+	$ENV{SDL2TTFDIR}
+	$ENV{SDL2}
+	PATH_SUFFIXES lib64 lib lib/x64
+	PATHS
+	/sw
+	/opt/local
+	/opt/csw
+	/opt
+)
+
+include(FindPackageHandleStandardArgs)
+find_package_handle_standard_args(SDL2_ttf REQUIRED_VARS SDL2_TTF_LIBRARY SDL2_TTF_INCLUDE_DIR)
@@ -0,0 +1,464 @@
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <limits>
+#include <sstream>
+#include "compute_batch.h"
+#include "spirv_shaders_embedded_spv.h"
+#include "vulkan_utils.h"
+
+// Every this many pixels of each batch are checked against the CPU result
+static const uint32_t verify_stride = 4099;
+static const uint32_t workgroup_size = 256;
+
+const char* compute_kernel_name(ComputeKernel kernel) {
+	switch (kernel) {
+		case ComputeKernel::INVERT: return "invert";
+		case ComputeKernel::GRAYSCALE: return "grayscale";
+		case ComputeKernel::THRESHOLD: return "threshold";
+	}
+	return "unknown";
+}
+
+bool parse_compute_kernel(const std::string &name, ComputeKernel &kernel) {
+	for (const auto k : { ComputeKernel::INVERT, ComputeKernel::GRAYSCALE, ComputeKernel::THRESHOLD }) {
+		if (name == compute_kernel_name(k)) {
+			kernel = k;
+			return true;
+		}
+	}
+	return false;
+}
+
+bool parse_compute_kernels(const std::string &names, std::vector<ComputeKernel> &kernels) {
+	std::vector<ComputeKernel> parsed;
+	std::stringstream ss(names);
+	std::string name;
+	while (std::getline(ss, name, ',')) {
+		ComputeKernel k;
+		if (!parse_compute_kernel(name, k)) {
+			return false;
+		}
+		parsed.push_back(k);
+	}
+	if (parsed.empty()) {
+		return false;
+	}
+	kernels = parsed;
+	return true;
+}
+
+// The input data, a cheap hash of the pixel index so every batch is different
+static uint32_t input_pixel(uint64_t i) {
+	uint32_t x = uint32_t(i) ^ uint32_t(i >> 32) * 0x9e3779b9u;
+	x ^= x >> 16;
+	x *= 0x7feb352du;
+	x ^= x >> 15;
+	return x;
+}
+
+// Same as the shaders' unpackUnorm4x8 and packUnorm4x8
+static std::array<float, 4> unpack_pixel(uint32_t p) {
+	std::array<float, 4> c;
+	for (int i = 0; i < 4; ++i) {
+		c[i] = float((p >> (8 * i)) & 0xff) / 255.f;
+	}
+	return c;
+}
+
+static uint32_t pack_pixel(const std::array<float, 4> &c) {
+	uint32_t p = 0;
+	for (int i = 0; i < 4; ++i) {
+		p |= uint32_t(std::round(std::min(std::max(c[i], 0.f), 1.f) * 255.f)) << (8 * i);
+	}
+	return p;
+}
+
+static uint32_t apply_kernel(ComputeKernel kernel, uint32_t pixel) {
+	std::array<float, 4> c = unpack_pixel(pixel);
+	switch (kernel) {
+		case ComputeKernel::INVERT:
+			for (int i = 0; i < 3; ++i) {
+				c[i] = 1.f - c[i];
+			}
+			break;
+		case ComputeKernel::GRAYSCALE: {
+			const float luma = c[0] * 0.2126f + c[1] * 0.7152f + c[2] * 0.0722f;
+			c[0] = c[1] = c[2] = luma;
+			break;
+		}
+		case ComputeKernel::THRESHOLD:
+			for (int i = 0; i < 3; ++i) {
+				c[i] = c[i] < 0.5f ? 0.f : 1.f;
+			}
+			break;
+	}
+	return pack_pixel(c);
+}
+
+// Allow rounding differences between the GPU and CPU of 1 in each channel
+static bool pixels_match(uint32_t a, uint32_t b) {
+	for (int i = 0; i < 4; ++i) {
+		const int ca = (a >> (8 * i)) & 0xff;
+		const int cb = (b >> (8 * i)) & 0xff;
+		if (std::abs(ca - cb) > 1) {
+			return false;
+		}
+	}
+	return true;
+}
+
+static VkPipeline create_kernel_pipeline(VkDevice device, VkPipelineLayout layout, ComputeKernel kernel) {
+	VkShaderModule module = VK_NULL_HANDLE;
+	switch (kernel) {
+		case ComputeKernel::INVERT:
+			module = create_shader_module(device, compute_invert_spv, sizeof(compute_invert_spv));
+			break;
+		case ComputeKernel::GRAYSCALE:
+			module = create_shader_module(device, compute_grayscale_spv, sizeof(compute_grayscale_spv));
+			break;
+		case ComputeKernel::THRESHOLD:
+			module = create_shader_module(device, compute_threshold_spv, sizeof(compute_threshold_spv));
+			break;
+	}
+
+	VkComputePipelineCreateInfo create_info = {};
+	create_info.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+	create_info.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	create_info.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+	create_info.stage.module = module;
+	create_info.stage.pName = "main";
+	create_info.layout = layout;
+
+	VkPipeline pipeline = VK_NULL_HANDLE;
+	CHECK_VULKAN(vkCreateComputePipelines(device, pipeline_cache(), 1, &create_info, nullptr, &pipeline));
+	vkDestroyShaderModule(device, module, nullptr);
+	return pipeline;
+}
+
+static void memory_barrier(VkCommandBuffer cmd_buf, VkAccessFlags src_access, VkAccessFlags dst_access,
+		VkPipelineStageFlags src_stage, VkPipelineStageFlags dst_stage)
+{
+	VkMemoryBarrier barrier = {};
+	barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	barrier.srcAccessMask = src_access;
+	barrier.dstAccessMask = dst_access;
+	vkCmdPipelineBarrier(cmd_buf, src_stage, dst_stage, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+}
+
+// One of the two sets of buffers batches alternate between
+struct BatchSlot {
+	Buffer upload;
+	Buffer work;
+	Buffer readback;
+	uint32_t *upload_data = nullptr;
+	const uint32_t *readback_data = nullptr;
+	bool readback_coherent = true;
+	VkDescriptorSet desc_set = VK_NULL_HANDLE;
+	VkCommandBuffer cmd_buf = VK_NULL_HANDLE;
+	VkFence fence = VK_NULL_HANDLE;
+
+	bool in_flight = false;
+	uint64_t first_pixel = 0;
+	uint32_t num_pixels = 0;
+};
+
+ComputeBatchResult run_compute_batch(VkDevice device, VkPhysicalDevice physical_device, VkQueue queue,
+		uint32_t queue_family, const ComputeBatchParams &params)
+{
+	VkPhysicalDeviceProperties properties = {};
+	vkGetPhysicalDeviceProperties(physical_device, &properties);
+	uint32_t num_families = 0;
+	vkGetPhysicalDeviceQueueFamilyProperties(physical_device, &num_families, nullptr);
+	std::vector<VkQueueFamilyProperties> family_props(num_families, VkQueueFamilyProperties{});
+	vkGetPhysicalDeviceQueueFamilyProperties(physical_device, &num_families, family_props.data());
+	const bool gpu_timing = family_props[queue_family].timestampValidBits != 0;
+
+	const VkDeviceSize batch_bytes = std::min(params.batch_bytes, params.total_bytes) / 4 * 4;
+	const uint64_t total_pixels = params.total_bytes / 4;
+	const uint32_t batch_pixels = uint32_t(batch_bytes / 4);
+	const uint64_t num_batches = (total_pixels + batch_pixels - 1) / batch_pixels;
+
+	VkDescriptorSetLayout desc_layout = VK_NULL_HANDLE;
+	{
+		VkDescriptorSetLayoutBinding binding = {};
+		binding.binding = 0;
+		binding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		binding.descriptorCount = 1;
+		binding.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+
+		VkDescriptorSetLayoutCreateInfo info = {};
+		info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+		info.bindingCount = 1;
+		info.pBindings = &binding;
+		CHECK_VULKAN(vkCreateDescriptorSetLayout(device, &info, nullptr, &desc_layout));
+	}
+
+	VkPipelineLayout pipeline_layout = VK_NULL_HANDLE;
+	{
+		VkPushConstantRange push_range = {};
+		push_range.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+		push_range.size = sizeof(uint32_t);
+
+		VkPipelineLayoutCreateInfo info = {};
+		info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+		info.setLayoutCount = 1;
+		info.pSetLayouts = &desc_layout;
+		info.pushConstantRangeCount = 1;
+		info.pPushConstantRanges = &push_range;
+		CHECK_VULKAN(vkCreatePipelineLayout(device, &info, nullptr, &pipeline_layout));
+	}
+
+	std::vector<VkPipeline> pipelines;
+	for (const auto k : params.kernels) {
+		pipelines.push_back(create_kernel_pipeline(device, pipeline_layout, k));
+	}
+
+	std::array<BatchSlot, 2> slots;
+
+	VkDescriptorPool desc_pool = VK_NULL_HANDLE;
+	{
+		VkDescriptorPoolSize pool_size = {};
+		pool_size.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		pool_size.descriptorCount = slots.size();
+
+		VkDescriptorPoolCreateInfo info = {};
+		info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+		info.maxSets = slots.size();
+		info.poolSizeCount = 1;
+		info.pPoolSizes = &pool_size;
+		CHECK_VULKAN(vkCreateDescriptorPool(device, &info, nullptr, &desc_pool));
+	}
+
+	VkCommandPool command_pool = VK_NULL_HANDLE;
+	{
+		VkCommandPoolCreateInfo info = {};
+		info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+		info.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+		info.queueFamilyIndex = queue_family;
+		CHECK_VULKAN(vkCreateCommandPool(device, &info, nullptr, &command_pool));
+	}
+
+	// Two timestamps around each slot's kernel chain
+	VkQueryPool query_pool = VK_NULL_HANDLE;
+	if (gpu_timing) {
+		VkQueryPoolCreateInfo info = {};
+		info.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+		info.queryType = VK_QUERY_TYPE_TIMESTAMP;
+		info.queryCount = 2 * slots.size();
+		CHECK_VULKAN(vkCreateQueryPool(device, &info, nullptr, &query_pool));
+	}
+
+	for (auto &s : slots) {
+		s.upload = create_buffer(device, physical_device, batch_bytes, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+		s.work = create_buffer(device, physical_device, batch_bytes,
+				VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+				VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+		// Reading uncached memory from the CPU is slow, so read back through cached memory if
+		// there is some and invalidate it before reading
+		try {
+			s.readback = create_buffer(device, physical_device, batch_bytes, VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+					VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_CACHED_BIT);
+			s.readback_coherent = false;
+		} catch (const std::runtime_error &) {
+			s.readback = create_buffer(device, physical_device, batch_bytes, VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+					VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+		}
+
+		void *mapping = nullptr;
+		CHECK_VULKAN(vkMapMemory(device, s.upload.mem, 0, VK_WHOLE_SIZE, 0, &mapping));
+		s.upload_data = reinterpret_cast<uint32_t*>(mapping);
+		CHECK_VULKAN(vkMapMemory(device, s.readback.mem, 0, VK_WHOLE_SIZE, 0, &mapping));
+		s.readback_data = reinterpret_cast<const uint32_t*>(mapping);
+
+		VkDescriptorSetAllocateInfo alloc_info = {};
+		alloc_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+		alloc_info.descriptorPool = desc_pool;
+		alloc_info.descriptorSetCount = 1;
+		alloc_info.pSetLayouts = &desc_layout;
+		CHECK_VULKAN(vkAllocateDescriptorSets(device, &alloc_info, &s.desc_set));
+
+		VkDescriptorBufferInfo buf_info = {};
+		buf_info.buffer = s.work.buffer;
+		buf_info.range = VK_WHOLE_SIZE;
+
+		VkWriteDescriptorSet write = {};
+		write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		write.dstSet = s.desc_set;
+		write.dstBinding = 0;
+		write.descriptorCount = 1;
+		write.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		write.pBufferInfo = &buf_info;
+		vkUpdateDescriptorSets(device, 1, &write, 0, nullptr);
+
+		VkCommandBufferAllocateInfo cmd_info = {};
+		cmd_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+		cmd_info.commandPool = command_pool;
+		cmd_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+		cmd_info.commandBufferCount = 1;
+		CHECK_VULKAN(vkAllocateCommandBuffers(device, &cmd_info, &s.cmd_buf));
+
+		VkFenceCreateInfo fence_info = {};
+		fence_info.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+		CHECK_VULKAN(vkCreateFence(device, &fence_info, nullptr, &s.fence));
+	}
+
+	std::cout << "Compute batch: " << params.total_bytes / (1024 * 1024) << "MB in " << num_batches
+		<< " batches of " << batch_bytes / (1024 * 1024) << "MB through";
+	for (const auto k : params.kernels) {
+		std::cout << " " << compute_kernel_name(k);
+	}
+	std::cout << "\n";
+
+	ComputeBatchResult result;
+	double kernel_seconds = 0.0;
+
+	// Wait for the slot's batch and check some of the results against the CPU
+	auto finish_batch = [&](BatchSlot &s, size_t slot_index) {
+		CHECK_VULKAN(vkWaitForFences(device, 1, &s.fence, true, std::numeric_limits<uint64_t>::max()));
+		CHECK_VULKAN(vkResetFences(device, 1, &s.fence));
+		s.in_flight = false;
+
+		if (!s.readback_coherent) {
+			VkMappedMemoryRange range = {};
+			range.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
+			range.memory = s.readback.mem;
+			range.size = VK_WHOLE_SIZE;
+			CHECK_VULKAN(vkInvalidateMappedMemoryRanges(device, 1, &range));
+		}
+
+		for (uint32_t i = 0; i < s.num_pixels; i += verify_stride) {
+			uint32_t expected = input_pixel(s.first_pixel + i);
+			for (const auto k : params.kernels) {
+				expected = apply_kernel(k, expected);
+			}
+			if (!pixels_match(s.readback_data[i], expected)) {
+				++result.mismatches;
+			}
+		}
+
+		if (gpu_timing) {
+			std::array<uint64_t, 2> timestamps = {};
+			CHECK_VULKAN(vkGetQueryPoolResults(device, query_pool, 2 * slot_index, 2, sizeof(timestamps),
+					timestamps.data(), sizeof(uint64_t), VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT));
+			kernel_seconds += (timestamps[1] - timestamps[0]) * properties.limits.timestampPeriod * 1e-9;
+		}
+	};
+
+	const auto start = std::chrono::steady_clock::now();
+	for (uint64_t b = 0; b < num_batches; ++b) {
+		const size_t slot_index = b % slots.size();
+		BatchSlot &s = slots[slot_index];
+		if (s.in_flight) {
+			finish_batch(s, slot_index);
+		}
+
+		s.first_pixel = b * batch_pixels;
+		s.num_pixels = uint32_t(std::min(uint64_t(batch_pixels), total_pixels - s.first_pixel));
+		for (uint32_t i = 0; i < s.num_pixels; ++i) {
+			s.upload_data[i] = input_pixel(s.first_pixel + i);
+		}
+		const VkDeviceSize bytes = VkDeviceSize(s.num_pixels) * 4;
+
+		CHECK_VULKAN(vkResetCommandBuffer(s.cmd_buf, 0));
+		VkCommandBufferBeginInfo begin_info = {};
+		begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+		begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+		CHECK_VULKAN(vkBeginCommandBuffer(s.cmd_buf, &begin_info));
+
+		VkBufferCopy region = {};
+		region.size = bytes;
+		vkCmdCopyBuffer(s.cmd_buf, s.upload.buffer, s.work.buffer, 1, &region);
+		memory_barrier(s.cmd_buf, VK_ACCESS_TRANSFER_WRITE_BIT,
+				VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT,
+				VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+
+		if (gpu_timing) {
+			vkCmdResetQueryPool(s.cmd_buf, query_pool, 2 * slot_index, 2);
+			vkCmdWriteTimestamp(s.cmd_buf, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, query_pool, 2 * slot_index);
+		}
+
+		// Loop in the kernels if there are more groups than can be dispatched at once
+		const uint32_t num_groups = std::min((s.num_pixels + workgroup_size - 1) / workgroup_size,
+				properties.limits.maxComputeWorkGroupCount[0]);
+		vkCmdBindDescriptorSets(s.cmd_buf, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline_layout, 0, 1,
+				&s.desc_set, 0, nullptr);
+		vkCmdPushConstants(s.cmd_buf, pipeline_layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(uint32_t),
+				&s.num_pixels);
+		for (size_t i = 0; i < pipelines.size(); ++i) {
+			if (i > 0) {
+				memory_barrier(s.cmd_buf, VK_ACCESS_SHADER_WRITE_BIT,
+						VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT,
+						VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+			}
+			vkCmdBindPipeline(s.cmd_buf, VK_PIPELINE_BIND_POINT_COMPUTE, pipelines[i]);
+			vkCmdDispatch(s.cmd_buf, num_groups, 1, 1);
+		}
+
+		if (gpu_timing) {
+			vkCmdWriteTimestamp(s.cmd_buf, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, query_pool, 2 * slot_index + 1);
+		}
+
+		memory_barrier(s.cmd_buf, VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_TRANSFER_READ_BIT,
+				VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+		vkCmdCopyBuffer(s.cmd_buf, s.work.buffer, s.readback.buffer, 1, &region);
+		memory_barrier(s.cmd_buf, VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_HOST_READ_BIT,
+				VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT);
+
+		CHECK_VULKAN(vkEndCommandBuffer(s.cmd_buf));
+
+		VkSubmitInfo submit_info = {};
+		submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+		submit_info.commandBufferCount = 1;
+		submit_info.pCommandBuffers = &s.cmd_buf;
+		CHECK_VULKAN(vkQueueSubmit(queue, 1, &submit_info, s.fence));
+		s.in_flight = true;
+	}
+	// Finish the remaining batches in the order they were submitted
+	for (uint64_t b = num_batches > slots.size() ? num_batches - slots.size() : 0; b < num_batches; ++b) {
+		const size_t slot_index = b % slots.size();
+		if (slots[slot_index].in_flight) {
+			finish_batch(slots[slot_index], slot_index);
+		}
+	}
+	const auto end = std::chrono::steady_clock::now();
+
+	result.seconds = std::chrono::duration<double>(end - start).count();
+	result.gb_per_s = params.total_bytes / result.seconds * 1e-9;
+	if (kernel_seconds > 0.0) {
+		result.kernel_gb_per_s = params.total_bytes / kernel_seconds * 1e-9;
+	}
+
+	for (auto &s : slots) {
+		vkUnmapMemory(device, s.upload.mem);
+		vkUnmapMemory(device, s.readback.mem);
+		destroy_buffer(device, s.upload);
+		destroy_buffer(device, s.work);
+		destroy_buffer(device, s.readback);
+		vkDestroyFence(device, s.fence, nullptr);
+	}
+	if (query_pool != VK_NULL_HANDLE) {
+		vkDestroyQueryPool(device, query_pool, nullptr);
+	}
+	vkDestroyCommandPool(device, command_pool, nullptr);
+	vkDestroyDescriptorPool(device, desc_pool, nullptr);
+	for (auto &p : pipelines) {
+		vkDestroyPipeline(device, p, nullptr);
+	}
+	vkDestroyPipelineLayout(device, pipeline_layout, nullptr);
+	vkDestroyDescriptorSetLayout(device, desc_layout, nullptr);
+	return result;
+}
+
+void print_compute_batch_result(const ComputeBatchParams &params, const ComputeBatchResult &result) {
+	std::cout << "Processed " << params.total_bytes / (1024 * 1024) << "MB in " << result.seconds * 1000.0
+		<< "ms: " << result.gb_per_s << " GB/s including uploads and readbacks";
+	if (result.kernel_gb_per_s > 0.0) {
+		std::cout << ", " << result.kernel_gb_per_s << " GB/s in the kernels";
+	}
+	std::cout << ", " << result.mismatches << " mismatches\n";
+}
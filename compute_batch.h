@@ -0,0 +1,48 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <vulkan/vulkan.h>
+
+// The kernels which can be chained in the compute-only mode, each runs in place over a buffer
+// of RGBA8 pixels
+enum class ComputeKernel {
+	INVERT,
+	GRAYSCALE,
+	// Each channel to 0 or 1 at 0.5
+	THRESHOLD
+};
+
+const char* compute_kernel_name(ComputeKernel kernel);
+
+bool parse_compute_kernel(const std::string &name, ComputeKernel &kernel);
+
+// Parse a comma separated list of kernel names
+bool parse_compute_kernels(const std::string &names, std::vector<ComputeKernel> &kernels);
+
+struct ComputeBatchParams {
+	std::vector<ComputeKernel> kernels = { ComputeKernel::GRAYSCALE, ComputeKernel::THRESHOLD };
+	// Total data to process, split into batches which are uploaded, processed by the chain
+	// of kernels and read back
+	VkDeviceSize total_bytes = VkDeviceSize(1) << 30;
+	VkDeviceSize batch_bytes = VkDeviceSize(64) << 20;
+};
+
+struct ComputeBatchResult {
+	double seconds = 0.0;
+	// Data processed per second, counting each byte once
+	double gb_per_s = 0.0;
+	// Data processed per second of GPU time spent in the kernel chain, 0 if the queue doesn't
+	// support timestamps
+	double kernel_gb_per_s = 0.0;
+	// Pixels in the read back data which didn't match the CPU result
+	uint64_t mismatches = 0;
+};
+
+// Process the data in batches with two sets of buffers, so the CPU fills the next batch's
+// upload buffer and reads back the previous batch while the GPU processes the current one
+ComputeBatchResult run_compute_batch(VkDevice device, VkPhysicalDevice physical_device, VkQueue queue,
+		uint32_t queue_family, const ComputeBatchParams &params);
+
+void print_compute_batch_result(const ComputeBatchParams &params, const ComputeBatchResult &result);
+
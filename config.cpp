@@ -0,0 +1,354 @@
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <thread>
+#include "config.h"
+
+static const char *env_prefix = "SDL2_VULKAN_";
+static const char *default_config_file = "sdl2_vulkan.cfg";
+
+// Options which take no value on the command line
+static const std::array<const char*, 6> flag_options = { "shadows", "hud", "ui", "compute", "vt", "software" };
+
+// All options, for reading them from the environment
+static const std::array<const char*, 56> option_names = {
+	"width", "height", "validation", "layers", "device", "swapchain-images", "clear-color",
+	"present-mode", "msaa", "frames-in-flight", "recording", "threads", "pipeline-cache",
+	"snapshot", "views", "shadows", "oit", "transparent", "oit-bench", "hud", "font", "font-size", "ui",
+	"bench", "autotune", "draws", "batch-size", "draw-sort", "state-tracking", "tuned", "compute", "kernels",
+	"compute-size", "compute-batch", "prim-bench", "particles", "particle-bench", "vt", "vt-sparse",
+	"vt-pages", "output", "server", "connect", "external-memory", "view-batch", "view-batch-size",
+	"view-size", "view-cubemaps", "view-atlas", "submit2", "software", "software-fallback", "defrag-budget",
+	"geometry-churn", "config", "help"
+};
+
+static std::string trim(const std::string &s) {
+	const size_t begin = s.find_first_not_of(" \t\r\n");
+	if (begin == std::string::npos) {
+		return "";
+	}
+	const size_t end = s.find_last_not_of(" \t\r\n");
+	return s.substr(begin, end - begin + 1);
+}
+
+static std::vector<std::string> split(const std::string &s, char sep) {
+	std::vector<std::string> parts;
+	std::stringstream ss(s);
+	std::string part;
+	while (std::getline(ss, part, sep)) {
+		part = trim(part);
+		if (!part.empty()) {
+			parts.push_back(part);
+		}
+	}
+	return parts;
+}
+
+static bool parse_bool(const std::string &s, bool &value) {
+	if (s == "1" || s == "true" || s == "on" || s == "yes") {
+		value = true;
+		return true;
+	}
+	if (s == "0" || s == "false" || s == "off" || s == "no") {
+		value = false;
+		return true;
+	}
+	return false;
+}
+
+static bool parse_uint(const std::string &s, uint32_t min_value, uint32_t max_value, uint32_t &value) {
+	if (s.empty() || !std::isdigit(static_cast<unsigned char>(s[0]))) {
+		return false;
+	}
+	char *end = nullptr;
+	const unsigned long v = std::strtoul(s.c_str(), &end, 10);
+	if (*end != '\0' || v < min_value || v > max_value) {
+		return false;
+	}
+	value = v;
+	return true;
+}
+
+bool set_config_option(Config &config, const std::string &name, const std::string &value, std::string &error) {
+	bool valid = true;
+	uint32_t u = 0;
+	if (name == "width") {
+		valid = parse_uint(value, 64, 16384, config.window_width);
+	} else if (name == "height") {
+		valid = parse_uint(value, 64, 16384, config.window_height);
+	} else if (name == "validation") {
+		valid = parse_bool(value, config.validation);
+	} else if (name == "layers") {
+		config.validation_layers = split(value, ',');
+	} else if (name == "device") {
+		valid = !value.empty();
+		config.device = value;
+	} else if (name == "swapchain-images") {
+		valid = parse_uint(value, 0, 16, config.swapchain_images);
+	} else if (name == "clear-color") {
+		const std::vector<std::string> parts = split(value, ',');
+		valid = parts.size() == 3 || parts.size() == 4;
+		for (size_t i = 0; valid && i < parts.size(); ++i) {
+			char *end = nullptr;
+			config.clear_color[i] = std::strtof(parts[i].c_str(), &end);
+			valid = *end == '\0';
+		}
+	} else if (name == "present-mode") {
+		valid = parse_present_mode(value, config.render.present_mode);
+	} else if (name == "msaa") {
+		valid = parse_uint(value, 1, 8, u) && (u == 1 || u == 2 || u == 4 || u == 8);
+		config.render.msaa_samples = VkSampleCountFlagBits(valid ? u : 1);
+	} else if (name == "frames-in-flight") {
+		valid = parse_uint(value, 1, MAX_FRAMES_IN_FLIGHT, config.render.frames_in_flight);
+	} else if (name == "recording") {
+		valid = parse_recording_mode(value, config.render.recording_mode);
+	} else if (name == "threads") {
+		valid = parse_uint(value, 1, 256, config.num_threads);
+	} else if (name == "pipeline-cache") {
+		config.pipeline_cache_path = value;
+	} else if (name == "snapshot") {
+		config.snapshot_path = value;
+	} else if (name == "views") {
+		valid = parse_uint(value, 1, 32, config.num_views);
+	} else if (name == "shadows") {
+		valid = parse_bool(value, config.enable_shadows);
+	} else if (name == "oit") {
+		valid = parse_oit_mode(value, config.oit_mode);
+		config.enable_oit = valid;
+	} else if (name == "transparent") {
+		valid = parse_uint(value, 1, 1 << 24, config.num_transparent);
+	} else if (name == "oit-bench") {
+		valid = parse_uint(value, 0, 1 << 20, config.oit_bench_iterations);
+	} else if (name == "hud") {
+		valid = parse_bool(value, config.enable_hud);
+	} else if (name == "font") {
+		config.font_path = value;
+	} else if (name == "font-size") {
+		valid = parse_uint(value, 6, 256, u);
+		config.font_size = valid ? u : config.font_size;
+	} else if (name == "ui") {
+		valid = parse_bool(value, config.show_ui);
+	} else if (name == "bench") {
+		valid = parse_uint(value, 0, 1 << 20, config.bench_frames);
+	} else if (name == "autotune") {
+		valid = parse_tune_objective(value, config.autotune_objective);
+		config.autotune = valid;
+	} else if (name == "draws") {
+		valid = parse_uint(value, 1, 1 << 24, config.draws_per_frame);
+	} else if (name == "batch-size") {
+		valid = parse_uint(value, 1, 1 << 24, config.batch_size);
+	} else if (name == "draw-sort") {
+		valid = parse_bool(value, config.sort_draws);
+	} else if (name == "state-tracking") {
+		valid = parse_bool(value, config.track_draw_state);
+	} else if (name == "tuned") {
+		valid = parse_bool(value, config.use_tuned);
+	} else if (name == "prim-bench") {
+		valid = parse_uint(value, 0, 1 << 24, config.prim_bench_count);
+	} else if (name == "particles") {
+		valid = parse_uint(value, 0, 1 << 24, config.num_particles);
+	} else if (name == "particle-bench") {
+		valid = parse_uint(value, 0, 1 << 20, config.particle_bench_frames);
+	} else if (name == "vt") {
+		valid = parse_bool(value, config.virtual_texture);
+	} else if (name == "vt-sparse") {
+		valid = parse_bool(value, config.virtual_texture_sparse);
+	} else if (name == "vt-pages") {
+		// Pages per side, a power of two
+		valid = parse_uint(value, 1, 8192, u) && (u & (u - 1)) == 0;
+		config.vt.pages_wide = valid ? u : config.vt.pages_wide;
+	} else if (name == "output") {
+		config.output_target = value;
+	} else if (name == "server") {
+		config.server_socket = value;
+	} else if (name == "connect") {
+		config.connect_socket = value;
+	} else if (name == "external-memory") {
+		valid = parse_bool(value, config.external_memory);
+	} else if (name == "submit2") {
+		valid = parse_bool(value, config.submit2);
+	} else if (name == "software") {
+		valid = parse_bool(value, config.software);
+	} else if (name == "software-fallback") {
+		valid = parse_bool(value, config.software_fallback);
+	} else if (name == "defrag-budget") {
+		valid = parse_uint(value, 0, 1 << 20, config.defrag_budget_kb);
+	} else if (name == "geometry-churn") {
+		valid = parse_uint(value, 0, 1 << 20, config.geometry_churn_frames);
+	} else if (name == "view-batch") {
+		valid = parse_uint(value, 0, 1 << 20, config.view_batch.num_views);
+		config.view_batch_only = valid && config.view_batch.num_views > 0;
+	} else if (name == "view-batch-size") {
+		valid = parse_uint(value, 1, 2048, config.view_batch.views_per_submission);
+	} else if (name == "view-size") {
+		valid = parse_uint(value, 1, 4096, u);
+		config.view_batch.view_extent = valid ? VkExtent2D{ u, u } : config.view_batch.view_extent;
+	} else if (name == "view-cubemaps") {
+		valid = parse_bool(value, config.view_batch.cubemaps);
+	} else if (name == "view-atlas") {
+		config.view_batch.atlas_path = value;
+	} else if (name == "compute") {
+		valid = parse_bool(value, config.compute_only);
+	} else if (name == "kernels") {
+		valid = parse_compute_kernels(value, config.compute.kernels);
+	} else if (name == "compute-size") {
+		valid = parse_uint(value, 1, 1 << 20, u);
+		config.compute.total_bytes = valid ? VkDeviceSize(u) << 20 : config.compute.total_bytes;
+	} else if (name == "compute-batch") {
+		valid = parse_uint(value, 1, 1024, u);
+		config.compute.batch_bytes = valid ? VkDeviceSize(u) << 20 : config.compute.batch_bytes;
+	} else {
+		error = "Unknown option " + name;
+		return false;
+	}
+	if (!valid) {
+		error = "Invalid value '" + value + "' for option " + name;
+		return false;
+	}
+	config.set_options.insert(name);
+	return true;
+}
+
+bool load_config_file(Config &config, const std::string &path, std::string &error, bool keep_set_options) {
+	std::ifstream fin(path.c_str());
+	if (!fin) {
+		error = "Failed to open config file " + path;
+		return false;
+	}
+	std::string line;
+	for (int line_num = 1; std::getline(fin, line); ++line_num) {
+		line = trim(line.substr(0, line.find('#')));
+		if (line.empty()) {
+			continue;
+		}
+		const size_t eq = line.find('=');
+		if (eq == std::string::npos) {
+			error = path + ":" + std::to_string(line_num) + ": expected name = value";
+			return false;
+		}
+		const std::string name = trim(line.substr(0, eq));
+		if (keep_set_options && config.set_options.count(name)) {
+			continue;
+		}
+		if (!set_config_option(config, name, trim(line.substr(eq + 1)), error)) {
+			error = path + ":" + std::to_string(line_num) + ": " + error;
+			return false;
+		}
+	}
+	return true;
+}
+
+static std::string env_name(const std::string &option) {
+	std::string name = env_prefix + option;
+	for (auto &c : name) {
+		c = c == '-' ? '_' : std::toupper(static_cast<unsigned char>(c));
+	}
+	return name;
+}
+
+static void print_usage() {
+	std::cout << "Options, also read from the config file and SDL2_VULKAN_* environment variables:\n";
+	for (const auto &o : option_names) {
+		std::cout << "  --" << o << "\n";
+	}
+}
+
+bool load_config(int argc, const char **argv, Config &config) {
+	config.num_threads = std::max(std::thread::hardware_concurrency(), 1u);
+
+	// Find the config file first since everything else overrides it
+	std::string config_path;
+	bool config_required = false;
+	if (const char *env = std::getenv(env_name("config").c_str())) {
+		config_path = env;
+		config_required = true;
+	}
+	for (int i = 1; i + 1 < argc; ++i) {
+		if (std::string(argv[i]) == "--config") {
+			config_path = argv[i + 1];
+			config_required = true;
+		}
+	}
+	if (config_path.empty()) {
+		config_path = default_config_file;
+	}
+
+	std::string error;
+	if (config_required || std::ifstream(config_path.c_str())) {
+		if (!load_config_file(config, config_path, error)) {
+			std::cerr << error << "\n";
+			return false;
+		}
+		std::cout << "Loaded config " << config_path << "\n";
+	}
+
+	for (const auto &o : option_names) {
+		const char *env = std::getenv(env_name(o).c_str());
+		if (!env || std::string(o) == "config" || std::string(o) == "help") {
+			continue;
+		}
+		if (!set_config_option(config, o, env, error)) {
+			std::cerr << env_name(o) << ": " << error << "\n";
+			return false;
+		}
+	}
+
+	for (int i = 1; i < argc; ++i) {
+		const std::string arg = argv[i];
+		if (arg.size() < 3 || arg.compare(0, 2, "--") != 0) {
+			std::cerr << "Unexpected argument " << arg << "\n";
+			return false;
+		}
+		const std::string name = arg.substr(2);
+		if (name == "help") {
+			print_usage();
+			return false;
+		}
+		std::string value;
+		const bool is_flag = std::find(flag_options.begin(), flag_options.end(), name) != flag_options.end();
+		if (is_flag) {
+			value = "1";
+		} else if (name == "oit-bench" || name == "bench" || name == "autotune" || name == "prim-bench"
+				|| name == "particle-bench" || name == "geometry-churn" || name == "view-batch")
+		{
+			// The iteration count, frame count, objective or value count is optional
+			value = name == "oit-bench" ? "200" : name == "bench" ? "300"
+				: name == "prim-bench" ? "4194304" : name == "particle-bench" || name == "geometry-churn" ? "600"
+				: name == "view-batch" ? "256" : "throughput";
+			if (i + 1 < argc && argv[i + 1][0] != '-') {
+				value = argv[++i];
+			}
+		} else if (i + 1 < argc) {
+			value = argv[++i];
+		} else {
+			std::cerr << "Missing value for " << arg << "\n";
+			return false;
+		}
+		if (name == "config") {
+			continue;
+		}
+		if (!set_config_option(config, name, value, error)) {
+			std::cerr << error << "\n";
+			return false;
+		}
+	}
+	return true;
+}
+
+void print_config(const Config &config) {
+	std::cout << "Config:\n"
+		<< "  window " << config.window_width << "x" << config.window_height << "\n"
+		<< "  validation " << (config.validation ? "on" : "off") << "\n"
+		<< "  device " << config.device << "\n"
+		<< "  present mode " << present_mode_name(config.render.present_mode) << "\n"
+		<< "  swapchain images " << config.swapchain_images << "\n"
+		<< "  msaa " << config.render.msaa_samples << "x\n"
+		<< "  frames in flight " << config.render.frames_in_flight << "\n"
+		<< "  recording " << recording_mode_name(config.render.recording_mode) << "\n"
+		<< "  threads " << config.num_threads << "\n"
+		<< "  pipeline cache " << (config.pipeline_cache_path.empty() ? "none" : config.pipeline_cache_path) << "\n"
+		<< "  snapshot " << (config.snapshot_path.empty() ? "none" : config.snapshot_path) << "\n";
+}
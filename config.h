@@ -0,0 +1,138 @@
+#pragma once
+
+#include <array>
+#include <set>
+#include <string>
+#include <vector>
+#include "autotune.h"
+#include "compute_batch.h"
+#include "oit.h"
+#include "settings.h"
+#include "view_batch.h"
+#include "virtual_texture.h"
+
+// Everything configurable about a run. Options are read from the config file, then from
+// SDL2_VULKAN_* environment variables and then the command line, each overriding the last.
+// The option names are the same in all three, e.g. the "frames-in-flight" option is set by
+// "frames-in-flight = 2" in the file, SDL2_VULKAN_FRAMES_IN_FLIGHT=2 in the environment or
+// --frames-in-flight 2 on the command line.
+struct Config {
+	uint32_t window_width = 1280;
+	uint32_t window_height = 720;
+
+	bool validation = true;
+	std::vector<std::string> validation_layers = { "VK_LAYER_KHRONOS_validation" };
+
+	// "discrete" prefers a discrete GPU and falls back to an integrated one, "integrated" the
+	// reverse. Otherwise the index of the device or a substring of its name
+	std::string device = "discrete";
+
+	// Swapchain image count, 0 picks based on the present mode
+	uint32_t swapchain_images = 0;
+	std::array<float, 4> clear_color = { 0.f, 0.f, 0.f, 1.f };
+
+	RenderSettings render;
+	// Worker threads for CPU side work
+	uint32_t num_threads = 1;
+	// Pipelines are created through a pipeline cache loaded from and saved to this file if set
+	std::string pipeline_cache_path;
+	// The device choice, pipeline cache and font atlas are reused from this snapshot file if
+	// they still match, and saved to it on exit. An explicit pipeline cache file takes precedence
+	std::string snapshot_path;
+
+	// Number of views to render with multiview, 1 renders directly to the swapchain as usual
+	uint32_t num_views = 1;
+	bool enable_shadows = false;
+	bool enable_oit = false;
+	OITMode oit_mode = OITMode::WEIGHTED_BLENDED;
+	// Number of transparent quads to render with OIT, and the benchmark iterations if running it
+	uint32_t num_transparent = 4096;
+	uint32_t oit_bench_iterations = 0;
+	// Show the profiler HUD, using the TTF font if given or the built in bitmap font
+	bool enable_hud = false;
+	std::string font_path;
+	int font_size = 16;
+	// Show the settings UI at startup, F1 toggles it
+	bool show_ui = false;
+
+	// Run the headless frame benchmark for this many frames and exit, or autotune the
+	// settings for the objective and exit
+	uint32_t bench_frames = 0;
+	bool autotune = false;
+	TuneObjective autotune_objective = TuneObjective::THROUGHPUT;
+	// The benchmark's workload, draws per frame recorded in batches
+	uint32_t draws_per_frame = 4096;
+	uint32_t batch_size = 256;
+	// Sort the benchmark's draws by state before recording them, and skip binding the state
+	// that's already bound
+	bool sort_draws = true;
+	bool track_draw_state = true;
+	// Load the settings saved by autotuning on this device, for the options not set otherwise
+	bool use_tuned = true;
+
+	// Run the GPU primitives benchmark over this many values and exit
+	uint32_t prim_bench_count = 0;
+
+	// Particles simulated and drawn on the GPU, 0 for none, and the frames to run the
+	// particle benchmark for before exiting
+	uint32_t num_particles = 0;
+	uint32_t particle_bench_frames = 0;
+
+	// Draw terrain with a streamed virtual texture, using sparse residency if allowed and
+	// supported
+	bool virtual_texture = false;
+	bool virtual_texture_sparse = true;
+	VirtualTextureParams vt;
+
+	// Stream the rendered frames to this file, or to the stdin of the command after a '|'
+	std::string output_target;
+
+	// Run the headless render server on this Unix domain socket instead of the window
+	std::string server_socket;
+	// Connect to the render server on this socket as a test client instead of the window
+	std::string connect_socket;
+	// Share render targets between the server and clients as external memory if supported
+	bool external_memory = true;
+
+	// Submit the frames with vkQueueSubmit2 if VK_KHR_synchronization2 is supported
+	bool submit2 = true;
+
+	// Draw the window with the CPU software renderer instead of Vulkan, and whether to fall
+	// back to it when there's no Vulkan driver or device
+	bool software = false;
+	bool software_fallback = true;
+
+	// The KB the geometry pool's defragmenter may copy per frame, 0 to disable it
+	uint32_t defrag_budget_kb = 1024;
+	// Run the geometry pool churn test for this many frames and exit
+	uint32_t geometry_churn_frames = 0;
+
+	// Render a batch of views offscreen into an atlas without a window and exit
+	bool view_batch_only = false;
+	ViewBatchParams view_batch;
+
+	// Run the chain of compute kernels over the data in batches without a window and exit
+	bool compute_only = false;
+	ComputeBatchParams compute;
+
+	// The options which were set, so the tuned settings don't override them
+	std::set<std::string> set_options;
+};
+
+// Set a single option, returns false and sets the error if the option is unknown or the
+// value is invalid
+bool set_config_option(Config &config, const std::string &name, const std::string &value, std::string &error);
+
+// Read "name = value" lines from the file, '#' starts a comment. Returns false if the file
+// can't be opened or has an invalid line. If keep_set_options is true the options which were
+// already set are left as is
+bool load_config_file(Config &config, const std::string &path, std::string &error,
+		bool keep_set_options = false);
+
+// Build the config from the file given by --config or SDL2_VULKAN_CONFIG (sdl2_vulkan.cfg
+// in the working directory if it exists otherwise), the environment and the command line.
+// Prints the error and returns false if any of them are invalid
+bool load_config(int argc, const char **argv, Config &config);
+
+void print_config(const Config &config);
+
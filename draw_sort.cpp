@@ -0,0 +1,133 @@
+#include <algorithm>
+#include <array>
+#include "draw_sort.h"
+#include "vulkan_utils.h"
+
+// Below this many draws the sort runs on the calling thread alone, since waking the workers
+// costs more than they'd save
+static const size_t parallel_sort_threshold = 16384;
+
+uint64_t make_draw_key(uint32_t pass, uint32_t pipeline, uint32_t desc_set, uint32_t material, float depth) {
+	const uint64_t depth_bits = uint64_t(std::min(std::max(depth, 0.f), 1.f) * float(0xffffff));
+	return (uint64_t(pass & 0xf) << 60) | (uint64_t(pipeline & 0xfff) << 48) | (uint64_t(desc_set & 0xfff) << 36)
+		| (uint64_t(material & 0xfff) << 24) | depth_bits;
+}
+
+void sort_draw_entries(WorkerPool &pool, std::vector<DrawSortEntry> &entries, std::vector<DrawSortEntry> &scratch) {
+	const size_t n = entries.size();
+	scratch.resize(n);
+	const uint32_t num_chunks = n >= parallel_sort_threshold ? worker_count(pool) : 1;
+	const size_t chunk_size = (n + num_chunks - 1) / num_chunks;
+	// The count of each digit in each chunk, then where the chunk scatters its entries of it
+	std::vector<std::array<size_t, 256>> offsets(num_chunks);
+
+	auto run = [&](const std::function<void(uint32_t)> &job) {
+		if (num_chunks == 1) {
+			job(0);
+		} else {
+			run_on_workers(pool, job);
+		}
+	};
+
+	std::vector<DrawSortEntry> *src = &entries;
+	std::vector<DrawSortEntry> *dst = &scratch;
+	for (uint32_t shift = 0; shift < 64; shift += 8) {
+		run([&](uint32_t chunk) {
+			std::array<size_t, 256> &counts = offsets[chunk];
+			counts.fill(0);
+			const size_t begin = std::min(chunk * chunk_size, n);
+			const size_t end = std::min(begin + chunk_size, n);
+			for (size_t i = begin; i < end; ++i) {
+				++counts[((*src)[i].key >> shift) & 0xff];
+			}
+		});
+
+		// The chunks' entries of each digit go after those of the earlier chunks, which keeps
+		// the sort stable
+		bool same_digit = false;
+		size_t offset = 0;
+		for (uint32_t d = 0; d < 256; ++d) {
+			const size_t digit_begin = offset;
+			for (auto &counts : offsets) {
+				const size_t count = counts[d];
+				counts[d] = offset;
+				offset += count;
+			}
+			same_digit = same_digit || offset - digit_begin == n;
+		}
+		if (same_digit) {
+			continue;
+		}
+
+		run([&](uint32_t chunk) {
+			std::array<size_t, 256> &next = offsets[chunk];
+			const size_t begin = std::min(chunk * chunk_size, n);
+			const size_t end = std::min(begin + chunk_size, n);
+			for (size_t i = begin; i < end; ++i) {
+				const DrawSortEntry &e = (*src)[i];
+				(*dst)[next[(e.key >> shift) & 0xff]++] = e;
+			}
+		});
+		std::swap(src, dst);
+	}
+	if (src != &entries) {
+		entries.swap(scratch);
+	}
+}
+
+void reset_draw_state(DrawStateTracker &state) {
+	state.pipeline = VK_NULL_HANDLE;
+	state.layout = VK_NULL_HANDLE;
+	state.desc_set = VK_NULL_HANDLE;
+	state.vertex_buffer = VK_NULL_HANDLE;
+	state.vertex_offset = 0;
+}
+
+void record_draw_packet(DrawStateTracker &state, VkCommandBuffer cmd_buf, const DrawPacket &packet) {
+	DrawStateStats &stats = state.stats;
+	if (!state.enabled || packet.pipeline != state.pipeline) {
+		vkCmdBindPipeline(cmd_buf, VK_PIPELINE_BIND_POINT_GRAPHICS, packet.pipeline);
+		state.pipeline = packet.pipeline;
+		++stats.pipeline_binds;
+	} else {
+		++stats.skipped_binds;
+	}
+
+	// Sets bound with a different layout are only kept if the layouts are compatible, so
+	// they're rebound when the layout changes
+	if (packet.desc_set != VK_NULL_HANDLE) {
+		if (!state.enabled || packet.desc_set != state.desc_set || packet.layout != state.layout) {
+			vkCmdBindDescriptorSets(cmd_buf, VK_PIPELINE_BIND_POINT_GRAPHICS, packet.layout, 0, 1, &packet.desc_set,
+					0, nullptr);
+			state.desc_set = packet.desc_set;
+			state.layout = packet.layout;
+			++stats.desc_set_binds;
+		} else {
+			++stats.skipped_binds;
+		}
+	}
+
+	if (packet.vertex_buffer != VK_NULL_HANDLE) {
+		if (!state.enabled || packet.vertex_buffer != state.vertex_buffer
+				|| packet.vertex_offset != state.vertex_offset)
+		{
+			vkCmdBindVertexBuffers(cmd_buf, 0, 1, &packet.vertex_buffer, &packet.vertex_offset);
+			state.vertex_buffer = packet.vertex_buffer;
+			state.vertex_offset = packet.vertex_offset;
+			++stats.vertex_buffer_binds;
+		} else {
+			++stats.skipped_binds;
+		}
+	}
+
+	vkCmdDraw(cmd_buf, packet.vertex_count, 1, packet.first_vertex, 0);
+	++stats.draws;
+}
+
+void add_draw_state_stats(DrawStateStats &total, const DrawStateStats &stats) {
+	total.draws += stats.draws;
+	total.pipeline_binds += stats.pipeline_binds;
+	total.desc_set_binds += stats.desc_set_binds;
+	total.vertex_buffer_binds += stats.vertex_buffer_binds;
+	total.skipped_binds += stats.skipped_binds;
+}
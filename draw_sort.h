@@ -0,0 +1,70 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <vulkan/vulkan.h>
+#include "worker_pool.h"
+
+// Sorting a frame's draws by a key built from their state before recording them, so the draws
+// sharing a pipeline, descriptor set and vertex buffer end up next to each other, and recording
+// them through a state tracker which skips binding what's already bound.
+
+// The key's fields from the most significant bits are the pass (4 bits), pipeline (12 bits),
+// descriptor set (12 bits), material (12 bits) and depth in [0, 1] (24 bits), so the draws
+// are grouped by pass first and go front to back within the same state. The indices are
+// masked to their field's width
+uint64_t make_draw_key(uint32_t pass, uint32_t pipeline, uint32_t desc_set, uint32_t material, float depth);
+
+// Everything needed to record a draw
+struct DrawPacket {
+	uint64_t key = 0;
+	VkPipeline pipeline = VK_NULL_HANDLE;
+	VkPipelineLayout layout = VK_NULL_HANDLE;
+	// Bound to set 0 if not null
+	VkDescriptorSet desc_set = VK_NULL_HANDLE;
+	// Bound to binding 0 if not null
+	VkBuffer vertex_buffer = VK_NULL_HANDLE;
+	VkDeviceSize vertex_offset = 0;
+	uint32_t vertex_count = 0;
+	uint32_t first_vertex = 0;
+};
+
+struct DrawSortEntry {
+	uint64_t key = 0;
+	uint32_t packet = 0;
+};
+
+// Sort the entries by key with a least significant digit radix sort on the pool's threads,
+// 8 bits per pass. Passes over a byte which is the same in all keys are skipped, so unused
+// key bits cost nothing. Stable, so draws with equal keys keep their order. scratch is resized
+// to match
+void sort_draw_entries(WorkerPool &pool, std::vector<DrawSortEntry> &entries, std::vector<DrawSortEntry> &scratch);
+
+struct DrawStateStats {
+	uint64_t draws = 0;
+	// The binds recorded, and the ones skipped since the state was already bound
+	uint64_t pipeline_binds = 0;
+	uint64_t desc_set_binds = 0;
+	uint64_t vertex_buffer_binds = 0;
+	uint64_t skipped_binds = 0;
+};
+
+// The state bound in the command buffer being recorded. Nothing is bound at the start of a
+// command buffer, so the tracker is reset at the start of each
+struct DrawStateTracker {
+	// Without tracking every packet binds all of its state
+	bool enabled = true;
+	VkPipeline pipeline = VK_NULL_HANDLE;
+	VkPipelineLayout layout = VK_NULL_HANDLE;
+	VkDescriptorSet desc_set = VK_NULL_HANDLE;
+	VkBuffer vertex_buffer = VK_NULL_HANDLE;
+	VkDeviceSize vertex_offset = 0;
+	DrawStateStats stats;
+};
+
+void reset_draw_state(DrawStateTracker &state);
+
+// Record the packet's draw, binding the state which differs from what's bound
+void record_draw_packet(DrawStateTracker &state, VkCommandBuffer cmd_buf, const DrawPacket &packet);
+
+void add_draw_state_stats(DrawStateStats &total, const DrawStateStats &stats);
@@ -0,0 +1,238 @@
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "external_memory.h"
+
+static const VkExternalMemoryHandleTypeFlagBits memory_handle_type = VK_EXTERNAL_MEMORY_HANDLE_TYPE_OPAQUE_FD_BIT;
+static const VkExternalSemaphoreHandleTypeFlagBits semaphore_handle_type =
+	VK_EXTERNAL_SEMAPHORE_HANDLE_TYPE_OPAQUE_FD_BIT;
+
+template <typename T>
+static T load_device_function(VkDevice device, const char *name) {
+	T fn = reinterpret_cast<T>(vkGetDeviceProcAddr(device, name));
+	if (!fn) {
+		throw std::runtime_error(std::string("Failed to load ") + name + ", is the extension enabled?");
+	}
+	return fn;
+}
+
+bool external_memory_supported(VkPhysicalDevice physical_device, VkFormat format, VkImageUsageFlags usage) {
+	uint32_t extension_count = 0;
+	vkEnumerateDeviceExtensionProperties(physical_device, nullptr, &extension_count, nullptr);
+	std::vector<VkExtensionProperties> extensions(extension_count, VkExtensionProperties{});
+	vkEnumerateDeviceExtensionProperties(physical_device, nullptr, &extension_count, extensions.data());
+	for (const char *name : external_memory_extensions) {
+		bool found = false;
+		for (const auto &e : extensions) {
+			found = found || std::strcmp(e.extensionName, name) == 0;
+		}
+		if (!found) {
+			return false;
+		}
+	}
+
+	VkPhysicalDeviceExternalImageFormatInfo external_info = {};
+	external_info.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTERNAL_IMAGE_FORMAT_INFO;
+	external_info.handleType = memory_handle_type;
+
+	VkPhysicalDeviceImageFormatInfo2 format_info = {};
+	format_info.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_IMAGE_FORMAT_INFO_2;
+	format_info.pNext = &external_info;
+	format_info.format = format;
+	format_info.type = VK_IMAGE_TYPE_2D;
+	format_info.tiling = VK_IMAGE_TILING_OPTIMAL;
+	format_info.usage = usage;
+
+	VkExternalImageFormatProperties external_props = {};
+	external_props.sType = VK_STRUCTURE_TYPE_EXTERNAL_IMAGE_FORMAT_PROPERTIES;
+	VkImageFormatProperties2 format_props = {};
+	format_props.sType = VK_STRUCTURE_TYPE_IMAGE_FORMAT_PROPERTIES_2;
+	format_props.pNext = &external_props;
+	if (vkGetPhysicalDeviceImageFormatProperties2(physical_device, &format_info, &format_props) != VK_SUCCESS) {
+		return false;
+	}
+	const VkExternalMemoryFeatureFlags memory_features =
+		external_props.externalMemoryProperties.externalMemoryFeatures;
+	if (!(memory_features & VK_EXTERNAL_MEMORY_FEATURE_EXPORTABLE_BIT)
+			|| !(memory_features & VK_EXTERNAL_MEMORY_FEATURE_IMPORTABLE_BIT))
+	{
+		return false;
+	}
+
+	VkPhysicalDeviceExternalSemaphoreInfo semaphore_info = {};
+	semaphore_info.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTERNAL_SEMAPHORE_INFO;
+	semaphore_info.handleType = semaphore_handle_type;
+	VkExternalSemaphoreProperties semaphore_props = {};
+	semaphore_props.sType = VK_STRUCTURE_TYPE_EXTERNAL_SEMAPHORE_PROPERTIES;
+	vkGetPhysicalDeviceExternalSemaphoreProperties(physical_device, &semaphore_info, &semaphore_props);
+	return (semaphore_props.externalSemaphoreFeatures & VK_EXTERNAL_SEMAPHORE_FEATURE_EXPORTABLE_BIT)
+		&& (semaphore_props.externalSemaphoreFeatures & VK_EXTERNAL_SEMAPHORE_FEATURE_IMPORTABLE_BIT);
+}
+
+ExternalDeviceId external_device_id(VkPhysicalDevice physical_device) {
+	VkPhysicalDeviceIDProperties id_props = {};
+	id_props.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_ID_PROPERTIES;
+	VkPhysicalDeviceProperties2 props = {};
+	props.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+	props.pNext = &id_props;
+	vkGetPhysicalDeviceProperties2(physical_device, &props);
+
+	ExternalDeviceId id;
+	std::memcpy(id.device_uuid, id_props.deviceUUID, VK_UUID_SIZE);
+	std::memcpy(id.driver_uuid, id_props.driverUUID, VK_UUID_SIZE);
+	return id;
+}
+
+bool same_external_device(const ExternalDeviceId &a, const ExternalDeviceId &b) {
+	return std::memcmp(a.device_uuid, b.device_uuid, VK_UUID_SIZE) == 0
+		&& std::memcmp(a.driver_uuid, b.driver_uuid, VK_UUID_SIZE) == 0;
+}
+
+// The exporter and importer create the image identically, so they get the same memory
+// requirements and memory type
+static Image create_external_image(VkDevice device, VkExtent2D extent, VkFormat format, VkImageUsageFlags usage) {
+	Image img;
+	img.format = format;
+	img.extent = extent;
+	img.layers = 1;
+	img.mip_levels = 1;
+
+	VkExternalMemoryImageCreateInfo external_info = {};
+	external_info.sType = VK_STRUCTURE_TYPE_EXTERNAL_MEMORY_IMAGE_CREATE_INFO;
+	external_info.handleTypes = memory_handle_type;
+
+	VkImageCreateInfo create_info = {};
+	create_info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+	create_info.pNext = &external_info;
+	create_info.imageType = VK_IMAGE_TYPE_2D;
+	create_info.format = format;
+	create_info.extent.width = extent.width;
+	create_info.extent.height = extent.height;
+	create_info.extent.depth = 1;
+	create_info.mipLevels = 1;
+	create_info.arrayLayers = 1;
+	create_info.samples = VK_SAMPLE_COUNT_1_BIT;
+	create_info.tiling = VK_IMAGE_TILING_OPTIMAL;
+	create_info.usage = usage;
+	create_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+	create_info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	CHECK_VULKAN(vkCreateImage(device, &create_info, nullptr, &img.image));
+	return img;
+}
+
+static void bind_external_image(VkDevice device, Image &img) {
+	CHECK_VULKAN(vkBindImageMemory(device, img.image, img.mem, 0));
+	img.view = create_image_view(device, img.image, VK_IMAGE_VIEW_TYPE_2D, img.format, VK_IMAGE_ASPECT_COLOR_BIT,
+			0, 1);
+}
+
+Image create_exportable_image(VkDevice device, VkPhysicalDevice physical_device, VkExtent2D extent,
+		VkFormat format, VkImageUsageFlags usage, VkDeviceSize &allocation_size)
+{
+	Image img = create_external_image(device, extent, format, usage);
+	VkMemoryRequirements mem_reqs = {};
+	vkGetImageMemoryRequirements(device, img.image, &mem_reqs);
+
+	VkMemoryDedicatedAllocateInfo dedicated_info = {};
+	dedicated_info.sType = VK_STRUCTURE_TYPE_MEMORY_DEDICATED_ALLOCATE_INFO;
+	dedicated_info.image = img.image;
+
+	VkExportMemoryAllocateInfo export_info = {};
+	export_info.sType = VK_STRUCTURE_TYPE_EXPORT_MEMORY_ALLOCATE_INFO;
+	export_info.pNext = &dedicated_info;
+	export_info.handleTypes = memory_handle_type;
+
+	img.mem = allocate_memory(device, physical_device, mem_reqs, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &export_info);
+	bind_external_image(device, img);
+	allocation_size = mem_reqs.size;
+	return img;
+}
+
+Image import_image(VkDevice device, VkPhysicalDevice physical_device, int fd, VkExtent2D extent,
+		VkFormat format, VkImageUsageFlags usage, VkDeviceSize allocation_size)
+{
+	Image img = create_external_image(device, extent, format, usage);
+	VkMemoryRequirements mem_reqs = {};
+	vkGetImageMemoryRequirements(device, img.image, &mem_reqs);
+	if (mem_reqs.size != allocation_size) {
+		vkDestroyImage(device, img.image, nullptr);
+		throw std::runtime_error("The imported image needs " + std::to_string(mem_reqs.size)
+				+ " bytes but " + std::to_string(allocation_size) + " were exported");
+	}
+
+	VkMemoryDedicatedAllocateInfo dedicated_info = {};
+	dedicated_info.sType = VK_STRUCTURE_TYPE_MEMORY_DEDICATED_ALLOCATE_INFO;
+	dedicated_info.image = img.image;
+
+	VkImportMemoryFdInfoKHR import_info = {};
+	import_info.sType = VK_STRUCTURE_TYPE_IMPORT_MEMORY_FD_INFO_KHR;
+	import_info.pNext = &dedicated_info;
+	import_info.handleType = memory_handle_type;
+	import_info.fd = fd;
+
+	try {
+		img.mem = allocate_memory(device, physical_device, mem_reqs, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+				&import_info);
+	} catch (...) {
+		vkDestroyImage(device, img.image, nullptr);
+		throw;
+	}
+	bind_external_image(device, img);
+	return img;
+}
+
+int export_memory_fd(VkDevice device, VkDeviceMemory mem) {
+	auto get_memory_fd = load_device_function<PFN_vkGetMemoryFdKHR>(device, "vkGetMemoryFdKHR");
+	VkMemoryGetFdInfoKHR info = {};
+	info.sType = VK_STRUCTURE_TYPE_MEMORY_GET_FD_INFO_KHR;
+	info.memory = mem;
+	info.handleType = memory_handle_type;
+	int fd = -1;
+	CHECK_VULKAN(get_memory_fd(device, &info, &fd));
+	return fd;
+}
+
+VkSemaphore create_exportable_semaphore(VkDevice device) {
+	VkExportSemaphoreCreateInfo export_info = {};
+	export_info.sType = VK_STRUCTURE_TYPE_EXPORT_SEMAPHORE_CREATE_INFO;
+	export_info.handleTypes = semaphore_handle_type;
+
+	VkSemaphoreCreateInfo info = {};
+	info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+	info.pNext = &export_info;
+	VkSemaphore semaphore = VK_NULL_HANDLE;
+	CHECK_VULKAN(vkCreateSemaphore(device, &info, nullptr, &semaphore));
+	return semaphore;
+}
+
+int export_semaphore_fd(VkDevice device, VkSemaphore semaphore) {
+	auto get_semaphore_fd = load_device_function<PFN_vkGetSemaphoreFdKHR>(device, "vkGetSemaphoreFdKHR");
+	VkSemaphoreGetFdInfoKHR info = {};
+	info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_GET_FD_INFO_KHR;
+	info.semaphore = semaphore;
+	info.handleType = semaphore_handle_type;
+	int fd = -1;
+	CHECK_VULKAN(get_semaphore_fd(device, &info, &fd));
+	return fd;
+}
+
+VkSemaphore import_semaphore(VkDevice device, int fd) {
+	auto import_semaphore_fd = load_device_function<PFN_vkImportSemaphoreFdKHR>(device, "vkImportSemaphoreFdKHR");
+	VkSemaphoreCreateInfo create_info = {};
+	create_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+	VkSemaphore semaphore = VK_NULL_HANDLE;
+	CHECK_VULKAN(vkCreateSemaphore(device, &create_info, nullptr, &semaphore));
+
+	VkImportSemaphoreFdInfoKHR info = {};
+	info.sType = VK_STRUCTURE_TYPE_IMPORT_SEMAPHORE_FD_INFO_KHR;
+	info.semaphore = semaphore;
+	info.handleType = semaphore_handle_type;
+	info.fd = fd;
+	const VkResult result = import_semaphore_fd(device, &info);
+	if (result != VK_SUCCESS) {
+		vkDestroySemaphore(device, semaphore, nullptr);
+		CHECK_VULKAN(result);
+	}
+	return semaphore;
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include "vulkan_utils.h"
+
+// Sharing images and semaphores with other processes through opaque POSIX file descriptors,
+// with VK_KHR_external_memory_fd and VK_KHR_external_semaphore_fd. Both processes must use
+// the same device and driver, which the UUIDs identify, and the importer must create its image
+// with the same parameters as the exporter. Images get a dedicated allocation on both sides.
+
+// The device extensions to enable for exporting or importing
+static const char *const external_memory_extensions[] = {
+	VK_KHR_EXTERNAL_MEMORY_FD_EXTENSION_NAME,
+	VK_KHR_EXTERNAL_SEMAPHORE_FD_EXTENSION_NAME,
+};
+
+// Whether the device has the extensions and can export and import images of the format and
+// usage and binary semaphores as file descriptors
+bool external_memory_supported(VkPhysicalDevice physical_device, VkFormat format, VkImageUsageFlags usage);
+
+struct ExternalDeviceId {
+	uint8_t device_uuid[VK_UUID_SIZE] = {};
+	uint8_t driver_uuid[VK_UUID_SIZE] = {};
+};
+
+ExternalDeviceId external_device_id(VkPhysicalDevice physical_device);
+
+bool same_external_device(const ExternalDeviceId &a, const ExternalDeviceId &b);
+
+// A device local optimal tiling image which can be exported, with its allocation size the
+// importer needs
+Image create_exportable_image(VkDevice device, VkPhysicalDevice physical_device, VkExtent2D extent,
+		VkFormat format, VkImageUsageFlags usage, VkDeviceSize &allocation_size);
+
+// Create the image and import its memory from the file descriptor, which the image owns if
+// this succeeds. Throws if the image needs a different allocation size than the exported one
+Image import_image(VkDevice device, VkPhysicalDevice physical_device, int fd, VkExtent2D extent,
+		VkFormat format, VkImageUsageFlags usage, VkDeviceSize allocation_size);
+
+// Each call returns a new file descriptor, owned by the caller
+int export_memory_fd(VkDevice device, VkDeviceMemory mem);
+
+VkSemaphore create_exportable_semaphore(VkDevice device);
+
+int export_semaphore_fd(VkDevice device, VkSemaphore semaphore);
+
+// Import permanently into a new semaphore, which owns the file descriptor if this succeeds
+VkSemaphore import_semaphore(VkDevice device, int fd);
@@ -0,0 +1,235 @@
+#include <algorithm>
+#include <cstring>
+#include <vector>
+#include <SDL.h>
+#ifdef HAVE_SDL2_TTF
+#include <SDL_ttf.h>
+#endif
+#include "font_atlas.h"
+#include "font_8x16.h"
+#include "object_cache.h"
+
+// A glyph's coverage before it's packed into the atlas
+struct GlyphBitmap {
+	uint32_t width = 0;
+	uint32_t height = 0;
+	std::vector<uint8_t> pixels;
+	float advance = 0.f;
+};
+
+static bool load_ttf_glyphs(const std::string &font_path, int font_size, std::vector<GlyphBitmap> &glyphs,
+		float &line_height)
+{
+#ifdef HAVE_SDL2_TTF
+	if (!TTF_WasInit() && TTF_Init() != 0) {
+		std::cout << "Failed to init SDL_ttf: " << TTF_GetError() << "\n";
+		return false;
+	}
+	TTF_Font *font = TTF_OpenFont(font_path.c_str(), font_size);
+	if (!font) {
+		std::cout << "Failed to load font " << font_path << ": " << TTF_GetError() << "\n";
+		return false;
+	}
+
+	// The rendered glyphs are the height of the font with the top at the ascent, so they all
+	// line up when placed at the top of the line
+	const SDL_Color white = { 255, 255, 255, 255 };
+	for (uint16_t c = 32; c < 127; ++c) {
+		GlyphBitmap glyph;
+		int min_x = 0, max_x = 0, min_y = 0, max_y = 0, advance = 0;
+		TTF_GlyphMetrics(font, c, &min_x, &max_x, &min_y, &max_y, &advance);
+		glyph.advance = advance;
+
+		SDL_Surface *rendered = TTF_RenderGlyph_Blended(font, c, white);
+		if (rendered) {
+			SDL_Surface *surface = SDL_ConvertSurfaceFormat(rendered, SDL_PIXELFORMAT_RGBA32, 0);
+			SDL_FreeSurface(rendered);
+			SDL_LockSurface(surface);
+			glyph.width = surface->w;
+			glyph.height = surface->h;
+			glyph.pixels.resize(glyph.width * glyph.height, 0);
+			const uint8_t *src = reinterpret_cast<const uint8_t*>(surface->pixels);
+			for (uint32_t y = 0; y < glyph.height; ++y) {
+				for (uint32_t x = 0; x < glyph.width; ++x) {
+					glyph.pixels[y * glyph.width + x] = src[y * surface->pitch + x * 4 + 3];
+				}
+			}
+			SDL_UnlockSurface(surface);
+			SDL_FreeSurface(surface);
+		}
+		glyphs.push_back(glyph);
+	}
+	line_height = TTF_FontLineSkip(font);
+	TTF_CloseFont(font);
+	return true;
+#else
+	(void)font_path;
+	(void)font_size;
+	(void)glyphs;
+	(void)line_height;
+	std::cout << "Built without SDL2_ttf, can't load " << font_path << "\n";
+	return false;
+#endif
+}
+
+static void load_bitmap_glyphs(std::vector<GlyphBitmap> &glyphs, float &line_height) {
+	for (uint32_t c = 0; c < 95; ++c) {
+		GlyphBitmap glyph;
+		glyph.width = font_8x16_width;
+		glyph.height = font_8x16_height;
+		glyph.advance = font_8x16_width;
+		glyph.pixels.resize(glyph.width * glyph.height, 0);
+		for (uint32_t y = 0; y < glyph.height; ++y) {
+			for (uint32_t x = 0; x < glyph.width; ++x) {
+				if (font_8x16[c][y] & (0x80 >> x)) {
+					glyph.pixels[y * glyph.width + x] = 255;
+				}
+			}
+		}
+		glyphs.push_back(glyph);
+	}
+	line_height = font_8x16_height;
+}
+
+// Upload the atlas pixels and leave the image ready to sample
+static void upload_atlas(VkDevice device, VkPhysicalDevice physical_device, VkQueue queue,
+		VkCommandPool command_pool, const Image &atlas, const std::vector<uint8_t> &pixels)
+{
+	Buffer staging = create_host_buffer(device, physical_device, pixels.data(), pixels.size(),
+			VK_BUFFER_USAGE_TRANSFER_SRC_BIT);
+
+	VkCommandBuffer cmd_buf = begin_one_time_commands(device, command_pool);
+	image_barrier(cmd_buf, atlas.image, VK_IMAGE_ASPECT_COLOR_BIT,
+			VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+			0, VK_ACCESS_TRANSFER_WRITE_BIT,
+			VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+
+	VkBufferImageCopy copy = {};
+	copy.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	copy.imageSubresource.layerCount = 1;
+	copy.imageExtent.width = atlas.extent.width;
+	copy.imageExtent.height = atlas.extent.height;
+	copy.imageExtent.depth = 1;
+	vkCmdCopyBufferToImage(cmd_buf, staging.buffer, atlas.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &copy);
+
+	image_barrier(cmd_buf, atlas.image, VK_IMAGE_ASPECT_COLOR_BIT,
+			VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+			VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT,
+			VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+	end_one_time_commands(device, queue, command_pool, cmd_buf);
+
+	destroy_buffer(device, staging);
+}
+
+// Pack the glyphs into rows of an atlas, after a 2x2 opaque block for the solid rectangles
+static void build_atlas(const std::vector<GlyphBitmap> &bitmaps, FontAtlasPixels &font) {
+	const uint32_t atlas_width = 512;
+	const uint32_t padding = 1;
+
+	std::vector<std::array<uint32_t, 2>> positions(bitmaps.size(), std::array<uint32_t, 2>{});
+	uint32_t x = 2 + padding;
+	uint32_t y = 0;
+	uint32_t row_height = 2;
+	for (size_t i = 0; i < bitmaps.size(); ++i) {
+		if (x + bitmaps[i].width > atlas_width) {
+			x = 0;
+			y += row_height + padding;
+			row_height = 0;
+		}
+		positions[i] = { x, y };
+		x += bitmaps[i].width + padding;
+		row_height = std::max(row_height, bitmaps[i].height);
+	}
+	const uint32_t atlas_height = y + row_height;
+
+	font.width = atlas_width;
+	font.height = atlas_height;
+	std::vector<uint8_t> &pixels = font.pixels;
+	pixels.assign(atlas_width * atlas_height, 0);
+	pixels[0] = pixels[1] = pixels[atlas_width] = pixels[atlas_width + 1] = 255;
+	for (size_t i = 0; i < bitmaps.size(); ++i) {
+		const GlyphBitmap &b = bitmaps[i];
+		for (uint32_t gy = 0; gy < b.height; ++gy) {
+			std::memcpy(&pixels[(positions[i][1] + gy) * atlas_width + positions[i][0]],
+					&b.pixels[gy * b.width], b.width);
+		}
+
+		Glyph &g = font.glyphs[i];
+		g.u0 = float(positions[i][0]) / atlas_width;
+		g.v0 = float(positions[i][1]) / atlas_height;
+		g.u1 = float(positions[i][0] + b.width) / atlas_width;
+		g.v1 = float(positions[i][1] + b.height) / atlas_height;
+		g.width = b.width;
+		g.height = b.height;
+		g.advance = b.advance;
+	}
+	font.white_u = 1.f / atlas_width;
+	font.white_v = 1.f / atlas_height;
+}
+
+FontAtlasPixels rasterize_font_atlas(const std::string &font_path, int font_size) {
+	FontAtlasPixels font;
+	std::vector<GlyphBitmap> bitmaps;
+	if (font_path.empty() || !load_ttf_glyphs(font_path, font_size, bitmaps, font.line_height)) {
+		bitmaps.clear();
+		load_bitmap_glyphs(bitmaps, font.line_height);
+	}
+	build_atlas(bitmaps, font);
+	return font;
+}
+
+FontAtlas create_font_atlas(VkDevice device, VkPhysicalDevice physical_device, VkQueue queue,
+		VkCommandPool command_pool, const FontAtlasPixels &pixels)
+{
+	FontAtlas font;
+	font.glyphs = pixels.glyphs;
+	font.line_height = pixels.line_height;
+	font.white_u = pixels.white_u;
+	font.white_v = pixels.white_v;
+
+	VkExtent2D extent = {};
+	extent.width = pixels.width;
+	extent.height = pixels.height;
+	font.image = create_image(device, physical_device, extent, 1, VK_FORMAT_R8_UNORM,
+			VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT, VK_IMAGE_ASPECT_COLOR_BIT);
+	upload_atlas(device, physical_device, queue, command_pool, font.image, pixels.pixels);
+
+	VkSamplerCreateInfo info = {};
+	info.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+	info.magFilter = VK_FILTER_NEAREST;
+	info.minFilter = VK_FILTER_NEAREST;
+	info.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+	info.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	info.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	info.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	info.maxLod = 0.f;
+	font.sampler = get_sampler(device, info);
+	return font;
+}
+
+FontAtlas create_font_atlas(VkDevice device, VkPhysicalDevice physical_device, VkQueue queue,
+		VkCommandPool command_pool, const std::string &font_path, int font_size)
+{
+	return create_font_atlas(device, physical_device, queue, command_pool,
+			rasterize_font_atlas(font_path, font_size));
+}
+
+void destroy_font_atlas(VkDevice device, FontAtlas &font) {
+	destroy_image(device, font.image);
+	font = FontAtlas();
+}
+
+const Glyph& find_glyph(const FontAtlas &font, char c) {
+	if (c < 32 || c > 126) {
+		c = '?';
+	}
+	return font.glyphs[c - 32];
+}
+
+float text_width(const FontAtlas &font, const char *text) {
+	float width = 0.f;
+	for (const char *c = text; *c; ++c) {
+		width += find_glyph(font, *c).advance;
+	}
+	return width;
+}
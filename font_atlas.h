@@ -0,0 +1,61 @@
+#pragma once
+
+#include <array>
+#include <string>
+#include <vector>
+#include <vulkan/vulkan.h>
+#include "vulkan_utils.h"
+
+// A glyph's rectangle in the atlas, and its placement relative to the pen position at the
+// top left of the line
+struct Glyph {
+	float u0 = 0.f, v0 = 0.f, u1 = 0.f, v1 = 0.f;
+	float x_offset = 0.f;
+	float y_offset = 0.f;
+	float width = 0.f;
+	float height = 0.f;
+	float advance = 0.f;
+};
+
+// Glyphs for printable ASCII packed into a single channel coverage texture, shared by the
+// 2D renderers
+struct FontAtlas {
+	std::array<Glyph, 95> glyphs;
+	float line_height = 0.f;
+	// The atlas has an opaque texel here which solid rectangles sample
+	float white_u = 0.f;
+	float white_v = 0.f;
+	Image image;
+	VkSampler sampler = VK_NULL_HANDLE;
+};
+
+// The packed atlas before it's uploaded, which can be saved and reused instead of
+// rasterizing the font again
+struct FontAtlasPixels {
+	std::array<Glyph, 95> glyphs;
+	float line_height = 0.f;
+	float white_u = 0.f;
+	float white_v = 0.f;
+	uint32_t width = 0;
+	uint32_t height = 0;
+	std::vector<uint8_t> pixels;
+};
+
+// Rasterize the TTF font at font_path, falling back to the built in bitmap font if the path
+// is empty, the font can't be loaded or SDL2_ttf isn't available
+FontAtlasPixels rasterize_font_atlas(const std::string &font_path, int font_size);
+
+FontAtlas create_font_atlas(VkDevice device, VkPhysicalDevice physical_device, VkQueue queue,
+		VkCommandPool command_pool, const FontAtlasPixels &pixels);
+
+// Rasterize the font and create the atlas from it
+FontAtlas create_font_atlas(VkDevice device, VkPhysicalDevice physical_device, VkQueue queue,
+		VkCommandPool command_pool, const std::string &font_path, int font_size);
+
+void destroy_font_atlas(VkDevice device, FontAtlas &font);
+
+// Characters outside printable ASCII are shown as '?'
+const Glyph& find_glyph(const FontAtlas &font, char c);
+
+float text_width(const FontAtlas &font, const char *text);
+
@@ -0,0 +1,440 @@
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <iostream>
+#include <limits>
+#include <vector>
+#include "draw_sort.h"
+#include "frame_benchmark.h"
+#include "scene_pass.h"
+#include "vulkan_utils.h"
+#include "worker_pool.h"
+
+// A cheap integer hash spreading the draws over the states and depths
+static uint32_t hash_u32(uint32_t x) {
+	x ^= x >> 16;
+	x *= 0x7feb352du;
+	x ^= x >> 15;
+	x *= 0x846ca68bu;
+	x ^= x >> 16;
+	return x;
+}
+
+// The resources for one frame in flight. Each thread records its batches from its own
+// command pool, since command pools can't be used from multiple threads at once
+struct BenchmarkFrame {
+	Image target;
+	VkFramebuffer framebuffer = VK_NULL_HANDLE;
+	VkFence fence = VK_NULL_HANDLE;
+	VkCommandBuffer primary = VK_NULL_HANDLE;
+	std::vector<VkCommandPool> thread_pools;
+	// Batch b is allocated from the pool of thread b % num_threads
+	std::vector<VkCommandBuffer> batches;
+	bool submitted = false;
+};
+
+static VkRenderPass create_benchmark_render_pass(VkDevice device, VkFormat format) {
+	VkAttachmentDescription color_attachment = {};
+	color_attachment.format = format;
+	color_attachment.samples = VK_SAMPLE_COUNT_1_BIT;
+	color_attachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+	color_attachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+	color_attachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+	color_attachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+	color_attachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	color_attachment.finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+	VkAttachmentReference color_attachment_ref = {};
+	color_attachment_ref.attachment = 0;
+	color_attachment_ref.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+	VkSubpassDescription subpass = {};
+	subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+	subpass.colorAttachmentCount = 1;
+	subpass.pColorAttachments = &color_attachment_ref;
+
+	VkRenderPassCreateInfo render_pass_info = {};
+	render_pass_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+	render_pass_info.attachmentCount = 1;
+	render_pass_info.pAttachments = &color_attachment;
+	render_pass_info.subpassCount = 1;
+	render_pass_info.pSubpasses = &subpass;
+	VkRenderPass render_pass = VK_NULL_HANDLE;
+	CHECK_VULKAN(vkCreateRenderPass(device, &render_pass_info, nullptr, &render_pass));
+	return render_pass;
+}
+
+FrameBenchmarkResult run_frame_benchmark(VkDevice device, VkPhysicalDevice physical_device, VkQueue queue,
+		uint32_t queue_family, const FrameBenchmarkParams &params)
+{
+	const VkFormat target_format = VK_FORMAT_R8G8B8A8_UNORM;
+	const uint32_t num_threads = std::max(params.num_threads, 1u);
+	const uint32_t batch_size = std::max(params.batch_size, 1u);
+	const uint32_t num_batches = (params.draws_per_frame + batch_size - 1) / batch_size;
+
+	const uint32_t num_pipelines = std::max(params.num_pipelines, 1u);
+	const uint32_t num_desc_sets = std::max(params.num_desc_sets, 1u);
+	const uint32_t num_vertex_buffers = std::max(params.num_vertex_buffers, 1u);
+
+	// The draw states. The scene pipeline reads neither the uniform buffer nor the vertex
+	// buffers, they're bound for the cost of binding them
+	VkRenderPass render_pass = create_benchmark_render_pass(device, target_format);
+	VkDescriptorSetLayout desc_layout = VK_NULL_HANDLE;
+	{
+		VkDescriptorSetLayoutBinding binding = {};
+		binding.binding = 0;
+		binding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+		binding.descriptorCount = 1;
+		binding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+
+		VkDescriptorSetLayoutCreateInfo info = {};
+		info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+		info.bindingCount = 1;
+		info.pBindings = &binding;
+		CHECK_VULKAN(vkCreateDescriptorSetLayout(device, &info, nullptr, &desc_layout));
+	}
+	VkPipelineLayout pipeline_layout = VK_NULL_HANDLE;
+	{
+		VkPipelineLayoutCreateInfo pipeline_info = {};
+		pipeline_info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+		pipeline_info.setLayoutCount = 1;
+		pipeline_info.pSetLayouts = &desc_layout;
+		CHECK_VULKAN(vkCreatePipelineLayout(device, &pipeline_info, nullptr, &pipeline_layout));
+	}
+	std::vector<VkPipeline> pipelines;
+	for (uint32_t i = 0; i < num_pipelines; ++i) {
+		pipelines.push_back(create_scene_pipeline(device, pipeline_layout, render_pass, VK_SAMPLE_COUNT_1_BIT,
+				params.extent));
+	}
+
+	const VkDeviceSize uniform_stride = 256;
+	const std::vector<uint8_t> uniform_data(num_desc_sets * uniform_stride, 0);
+	Buffer uniform_buffer = create_host_buffer(device, physical_device, uniform_data.data(), uniform_data.size(),
+			VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT);
+	VkDescriptorPool desc_pool = VK_NULL_HANDLE;
+	std::vector<VkDescriptorSet> desc_sets(num_desc_sets, VK_NULL_HANDLE);
+	{
+		VkDescriptorPoolSize pool_size = {};
+		pool_size.type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+		pool_size.descriptorCount = num_desc_sets;
+
+		VkDescriptorPoolCreateInfo pool_info = {};
+		pool_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+		pool_info.maxSets = num_desc_sets;
+		pool_info.poolSizeCount = 1;
+		pool_info.pPoolSizes = &pool_size;
+		CHECK_VULKAN(vkCreateDescriptorPool(device, &pool_info, nullptr, &desc_pool));
+
+		const std::vector<VkDescriptorSetLayout> layouts(num_desc_sets, desc_layout);
+		VkDescriptorSetAllocateInfo alloc_info = {};
+		alloc_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+		alloc_info.descriptorPool = desc_pool;
+		alloc_info.descriptorSetCount = num_desc_sets;
+		alloc_info.pSetLayouts = layouts.data();
+		CHECK_VULKAN(vkAllocateDescriptorSets(device, &alloc_info, desc_sets.data()));
+
+		for (uint32_t i = 0; i < num_desc_sets; ++i) {
+			VkDescriptorBufferInfo buffer_info = {};
+			buffer_info.buffer = uniform_buffer.buffer;
+			buffer_info.offset = i * uniform_stride;
+			buffer_info.range = uniform_stride;
+
+			VkWriteDescriptorSet write = {};
+			write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+			write.dstSet = desc_sets[i];
+			write.dstBinding = 0;
+			write.descriptorCount = 1;
+			write.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+			write.pBufferInfo = &buffer_info;
+			vkUpdateDescriptorSets(device, 1, &write, 0, nullptr);
+		}
+	}
+	std::vector<Buffer> vertex_buffers;
+	{
+		const std::array<float, 9> positions = {};
+		for (uint32_t i = 0; i < num_vertex_buffers; ++i) {
+			vertex_buffers.push_back(create_host_buffer(device, physical_device, positions.data(),
+					sizeof(positions), VK_BUFFER_USAGE_VERTEX_BUFFER_BIT));
+		}
+	}
+
+	VkCommandPool command_pool = VK_NULL_HANDLE;
+	{
+		VkCommandPoolCreateInfo create_info = {};
+		create_info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+		create_info.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+		create_info.queueFamilyIndex = queue_family;
+		CHECK_VULKAN(vkCreateCommandPool(device, &create_info, nullptr, &command_pool));
+	}
+
+	// Timestamps around each frame's rendering, if the queue supports them
+	VkPhysicalDeviceProperties properties = {};
+	vkGetPhysicalDeviceProperties(physical_device, &properties);
+	uint32_t num_families = 0;
+	vkGetPhysicalDeviceQueueFamilyProperties(physical_device, &num_families, nullptr);
+	std::vector<VkQueueFamilyProperties> family_props(num_families, VkQueueFamilyProperties{});
+	vkGetPhysicalDeviceQueueFamilyProperties(physical_device, &num_families, family_props.data());
+	const bool gpu_timing = family_props[queue_family].timestampValidBits != 0;
+
+	VkQueryPool query_pool = VK_NULL_HANDLE;
+	if (gpu_timing) {
+		VkQueryPoolCreateInfo info = {};
+		info.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+		info.queryType = VK_QUERY_TYPE_TIMESTAMP;
+		info.queryCount = 2 * params.frames_in_flight;
+		CHECK_VULKAN(vkCreateQueryPool(device, &info, nullptr, &query_pool));
+	}
+
+	std::vector<BenchmarkFrame> frames(params.frames_in_flight, BenchmarkFrame{});
+	for (auto &f : frames) {
+		f.target = create_image(device, physical_device, params.extent, 1, target_format,
+				VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT, VK_IMAGE_ASPECT_COLOR_BIT);
+
+		VkFramebufferCreateInfo fb_info = {};
+		fb_info.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+		fb_info.renderPass = render_pass;
+		fb_info.attachmentCount = 1;
+		fb_info.pAttachments = &f.target.view;
+		fb_info.width = params.extent.width;
+		fb_info.height = params.extent.height;
+		fb_info.layers = 1;
+		CHECK_VULKAN(vkCreateFramebuffer(device, &fb_info, nullptr, &f.framebuffer));
+
+		VkFenceCreateInfo fence_info = {};
+		fence_info.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+		fence_info.flags = VK_FENCE_CREATE_SIGNALED_BIT;
+		CHECK_VULKAN(vkCreateFence(device, &fence_info, nullptr, &f.fence));
+
+		VkCommandBufferAllocateInfo alloc_info = {};
+		alloc_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+		alloc_info.commandPool = command_pool;
+		alloc_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+		alloc_info.commandBufferCount = 1;
+		CHECK_VULKAN(vkAllocateCommandBuffers(device, &alloc_info, &f.primary));
+
+		for (uint32_t t = 0; t < num_threads; ++t) {
+			VkCommandPoolCreateInfo create_info = {};
+			create_info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+			create_info.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+			create_info.queueFamilyIndex = queue_family;
+			VkCommandPool pool = VK_NULL_HANDLE;
+			CHECK_VULKAN(vkCreateCommandPool(device, &create_info, nullptr, &pool));
+			f.thread_pools.push_back(pool);
+		}
+		f.batches.resize(num_batches, VK_NULL_HANDLE);
+		for (uint32_t b = 0; b < num_batches; ++b) {
+			alloc_info.commandPool = f.thread_pools[b % num_threads];
+			alloc_info.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+			CHECK_VULKAN(vkAllocateCommandBuffers(device, &alloc_info, &f.batches[b]));
+		}
+	}
+
+	WorkerPool workers;
+	start_workers(workers, num_threads);
+
+	// The frame's draws, in the order they're recorded. Only used while recording, so they're
+	// shared by the frames in flight
+	std::vector<DrawPacket> packets(params.draws_per_frame);
+	std::vector<DrawSortEntry> draw_order(params.draws_per_frame);
+	std::vector<DrawSortEntry> sort_scratch;
+	std::vector<DrawStateTracker> trackers(num_threads);
+	for (auto &t : trackers) {
+		t.enabled = params.track_state;
+	}
+	uint32_t num_recorded = 0;
+
+	// Build the draws of the nth recorded frame, their depths change every frame
+	auto build_draws = [&](uint32_t thread, uint32_t n) {
+		const uint32_t chunk = (params.draws_per_frame + num_threads - 1) / num_threads;
+		const uint32_t begin = std::min(thread * chunk, params.draws_per_frame);
+		const uint32_t end = std::min(begin + chunk, params.draws_per_frame);
+		for (uint32_t i = begin; i < end; ++i) {
+			const uint32_t h = hash_u32(i);
+			const uint32_t pipeline = h % num_pipelines;
+			const uint32_t desc_set = (h >> 8) % num_desc_sets;
+			const uint32_t vertex_buffer = (h >> 20) % num_vertex_buffers;
+			const float depth = (hash_u32(i + n * params.draws_per_frame) & 0xffffff) / float(0x1000000);
+
+			DrawPacket &p = packets[i];
+			p.key = make_draw_key(0, pipeline, desc_set, vertex_buffer, depth);
+			p.pipeline = pipelines[pipeline];
+			p.layout = pipeline_layout;
+			p.desc_set = desc_sets[desc_set];
+			p.vertex_buffer = vertex_buffers[vertex_buffer].buffer;
+			p.vertex_count = 3;
+			draw_order[i].key = p.key;
+			draw_order[i].packet = i;
+		}
+	};
+
+	// Record the batches assigned to the thread, resetting its pool first
+	auto record_thread_batches = [&](BenchmarkFrame &f, uint32_t thread) {
+		DrawStateTracker &state = trackers[thread];
+		CHECK_VULKAN(vkResetCommandPool(device, f.thread_pools[thread], 0));
+		for (uint32_t b = thread; b < num_batches; b += num_threads) {
+			VkCommandBufferInheritanceInfo inheritance = {};
+			inheritance.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+			inheritance.renderPass = render_pass;
+			inheritance.subpass = 0;
+			inheritance.framebuffer = f.framebuffer;
+
+			VkCommandBufferBeginInfo begin_info = {};
+			begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+			begin_info.flags = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+			begin_info.pInheritanceInfo = &inheritance;
+			CHECK_VULKAN(vkBeginCommandBuffer(f.batches[b], &begin_info));
+			reset_draw_state(state);
+			const uint32_t first = b * batch_size;
+			const uint32_t num_draws = std::min(batch_size, params.draws_per_frame - first);
+			for (uint32_t i = 0; i < num_draws; ++i) {
+				record_draw_packet(state, f.batches[b], packets[draw_order[first + i].packet]);
+			}
+			CHECK_VULKAN(vkEndCommandBuffer(f.batches[b]));
+		}
+	};
+
+	auto record_batches = [&](BenchmarkFrame &f) {
+		run_on_workers(workers, [&](uint32_t t) { build_draws(t, num_recorded); });
+		if (params.sort_draws) {
+			sort_draw_entries(workers, draw_order, sort_scratch);
+		}
+		run_on_workers(workers, [&](uint32_t t) { record_thread_batches(f, t); });
+		++num_recorded;
+	};
+
+	auto record_primary = [&](BenchmarkFrame &f, uint32_t index) {
+		VkCommandBufferBeginInfo begin_info = {};
+		begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+		CHECK_VULKAN(vkBeginCommandBuffer(f.primary, &begin_info));
+		if (gpu_timing) {
+			vkCmdResetQueryPool(f.primary, query_pool, 2 * index, 2);
+			vkCmdWriteTimestamp(f.primary, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, query_pool, 2 * index);
+		}
+
+		VkClearValue clear_color = { 0.f, 0.f, 0.f, 1.f };
+		VkRenderPassBeginInfo render_pass_info = {};
+		render_pass_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+		render_pass_info.renderPass = render_pass;
+		render_pass_info.framebuffer = f.framebuffer;
+		render_pass_info.renderArea.extent = params.extent;
+		render_pass_info.clearValueCount = 1;
+		render_pass_info.pClearValues = &clear_color;
+		vkCmdBeginRenderPass(f.primary, &render_pass_info, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+		vkCmdExecuteCommands(f.primary, f.batches.size(), f.batches.data());
+		vkCmdEndRenderPass(f.primary);
+
+		if (gpu_timing) {
+			vkCmdWriteTimestamp(f.primary, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, query_pool, 2 * index + 1);
+		}
+		CHECK_VULKAN(vkEndCommandBuffer(f.primary));
+	};
+
+	if (params.recording_mode == RecordingMode::PRERECORDED) {
+		for (uint32_t i = 0; i < frames.size(); ++i) {
+			record_batches(frames[i]);
+			record_primary(frames[i], i);
+		}
+	}
+
+	// The first few frames warm up the caches and clocks and aren't counted
+	const uint32_t warmup = std::min(params.frames / 10, 10u);
+	std::vector<float> frame_ms;
+	double cpu_ms = 0.0;
+	double gpu_ms = 0.0;
+	uint32_t gpu_samples = 0;
+	using clock = std::chrono::steady_clock;
+	auto prev_start = clock::now();
+	for (uint32_t n = 0; n < params.frames + warmup; ++n) {
+		const uint32_t index = n % frames.size();
+		BenchmarkFrame &f = frames[index];
+		const auto start = clock::now();
+		CHECK_VULKAN(vkWaitForFences(device, 1, &f.fence, true, std::numeric_limits<uint64_t>::max()));
+		if (gpu_timing && f.submitted && n >= warmup) {
+			std::array<uint64_t, 2> timestamps = {};
+			CHECK_VULKAN(vkGetQueryPoolResults(device, query_pool, 2 * index, 2, sizeof(timestamps),
+					timestamps.data(), sizeof(uint64_t), VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT));
+			gpu_ms += (timestamps[1] - timestamps[0]) * properties.limits.timestampPeriod * 1e-6;
+			++gpu_samples;
+		}
+		const auto wait_done = clock::now();
+		CHECK_VULKAN(vkResetFences(device, 1, &f.fence));
+
+		if (params.recording_mode == RecordingMode::PER_FRAME) {
+			record_batches(f);
+			record_primary(f, index);
+		}
+
+		VkSubmitInfo submit_info = {};
+		submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+		submit_info.commandBufferCount = 1;
+		submit_info.pCommandBuffers = &f.primary;
+		CHECK_VULKAN(vkQueueSubmit(queue, 1, &submit_info, f.fence));
+		f.submitted = true;
+
+		if (n >= warmup) {
+			cpu_ms += std::chrono::duration<double, std::milli>(clock::now() - wait_done).count();
+			frame_ms.push_back(std::chrono::duration<float, std::milli>(start - prev_start).count());
+		}
+		prev_start = start;
+	}
+	CHECK_VULKAN(vkQueueWaitIdle(queue));
+	stop_workers(workers);
+
+	FrameBenchmarkResult result;
+	if (!frame_ms.empty()) {
+		double total_ms = 0.0;
+		for (const auto &ms : frame_ms) {
+			total_ms += ms;
+		}
+		result.avg_frame_ms = total_ms / frame_ms.size();
+		result.fps = result.avg_frame_ms > 0.f ? 1000.f / result.avg_frame_ms : 0.f;
+		result.cpu_ms = cpu_ms / frame_ms.size();
+		std::sort(frame_ms.begin(), frame_ms.end());
+		result.p99_frame_ms = frame_ms[std::min(size_t(frame_ms.size() * 0.99), frame_ms.size() - 1)];
+	}
+	if (gpu_samples > 0) {
+		result.gpu_ms = gpu_ms / gpu_samples;
+	}
+	if (num_recorded > 0) {
+		DrawStateStats stats;
+		for (const auto &t : trackers) {
+			add_draw_state_stats(stats, t.stats);
+		}
+		result.binds = float(stats.pipeline_binds + stats.desc_set_binds + stats.vertex_buffer_binds) / num_recorded;
+		result.skipped_binds = float(stats.skipped_binds) / num_recorded;
+	}
+
+	for (auto &f : frames) {
+		for (auto &p : f.thread_pools) {
+			vkDestroyCommandPool(device, p, nullptr);
+		}
+		vkDestroyFence(device, f.fence, nullptr);
+		vkDestroyFramebuffer(device, f.framebuffer, nullptr);
+		destroy_image(device, f.target);
+	}
+	if (gpu_timing) {
+		vkDestroyQueryPool(device, query_pool, nullptr);
+	}
+	vkDestroyCommandPool(device, command_pool, nullptr);
+	for (auto &b : vertex_buffers) {
+		destroy_buffer(device, b);
+	}
+	vkDestroyDescriptorPool(device, desc_pool, nullptr);
+	destroy_buffer(device, uniform_buffer);
+	for (auto &p : pipelines) {
+		vkDestroyPipeline(device, p, nullptr);
+	}
+	vkDestroyPipelineLayout(device, pipeline_layout, nullptr);
+	vkDestroyDescriptorSetLayout(device, desc_layout, nullptr);
+	vkDestroyRenderPass(device, render_pass, nullptr);
+	return result;
+}
+
+void print_frame_benchmark_result(const FrameBenchmarkParams &params, const FrameBenchmarkResult &result) {
+	std::cout << params.frames_in_flight << " frames in flight, " << recording_mode_name(params.recording_mode)
+		<< ", " << params.num_threads << " threads, batches of " << params.batch_size
+		<< (params.sort_draws ? ", sorted" : ", unsorted") << ": "
+		<< result.avg_frame_ms << " ms avg, " << result.p99_frame_ms << " ms p99, " << result.fps << " fps, "
+		<< result.cpu_ms << " ms CPU, " << result.gpu_ms << " ms GPU, " << result.binds << " binds ("
+		<< result.skipped_binds << " skipped)\n";
+}
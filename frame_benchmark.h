@@ -0,0 +1,48 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include "settings.h"
+
+// A headless frame loop drawing many small batches of triangles into offscreen targets, to
+// measure how the CPU side settings affect frame times. Each frame's draws are split into
+// secondary command buffers of batch_size draws, which are recorded across the threads when
+// recording each frame.
+//
+// The draws are spread over several pipelines, descriptor sets and vertex buffers like real
+// content. They can be sorted by a key of their state before being split into batches, and
+// recorded through a state tracker which skips the redundant binds, see draw_sort.h.
+struct FrameBenchmarkParams {
+	uint32_t frames_in_flight = 1;
+	RecordingMode recording_mode = RecordingMode::PRERECORDED;
+	uint32_t num_threads = 1;
+	uint32_t draws_per_frame = 4096;
+	uint32_t batch_size = 256;
+	uint32_t frames = 300;
+	uint32_t num_pipelines = 8;
+	uint32_t num_desc_sets = 64;
+	uint32_t num_vertex_buffers = 4;
+	bool sort_draws = true;
+	bool track_state = true;
+	// Small so the draws aren't fill rate bound and the CPU side differences show
+	VkExtent2D extent = { 128, 128 };
+};
+
+struct FrameBenchmarkResult {
+	float avg_frame_ms = 0.f;
+	float p99_frame_ms = 0.f;
+	float fps = 0.f;
+	// CPU time spent recording and submitting each frame, excluding waiting for the GPU
+	float cpu_ms = 0.f;
+	// GPU time per frame, 0 if the queue doesn't support timestamps
+	float gpu_ms = 0.f;
+	// Pipeline, descriptor set and vertex buffer binds recorded per frame, and skipped by the
+	// state tracker
+	float binds = 0.f;
+	float skipped_binds = 0.f;
+};
+
+FrameBenchmarkResult run_frame_benchmark(VkDevice device, VkPhysicalDevice physical_device, VkQueue queue,
+		uint32_t queue_family, const FrameBenchmarkParams &params);
+
+void print_frame_benchmark_result(const FrameBenchmarkParams &params, const FrameBenchmarkResult &result);
+
@@ -0,0 +1,259 @@
+#include <algorithm>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <iostream>
+#include <mutex>
+#include <thread>
+#include "frame_output.h"
+
+#ifdef _WIN32
+#define popen _popen
+#define pclose _pclose
+#else
+#include <csignal>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+// Connect to a consumer listening on the Unix domain socket, returning a stream writing to it
+// or null
+static FILE* connect_output_socket(const std::string &path) {
+#ifdef _WIN32
+	std::cout << "Unix domain socket outputs aren't supported on this platform\n";
+	return nullptr;
+#else
+	sockaddr_un addr = {};
+	addr.sun_family = AF_UNIX;
+	if (path.size() >= sizeof(addr.sun_path)) {
+		throw std::runtime_error("Frame output socket path is too long: " + path);
+	}
+	std::strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+	const int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (fd < 0 || connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0) {
+		if (fd >= 0) {
+			close(fd);
+		}
+		return nullptr;
+	}
+	FILE *file = fdopen(fd, "wb");
+	if (!file) {
+		close(fd);
+	}
+	return file;
+#endif
+}
+
+// Frames waiting to be encoded beyond this are dropped
+static const size_t max_queued_frames = 4;
+
+struct FrameEncoder {
+	FILE *file = nullptr;
+	bool is_pipe = false;
+	std::mutex mutex;
+	std::condition_variable cv;
+	std::deque<std::vector<uint8_t>> queue;
+	// Encoded frames' buffers, reused for the next readbacks
+	std::vector<std::vector<uint8_t>> free_frames;
+	bool quit = false;
+	// Set if writing failed, e.g. the encoder exited, after which frames are discarded
+	bool failed = false;
+	FrameOutputStats stats;
+	std::thread thread;
+};
+
+static void encode_frames(FrameEncoder &encoder) {
+	while (true) {
+		std::vector<uint8_t> frame;
+		{
+			std::unique_lock<std::mutex> lock(encoder.mutex);
+			encoder.cv.wait(lock, [&]() { return encoder.quit || !encoder.queue.empty(); });
+			// Finish writing the queued frames before quitting
+			if (encoder.queue.empty()) {
+				return;
+			}
+			frame = std::move(encoder.queue.front());
+			encoder.queue.pop_front();
+		}
+		const bool written = std::fwrite(frame.data(), 1, frame.size(), encoder.file) == frame.size();
+
+		std::lock_guard<std::mutex> lock(encoder.mutex);
+		if (written) {
+			++encoder.stats.frames_encoded;
+			encoder.stats.bytes_written += frame.size();
+		} else if (!encoder.failed) {
+			std::cout << "Failed to write frames to the output, discarding the rest\n";
+			encoder.failed = true;
+		}
+		encoder.free_frames.push_back(std::move(frame));
+	}
+}
+
+// Copy the pixels for the encoder thread, or drop them if it's behind
+static void submit_frame(FrameEncoder &encoder, const uint8_t *pixels, size_t size) {
+	std::lock_guard<std::mutex> lock(encoder.mutex);
+	if (encoder.failed || encoder.queue.size() >= max_queued_frames) {
+		++encoder.stats.frames_dropped;
+		return;
+	}
+	std::vector<uint8_t> frame;
+	if (!encoder.free_frames.empty()) {
+		frame = std::move(encoder.free_frames.back());
+		encoder.free_frames.pop_back();
+	}
+	frame.assign(pixels, pixels + size);
+	encoder.queue.push_back(std::move(frame));
+	encoder.cv.notify_one();
+}
+
+// Prefer cached memory since the readbacks are read by the CPU
+static VkMemoryPropertyFlags readback_memory_props(VkPhysicalDevice physical_device) {
+	const VkMemoryPropertyFlags cached = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT
+		| VK_MEMORY_PROPERTY_HOST_COHERENT_BIT | VK_MEMORY_PROPERTY_HOST_CACHED_BIT;
+	VkPhysicalDeviceMemoryProperties mem_props = {};
+	vkGetPhysicalDeviceMemoryProperties(physical_device, &mem_props);
+	for (uint32_t i = 0; i < mem_props.memoryTypeCount; ++i) {
+		if ((mem_props.memoryTypes[i].propertyFlags & cached) == cached) {
+			return cached;
+		}
+	}
+	return VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+}
+
+FrameOutput create_frame_output(VkDevice device, VkPhysicalDevice physical_device, const std::string &target,
+		VkExtent2D extent, uint32_t num_frames)
+{
+	FrameOutput output;
+	output.extent = extent;
+	output.frame_bytes = VkDeviceSize(extent.width) * extent.height * 4;
+
+	output.encoder = std::make_shared<FrameEncoder>();
+	FrameEncoder *encoder = output.encoder.get();
+	if (!target.empty() && target[0] == '|') {
+		std::string command = target.substr(1);
+		const std::string size = std::to_string(extent.width) + "x" + std::to_string(extent.height);
+		for (size_t pos = command.find("{size}"); pos != std::string::npos; pos = command.find("{size}")) {
+			command.replace(pos, 6, size);
+		}
+#ifdef _WIN32
+		encoder->file = popen(command.c_str(), "wb");
+#else
+		// A failed write to an encoder which exited is reported instead of killing the process
+		std::signal(SIGPIPE, SIG_IGN);
+		encoder->file = popen(command.c_str(), "w");
+#endif
+		encoder->is_pipe = true;
+		std::cout << "Streaming " << size << " BGRA frames to '" << command << "'\n";
+	} else if (target.compare(0, 5, "unix:") == 0) {
+#ifndef _WIN32
+		// A failed write to a consumer which disconnected is reported instead of killing the process
+		std::signal(SIGPIPE, SIG_IGN);
+#endif
+		encoder->file = connect_output_socket(target.substr(5));
+		std::cout << "Streaming " << extent.width << "x" << extent.height << " BGRA frames to socket "
+			<< target.substr(5) << "\n";
+	} else {
+		encoder->file = std::fopen(target.c_str(), "wb");
+		std::cout << "Writing " << extent.width << "x" << extent.height << " BGRA frames to " << target << "\n";
+	}
+	if (!encoder->file) {
+		throw std::runtime_error("Failed to open the frame output " + target);
+	}
+	encoder->thread = std::thread([encoder]() { encode_frames(*encoder); });
+
+	const VkMemoryPropertyFlags mem_props = readback_memory_props(physical_device);
+	for (uint32_t i = 0; i < num_frames; ++i) {
+		Buffer buf = create_buffer(device, physical_device, output.frame_bytes, VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+				mem_props);
+		void *mapping = nullptr;
+		CHECK_VULKAN(vkMapMemory(device, buf.mem, 0, output.frame_bytes, 0, &mapping));
+		output.readback.push_back(buf);
+		output.mappings.push_back(reinterpret_cast<const uint8_t*>(mapping));
+	}
+	output.pending = std::vector<uint64_t>(num_frames, 0);
+	return output;
+}
+
+void frame_output_begin_frame(FrameOutput &output, uint32_t frame) {
+	if (output.pending[frame] != 0) {
+		submit_frame(*output.encoder, output.mappings[frame], output.frame_bytes);
+		output.pending[frame] = 0;
+	}
+}
+
+void flush_frame_output(FrameOutput &output) {
+	while (true) {
+		auto oldest = output.pending.end();
+		for (auto it = output.pending.begin(); it != output.pending.end(); ++it) {
+			if (*it != 0 && (oldest == output.pending.end() || *it < *oldest)) {
+				oldest = it;
+			}
+		}
+		if (oldest == output.pending.end()) {
+			return;
+		}
+		frame_output_begin_frame(output, oldest - output.pending.begin());
+	}
+}
+
+void record_frame_output(FrameOutput &output, VkCommandBuffer cmd_buf, uint32_t frame, VkImage image) {
+	image_barrier(cmd_buf, image, VK_IMAGE_ASPECT_COLOR_BIT,
+			VK_IMAGE_LAYOUT_PRESENT_SRC_KHR, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+			VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_TRANSFER_READ_BIT,
+			VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT,
+			VK_PIPELINE_STAGE_TRANSFER_BIT);
+
+	VkBufferImageCopy copy = {};
+	copy.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	copy.imageSubresource.layerCount = 1;
+	copy.imageExtent.width = output.extent.width;
+	copy.imageExtent.height = output.extent.height;
+	copy.imageExtent.depth = 1;
+	vkCmdCopyImageToBuffer(cmd_buf, image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, output.readback[frame].buffer,
+			1, &copy);
+
+	image_barrier(cmd_buf, image, VK_IMAGE_ASPECT_COLOR_BIT,
+			VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
+			VK_ACCESS_TRANSFER_READ_BIT, 0,
+			VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT);
+
+	VkBufferMemoryBarrier barrier = {};
+	barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+	barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+	barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.buffer = output.readback[frame].buffer;
+	barrier.size = VK_WHOLE_SIZE;
+	vkCmdPipelineBarrier(cmd_buf, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0,
+			0, nullptr, 1, &barrier, 0, nullptr);
+
+	output.pending[frame] = output.next_sequence++;
+}
+
+void destroy_frame_output(VkDevice device, FrameOutput &output) {
+	if (output.encoder) {
+		flush_frame_output(output);
+		{
+			std::lock_guard<std::mutex> lock(output.encoder->mutex);
+			output.encoder->quit = true;
+			output.encoder->cv.notify_one();
+		}
+		output.encoder->thread.join();
+		const FrameOutputStats &stats = output.encoder->stats;
+		std::cout << "Frame output: " << stats.frames_encoded << " frames written, " << stats.frames_dropped
+			<< " dropped, " << stats.bytes_written / (1024 * 1024) << "MB\n";
+		if (output.encoder->is_pipe) {
+			pclose(output.encoder->file);
+		} else {
+			std::fclose(output.encoder->file);
+		}
+	}
+	for (auto &b : output.readback) {
+		vkUnmapMemory(device, b.mem);
+		destroy_buffer(device, b);
+	}
+	output = FrameOutput();
+}
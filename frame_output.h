@@ -0,0 +1,58 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+#include <vulkan/vulkan.h>
+#include "vulkan_utils.h"
+
+// Streams the rendered frames to an encoder. Each frame's swapchain image is copied into the
+// frame's readback buffer after it's rendered, and once the frame's fence has been waited on
+// for its next use the pixels are handed to an encoder thread, so rendering never waits on the
+// readback or the encoding. When the encoder falls behind frames are dropped instead of
+// queueing up without bound.
+//
+// The target is a file the raw BGRA frames are appended to, which can be a named pipe,
+// "unix:PATH" to stream them to a consumer listening on a Unix domain socket, or "|command"
+// to pipe them into an encoder's stdin, where {size} in the command is replaced with
+// WIDTHxHEIGHT. E.g. "|ffmpeg -f rawvideo -pixel_format bgra -video_size {size}
+// -framerate 60 -i - -c:v libx264 out.mp4"
+
+struct FrameEncoder;
+
+struct FrameOutputStats {
+	uint64_t frames_encoded = 0;
+	uint64_t frames_dropped = 0;
+	uint64_t bytes_written = 0;
+};
+
+struct FrameOutput {
+	VkExtent2D extent = {};
+	VkDeviceSize frame_bytes = 0;
+	std::vector<Buffer> readback;
+	std::vector<const uint8_t*> mappings;
+	// The sequence number of the frame copied into each readback buffer and not handed to
+	// the encoder yet, or 0
+	std::vector<uint64_t> pending;
+	uint64_t next_sequence = 1;
+	std::shared_ptr<FrameEncoder> encoder;
+};
+
+// The swapchain images must have been created with transfer src usage. Throws if the target
+// can't be opened
+FrameOutput create_frame_output(VkDevice device, VkPhysicalDevice physical_device, const std::string &target,
+		VkExtent2D extent, uint32_t num_frames);
+
+// Hand the frame's previous readback to the encoder, the frame's fence must have been waited on
+void frame_output_begin_frame(FrameOutput &output, uint32_t frame);
+
+// Hand all readbacks to the encoder in the order they were rendered, the device must be idle
+void flush_frame_output(FrameOutput &output);
+
+// Record copying the rendered swapchain image into the frame's readback buffer. The image
+// must be in the present layout, and is left in it
+void record_frame_output(FrameOutput &output, VkCommandBuffer cmd_buf, uint32_t frame, VkImage image);
+
+// Flush the remaining readbacks, wait for the encoder to finish writing them and print the
+// frame counts. The device must be idle
+void destroy_frame_output(VkDevice device, FrameOutput &output);
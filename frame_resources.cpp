@@ -0,0 +1,114 @@
+#include <array>
+#include "frame_resources.h"
+
+FrameRingBuffer create_frame_ring_buffer(VkDevice device, VkPhysicalDevice physical_device,
+		VkDeviceSize frame_size, uint32_t num_frames, VkBufferUsageFlags usage)
+{
+	FrameRingBuffer ring;
+	ring.frame_size = frame_size;
+	ring.num_frames = num_frames;
+	ring.buffer = create_buffer(device, physical_device, frame_size * num_frames, usage,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+	CHECK_VULKAN(vkMapMemory(device, ring.buffer.mem, 0, ring.buffer.size, 0,
+			reinterpret_cast<void**>(&ring.mapping)));
+	return ring;
+}
+
+void ring_begin_frame(FrameRingBuffer &ring, uint32_t frame) {
+	ring.frame = frame;
+	ring.offset = 0;
+}
+
+RingAllocation ring_alloc(FrameRingBuffer &ring, VkDeviceSize size, VkDeviceSize alignment) {
+	RingAllocation alloc;
+	const VkDeviceSize offset = (ring.offset + alignment - 1) / alignment * alignment;
+	if (offset + size > ring.frame_size) {
+		return alloc;
+	}
+	ring.offset = offset + size;
+	alloc.offset = ring.frame * ring.frame_size + offset;
+	alloc.data = ring.mapping + alloc.offset;
+	return alloc;
+}
+
+void destroy_frame_ring_buffer(VkDevice device, FrameRingBuffer &ring) {
+	vkUnmapMemory(device, ring.buffer.mem);
+	destroy_buffer(device, ring.buffer);
+	ring = FrameRingBuffer();
+}
+
+FrameDescriptorPools create_frame_descriptor_pools(VkDevice device, uint32_t num_frames, uint32_t max_sets,
+		const std::vector<VkDescriptorPoolSize> &pool_sizes)
+{
+	FrameDescriptorPools pools;
+	for (uint32_t i = 0; i < num_frames; ++i) {
+		VkDescriptorPoolCreateInfo pool_info = {};
+		pool_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+		pool_info.maxSets = max_sets;
+		pool_info.poolSizeCount = pool_sizes.size();
+		pool_info.pPoolSizes = pool_sizes.data();
+		VkDescriptorPool pool = VK_NULL_HANDLE;
+		CHECK_VULKAN(vkCreateDescriptorPool(device, &pool_info, nullptr, &pool));
+		pools.pools.push_back(pool);
+	}
+	return pools;
+}
+
+VkDescriptorPool begin_frame_descriptor_pool(VkDevice device, FrameDescriptorPools &pools, uint32_t frame) {
+	CHECK_VULKAN(vkResetDescriptorPool(device, pools.pools[frame], 0));
+	return pools.pools[frame];
+}
+
+void destroy_frame_descriptor_pools(VkDevice device, FrameDescriptorPools &pools) {
+	for (auto &p : pools.pools) {
+		vkDestroyDescriptorPool(device, p, nullptr);
+	}
+	pools = FrameDescriptorPools();
+}
+
+std::vector<FrameContext> create_frame_contexts(VkDevice device, VkCommandPool command_pool, uint32_t num_frames) {
+	std::vector<FrameContext> frames(num_frames, FrameContext{});
+	for (auto &f : frames) {
+		VkSemaphoreCreateInfo semaphore_info = {};
+		semaphore_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+		CHECK_VULKAN(vkCreateSemaphore(device, &semaphore_info, nullptr, &f.img_avail_semaphore));
+		CHECK_VULKAN(vkCreateSemaphore(device, &semaphore_info, nullptr, &f.render_finished_semaphore));
+
+		VkFenceCreateInfo fence_info = {};
+		fence_info.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+		fence_info.flags = VK_FENCE_CREATE_SIGNALED_BIT;
+		CHECK_VULKAN(vkCreateFence(device, &fence_info, nullptr, &f.fence));
+
+		std::array<VkCommandBuffer, 8> buffers = {};
+		VkCommandBufferAllocateInfo info = {};
+		info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+		info.commandPool = command_pool;
+		info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+		info.commandBufferCount = buffers.size();
+		CHECK_VULKAN(vkAllocateCommandBuffers(device, &info, buffers.data()));
+		f.command_buffer = buffers[0];
+		f.shadow_command_buffer = buffers[1];
+		f.ui_command_buffer = buffers[2];
+		f.overlay_command_buffer = buffers[3];
+		f.particle_command_buffer = buffers[4];
+		f.virtual_texture_command_buffer = buffers[5];
+		f.output_command_buffer = buffers[6];
+		f.lit_command_buffer = buffers[7];
+	}
+	return frames;
+}
+
+void destroy_frame_contexts(VkDevice device, VkCommandPool command_pool, std::vector<FrameContext> &frames) {
+	for (auto &f : frames) {
+		const std::array<VkCommandBuffer, 8> buffers = {
+			f.command_buffer, f.shadow_command_buffer, f.ui_command_buffer, f.overlay_command_buffer,
+			f.particle_command_buffer, f.virtual_texture_command_buffer, f.output_command_buffer,
+			f.lit_command_buffer
+		};
+		vkFreeCommandBuffers(device, command_pool, buffers.size(), buffers.data());
+		vkDestroySemaphore(device, f.img_avail_semaphore, nullptr);
+		vkDestroySemaphore(device, f.render_finished_semaphore, nullptr);
+		vkDestroyFence(device, f.fence, nullptr);
+	}
+	frames.clear();
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <vector>
+#include <vulkan/vulkan.h>
+#include "vulkan_utils.h"
+
+// A persistently mapped host visible buffer split into one region per frame in flight, for
+// transient per-frame data such as vertices, indices and uniforms. Allocations are linear
+// within the frame's region and all released when the frame's region is reused.
+struct FrameRingBuffer {
+	Buffer buffer;
+	uint8_t *mapping = nullptr;
+	VkDeviceSize frame_size = 0;
+	uint32_t num_frames = 0;
+	uint32_t frame = 0;
+	VkDeviceSize offset = 0;
+};
+
+struct RingAllocation {
+	// Offset from the start of the buffer, for binding
+	VkDeviceSize offset = 0;
+	// Null if the frame's region is full
+	void *data = nullptr;
+};
+
+FrameRingBuffer create_frame_ring_buffer(VkDevice device, VkPhysicalDevice physical_device,
+		VkDeviceSize frame_size, uint32_t num_frames, VkBufferUsageFlags usage);
+
+// The frame's previous contents must no longer be in use by the GPU
+void ring_begin_frame(FrameRingBuffer &ring, uint32_t frame);
+
+RingAllocation ring_alloc(FrameRingBuffer &ring, VkDeviceSize size, VkDeviceSize alignment = 16);
+
+void destroy_frame_ring_buffer(VkDevice device, FrameRingBuffer &ring);
+
+// One descriptor pool per frame in flight for descriptor sets which only live for the frame.
+// The frame's pool is reset when it begins instead of freeing sets individually
+struct FrameDescriptorPools {
+	std::vector<VkDescriptorPool> pools;
+};
+
+FrameDescriptorPools create_frame_descriptor_pools(VkDevice device, uint32_t num_frames, uint32_t max_sets,
+		const std::vector<VkDescriptorPoolSize> &pool_sizes);
+
+// Reset the frame's pool and return it for allocating the frame's sets
+VkDescriptorPool begin_frame_descriptor_pool(VkDevice device, FrameDescriptorPools &pools, uint32_t frame);
+
+void destroy_frame_descriptor_pools(VkDevice device, FrameDescriptorPools &pools);
+
+// The synchronization and command buffers used by a frame in flight
+struct FrameContext {
+	VkFence fence = VK_NULL_HANDLE;
+	VkSemaphore img_avail_semaphore = VK_NULL_HANDLE;
+	VkSemaphore render_finished_semaphore = VK_NULL_HANDLE;
+	// Re-recorded each frame they're used
+	VkCommandBuffer command_buffer = VK_NULL_HANDLE;
+	VkCommandBuffer shadow_command_buffer = VK_NULL_HANDLE;
+	VkCommandBuffer ui_command_buffer = VK_NULL_HANDLE;
+	VkCommandBuffer overlay_command_buffer = VK_NULL_HANDLE;
+	VkCommandBuffer particle_command_buffer = VK_NULL_HANDLE;
+	VkCommandBuffer virtual_texture_command_buffer = VK_NULL_HANDLE;
+	VkCommandBuffer output_command_buffer = VK_NULL_HANDLE;
+	VkCommandBuffer lit_command_buffer = VK_NULL_HANDLE;
+	// The resource timeline value of the frame's last submission
+	uint64_t timeline_value = 0;
+};
+
+// The fences start signaled so the first wait on each frame returns immediately
+std::vector<FrameContext> create_frame_contexts(VkDevice device, VkCommandPool command_pool, uint32_t num_frames);
+
+void destroy_frame_contexts(VkDevice device, VkCommandPool command_pool, std::vector<FrameContext> &frames);
+
@@ -0,0 +1,283 @@
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <iostream>
+#include <limits>
+#include <random>
+#include <vector>
+#include "geometry_pool.h"
+
+// Meshes have their serial number in every vertex and indices derived from it, so the pool's
+// contents can be checked after the defragmenter moved them around
+struct ChurnMesh {
+	GeometryHandle handle;
+	uint32_t serial = 0;
+	uint32_t vertex_count = 0;
+	uint32_t index_count = 0;
+};
+
+struct ChurnFrame {
+	VkCommandBuffer cmd_buf = VK_NULL_HANDLE;
+	VkFence fence = VK_NULL_HANDLE;
+	uint64_t timeline_value = 0;
+	bool submitted = false;
+};
+
+struct ChurnResult {
+	uint32_t peak_blocks = 0;
+	uint32_t checked_meshes = 0;
+	uint32_t mismatches = 0;
+};
+
+static const uint32_t churn_vertex_stride = 16;
+
+static uint32_t live_blocks(const GeometryPool &pool) {
+	return std::count_if(pool.blocks.begin(), pool.blocks.end(),
+		[](const GeometryBlock &b) {
+			return !b.retired;
+		});
+}
+
+// Read back every live block and check each mesh's vertices and indices hold its serial
+static void check_churn_meshes(VkDevice device, VkPhysicalDevice physical_device, VkQueue queue,
+		VkCommandPool command_pool, const GeometryPool &pool, const ResourceManager &resources,
+		const std::vector<ChurnMesh> &meshes, ChurnResult &result)
+{
+	std::vector<Buffer> vertex_readback(pool.blocks.size());
+	std::vector<Buffer> index_readback(pool.blocks.size());
+	VkCommandBuffer cmd_buf = begin_one_time_commands(device, command_pool);
+	VkMemoryBarrier barrier = {};
+	barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+	vkCmdPipelineBarrier(cmd_buf, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+			1, &barrier, 0, nullptr, 0, nullptr);
+	for (size_t i = 0; i < pool.blocks.size(); ++i) {
+		const GeometryBlock &b = pool.blocks[i];
+		if (b.retired) {
+			continue;
+		}
+		VkBufferCopy region = {};
+		region.size = VkDeviceSize(b.vertex_capacity) * pool.vertex_stride;
+		vertex_readback[i] = create_buffer(device, physical_device, region.size, VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+		vkCmdCopyBuffer(cmd_buf, get_buffer(resources, b.vertices).buffer, vertex_readback[i].buffer, 1, &region);
+
+		region.size = VkDeviceSize(b.index_capacity) * sizeof(uint32_t);
+		index_readback[i] = create_buffer(device, physical_device, region.size, VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+		vkCmdCopyBuffer(cmd_buf, get_buffer(resources, b.indices).buffer, index_readback[i].buffer, 1, &region);
+	}
+	barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+	vkCmdPipelineBarrier(cmd_buf, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0,
+			1, &barrier, 0, nullptr, 0, nullptr);
+	end_one_time_commands(device, queue, command_pool, cmd_buf);
+
+	std::vector<const uint32_t*> vertex_data(pool.blocks.size(), nullptr);
+	std::vector<const uint32_t*> index_data(pool.blocks.size(), nullptr);
+	for (size_t i = 0; i < pool.blocks.size(); ++i) {
+		if (pool.blocks[i].retired) {
+			continue;
+		}
+		void *mapping = nullptr;
+		CHECK_VULKAN(vkMapMemory(device, vertex_readback[i].mem, 0, VK_WHOLE_SIZE, 0, &mapping));
+		vertex_data[i] = reinterpret_cast<const uint32_t*>(mapping);
+		CHECK_VULKAN(vkMapMemory(device, index_readback[i].mem, 0, VK_WHOLE_SIZE, 0, &mapping));
+		index_data[i] = reinterpret_cast<const uint32_t*>(mapping);
+	}
+
+	for (const auto &m : meshes) {
+		const GeometryMesh &mesh = get_geometry(pool, m.handle);
+		const uint32_t *vertices = vertex_data[mesh.block] + size_t(mesh.vertex_offset) * churn_vertex_stride / 4;
+		const uint32_t *indices = index_data[mesh.block] + mesh.first_index;
+		bool match = true;
+		for (uint32_t i = 0; i < m.vertex_count && match; ++i) {
+			match = vertices[i * churn_vertex_stride / 4] == m.serial;
+		}
+		for (uint32_t i = 0; i < m.index_count && match; ++i) {
+			match = indices[i] == (m.serial + i) % m.vertex_count;
+		}
+		++result.checked_meshes;
+		if (!match) {
+			++result.mismatches;
+		}
+	}
+
+	for (size_t i = 0; i < pool.blocks.size(); ++i) {
+		if (pool.blocks[i].retired) {
+			continue;
+		}
+		vkUnmapMemory(device, vertex_readback[i].mem);
+		vkUnmapMemory(device, index_readback[i].mem);
+		destroy_buffer(device, vertex_readback[i]);
+		destroy_buffer(device, index_readback[i]);
+	}
+}
+
+// Stream meshes in and out like a long session would, the number of live meshes rising to a
+// peak and falling back every period so the frees leave every block sparse. The same seed
+// gives the same meshes with and without the defragmenter
+static ChurnResult run_churn(VkDevice device, VkPhysicalDevice physical_device, VkQueue queue,
+		VkCommandPool command_pool, std::array<ChurnFrame, 2> &frames, uint32_t num_frames,
+		VkDeviceSize defrag_budget)
+{
+	ResourceManager resources;
+	GeometryPool pool = create_geometry_pool(churn_vertex_stride, 1 << 16, 1 << 18);
+	GeometryDefragmenter defrag;
+	defrag.params.max_bytes_per_step = defrag_budget;
+
+	std::mt19937 rng(7);
+	std::vector<ChurnMesh> meshes;
+	uint32_t next_serial = 1;
+	std::vector<uint32_t> vertices;
+	std::vector<uint32_t> indices;
+
+	ChurnResult result;
+	const uint32_t period = 240;
+	const uint32_t min_meshes = 64;
+	const uint32_t max_meshes = 512;
+	const uint32_t meshes_per_frame = 16;
+	for (uint32_t i = 0; i < num_frames; ++i) {
+		ChurnFrame &frame = frames[i % frames.size()];
+		if (frame.submitted) {
+			CHECK_VULKAN(vkWaitForFences(device, 1, &frame.fence, VK_TRUE, std::numeric_limits<uint64_t>::max()));
+			CHECK_VULKAN(vkResetFences(device, 1, &frame.fence));
+			complete_resource_timeline(device, resources, frame.timeline_value);
+			collect_geometry_frees(pool, resources);
+		}
+
+		VkCommandBufferBeginInfo begin_info = {};
+		begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+		begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+		CHECK_VULKAN(vkBeginCommandBuffer(frame.cmd_buf, &begin_info));
+
+		// Rise for the first half of the period and fall for the second, with some of the
+		// meshes replaced either way
+		const uint32_t phase = i % period;
+		const uint32_t ramp = phase < period / 2 ? phase : period - phase;
+		const uint32_t target = min_meshes + (max_meshes - min_meshes) * ramp / (period / 2);
+		uint32_t num_frees = std::min<uint32_t>(meshes.size(), meshes_per_frame / 4);
+		if (meshes.size() > target) {
+			num_frees = std::min<uint32_t>(meshes.size(), meshes.size() - target + num_frees);
+		}
+		for (uint32_t j = 0; j < num_frees; ++j) {
+			const size_t k = rng() % meshes.size();
+			free_geometry(pool, resources, meshes[k].handle);
+			meshes[k] = meshes.back();
+			meshes.pop_back();
+		}
+		const uint32_t num_adds = std::min<uint32_t>(meshes_per_frame,
+				meshes.size() < target ? target - meshes.size() : 0);
+		for (uint32_t j = 0; j < num_adds; ++j) {
+			ChurnMesh m;
+			m.serial = next_serial++;
+			m.vertex_count = 64 + rng() % 8192;
+			m.index_count = 3 * (m.vertex_count / 2 + rng() % m.vertex_count);
+			vertices.assign(size_t(m.vertex_count) * churn_vertex_stride / 4, 0);
+			for (uint32_t k = 0; k < m.vertex_count; ++k) {
+				vertices[k * churn_vertex_stride / 4] = m.serial;
+			}
+			indices.resize(m.index_count);
+			for (uint32_t k = 0; k < m.index_count; ++k) {
+				indices[k] = (m.serial + k) % m.vertex_count;
+			}
+			m.handle = add_geometry(device, physical_device, pool, resources, frame.cmd_buf, vertices.data(),
+					m.vertex_count, indices.data(), m.index_count);
+			meshes.push_back(m);
+		}
+
+		if (defrag_budget > 0 && geometry_defrag_pending(defrag, pool)) {
+			defragment_geometry_step(defrag, pool, resources, frame.cmd_buf);
+		}
+		CHECK_VULKAN(vkEndCommandBuffer(frame.cmd_buf));
+
+		VkSubmitInfo submit_info = {};
+		submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+		submit_info.commandBufferCount = 1;
+		submit_info.pCommandBuffers = &frame.cmd_buf;
+		CHECK_VULKAN(vkQueueSubmit(queue, 1, &submit_info, frame.fence));
+		frame.timeline_value = submit_resource_timeline(resources);
+		frame.submitted = true;
+
+		result.peak_blocks = std::max(result.peak_blocks, live_blocks(pool));
+	}
+
+	for (auto &f : frames) {
+		if (f.submitted) {
+			CHECK_VULKAN(vkWaitForFences(device, 1, &f.fence, VK_TRUE, std::numeric_limits<uint64_t>::max()));
+			CHECK_VULKAN(vkResetFences(device, 1, &f.fence));
+			f.submitted = false;
+		}
+	}
+	complete_all_resource_timeline(device, resources);
+	collect_geometry_frees(pool, resources);
+
+	check_churn_meshes(device, physical_device, queue, command_pool, pool, resources, meshes, result);
+	std::cout << "  " << result.peak_blocks << " blocks at the peak\n  ";
+	print_geometry_pool_stats(pool);
+	if (defrag_budget > 0) {
+		std::cout << "  ";
+		print_geometry_defrag_stats(defrag);
+	}
+
+	// Compacting everything at once while idle packs the pool as tightly as it gets, for
+	// comparison with the incremental defragmentation
+	VkCommandBuffer cmd_buf = begin_one_time_commands(device, command_pool);
+	compact_geometry_pool(device, physical_device, pool, resources, cmd_buf);
+	end_one_time_commands(device, queue, command_pool, cmd_buf);
+	flush_released_resources(device, resources);
+	check_churn_meshes(device, physical_device, queue, command_pool, pool, resources, meshes, result);
+	std::cout << "  Compacted: ";
+	print_geometry_pool_stats(pool);
+
+	destroy_geometry_pool(pool, resources);
+	flush_released_resources(device, resources);
+	destroy_resource_manager(device, resources);
+	return result;
+}
+
+bool run_geometry_churn(VkDevice device, VkPhysicalDevice physical_device, VkQueue queue, uint32_t queue_family,
+		uint32_t frames, VkDeviceSize defrag_budget)
+{
+	VkCommandPool command_pool = VK_NULL_HANDLE;
+	{
+		VkCommandPoolCreateInfo info = {};
+		info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+		info.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+		info.queueFamilyIndex = queue_family;
+		CHECK_VULKAN(vkCreateCommandPool(device, &info, nullptr, &command_pool));
+	}
+
+	std::array<ChurnFrame, 2> churn_frames;
+	for (auto &f : churn_frames) {
+		VkCommandBufferAllocateInfo info = {};
+		info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+		info.commandPool = command_pool;
+		info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+		info.commandBufferCount = 1;
+		CHECK_VULKAN(vkAllocateCommandBuffers(device, &info, &f.cmd_buf));
+
+		VkFenceCreateInfo fence_info = {};
+		fence_info.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+		CHECK_VULKAN(vkCreateFence(device, &fence_info, nullptr, &f.fence));
+	}
+
+	std::cout << "Geometry churn: " << frames << " frames, without defragmentation\n";
+	const ChurnResult before = run_churn(device, physical_device, queue, command_pool, churn_frames, frames, 0);
+	ChurnResult after;
+	if (defrag_budget > 0) {
+		std::cout << "Geometry churn: " << frames << " frames, defragmenting " << defrag_budget / 1024
+			<< " KB per frame\n";
+		after = run_churn(device, physical_device, queue, command_pool, churn_frames, frames, defrag_budget);
+	}
+	const uint32_t mismatches = before.mismatches + after.mismatches;
+	std::cout << "Geometry churn: checked " << before.checked_meshes + after.checked_meshes << " meshes, "
+		<< mismatches << " mismatched\n";
+
+	for (auto &f : churn_frames) {
+		vkDestroyFence(device, f.fence, nullptr);
+	}
+	vkDestroyCommandPool(device, command_pool, nullptr);
+	return mismatches == 0;
+}
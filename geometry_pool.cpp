@@ -0,0 +1,523 @@
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include "geometry_pool.h"
+
+// Take count elements from the first free range large enough
+static bool alloc_range(std::vector<GeometryRange> &free_ranges, uint32_t count, uint32_t &offset) {
+	for (auto it = free_ranges.begin(); it != free_ranges.end(); ++it) {
+		if (it->count < count) {
+			continue;
+		}
+		offset = it->offset;
+		it->offset += count;
+		it->count -= count;
+		if (it->count == 0) {
+			free_ranges.erase(it);
+		}
+		return true;
+	}
+	return false;
+}
+
+// Return the range to the free list, merging it with its free neighbours
+static void free_range(std::vector<GeometryRange> &free_ranges, GeometryRange range) {
+	if (range.count == 0) {
+		return;
+	}
+	auto next = std::lower_bound(free_ranges.begin(), free_ranges.end(), range,
+		[](const GeometryRange &a, const GeometryRange &b) {
+			return a.offset < b.offset;
+		});
+	if (next != free_ranges.begin()) {
+		auto prev = next - 1;
+		if (prev->offset + prev->count == range.offset) {
+			prev->count += range.count;
+			if (next != free_ranges.end() && prev->offset + prev->count == next->offset) {
+				prev->count += next->count;
+				free_ranges.erase(next);
+			}
+			return;
+		}
+	}
+	if (next != free_ranges.end() && range.offset + range.count == next->offset) {
+		next->offset = range.offset;
+		next->count += range.count;
+		return;
+	}
+	free_ranges.insert(next, range);
+}
+
+static GeometryBlock create_geometry_block(VkDevice device, VkPhysicalDevice physical_device,
+		const GeometryPool &pool, ResourceManager &resources, uint32_t vertex_capacity, uint32_t index_capacity)
+{
+	GeometryBlock block;
+	block.vertex_capacity = vertex_capacity;
+	block.index_capacity = index_capacity;
+	block.vertices = add_buffer(resources, create_buffer(device, physical_device,
+			VkDeviceSize(vertex_capacity) * pool.vertex_stride,
+			VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT));
+	block.indices = add_buffer(resources, create_buffer(device, physical_device,
+			VkDeviceSize(index_capacity) * sizeof(uint32_t),
+			VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT));
+	block.free_vertices.push_back(GeometryRange{0, vertex_capacity});
+	block.free_indices.push_back(GeometryRange{0, index_capacity});
+	return block;
+}
+
+static bool alloc_in_block(GeometryBlock &block, uint32_t vertex_count, uint32_t index_count, GeometryMesh &mesh) {
+	if (block.retired || block.draining) {
+		return false;
+	}
+	uint32_t vertex_offset = 0;
+	uint32_t first_index = 0;
+	if (!alloc_range(block.free_vertices, vertex_count, vertex_offset)) {
+		return false;
+	}
+	if (!alloc_range(block.free_indices, index_count, first_index)) {
+		free_range(block.free_vertices, GeometryRange{vertex_offset, vertex_count});
+		return false;
+	}
+	mesh.vertex_offset = int32_t(vertex_offset);
+	mesh.vertex_count = vertex_count;
+	mesh.first_index = first_index;
+	mesh.index_count = index_count;
+	block.used_vertices += vertex_count;
+	block.used_indices += index_count;
+	return true;
+}
+
+static VkDeviceSize mesh_bytes(const GeometryPool &pool, const GeometryMesh &mesh) {
+	return VkDeviceSize(mesh.vertex_count) * pool.vertex_stride + VkDeviceSize(mesh.index_count) * sizeof(uint32_t);
+}
+
+// Queue the mesh's ranges to be freed once the submission being recorded completes
+static void defer_free(GeometryPool &pool, const ResourceManager &resources, const GeometryMesh &mesh) {
+	GeometryBlock &block = pool.blocks[mesh.block];
+	block.used_vertices -= mesh.vertex_count;
+	block.used_indices -= mesh.index_count;
+
+	GeometryFree f;
+	f.mesh = mesh;
+	f.value = resources.recording_value;
+	pool.deferred_frees.push_back(f);
+}
+
+// Make transfer writes to the blocks visible to the following copies and vertex input
+static void geometry_copy_barrier(VkCommandBuffer cmd_buf) {
+	VkMemoryBarrier barrier = {};
+	barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT
+		| VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT;
+	vkCmdPipelineBarrier(cmd_buf, VK_PIPELINE_STAGE_TRANSFER_BIT,
+			VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, 0,
+			1, &barrier, 0, nullptr, 0, nullptr);
+}
+
+GeometryPool create_geometry_pool(uint32_t vertex_stride, uint32_t block_vertices, uint32_t block_indices) {
+	GeometryPool pool;
+	pool.vertex_stride = vertex_stride;
+	pool.block_vertices = block_vertices;
+	pool.block_indices = block_indices;
+	return pool;
+}
+
+GeometryHandle add_geometry(VkDevice device, VkPhysicalDevice physical_device, GeometryPool &pool,
+		ResourceManager &resources, VkCommandBuffer cmd_buf, const void *vertices, uint32_t vertex_count,
+		const uint32_t *indices, uint32_t index_count)
+{
+	GeometryMesh mesh;
+	bool placed = false;
+	for (uint32_t i = 0; i < pool.blocks.size() && !placed; ++i) {
+		placed = alloc_in_block(pool.blocks[i], vertex_count, index_count, mesh);
+		mesh.block = i;
+	}
+	if (!placed) {
+		const GeometryBlock block = create_geometry_block(device, physical_device, pool, resources,
+				std::max(pool.block_vertices, vertex_count), std::max(pool.block_indices, index_count));
+		auto retired = std::find_if(pool.blocks.begin(), pool.blocks.end(),
+			[](const GeometryBlock &b) {
+				return b.retired;
+			});
+		if (retired != pool.blocks.end()) {
+			*retired = block;
+		} else {
+			retired = pool.blocks.insert(pool.blocks.end(), block);
+		}
+		mesh.block = retired - pool.blocks.begin();
+		alloc_in_block(*retired, vertex_count, index_count, mesh);
+	}
+
+	const size_t vertex_bytes = size_t(vertex_count) * pool.vertex_stride;
+	const size_t index_bytes = size_t(index_count) * sizeof(uint32_t);
+	if (vertex_bytes + index_bytes > 0) {
+		std::vector<uint8_t> staging_data(vertex_bytes + index_bytes);
+		std::memcpy(staging_data.data(), vertices, vertex_bytes);
+		std::memcpy(staging_data.data() + vertex_bytes, indices, index_bytes);
+		const BufferHandle staging = add_buffer(resources, create_host_buffer(device, physical_device,
+				staging_data.data(), staging_data.size(), VK_BUFFER_USAGE_TRANSFER_SRC_BIT));
+
+		const GeometryBlock &block = pool.blocks[mesh.block];
+		VkBufferCopy region = {};
+		if (vertex_bytes > 0) {
+			region.srcOffset = 0;
+			region.dstOffset = VkDeviceSize(mesh.vertex_offset) * pool.vertex_stride;
+			region.size = vertex_bytes;
+			vkCmdCopyBuffer(cmd_buf, get_buffer(resources, staging).buffer,
+					get_buffer(resources, block.vertices).buffer, 1, &region);
+		}
+		if (index_bytes > 0) {
+			region.srcOffset = vertex_bytes;
+			region.dstOffset = VkDeviceSize(mesh.first_index) * sizeof(uint32_t);
+			region.size = index_bytes;
+			vkCmdCopyBuffer(cmd_buf, get_buffer(resources, staging).buffer,
+					get_buffer(resources, block.indices).buffer, 1, &region);
+		}
+		geometry_copy_barrier(cmd_buf);
+		release_buffer(resources, staging);
+	}
+
+	++pool.stats.meshes;
+	pool.stats.used_vertices += vertex_count;
+	pool.stats.used_indices += index_count;
+	pool.stats.uploaded_bytes += vertex_bytes + index_bytes;
+	++pool.version;
+
+	uint32_t index = 0;
+	if (!pool.meshes.free_slots.empty()) {
+		index = pool.meshes.free_slots.back();
+		pool.meshes.free_slots.pop_back();
+	} else {
+		index = pool.meshes.slots.size();
+		pool.meshes.slots.emplace_back();
+	}
+	auto &slot = pool.meshes.slots[index];
+	slot.resource = mesh;
+	slot.used = true;
+
+	GeometryHandle handle;
+	handle.index = index;
+	handle.generation = slot.generation;
+	return handle;
+}
+
+bool is_valid(const GeometryPool &pool, GeometryHandle handle) {
+	return handle.index < pool.meshes.slots.size() && pool.meshes.slots[handle.index].used
+		&& pool.meshes.slots[handle.index].generation == handle.generation;
+}
+
+const GeometryMesh& get_geometry(const GeometryPool &pool, GeometryHandle handle) {
+	if (!is_valid(pool, handle)) {
+		throw std::runtime_error("Stale geometry handle");
+	}
+	return pool.meshes.slots[handle.index].resource;
+}
+
+void free_geometry(GeometryPool &pool, const ResourceManager &resources, GeometryHandle handle) {
+	if (!is_valid(pool, handle)) {
+		throw std::runtime_error("Freeing a stale geometry handle");
+	}
+	auto &slot = pool.meshes.slots[handle.index];
+	defer_free(pool, resources, slot.resource);
+
+	--pool.stats.meshes;
+	pool.stats.used_vertices -= slot.resource.vertex_count;
+	pool.stats.used_indices -= slot.resource.index_count;
+	++pool.version;
+
+	slot.resource = GeometryMesh();
+	slot.used = false;
+	++slot.generation;
+	pool.meshes.free_slots.push_back(handle.index);
+}
+
+void collect_geometry_frees(GeometryPool &pool, const ResourceManager &resources) {
+	while (!pool.deferred_frees.empty() && pool.deferred_frees.front().value <= resources.completed_value) {
+		const GeometryMesh &mesh = pool.deferred_frees.front().mesh;
+		GeometryBlock &block = pool.blocks[mesh.block];
+		free_range(block.free_vertices, GeometryRange{uint32_t(mesh.vertex_offset), mesh.vertex_count});
+		free_range(block.free_indices, GeometryRange{mesh.first_index, mesh.index_count});
+		pool.deferred_frees.pop_front();
+	}
+}
+
+void bind_geometry_block(const GeometryPool &pool, const ResourceManager &resources, VkCommandBuffer cmd_buf,
+		uint32_t block)
+{
+	const GeometryBlock &b = pool.blocks[block];
+	const VkDeviceSize offset = 0;
+	vkCmdBindVertexBuffers(cmd_buf, 0, 1, &get_buffer(resources, b.vertices).buffer, &offset);
+	vkCmdBindIndexBuffer(cmd_buf, get_buffer(resources, b.indices).buffer, 0, VK_INDEX_TYPE_UINT32);
+}
+
+VkDeviceSize geometry_free_bytes(const GeometryPool &pool) {
+	VkDeviceSize total = 0;
+	for (const auto &b : pool.blocks) {
+		total += VkDeviceSize(b.vertex_capacity) * pool.vertex_stride
+			+ VkDeviceSize(b.index_capacity) * sizeof(uint32_t);
+	}
+	return total - pool.stats.used_vertices * pool.vertex_stride - pool.stats.used_indices * sizeof(uint32_t);
+}
+
+void compact_geometry_pool(VkDevice device, VkPhysicalDevice physical_device, GeometryPool &pool,
+		ResourceManager &resources, VkCommandBuffer cmd_buf)
+{
+	std::vector<GeometryBlock> old_blocks;
+	old_blocks.swap(pool.blocks);
+	pool.deferred_frees.clear();
+
+	if (pool.stats.meshes > 0) {
+		pool.blocks.push_back(create_geometry_block(device, physical_device, pool, resources,
+				std::max(pool.block_vertices, uint32_t(pool.stats.used_vertices)),
+				std::max(pool.block_indices, uint32_t(pool.stats.used_indices))));
+		GeometryBlock &block = pool.blocks.back();
+		const VkBuffer dst_vertices = get_buffer(resources, block.vertices).buffer;
+		const VkBuffer dst_indices = get_buffer(resources, block.indices).buffer;
+
+		// Earlier uploads to the old blocks must land before they're read
+		geometry_copy_barrier(cmd_buf);
+
+		std::vector<std::vector<VkBufferCopy>> vertex_regions(old_blocks.size());
+		std::vector<std::vector<VkBufferCopy>> index_regions(old_blocks.size());
+		uint32_t vertex_offset = 0;
+		uint32_t first_index = 0;
+		for (auto &slot : pool.meshes.slots) {
+			if (!slot.used) {
+				continue;
+			}
+			GeometryMesh &mesh = slot.resource;
+			VkBufferCopy region = {};
+			if (mesh.vertex_count > 0) {
+				region.srcOffset = VkDeviceSize(mesh.vertex_offset) * pool.vertex_stride;
+				region.dstOffset = VkDeviceSize(vertex_offset) * pool.vertex_stride;
+				region.size = VkDeviceSize(mesh.vertex_count) * pool.vertex_stride;
+				vertex_regions[mesh.block].push_back(region);
+			}
+			if (mesh.index_count > 0) {
+				region.srcOffset = VkDeviceSize(mesh.first_index) * sizeof(uint32_t);
+				region.dstOffset = VkDeviceSize(first_index) * sizeof(uint32_t);
+				region.size = VkDeviceSize(mesh.index_count) * sizeof(uint32_t);
+				index_regions[mesh.block].push_back(region);
+			}
+			pool.stats.compacted_bytes += mesh_bytes(pool, mesh);
+
+			mesh.block = 0;
+			mesh.vertex_offset = int32_t(vertex_offset);
+			mesh.first_index = first_index;
+			vertex_offset += mesh.vertex_count;
+			first_index += mesh.index_count;
+		}
+		for (size_t i = 0; i < old_blocks.size(); ++i) {
+			if (!vertex_regions[i].empty()) {
+				vkCmdCopyBuffer(cmd_buf, get_buffer(resources, old_blocks[i].vertices).buffer, dst_vertices,
+						vertex_regions[i].size(), vertex_regions[i].data());
+			}
+			if (!index_regions[i].empty()) {
+				vkCmdCopyBuffer(cmd_buf, get_buffer(resources, old_blocks[i].indices).buffer, dst_indices,
+						index_regions[i].size(), index_regions[i].data());
+			}
+		}
+		geometry_copy_barrier(cmd_buf);
+
+		block.free_vertices.clear();
+		block.free_indices.clear();
+		free_range(block.free_vertices, GeometryRange{vertex_offset, block.vertex_capacity - vertex_offset});
+		free_range(block.free_indices, GeometryRange{first_index, block.index_capacity - first_index});
+		block.used_vertices = vertex_offset;
+		block.used_indices = first_index;
+	}
+
+	// The old blocks may still be read by the frames in flight
+	for (auto &b : old_blocks) {
+		if (!b.retired) {
+			release_buffer(resources, b.vertices);
+			release_buffer(resources, b.indices);
+		}
+	}
+	++pool.stats.compactions;
+	++pool.version;
+}
+
+void print_geometry_pool_stats(const GeometryPool &pool) {
+	const size_t num_blocks = std::count_if(pool.blocks.begin(), pool.blocks.end(),
+		[](const GeometryBlock &b) {
+			return !b.retired;
+		});
+	std::cout << "Geometry pool: " << pool.stats.meshes << " meshes in " << num_blocks << " blocks, "
+		<< (pool.stats.used_vertices * pool.vertex_stride + pool.stats.used_indices * sizeof(uint32_t)) / 1024
+		<< " KB used, " << geometry_free_bytes(pool) / 1024 << " KB free, "
+		<< pool.stats.uploaded_bytes / 1024 << " KB uploaded, " << pool.stats.compactions << " compactions moving "
+		<< pool.stats.compacted_bytes / 1024 << " KB\n";
+}
+
+// The emptiest block, if it's sparse enough to empty and the other blocks have room for its
+// meshes, or -1
+static int32_t pick_defrag_source(const GeometryDefragmenter &defrag, const GeometryPool &pool) {
+	int32_t source = -1;
+	float source_occupancy = defrag.params.max_occupancy;
+	uint64_t free_vertices = 0;
+	uint64_t free_indices = 0;
+	uint32_t num_blocks = 0;
+	for (size_t i = 0; i < pool.blocks.size(); ++i) {
+		const GeometryBlock &b = pool.blocks[i];
+		if (b.retired) {
+			continue;
+		}
+		++num_blocks;
+		free_vertices += b.vertex_capacity - b.used_vertices;
+		free_indices += b.index_capacity - b.used_indices;
+
+		const VkDeviceSize capacity = VkDeviceSize(b.vertex_capacity) * pool.vertex_stride
+			+ VkDeviceSize(b.index_capacity) * sizeof(uint32_t);
+		const VkDeviceSize used = VkDeviceSize(b.used_vertices) * pool.vertex_stride
+			+ VkDeviceSize(b.used_indices) * sizeof(uint32_t);
+		const float occupancy = capacity > 0 ? float(used) / capacity : 0.f;
+		if (occupancy < source_occupancy) {
+			source = i;
+			source_occupancy = occupancy;
+		}
+	}
+	if (num_blocks < 2 || source < 0) {
+		return -1;
+	}
+	const GeometryBlock &b = pool.blocks[source];
+	free_vertices -= b.vertex_capacity - b.used_vertices;
+	free_indices -= b.index_capacity - b.used_indices;
+	if (free_vertices < b.used_vertices || free_indices < b.used_indices) {
+		return -1;
+	}
+	return source;
+}
+
+bool geometry_defrag_pending(GeometryDefragmenter &defrag, GeometryPool &pool) {
+	// Compacting the pool replaces its blocks, which aren't draining
+	if (defrag.source_block >= 0 && (defrag.source_block >= int32_t(pool.blocks.size())
+			|| !pool.blocks[defrag.source_block].draining))
+	{
+		defrag.source_block = -1;
+	}
+	if (defrag.source_block >= 0) {
+		return true;
+	}
+	if (pool.version == defrag.idle_version) {
+		return false;
+	}
+	defrag.source_block = pick_defrag_source(defrag, pool);
+	if (defrag.source_block < 0) {
+		defrag.idle_version = pool.version;
+		return false;
+	}
+	pool.blocks[defrag.source_block].draining = true;
+	return true;
+}
+
+void defragment_geometry_step(GeometryDefragmenter &defrag, GeometryPool &pool, ResourceManager &resources,
+		VkCommandBuffer cmd_buf)
+{
+	if (!geometry_defrag_pending(defrag, pool)) {
+		return;
+	}
+	++defrag.stats.steps;
+	const uint32_t source_index = defrag.source_block;
+
+	// Once the moved meshes' ranges are freed nothing reads the block, release it
+	{
+		GeometryBlock &source = pool.blocks[source_index];
+		if (source.used_vertices == 0 && source.used_indices == 0) {
+			const bool all_free = source.free_vertices.size() == 1 && source.free_indices.size() == 1
+				&& source.free_vertices[0].count == source.vertex_capacity
+				&& source.free_indices[0].count == source.index_capacity;
+			if (all_free) {
+				release_buffer(resources, source.vertices);
+				release_buffer(resources, source.indices);
+				source = GeometryBlock();
+				source.retired = true;
+				defrag.source_block = -1;
+				++defrag.stats.retired_blocks;
+			}
+			return;
+		}
+	}
+
+	VkDeviceSize moved_bytes = 0;
+	bool abandoned = false;
+	for (auto &slot : pool.meshes.slots) {
+		if (moved_bytes >= defrag.params.max_bytes_per_step) {
+			break;
+		}
+		if (!slot.used || slot.resource.block != source_index) {
+			continue;
+		}
+		const GeometryMesh mesh = slot.resource;
+		GeometryMesh moved;
+		bool placed = false;
+		for (uint32_t i = 0; i < pool.blocks.size() && !placed; ++i) {
+			if (i != source_index) {
+				placed = alloc_in_block(pool.blocks[i], mesh.vertex_count, mesh.index_count, moved);
+				moved.block = i;
+			}
+		}
+		if (!placed) {
+			abandoned = true;
+			break;
+		}
+
+		// Earlier uploads and moves into the source block must land before it's read
+		if (moved_bytes == 0) {
+			geometry_copy_barrier(cmd_buf);
+		}
+		const GeometryBlock &src = pool.blocks[mesh.block];
+		const GeometryBlock &dst = pool.blocks[moved.block];
+		VkBufferCopy region = {};
+		if (mesh.vertex_count > 0) {
+			region.srcOffset = VkDeviceSize(mesh.vertex_offset) * pool.vertex_stride;
+			region.dstOffset = VkDeviceSize(moved.vertex_offset) * pool.vertex_stride;
+			region.size = VkDeviceSize(mesh.vertex_count) * pool.vertex_stride;
+			vkCmdCopyBuffer(cmd_buf, get_buffer(resources, src.vertices).buffer,
+					get_buffer(resources, dst.vertices).buffer, 1, &region);
+		}
+		if (mesh.index_count > 0) {
+			region.srcOffset = VkDeviceSize(mesh.first_index) * sizeof(uint32_t);
+			region.dstOffset = VkDeviceSize(moved.first_index) * sizeof(uint32_t);
+			region.size = VkDeviceSize(mesh.index_count) * sizeof(uint32_t);
+			vkCmdCopyBuffer(cmd_buf, get_buffer(resources, src.indices).buffer,
+					get_buffer(resources, dst.indices).buffer, 1, &region);
+		}
+		defer_free(pool, resources, mesh);
+		slot.resource = moved;
+
+		moved_bytes += mesh_bytes(pool, mesh);
+		++defrag.stats.moved_meshes;
+	}
+
+	if (moved_bytes > 0) {
+		geometry_copy_barrier(cmd_buf);
+		defrag.stats.moved_bytes += moved_bytes;
+		++pool.version;
+	}
+	if (abandoned) {
+		pool.blocks[source_index].draining = false;
+		defrag.source_block = -1;
+		defrag.idle_version = pool.version;
+		++defrag.stats.abandoned_blocks;
+	}
+}
+
+void print_geometry_defrag_stats(const GeometryDefragmenter &defrag) {
+	std::cout << "Geometry defragmentation: " << defrag.stats.steps << " steps moved " << defrag.stats.moved_meshes
+		<< " meshes, " << defrag.stats.moved_bytes / 1024 << " KB, " << defrag.stats.retired_blocks
+		<< " blocks released, " << defrag.stats.abandoned_blocks << " abandoned\n";
+}
+
+void destroy_geometry_pool(GeometryPool &pool, ResourceManager &resources) {
+	for (auto &b : pool.blocks) {
+		if (!b.retired) {
+			release_buffer(resources, b.vertices);
+			release_buffer(resources, b.indices);
+		}
+	}
+	pool = GeometryPool();
+}
@@ -0,0 +1,175 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <vector>
+#include <vulkan/vulkan.h>
+#include "resources.h"
+#include "vulkan_utils.h"
+
+// The vertices and indices of many meshes packed into a few large device local buffers, so
+// drawing them takes one vertex and index buffer bind per block and each draw selects its
+// mesh with vkCmdDrawIndexed's firstIndex and vertexOffset. The indices are relative to the
+// mesh's first vertex, so meshes can be placed anywhere in the block without rewriting them.
+//
+// Each block's vertices and indices are sub-allocated from first fit free lists, with freed
+// ranges merged with their free neighbours. A freed range may still be read by the frames in
+// flight, so it only returns to the free list once the submission being recorded when it was
+// freed completes, using the resource manager's timeline. Meshes are referenced by
+// generational handles, so compacting or defragmenting the pool can move them.
+
+// A range of a block, in vertices or indices
+struct GeometryRange {
+	uint32_t offset = 0;
+	uint32_t count = 0;
+};
+
+// Where a mesh lives in the pool, for drawing it
+struct GeometryMesh {
+	uint32_t block = 0;
+	int32_t vertex_offset = 0;
+	uint32_t vertex_count = 0;
+	uint32_t first_index = 0;
+	uint32_t index_count = 0;
+};
+
+using GeometryHandle = ResourceHandle<GeometryMesh>;
+
+struct GeometryBlock {
+	BufferHandle vertices;
+	BufferHandle indices;
+	uint32_t vertex_capacity = 0;
+	uint32_t index_capacity = 0;
+	// Sorted by offset, with no two ranges adjacent
+	std::vector<GeometryRange> free_vertices;
+	std::vector<GeometryRange> free_indices;
+	// Taken by the live meshes
+	uint32_t used_vertices = 0;
+	uint32_t used_indices = 0;
+	// Being emptied by the defragmenter, new meshes go elsewhere so it can be released
+	bool draining = false;
+	// Emptied by the defragmenter and its buffers released, the next new block reuses it
+	bool retired = false;
+};
+
+// A freed mesh's ranges, returned to the free lists once the submission value completes
+struct GeometryFree {
+	GeometryMesh mesh;
+	uint64_t value = 0;
+};
+
+struct GeometryPoolStats {
+	uint32_t meshes = 0;
+	uint64_t used_vertices = 0;
+	uint64_t used_indices = 0;
+	uint64_t uploaded_bytes = 0;
+	uint32_t compactions = 0;
+	uint64_t compacted_bytes = 0;
+};
+
+struct GeometryPool {
+	uint32_t vertex_stride = 0;
+	// The size of new blocks, larger meshes get a block of their own size
+	uint32_t block_vertices = 0;
+	uint32_t block_indices = 0;
+	std::vector<GeometryBlock> blocks;
+	ResourcePool<GeometryMesh> meshes;
+	std::deque<GeometryFree> deferred_frees;
+	// Bumped when meshes are added, freed or moved, for refreshing placements copied out of
+	// the pool
+	uint64_t version = 0;
+	GeometryPoolStats stats;
+};
+
+GeometryPool create_geometry_pool(uint32_t vertex_stride, uint32_t block_vertices, uint32_t block_indices);
+
+// Allocate the mesh's ranges, adding a block if none has room, and record copying the data
+// into them from a staging buffer which is released to the resource manager. The copy is
+// made visible to vertex input, the command buffer must be submitted before the mesh is drawn
+GeometryHandle add_geometry(VkDevice device, VkPhysicalDevice physical_device, GeometryPool &pool,
+		ResourceManager &resources, VkCommandBuffer cmd_buf, const void *vertices, uint32_t vertex_count,
+		const uint32_t *indices, uint32_t index_count);
+
+bool is_valid(const GeometryPool &pool, GeometryHandle handle);
+
+// Throws if the mesh was freed
+const GeometryMesh& get_geometry(const GeometryPool &pool, GeometryHandle handle);
+
+// Invalidate the handle, its ranges are reused once the submission being recorded completes
+void free_geometry(GeometryPool &pool, const ResourceManager &resources, GeometryHandle handle);
+
+// Return the ranges freed before the resource manager's completed value to the free lists,
+// called after completing the resource timeline
+void collect_geometry_frees(GeometryPool &pool, const ResourceManager &resources);
+
+// Bind the block's vertex buffer to binding 0 and its index buffer
+void bind_geometry_block(const GeometryPool &pool, const ResourceManager &resources, VkCommandBuffer cmd_buf,
+		uint32_t block);
+
+// The bytes allocated for the blocks which aren't holding a live mesh, including the ranges
+// waiting to be freed
+VkDeviceSize geometry_free_bytes(const GeometryPool &pool);
+
+// Record copying all live meshes tightly packed into a single new block and release the old
+// blocks to the resource manager, closing the holes left by freed meshes. The meshes' handles
+// stay valid but their placement changes, so draws must be recorded after compacting
+void compact_geometry_pool(VkDevice device, VkPhysicalDevice physical_device, GeometryPool &pool,
+		ResourceManager &resources, VkCommandBuffer cmd_buf);
+
+void print_geometry_pool_stats(const GeometryPool &pool);
+
+// Incremental defragmentation for pools whose meshes come and go over long sessions. Freed
+// meshes leave holes in the blocks and new blocks get added when no single free range is
+// large enough, so the pool keeps growing even though it has the space. Each step moves
+// meshes out of the emptiest block into the free ranges of the others with GPU copies, up to
+// a budget of bytes per step so no frame pays for copying the whole pool, and releases the
+// block's buffers once it's empty and the frames in flight which read it are done.
+
+struct GeometryDefragParams {
+	// The copies are bound by bandwidth, so the bytes copied bound the step's GPU time
+	VkDeviceSize max_bytes_per_step = 1 << 20;
+	// Blocks whose live meshes take less than this fraction of them are emptied
+	float max_occupancy = 0.5f;
+};
+
+struct GeometryDefragStats {
+	uint64_t steps = 0;
+	uint64_t moved_meshes = 0;
+	uint64_t moved_bytes = 0;
+	uint32_t retired_blocks = 0;
+	// Blocks given up on since the other blocks' free ranges couldn't take their meshes
+	uint32_t abandoned_blocks = 0;
+};
+
+struct GeometryDefragmenter {
+	GeometryDefragParams params;
+	// The block being emptied, or -1
+	int32_t source_block = -1;
+	// After giving up on a block nothing is tried until the pool changes
+	uint64_t idle_version = ~uint64_t(0);
+	GeometryDefragStats stats;
+};
+
+// Whether a step has work to do, a block being emptied or one sparse enough to start on. A
+// block picked to be emptied is marked as draining until it's released or given up on
+bool geometry_defrag_pending(GeometryDefragmenter &defrag, GeometryPool &pool);
+
+// Record moving meshes out of the block being emptied, made visible to vertex input. The
+// moved meshes' old ranges are freed once the submission being recorded completes, so the
+// frames in flight can keep drawing from them, and the pool's version is bumped so draws
+// recorded after the step pick up the new placements
+void defragment_geometry_step(GeometryDefragmenter &defrag, GeometryPool &pool, ResourceManager &resources,
+		VkCommandBuffer cmd_buf);
+
+void print_geometry_defrag_stats(const GeometryDefragmenter &defrag);
+
+// Release the blocks to the resource manager and clear the pool
+void destroy_geometry_pool(GeometryPool &pool, ResourceManager &resources);
+
+// Add and free meshes of random sizes each frame for the number of frames, first without and
+// then with the defragmenter copying up to the budget per frame, and print the pool's blocks,
+// free space and the defragmenter's stats after each and again after compacting the pool.
+// Returns false if a mesh's data read back after the churn or the compaction doesn't match
+// what was added
+bool run_geometry_churn(VkDevice device, VkPhysicalDevice physical_device, VkQueue queue, uint32_t queue_family,
+		uint32_t frames, VkDeviceSize defrag_budget);
@@ -0,0 +1,410 @@
+#include <algorithm>
+#include <iostream>
+#include "gpu_primitives.h"
+#include "spirv_shaders_embedded_spv.h"
+
+// Values per workgroup for the reduce, scan and compact kernels, and keys per workgroup for
+// the radix sort kernels
+static const uint32_t tile_size = 1024;
+static const uint32_t radix_tile_size = 256;
+static const uint32_t radix_digits = 256;
+static const uint32_t max_bindings = 5;
+// The subgroup kernels keep a value per subgroup in shared memory for up to 16 subgroups
+static const uint32_t min_subgroup_size = 16;
+
+struct PrimitivePushConstants {
+	uint32_t count = 0;
+	uint32_t shift = 0;
+	uint32_t num_tiles = 0;
+};
+
+static uint32_t div_up(uint32_t a, uint32_t b) {
+	return (a + b - 1) / b;
+}
+
+SubgroupSupport query_subgroup_support(VkPhysicalDevice physical_device) {
+	VkPhysicalDeviceSubgroupProperties subgroup_props = {};
+	subgroup_props.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SUBGROUP_PROPERTIES;
+
+	VkPhysicalDeviceProperties2 props = {};
+	props.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+	props.pNext = &subgroup_props;
+	vkGetPhysicalDeviceProperties2(physical_device, &props);
+
+	SubgroupSupport support;
+	if (subgroup_props.supportedStages & VK_SHADER_STAGE_COMPUTE_BIT) {
+		support.size = subgroup_props.subgroupSize;
+		support.arithmetic = subgroup_props.supportedOperations & VK_SUBGROUP_FEATURE_ARITHMETIC_BIT;
+		support.ballot = subgroup_props.supportedOperations & VK_SUBGROUP_FEATURE_BALLOT_BIT;
+	}
+	return support;
+}
+
+static VkPipeline create_primitive_pipeline(VkDevice device, VkPipelineLayout layout, const uint32_t *code,
+		size_t code_size)
+{
+	VkShaderModule module = create_shader_module(device, code, code_size);
+
+	VkComputePipelineCreateInfo create_info = {};
+	create_info.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+	create_info.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	create_info.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+	create_info.stage.module = module;
+	create_info.stage.pName = "main";
+	create_info.layout = layout;
+
+	VkPipeline pipeline = VK_NULL_HANDLE;
+	CHECK_VULKAN(vkCreateComputePipelines(device, pipeline_cache(), 1, &create_info, nullptr, &pipeline));
+	vkDestroyShaderModule(device, module, nullptr);
+	return pipeline;
+}
+
+GpuPrimitives create_gpu_primitives(VkDevice device, VkPhysicalDevice physical_device, bool allow_subgroups) {
+	GpuPrimitives prims;
+	const SubgroupSupport subgroups = query_subgroup_support(physical_device);
+	prims.use_subgroups = allow_subgroups && subgroups.arithmetic && subgroups.ballot
+		&& subgroups.size >= min_subgroup_size;
+
+	{
+		std::array<VkDescriptorSetLayoutBinding, max_bindings> bindings = {};
+		for (uint32_t i = 0; i < bindings.size(); ++i) {
+			bindings[i].binding = i;
+			bindings[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+			bindings[i].descriptorCount = 1;
+			bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+		}
+
+		VkDescriptorSetLayoutCreateInfo info = {};
+		info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+		info.bindingCount = bindings.size();
+		info.pBindings = bindings.data();
+		CHECK_VULKAN(vkCreateDescriptorSetLayout(device, &info, nullptr, &prims.desc_layout));
+	}
+	{
+		VkPushConstantRange push_range = {};
+		push_range.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+		push_range.size = sizeof(PrimitivePushConstants);
+
+		VkPipelineLayoutCreateInfo info = {};
+		info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+		info.setLayoutCount = 1;
+		info.pSetLayouts = &prims.desc_layout;
+		info.pushConstantRangeCount = 1;
+		info.pPushConstantRanges = &push_range;
+		CHECK_VULKAN(vkCreatePipelineLayout(device, &info, nullptr, &prims.pipeline_layout));
+	}
+
+	const VkPipelineLayout layout = prims.pipeline_layout;
+	if (prims.use_subgroups) {
+		prims.reduce = create_primitive_pipeline(device, layout, prim_reduce_subgroup_spv,
+				sizeof(prim_reduce_subgroup_spv));
+		prims.scan = create_primitive_pipeline(device, layout, prim_scan_subgroup_spv,
+				sizeof(prim_scan_subgroup_spv));
+		prims.radix_scatter = create_primitive_pipeline(device, layout, prim_radix_scatter_subgroup_spv,
+				sizeof(prim_radix_scatter_subgroup_spv));
+	} else {
+		prims.reduce = create_primitive_pipeline(device, layout, prim_reduce_spv, sizeof(prim_reduce_spv));
+		prims.scan = create_primitive_pipeline(device, layout, prim_scan_spv, sizeof(prim_scan_spv));
+		prims.radix_scatter = create_primitive_pipeline(device, layout, prim_radix_scatter_spv,
+				sizeof(prim_radix_scatter_spv));
+	}
+	prims.scan_add = create_primitive_pipeline(device, layout, prim_scan_add_spv, sizeof(prim_scan_add_spv));
+	prims.compact = create_primitive_pipeline(device, layout, prim_compact_spv, sizeof(prim_compact_spv));
+	prims.radix_histogram = create_primitive_pipeline(device, layout, prim_radix_histogram_spv,
+			sizeof(prim_radix_histogram_spv));
+
+	std::cout << "GPU primitives using " << (prims.use_subgroups ? "subgroup" : "scalar") << " kernels"
+		<< ", subgroup size " << subgroups.size << "\n";
+	return prims;
+}
+
+void destroy_gpu_primitives(VkDevice device, GpuPrimitives &prims) {
+	for (auto p : { prims.reduce, prims.scan, prims.scan_add, prims.compact, prims.radix_histogram,
+			prims.radix_scatter })
+	{
+		vkDestroyPipeline(device, p, nullptr);
+	}
+	vkDestroyPipelineLayout(device, prims.pipeline_layout, nullptr);
+	vkDestroyDescriptorSetLayout(device, prims.desc_layout, nullptr);
+	prims = GpuPrimitives();
+}
+
+static VkDescriptorPool create_primitive_desc_pool(VkDevice device, uint32_t max_sets) {
+	VkDescriptorPoolSize pool_size = {};
+	pool_size.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	pool_size.descriptorCount = max_sets * max_bindings;
+
+	VkDescriptorPoolCreateInfo info = {};
+	info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	info.maxSets = max_sets;
+	info.poolSizeCount = 1;
+	info.pPoolSizes = &pool_size;
+
+	VkDescriptorPool pool = VK_NULL_HANDLE;
+	CHECK_VULKAN(vkCreateDescriptorPool(device, &info, nullptr, &pool));
+	return pool;
+}
+
+// Allocate a set with the buffers at bindings 0, 1, ... in order. Bindings the kernel doesn't
+// use are passed as VK_NULL_HANDLE and left unwritten
+static VkDescriptorSet create_primitive_desc_set(VkDevice device, const GpuPrimitives &prims, VkDescriptorPool pool,
+		const std::vector<VkBuffer> &buffers)
+{
+	VkDescriptorSetAllocateInfo alloc_info = {};
+	alloc_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+	alloc_info.descriptorPool = pool;
+	alloc_info.descriptorSetCount = 1;
+	alloc_info.pSetLayouts = &prims.desc_layout;
+	VkDescriptorSet set = VK_NULL_HANDLE;
+	CHECK_VULKAN(vkAllocateDescriptorSets(device, &alloc_info, &set));
+
+	std::vector<VkDescriptorBufferInfo> infos(buffers.size(), VkDescriptorBufferInfo{});
+	std::vector<VkWriteDescriptorSet> writes;
+	for (uint32_t i = 0; i < buffers.size(); ++i) {
+		if (buffers[i] == VK_NULL_HANDLE) {
+			continue;
+		}
+		infos[i].buffer = buffers[i];
+		infos[i].range = VK_WHOLE_SIZE;
+
+		VkWriteDescriptorSet write = {};
+		write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		write.dstSet = set;
+		write.dstBinding = i;
+		write.descriptorCount = 1;
+		write.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		write.pBufferInfo = &infos[i];
+		writes.push_back(write);
+	}
+	vkUpdateDescriptorSets(device, writes.size(), writes.data(), 0, nullptr);
+	return set;
+}
+
+static void compute_barrier(VkCommandBuffer cmd_buf, VkAccessFlags src_access = VK_ACCESS_SHADER_WRITE_BIT,
+		VkPipelineStageFlags src_stage = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT)
+{
+	VkMemoryBarrier barrier = {};
+	barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	barrier.srcAccessMask = src_access;
+	barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+	vkCmdPipelineBarrier(cmd_buf, src_stage, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &barrier,
+			0, nullptr, 0, nullptr);
+}
+
+static void dispatch_primitive(VkCommandBuffer cmd_buf, const GpuPrimitives &prims, VkPipeline pipeline,
+		VkDescriptorSet desc_set, const PrimitivePushConstants &push, uint32_t num_groups)
+{
+	vkCmdBindPipeline(cmd_buf, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline);
+	vkCmdBindDescriptorSets(cmd_buf, VK_PIPELINE_BIND_POINT_COMPUTE, prims.pipeline_layout, 0, 1,
+			&desc_set, 0, nullptr);
+	vkCmdPushConstants(cmd_buf, prims.pipeline_layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(push), &push);
+	vkCmdDispatch(cmd_buf, num_groups, 1, 1);
+}
+
+GpuReduce create_gpu_reduce(VkDevice device, const GpuPrimitives &prims, VkBuffer input, VkBuffer output,
+		uint32_t max_count)
+{
+	GpuReduce reduce;
+	reduce.max_count = max_count;
+	reduce.output = output;
+	reduce.desc_pool = create_primitive_desc_pool(device, 1);
+	reduce.desc_set = create_primitive_desc_set(device, prims, reduce.desc_pool, { input, output });
+	return reduce;
+}
+
+void record_gpu_reduce(VkCommandBuffer cmd_buf, const GpuPrimitives &prims, const GpuReduce &reduce, uint32_t count) {
+	// The workgroups add their sums to the total
+	vkCmdFillBuffer(cmd_buf, reduce.output, 0, sizeof(uint32_t), 0);
+	compute_barrier(cmd_buf, VK_ACCESS_TRANSFER_WRITE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+
+	PrimitivePushConstants push;
+	push.count = std::min(count, reduce.max_count);
+	dispatch_primitive(cmd_buf, prims, prims.reduce, reduce.desc_set, push, div_up(push.count, tile_size));
+}
+
+void destroy_gpu_reduce(VkDevice device, GpuReduce &reduce) {
+	vkDestroyDescriptorPool(device, reduce.desc_pool, nullptr);
+	reduce = GpuReduce();
+}
+
+GpuScan create_gpu_scan(VkDevice device, VkPhysicalDevice physical_device, const GpuPrimitives &prims,
+		VkBuffer input, VkBuffer output, uint32_t max_count)
+{
+	GpuScan scan;
+	scan.max_count = max_count;
+
+	// Each level's block sums are scanned in place by the next level
+	for (uint32_t n = div_up(max_count, tile_size); ; n = div_up(n, tile_size)) {
+		scan.block_sums.push_back(create_buffer(device, physical_device, n * sizeof(uint32_t),
+				VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT));
+		if (n <= 1) {
+			break;
+		}
+	}
+
+	scan.desc_pool = create_primitive_desc_pool(device, 2 * scan.block_sums.size());
+	for (size_t i = 0; i < scan.block_sums.size(); ++i) {
+		const VkBuffer level_in = i == 0 ? input : scan.block_sums[i - 1].buffer;
+		const VkBuffer level_out = i == 0 ? output : scan.block_sums[i - 1].buffer;
+		scan.scan_sets.push_back(create_primitive_desc_set(device, prims, scan.desc_pool,
+				{ level_in, level_out, scan.block_sums[i].buffer }));
+		scan.add_sets.push_back(create_primitive_desc_set(device, prims, scan.desc_pool,
+				{ VK_NULL_HANDLE, level_out, scan.block_sums[i].buffer }));
+	}
+	return scan;
+}
+
+void record_gpu_scan(VkCommandBuffer cmd_buf, const GpuPrimitives &prims, const GpuScan &scan, uint32_t count) {
+	count = std::min(count, scan.max_count);
+
+	// Scan down the levels until the tiles' totals fit in one tile
+	std::vector<uint32_t> level_counts;
+	for (uint32_t n = count; ; n = div_up(n, tile_size)) {
+		PrimitivePushConstants push;
+		push.count = n;
+		if (!level_counts.empty()) {
+			compute_barrier(cmd_buf);
+		}
+		dispatch_primitive(cmd_buf, prims, prims.scan, scan.scan_sets[level_counts.size()], push,
+				std::max(div_up(n, tile_size), 1u));
+		level_counts.push_back(n);
+		if (n <= tile_size) {
+			break;
+		}
+	}
+
+	// Then add the scanned totals back up the levels
+	for (size_t i = level_counts.size() - 1; i-- > 0;) {
+		PrimitivePushConstants push;
+		push.count = level_counts[i];
+		compute_barrier(cmd_buf);
+		dispatch_primitive(cmd_buf, prims, prims.scan_add, scan.add_sets[i], push, div_up(push.count, tile_size));
+	}
+}
+
+void destroy_gpu_scan(VkDevice device, GpuScan &scan) {
+	for (auto &b : scan.block_sums) {
+		destroy_buffer(device, b);
+	}
+	vkDestroyDescriptorPool(device, scan.desc_pool, nullptr);
+	scan = GpuScan();
+}
+
+GpuCompact create_gpu_compact(VkDevice device, VkPhysicalDevice physical_device, const GpuPrimitives &prims,
+		VkBuffer values, VkBuffer flags, VkBuffer output, VkBuffer count_buffer, uint32_t max_count)
+{
+	GpuCompact compact;
+	compact.max_count = max_count;
+	compact.offsets = create_buffer(device, physical_device, std::max(max_count, 1u) * sizeof(uint32_t),
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+	compact.scan = create_gpu_scan(device, physical_device, prims, flags, compact.offsets.buffer, max_count);
+	compact.desc_pool = create_primitive_desc_pool(device, 1);
+	compact.desc_set = create_primitive_desc_set(device, prims, compact.desc_pool,
+			{ values, flags, compact.offsets.buffer, output, count_buffer });
+	return compact;
+}
+
+void record_gpu_compact(VkCommandBuffer cmd_buf, const GpuPrimitives &prims, const GpuCompact &compact,
+		uint32_t count)
+{
+	PrimitivePushConstants push;
+	push.count = std::min(count, compact.max_count);
+	record_gpu_scan(cmd_buf, prims, compact.scan, push.count);
+	compute_barrier(cmd_buf);
+	dispatch_primitive(cmd_buf, prims, prims.compact, compact.desc_set, push, div_up(push.count, tile_size));
+}
+
+void destroy_gpu_compact(VkDevice device, GpuCompact &compact) {
+	destroy_gpu_scan(device, compact.scan);
+	destroy_buffer(device, compact.offsets);
+	vkDestroyDescriptorPool(device, compact.desc_pool, nullptr);
+	compact = GpuCompact();
+}
+
+GpuRadixSort create_gpu_radix_sort(VkDevice device, VkPhysicalDevice physical_device, const GpuPrimitives &prims,
+		VkBuffer keys, VkBuffer values, uint32_t max_count)
+{
+	VkPhysicalDeviceProperties properties = {};
+	vkGetPhysicalDeviceProperties(physical_device, &properties);
+	if (div_up(max_count, radix_tile_size) > properties.limits.maxComputeWorkGroupCount[0]) {
+		throw std::runtime_error("Too many keys for the radix sort");
+	}
+
+	GpuRadixSort sort;
+	sort.max_count = max_count;
+	sort.keys = keys;
+	sort.values = values;
+
+	const VkDeviceSize size = std::max(max_count, 1u) * sizeof(uint32_t);
+	const VkBufferUsageFlags usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+	sort.temp_keys = create_buffer(device, physical_device, size, usage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+	sort.temp_values = create_buffer(device, physical_device, size, usage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+	const uint32_t histogram_count = std::max(div_up(max_count, radix_tile_size), 1u) * radix_digits;
+	sort.histogram = create_buffer(device, physical_device, histogram_count * sizeof(uint32_t),
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+	sort.scan = create_gpu_scan(device, physical_device, prims, sort.histogram.buffer, sort.histogram.buffer,
+			histogram_count);
+
+	sort.desc_pool = create_primitive_desc_pool(device, 4);
+	const std::array<VkBuffer, 2> pass_keys = { keys, sort.temp_keys.buffer };
+	const std::array<VkBuffer, 2> pass_values = { values, sort.temp_values.buffer };
+	for (size_t i = 0; i < 2; ++i) {
+		sort.histogram_sets[i] = create_primitive_desc_set(device, prims, sort.desc_pool,
+				{ pass_keys[i], sort.histogram.buffer });
+		sort.scatter_sets[i] = create_primitive_desc_set(device, prims, sort.desc_pool,
+				{ pass_keys[i], pass_values[i], sort.histogram.buffer, pass_keys[1 - i], pass_values[1 - i] });
+	}
+	return sort;
+}
+
+void record_gpu_radix_sort(VkCommandBuffer cmd_buf, const GpuPrimitives &prims, const GpuRadixSort &sort,
+		uint32_t count, uint32_t key_bits)
+{
+	PrimitivePushConstants push;
+	push.count = std::min(count, sort.max_count);
+	push.num_tiles = div_up(push.count, radix_tile_size);
+	if (push.count == 0) {
+		return;
+	}
+
+	const uint32_t num_passes = div_up(std::min(key_bits, 32u), 8);
+	for (uint32_t pass = 0; pass < num_passes; ++pass) {
+		push.shift = pass * 8;
+		if (pass > 0) {
+			compute_barrier(cmd_buf);
+		}
+		dispatch_primitive(cmd_buf, prims, prims.radix_histogram, sort.histogram_sets[pass % 2], push,
+				push.num_tiles);
+		compute_barrier(cmd_buf);
+		record_gpu_scan(cmd_buf, prims, sort.scan, push.num_tiles * radix_digits);
+		compute_barrier(cmd_buf);
+		dispatch_primitive(cmd_buf, prims, prims.radix_scatter, sort.scatter_sets[pass % 2], push,
+				push.num_tiles);
+	}
+
+	if (num_passes % 2 == 1) {
+		VkMemoryBarrier barrier = {};
+		barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+		vkCmdPipelineBarrier(cmd_buf, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+				1, &barrier, 0, nullptr, 0, nullptr);
+
+		VkBufferCopy region = {};
+		region.size = push.count * sizeof(uint32_t);
+		vkCmdCopyBuffer(cmd_buf, sort.temp_keys.buffer, sort.keys, 1, &region);
+		vkCmdCopyBuffer(cmd_buf, sort.temp_values.buffer, sort.values, 1, &region);
+		// Leave the results visible to compute like the even pass case
+		compute_barrier(cmd_buf, VK_ACCESS_TRANSFER_WRITE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+	}
+}
+
+void destroy_gpu_radix_sort(VkDevice device, GpuRadixSort &sort) {
+	destroy_gpu_scan(device, sort.scan);
+	destroy_buffer(device, sort.temp_keys);
+	destroy_buffer(device, sort.temp_values);
+	destroy_buffer(device, sort.histogram);
+	vkDestroyDescriptorPool(device, sort.desc_pool, nullptr);
+	sort = GpuRadixSort();
+}
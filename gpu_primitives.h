@@ -0,0 +1,124 @@
+#pragma once
+
+#include <array>
+#include <vector>
+#include <vulkan/vulkan.h>
+#include "vulkan_utils.h"
+
+// Compute primitives over uint32 buffers on the GPU: reduction, exclusive prefix scan, stream
+// compaction and radix sort. Each has a subgroup kernel used when the device supports the
+// subgroup operations it needs in compute shaders, and a scalar fallback using shared memory.
+//
+// The create functions bind the primitive to the caller's buffers, and the record functions
+// record its dispatches with the barriers between them. The caller records the barriers
+// before, making the inputs visible to compute shader reads, and after before using the output.
+
+struct SubgroupSupport {
+	uint32_t size = 1;
+	bool arithmetic = false;
+	bool ballot = false;
+};
+
+SubgroupSupport query_subgroup_support(VkPhysicalDevice physical_device);
+
+struct GpuPrimitives {
+	bool use_subgroups = false;
+	VkDescriptorSetLayout desc_layout = VK_NULL_HANDLE;
+	VkPipelineLayout pipeline_layout = VK_NULL_HANDLE;
+
+	VkPipeline reduce = VK_NULL_HANDLE;
+	VkPipeline scan = VK_NULL_HANDLE;
+	VkPipeline scan_add = VK_NULL_HANDLE;
+	VkPipeline compact = VK_NULL_HANDLE;
+	VkPipeline radix_histogram = VK_NULL_HANDLE;
+	VkPipeline radix_scatter = VK_NULL_HANDLE;
+};
+
+// Use the subgroup kernels if allowed and the device supports them
+GpuPrimitives create_gpu_primitives(VkDevice device, VkPhysicalDevice physical_device, bool allow_subgroups = true);
+
+void destroy_gpu_primitives(VkDevice device, GpuPrimitives &prims);
+
+// Sum of the input values, written to the first uint32 of the output
+struct GpuReduce {
+	uint32_t max_count = 0;
+	VkBuffer output = VK_NULL_HANDLE;
+	VkDescriptorPool desc_pool = VK_NULL_HANDLE;
+	VkDescriptorSet desc_set = VK_NULL_HANDLE;
+};
+
+GpuReduce create_gpu_reduce(VkDevice device, const GpuPrimitives &prims, VkBuffer input, VkBuffer output,
+		uint32_t max_count);
+
+void record_gpu_reduce(VkCommandBuffer cmd_buf, const GpuPrimitives &prims, const GpuReduce &reduce, uint32_t count);
+
+void destroy_gpu_reduce(VkDevice device, GpuReduce &reduce);
+
+// Exclusive prefix sum of the input written to the output, which may be the same buffer.
+// Each level scans tiles of 1024 values and the tiles' totals are scanned by the next level,
+// until they fit in one tile
+struct GpuScan {
+	uint32_t max_count = 0;
+	std::vector<Buffer> block_sums;
+	VkDescriptorPool desc_pool = VK_NULL_HANDLE;
+	std::vector<VkDescriptorSet> scan_sets;
+	std::vector<VkDescriptorSet> add_sets;
+};
+
+GpuScan create_gpu_scan(VkDevice device, VkPhysicalDevice physical_device, const GpuPrimitives &prims,
+		VkBuffer input, VkBuffer output, uint32_t max_count);
+
+void record_gpu_scan(VkCommandBuffer cmd_buf, const GpuPrimitives &prims, const GpuScan &scan, uint32_t count);
+
+void destroy_gpu_scan(VkDevice device, GpuScan &scan);
+
+// Write the values whose flag is 1 to the output in order and the number written to the
+// first uint32 of the count buffer. Flags must be 0 or 1
+struct GpuCompact {
+	uint32_t max_count = 0;
+	Buffer offsets;
+	GpuScan scan;
+	VkDescriptorPool desc_pool = VK_NULL_HANDLE;
+	VkDescriptorSet desc_set = VK_NULL_HANDLE;
+};
+
+GpuCompact create_gpu_compact(VkDevice device, VkPhysicalDevice physical_device, const GpuPrimitives &prims,
+		VkBuffer values, VkBuffer flags, VkBuffer output, VkBuffer count_buffer, uint32_t max_count);
+
+void record_gpu_compact(VkCommandBuffer cmd_buf, const GpuPrimitives &prims, const GpuCompact &compact,
+		uint32_t count);
+
+void destroy_gpu_compact(VkDevice device, GpuCompact &compact);
+
+// Stable sort of the keys and their values in place, 8 bits per pass. The keys and values
+// are sorted back and forth with temporary buffers, and copied back after an odd number of
+// passes, so the keys and values need transfer dst usage when sorting on 8 or 24 bits. Up to
+// 16M keys
+struct GpuRadixSort {
+	uint32_t max_count = 0;
+	VkBuffer keys = VK_NULL_HANDLE;
+	VkBuffer values = VK_NULL_HANDLE;
+	Buffer temp_keys;
+	Buffer temp_values;
+	Buffer histogram;
+	GpuScan scan;
+	VkDescriptorPool desc_pool = VK_NULL_HANDLE;
+	// Indexed by the pass parity, even passes read the keys and odd passes the temp keys
+	std::array<VkDescriptorSet, 2> histogram_sets = {};
+	std::array<VkDescriptorSet, 2> scatter_sets = {};
+};
+
+GpuRadixSort create_gpu_radix_sort(VkDevice device, VkPhysicalDevice physical_device, const GpuPrimitives &prims,
+		VkBuffer keys, VkBuffer values, uint32_t max_count);
+
+// Only the low key_bits of the keys are sorted on
+void record_gpu_radix_sort(VkCommandBuffer cmd_buf, const GpuPrimitives &prims, const GpuRadixSort &sort,
+		uint32_t count, uint32_t key_bits = 32);
+
+void destroy_gpu_radix_sort(VkDevice device, GpuRadixSort &sort);
+
+// Run each primitive over count random values with the scalar and subgroup kernels, check
+// the results against the CPU and print the times
+void run_gpu_primitives_benchmark(VkDevice device, VkPhysicalDevice physical_device, VkQueue queue,
+		uint32_t queue_family, uint32_t count, uint32_t iterations);
+
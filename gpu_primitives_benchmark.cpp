@@ -0,0 +1,262 @@
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <limits>
+#include <random>
+#include "gpu_primitives.h"
+
+// The CPU written inputs and read back output, host visible
+struct HostBuffer {
+	Buffer buf;
+	uint32_t *data = nullptr;
+};
+
+static HostBuffer create_mapped_buffer(VkDevice device, VkPhysicalDevice physical_device, uint32_t count) {
+	HostBuffer host;
+	host.buf = create_buffer(device, physical_device, count * sizeof(uint32_t),
+			VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+	void *mapping = nullptr;
+	CHECK_VULKAN(vkMapMemory(device, host.buf.mem, 0, VK_WHOLE_SIZE, 0, &mapping));
+	host.data = reinterpret_cast<uint32_t*>(mapping);
+	return host;
+}
+
+static void copy_buffer(VkCommandBuffer cmd_buf, VkBuffer src, VkBuffer dst, uint32_t count) {
+	VkBufferCopy region = {};
+	region.size = count * sizeof(uint32_t);
+	vkCmdCopyBuffer(cmd_buf, src, dst, 1, &region);
+}
+
+static void barrier(VkCommandBuffer cmd_buf, VkAccessFlags src_access, VkAccessFlags dst_access,
+		VkPipelineStageFlags src_stage, VkPipelineStageFlags dst_stage)
+{
+	VkMemoryBarrier barrier = {};
+	barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	barrier.srcAccessMask = src_access;
+	barrier.dstAccessMask = dst_access;
+	vkCmdPipelineBarrier(cmd_buf, src_stage, dst_stage, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+}
+
+void run_gpu_primitives_benchmark(VkDevice device, VkPhysicalDevice physical_device, VkQueue queue,
+		uint32_t queue_family, uint32_t count, uint32_t iterations)
+{
+	VkPhysicalDeviceProperties properties = {};
+	vkGetPhysicalDeviceProperties(physical_device, &properties);
+	uint32_t num_families = 0;
+	vkGetPhysicalDeviceQueueFamilyProperties(physical_device, &num_families, nullptr);
+	std::vector<VkQueueFamilyProperties> family_props(num_families, VkQueueFamilyProperties{});
+	vkGetPhysicalDeviceQueueFamilyProperties(physical_device, &num_families, family_props.data());
+	if (family_props[queue_family].timestampValidBits == 0) {
+		std::cout << "GPU primitives benchmark: the queue doesn't support timestamps\n";
+		return;
+	}
+
+	VkCommandPool command_pool = VK_NULL_HANDLE;
+	{
+		VkCommandPoolCreateInfo info = {};
+		info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+		info.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+		info.queueFamilyIndex = queue_family;
+		CHECK_VULKAN(vkCreateCommandPool(device, &info, nullptr, &command_pool));
+	}
+
+	VkCommandBuffer cmd_buf = VK_NULL_HANDLE;
+	{
+		VkCommandBufferAllocateInfo info = {};
+		info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+		info.commandPool = command_pool;
+		info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+		info.commandBufferCount = 1;
+		CHECK_VULKAN(vkAllocateCommandBuffers(device, &info, &cmd_buf));
+	}
+
+	VkFence fence = VK_NULL_HANDLE;
+	{
+		VkFenceCreateInfo info = {};
+		info.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+		CHECK_VULKAN(vkCreateFence(device, &info, nullptr, &fence));
+	}
+
+	VkQueryPool query_pool = VK_NULL_HANDLE;
+	{
+		VkQueryPoolCreateInfo info = {};
+		info.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+		info.queryType = VK_QUERY_TYPE_TIMESTAMP;
+		info.queryCount = 2;
+		CHECK_VULKAN(vkCreateQueryPool(device, &info, nullptr, &query_pool));
+	}
+
+	// Small values so the sums are easy to read, flags keeping about half and random keys
+	// with the original index as the value to check the sort is stable
+	std::mt19937 rng(42);
+	HostBuffer src_values = create_mapped_buffer(device, physical_device, count);
+	HostBuffer src_flags = create_mapped_buffer(device, physical_device, count);
+	HostBuffer src_keys = create_mapped_buffer(device, physical_device, count);
+	HostBuffer src_indices = create_mapped_buffer(device, physical_device, count);
+	HostBuffer readback = create_mapped_buffer(device, physical_device, count);
+	HostBuffer readback_extra = create_mapped_buffer(device, physical_device, count);
+	for (uint32_t i = 0; i < count; ++i) {
+		src_values.data[i] = rng() % 16;
+		src_flags.data[i] = rng() % 2;
+		src_keys.data[i] = rng();
+		src_indices.data[i] = i;
+	}
+
+	const VkBufferUsageFlags usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT
+		| VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+	const VkDeviceSize size = count * sizeof(uint32_t);
+	Buffer values = create_buffer(device, physical_device, size, usage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+	Buffer flags = create_buffer(device, physical_device, size, usage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+	Buffer output = create_buffer(device, physical_device, size, usage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+	Buffer output_count = create_buffer(device, physical_device, sizeof(uint32_t), usage,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+	Buffer keys = create_buffer(device, physical_device, size, usage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+	Buffer key_values = create_buffer(device, physical_device, size, usage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+	// The CPU results to check against
+	uint32_t expected_sum = 0;
+	std::vector<uint32_t> expected_scan(count, 0);
+	std::vector<uint32_t> expected_compact;
+	for (uint32_t i = 0; i < count; ++i) {
+		expected_scan[i] = expected_sum;
+		expected_sum += src_values.data[i];
+		if (src_flags.data[i]) {
+			expected_compact.push_back(src_values.data[i]);
+		}
+	}
+
+	std::cout << "GPU primitives benchmark: " << count << " values, " << iterations << " iterations\n";
+
+	// Record copying in the inputs and the primitive between timestamps, and return the
+	// average GPU time of the primitive
+	auto time_primitive = [&](const std::function<void()> &record_primitive) {
+		double gpu_ms = 0.0;
+		for (uint32_t i = 0; i < iterations; ++i) {
+			VkCommandBufferBeginInfo begin_info = {};
+			begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+			begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+			CHECK_VULKAN(vkBeginCommandBuffer(cmd_buf, &begin_info));
+
+			copy_buffer(cmd_buf, src_values.buf.buffer, values.buffer, count);
+			copy_buffer(cmd_buf, src_flags.buf.buffer, flags.buffer, count);
+			copy_buffer(cmd_buf, src_keys.buf.buffer, keys.buffer, count);
+			copy_buffer(cmd_buf, src_indices.buf.buffer, key_values.buffer, count);
+			barrier(cmd_buf, VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT,
+					VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+
+			vkCmdResetQueryPool(cmd_buf, query_pool, 0, 2);
+			vkCmdWriteTimestamp(cmd_buf, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, query_pool, 0);
+			record_primitive();
+			vkCmdWriteTimestamp(cmd_buf, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, query_pool, 1);
+
+			barrier(cmd_buf, VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_TRANSFER_READ_BIT,
+					VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT,
+					VK_PIPELINE_STAGE_TRANSFER_BIT);
+			CHECK_VULKAN(vkEndCommandBuffer(cmd_buf));
+
+			VkSubmitInfo submit_info = {};
+			submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+			submit_info.commandBufferCount = 1;
+			submit_info.pCommandBuffers = &cmd_buf;
+			CHECK_VULKAN(vkResetFences(device, 1, &fence));
+			CHECK_VULKAN(vkQueueSubmit(queue, 1, &submit_info, fence));
+			CHECK_VULKAN(vkWaitForFences(device, 1, &fence, true, std::numeric_limits<uint64_t>::max()));
+
+			std::array<uint64_t, 2> timestamps = {};
+			CHECK_VULKAN(vkGetQueryPoolResults(device, query_pool, 0, 2, sizeof(timestamps), timestamps.data(),
+					sizeof(uint64_t), VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT));
+			gpu_ms += (timestamps[1] - timestamps[0]) * properties.limits.timestampPeriod * 1e-6;
+		}
+		return gpu_ms / iterations;
+	};
+
+	// Copy the outputs back for checking
+	auto read_back = [&](VkBuffer a, uint32_t a_count, VkBuffer b, uint32_t b_count) {
+		VkCommandBuffer copy_cmd = begin_one_time_commands(device, command_pool);
+		copy_buffer(copy_cmd, a, readback.buf.buffer, a_count);
+		if (b != VK_NULL_HANDLE) {
+			copy_buffer(copy_cmd, b, readback_extra.buf.buffer, b_count);
+		}
+		end_one_time_commands(device, queue, command_pool, copy_cmd);
+	};
+
+	auto print_result = [&](const char *name, double ms, bool correct) {
+		std::cout << "  " << name << ": " << ms << "ms, " << count / (ms * 1e6) << " G values/s"
+			<< (correct ? "" : ", INCORRECT") << "\n";
+	};
+
+	for (const bool subgroups : { false, true }) {
+		GpuPrimitives prims = create_gpu_primitives(device, physical_device, subgroups);
+		if (subgroups && !prims.use_subgroups) {
+			destroy_gpu_primitives(device, prims);
+			break;
+		}
+
+		{
+			GpuReduce reduce = create_gpu_reduce(device, prims, values.buffer, output_count.buffer, count);
+			const double ms = time_primitive([&]() {
+				record_gpu_reduce(cmd_buf, prims, reduce, count);
+			});
+			read_back(output_count.buffer, 1, VK_NULL_HANDLE, 0);
+			print_result("reduce", ms, readback.data[0] == expected_sum);
+			destroy_gpu_reduce(device, reduce);
+		}
+		{
+			GpuScan scan = create_gpu_scan(device, physical_device, prims, values.buffer, output.buffer, count);
+			const double ms = time_primitive([&]() {
+				record_gpu_scan(cmd_buf, prims, scan, count);
+			});
+			read_back(output.buffer, count, VK_NULL_HANDLE, 0);
+			print_result("scan", ms, std::equal(expected_scan.begin(), expected_scan.end(), readback.data));
+			destroy_gpu_scan(device, scan);
+		}
+		{
+			GpuCompact compact = create_gpu_compact(device, physical_device, prims, values.buffer, flags.buffer,
+					output.buffer, output_count.buffer, count);
+			const double ms = time_primitive([&]() {
+				record_gpu_compact(cmd_buf, prims, compact, count);
+			});
+			read_back(output.buffer, count, output_count.buffer, 1);
+			const bool correct = readback_extra.data[0] == expected_compact.size()
+				&& std::equal(expected_compact.begin(), expected_compact.end(), readback.data);
+			print_result("compact", ms, correct);
+			destroy_gpu_compact(device, compact);
+		}
+		{
+			GpuRadixSort sort = create_gpu_radix_sort(device, physical_device, prims, keys.buffer,
+					key_values.buffer, count);
+			const double ms = time_primitive([&]() {
+				record_gpu_radix_sort(cmd_buf, prims, sort, count);
+			});
+			read_back(keys.buffer, count, key_values.buffer, count);
+			// Sorted, each key moved with its index and equal keys kept in order
+			bool correct = true;
+			for (uint32_t i = 0; i < count && correct; ++i) {
+				const uint32_t index = readback_extra.data[i];
+				correct = index < count && src_keys.data[index] == readback.data[i];
+				if (i > 0 && correct) {
+					correct = readback.data[i - 1] < readback.data[i]
+						|| (readback.data[i - 1] == readback.data[i] && readback_extra.data[i - 1] < index);
+				}
+			}
+			print_result("radix sort", ms, correct);
+			destroy_gpu_radix_sort(device, sort);
+		}
+
+		destroy_gpu_primitives(device, prims);
+	}
+
+	for (auto *h : { &src_values, &src_flags, &src_keys, &src_indices, &readback, &readback_extra }) {
+		vkUnmapMemory(device, h->buf.mem);
+		destroy_buffer(device, h->buf);
+	}
+	for (auto *b : { &values, &flags, &output, &output_count, &keys, &key_values }) {
+		destroy_buffer(device, *b);
+	}
+	vkDestroyQueryPool(device, query_pool, nullptr);
+	vkDestroyFence(device, fence, nullptr);
+	vkDestroyCommandPool(device, command_pool, nullptr);
+}
@@ -0,0 +1,164 @@
+#pragma once
+
+#include <cmath>
+
+// Minimal vector and matrix types for the CPU side camera and light math. Matrices are
+// column-major to match the GLSL layout, and projections target the Vulkan clip space
+// (depth in [0, 1], and y pointing down for the perspective projection).
+
+struct vec3 {
+	float x = 0.f, y = 0.f, z = 0.f;
+
+	vec3() = default;
+	vec3(float x, float y, float z) : x(x), y(y), z(z) {}
+};
+
+inline vec3 operator+(const vec3 &a, const vec3 &b) {
+	return vec3(a.x + b.x, a.y + b.y, a.z + b.z);
+}
+inline vec3 operator-(const vec3 &a, const vec3 &b) {
+	return vec3(a.x - b.x, a.y - b.y, a.z - b.z);
+}
+inline vec3 operator*(const vec3 &a, float s) {
+	return vec3(a.x * s, a.y * s, a.z * s);
+}
+inline vec3 operator/(const vec3 &a, float s) {
+	return vec3(a.x / s, a.y / s, a.z / s);
+}
+inline float dot(const vec3 &a, const vec3 &b) {
+	return a.x * b.x + a.y * b.y + a.z * b.z;
+}
+inline vec3 cross(const vec3 &a, const vec3 &b) {
+	return vec3(a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x);
+}
+inline float length(const vec3 &a) {
+	return std::sqrt(dot(a, a));
+}
+inline vec3 normalize(const vec3 &a) {
+	return a / length(a);
+}
+inline vec3 min(const vec3 &a, const vec3 &b) {
+	return vec3(std::fmin(a.x, b.x), std::fmin(a.y, b.y), std::fmin(a.z, b.z));
+}
+inline vec3 max(const vec3 &a, const vec3 &b) {
+	return vec3(std::fmax(a.x, b.x), std::fmax(a.y, b.y), std::fmax(a.z, b.z));
+}
+
+struct mat4 {
+	float m[16] = {
+		1.f, 0.f, 0.f, 0.f,
+		0.f, 1.f, 0.f, 0.f,
+		0.f, 0.f, 1.f, 0.f,
+		0.f, 0.f, 0.f, 1.f
+	};
+
+	float& operator()(int row, int col) {
+		return m[col * 4 + row];
+	}
+	float operator()(int row, int col) const {
+		return m[col * 4 + row];
+	}
+};
+
+inline mat4 operator*(const mat4 &a, const mat4 &b) {
+	mat4 r;
+	for (int i = 0; i < 4; ++i) {
+		for (int j = 0; j < 4; ++j) {
+			r(i, j) = 0.f;
+			for (int k = 0; k < 4; ++k) {
+				r(i, j) += a(i, k) * b(k, j);
+			}
+		}
+	}
+	return r;
+}
+
+inline bool operator==(const mat4 &a, const mat4 &b) {
+	for (int i = 0; i < 16; ++i) {
+		if (a.m[i] != b.m[i]) {
+			return false;
+		}
+	}
+	return true;
+}
+inline bool operator!=(const mat4 &a, const mat4 &b) {
+	return !(a == b);
+}
+
+// Transform a point, performing the perspective divide
+inline vec3 transform_point(const mat4 &a, const vec3 &p) {
+	const float w = a(3, 0) * p.x + a(3, 1) * p.y + a(3, 2) * p.z + a(3, 3);
+	return vec3(a(0, 0) * p.x + a(0, 1) * p.y + a(0, 2) * p.z + a(0, 3),
+		a(1, 0) * p.x + a(1, 1) * p.y + a(1, 2) * p.z + a(1, 3),
+		a(2, 0) * p.x + a(2, 1) * p.y + a(2, 2) * p.z + a(2, 3)) / w;
+}
+
+inline mat4 translate(const vec3 &t) {
+	mat4 r;
+	r(0, 3) = t.x;
+	r(1, 3) = t.y;
+	r(2, 3) = t.z;
+	return r;
+}
+
+inline mat4 scale(const vec3 &s) {
+	mat4 r;
+	r(0, 0) = s.x;
+	r(1, 1) = s.y;
+	r(2, 2) = s.z;
+	return r;
+}
+
+inline mat4 rotate_y(float radians) {
+	mat4 r;
+	r(0, 0) = std::cos(radians);
+	r(0, 2) = std::sin(radians);
+	r(2, 0) = -std::sin(radians);
+	r(2, 2) = std::cos(radians);
+	return r;
+}
+
+// Right handed view matrix looking down -z
+inline mat4 look_at(const vec3 &eye, const vec3 &center, const vec3 &up) {
+	const vec3 f = normalize(center - eye);
+	const vec3 s = normalize(cross(f, up));
+	const vec3 u = cross(s, f);
+	mat4 r;
+	r(0, 0) = s.x;
+	r(0, 1) = s.y;
+	r(0, 2) = s.z;
+	r(1, 0) = u.x;
+	r(1, 1) = u.y;
+	r(1, 2) = u.z;
+	r(2, 0) = -f.x;
+	r(2, 1) = -f.y;
+	r(2, 2) = -f.z;
+	r(0, 3) = -dot(s, eye);
+	r(1, 3) = -dot(u, eye);
+	r(2, 3) = dot(f, eye);
+	return r;
+}
+
+inline mat4 ortho(float left, float right, float bottom, float top, float near_plane, float far_plane) {
+	mat4 r;
+	r(0, 0) = 2.f / (right - left);
+	r(1, 1) = 2.f / (top - bottom);
+	r(2, 2) = -1.f / (far_plane - near_plane);
+	r(0, 3) = -(right + left) / (right - left);
+	r(1, 3) = -(top + bottom) / (top - bottom);
+	r(2, 3) = -near_plane / (far_plane - near_plane);
+	return r;
+}
+
+inline mat4 perspective(float fovy_radians, float aspect, float near_plane, float far_plane) {
+	const float f = 1.f / std::tan(fovy_radians / 2.f);
+	mat4 r;
+	r(0, 0) = f / aspect;
+	r(1, 1) = -f;
+	r(2, 2) = far_plane / (near_plane - far_plane);
+	r(2, 3) = near_plane * far_plane / (near_plane - far_plane);
+	r(3, 2) = -1.f;
+	r(3, 3) = 0.f;
+	return r;
+}
+
@@ -0,0 +1,27 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+layout(location = 0) in vec3 position;
+
+layout(set = 0, binding = 0, std140) uniform LitParams {
+	mat4 view_proj;
+	mat4 light_view_proj[4];
+	// The far distance of each cascade along the view direction
+	vec4 split_far;
+	vec4 light_dir;
+	vec4 camera_position;
+	vec4 camera_forward;
+};
+
+layout(push_constant) uniform MeshParams {
+	mat4 model;
+	vec4 color;
+};
+
+layout(location = 0) out vec3 world_pos;
+
+void main() {
+	const vec4 p = model * vec4(position, 1.0);
+	world_pos = p.xyz;
+	gl_Position = view_proj * p;
+}
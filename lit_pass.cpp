@@ -0,0 +1,420 @@
+#include <array>
+#include <cstring>
+#include "lit_pass.h"
+#include "object_cache.h"
+#include "spirv_shaders_embedded_spv.h"
+
+// Matches LitParams in the shaders, with std140 layout
+struct LitParams {
+	mat4 view_proj;
+	mat4 light_view_proj[4];
+	float split_far[4];
+	float light_dir[4];
+	float camera_position[4];
+	float camera_forward[4];
+};
+
+struct LitMeshParams {
+	mat4 model;
+	float color[4];
+};
+
+static VkFormat pick_lit_depth_format(VkPhysicalDevice physical_device) {
+	const std::array<VkFormat, 2> candidates = { VK_FORMAT_D32_SFLOAT, VK_FORMAT_D16_UNORM };
+	for (const auto &f : candidates) {
+		VkFormatProperties props = {};
+		vkGetPhysicalDeviceFormatProperties(physical_device, f, &props);
+		if (props.optimalTilingFeatures & VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT) {
+			return f;
+		}
+	}
+	throw std::runtime_error("No supported lit pass depth format");
+}
+
+static VkRenderPass create_lit_render_pass(VkDevice device, VkFormat color_format, VkFormat depth_format,
+		VkSampleCountFlagBits samples)
+{
+	// The color target is left as the scene pass's load render pass expects it: the swapchain
+	// image ready to present, or the multisampled image ready to draw to
+	VkAttachmentDescription color_attachment = {};
+	color_attachment.format = color_format;
+	color_attachment.samples = samples;
+	color_attachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+	color_attachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+	color_attachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+	color_attachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+	color_attachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	color_attachment.finalLayout = samples == VK_SAMPLE_COUNT_1_BIT
+		? VK_IMAGE_LAYOUT_PRESENT_SRC_KHR : VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+	VkAttachmentDescription depth_attachment = {};
+	depth_attachment.format = depth_format;
+	depth_attachment.samples = samples;
+	depth_attachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+	depth_attachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+	depth_attachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+	depth_attachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+	depth_attachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	depth_attachment.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+	const std::array<VkAttachmentDescription, 2> attachments = { color_attachment, depth_attachment };
+
+	VkAttachmentReference color_attachment_ref = {};
+	color_attachment_ref.attachment = 0;
+	color_attachment_ref.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+	VkAttachmentReference depth_attachment_ref = {};
+	depth_attachment_ref.attachment = 1;
+	depth_attachment_ref.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+	VkSubpassDescription subpass = {};
+	subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+	subpass.colorAttachmentCount = 1;
+	subpass.pColorAttachments = &color_attachment_ref;
+	subpass.pDepthStencilAttachment = &depth_attachment_ref;
+
+	// The color and depth targets are shared by the frames in flight
+	VkSubpassDependency dependency = {};
+	dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
+	dependency.dstSubpass = 0;
+	dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT
+		| VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT;
+	dependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
+	dependency.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT
+		| VK_ACCESS_TRANSFER_READ_BIT;
+	dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT
+		| VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+
+	VkRenderPassCreateInfo render_pass_info = {};
+	render_pass_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+	render_pass_info.attachmentCount = attachments.size();
+	render_pass_info.pAttachments = attachments.data();
+	render_pass_info.subpassCount = 1;
+	render_pass_info.pSubpasses = &subpass;
+	render_pass_info.dependencyCount = 1;
+	render_pass_info.pDependencies = &dependency;
+	VkRenderPass render_pass = VK_NULL_HANDLE;
+	CHECK_VULKAN(vkCreateRenderPass(device, &render_pass_info, nullptr, &render_pass));
+	return render_pass;
+}
+
+static VkPipeline create_lit_pipeline(VkDevice device, VkPipelineLayout layout, VkRenderPass render_pass,
+		VkSampleCountFlagBits samples, VkExtent2D extent)
+{
+	VkShaderModule vertex_shader_module = create_shader_module(device, lit_mesh_spv, sizeof(lit_mesh_spv));
+	VkShaderModule fragment_shader_module = create_shader_module(device, lit_shadowed_spv, sizeof(lit_shadowed_spv));
+
+	VkPipelineShaderStageCreateInfo vertex_stage = {};
+	vertex_stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	vertex_stage.stage = VK_SHADER_STAGE_VERTEX_BIT;
+	vertex_stage.module = vertex_shader_module;
+	vertex_stage.pName = "main";
+
+	VkPipelineShaderStageCreateInfo fragment_stage = {};
+	fragment_stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	fragment_stage.stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+	fragment_stage.module = fragment_shader_module;
+	fragment_stage.pName = "main";
+
+	std::array<VkPipelineShaderStageCreateInfo, 2> shader_stages = { vertex_stage, fragment_stage };
+
+	// The geometry pool's tightly packed positions, as drawn into the shadow maps
+	VkVertexInputBindingDescription vertex_binding = {};
+	vertex_binding.binding = 0;
+	vertex_binding.stride = sizeof(vec3);
+	vertex_binding.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+
+	VkVertexInputAttributeDescription position_attrib = {};
+	position_attrib.location = 0;
+	position_attrib.binding = 0;
+	position_attrib.format = VK_FORMAT_R32G32B32_SFLOAT;
+	position_attrib.offset = 0;
+
+	VkPipelineVertexInputStateCreateInfo vertex_input_info = {};
+	vertex_input_info.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+	vertex_input_info.vertexBindingDescriptionCount = 1;
+	vertex_input_info.pVertexBindingDescriptions = &vertex_binding;
+	vertex_input_info.vertexAttributeDescriptionCount = 1;
+	vertex_input_info.pVertexAttributeDescriptions = &position_attrib;
+
+	VkPipelineInputAssemblyStateCreateInfo input_assembly = {};
+	input_assembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+	input_assembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+	input_assembly.primitiveRestartEnable = VK_FALSE;
+
+	VkViewport viewport = {};
+	viewport.x = 0.0f;
+	viewport.y = 0.0f;
+	viewport.width = extent.width;
+	viewport.height = extent.height;
+	viewport.minDepth = 0.0f;
+	viewport.maxDepth = 1.0f;
+
+	VkRect2D scissor = {};
+	scissor.extent = extent;
+
+	VkPipelineViewportStateCreateInfo viewport_state_info = {};
+	viewport_state_info.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+	viewport_state_info.viewportCount = 1;
+	viewport_state_info.pViewports = &viewport;
+	viewport_state_info.scissorCount = 1;
+	viewport_state_info.pScissors = &scissor;
+
+	// Drawn double sided like in the shadow maps, the shader flips the normal to face the camera
+	VkPipelineRasterizationStateCreateInfo rasterizer_info = {};
+	rasterizer_info.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+	rasterizer_info.depthClampEnable = VK_FALSE;
+	rasterizer_info.rasterizerDiscardEnable = VK_FALSE;
+	rasterizer_info.polygonMode = VK_POLYGON_MODE_FILL;
+	rasterizer_info.lineWidth = 1.f;
+	rasterizer_info.cullMode = VK_CULL_MODE_NONE;
+	rasterizer_info.frontFace = VK_FRONT_FACE_CLOCKWISE;
+	rasterizer_info.depthBiasEnable = VK_FALSE;
+
+	VkPipelineMultisampleStateCreateInfo multisampling = {};
+	multisampling.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+	multisampling.sampleShadingEnable = VK_FALSE;
+	multisampling.rasterizationSamples = samples;
+
+	VkPipelineDepthStencilStateCreateInfo depth_stencil_info = {};
+	depth_stencil_info.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+	depth_stencil_info.depthTestEnable = VK_TRUE;
+	depth_stencil_info.depthWriteEnable = VK_TRUE;
+	depth_stencil_info.depthCompareOp = VK_COMPARE_OP_LESS;
+
+	VkPipelineColorBlendAttachmentState blend_mode = {};
+	blend_mode.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT
+		| VK_COLOR_COMPONENT_A_BIT;
+	blend_mode.blendEnable = VK_FALSE;
+
+	VkPipelineColorBlendStateCreateInfo blend_info = {};
+	blend_info.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+	blend_info.logicOpEnable = VK_FALSE;
+	blend_info.attachmentCount = 1;
+	blend_info.pAttachments = &blend_mode;
+
+	VkGraphicsPipelineCreateInfo graphics_pipeline_info = {};
+	graphics_pipeline_info.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+	graphics_pipeline_info.stageCount = shader_stages.size();
+	graphics_pipeline_info.pStages = shader_stages.data();
+	graphics_pipeline_info.pVertexInputState = &vertex_input_info;
+	graphics_pipeline_info.pInputAssemblyState = &input_assembly;
+	graphics_pipeline_info.pViewportState = &viewport_state_info;
+	graphics_pipeline_info.pRasterizationState = &rasterizer_info;
+	graphics_pipeline_info.pMultisampleState = &multisampling;
+	graphics_pipeline_info.pDepthStencilState = &depth_stencil_info;
+	graphics_pipeline_info.pColorBlendState = &blend_info;
+	graphics_pipeline_info.layout = layout;
+	graphics_pipeline_info.renderPass = render_pass;
+	graphics_pipeline_info.subpass = 0;
+	VkPipeline pipeline = VK_NULL_HANDLE;
+	CHECK_VULKAN(vkCreateGraphicsPipelines(device, pipeline_cache(), 1, &graphics_pipeline_info, nullptr, &pipeline));
+
+	vkDestroyShaderModule(device, vertex_shader_module, nullptr);
+	vkDestroyShaderModule(device, fragment_shader_module, nullptr);
+	return pipeline;
+}
+
+LitPass create_lit_pass(VkDevice device, VkPhysicalDevice physical_device, ResourceManager &resources,
+		const Swapchain &swapchain, const ScenePass &scene_pass)
+{
+	LitPass pass;
+	pass.extent = swapchain.extent;
+	pass.clear_values[0] = scene_pass.clear_value;
+	pass.clear_values[1].depthStencil.depth = 1.f;
+
+	const VkFormat depth_format = pick_lit_depth_format(physical_device);
+	pass.depth = create_image(device, physical_device, swapchain.extent, 1, depth_format,
+			VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, VK_IMAGE_ASPECT_DEPTH_BIT, scene_pass.samples);
+	pass.depth_handle = add_image(resources, pass.depth);
+	pass.render_pass = create_lit_render_pass(device, swapchain.format, depth_format, scene_pass.samples);
+
+	for (const auto &v : swapchain.image_views) {
+		const std::array<VkImageView, 2> attachments = {
+			scene_pass.samples != VK_SAMPLE_COUNT_1_BIT ? scene_pass.msaa_color.view : v,
+			pass.depth.view
+		};
+		VkFramebufferCreateInfo create_info = {};
+		create_info.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+		create_info.renderPass = pass.render_pass;
+		create_info.attachmentCount = attachments.size();
+		create_info.pAttachments = attachments.data();
+		create_info.width = swapchain.extent.width;
+		create_info.height = swapchain.extent.height;
+		create_info.layers = 1;
+		VkFramebuffer fb = VK_NULL_HANDLE;
+		CHECK_VULKAN(vkCreateFramebuffer(device, &create_info, nullptr, &fb));
+		pass.framebuffers.push_back(fb);
+	}
+
+	// Depth comparison sampler for the cascades, outside a cascade counts as lit
+	{
+		VkSamplerCreateInfo info = {};
+		info.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+		info.magFilter = VK_FILTER_NEAREST;
+		info.minFilter = VK_FILTER_NEAREST;
+		info.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+		info.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_BORDER;
+		info.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_BORDER;
+		info.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_BORDER;
+		info.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;
+		info.compareEnable = VK_TRUE;
+		info.compareOp = VK_COMPARE_OP_LESS_OR_EQUAL;
+		info.maxLod = 0.f;
+		pass.shadow_sampler = get_sampler(device, info);
+	}
+
+	{
+		std::array<VkDescriptorSetLayoutBinding, 2> bindings = {};
+		bindings[0].binding = 0;
+		bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+		bindings[0].descriptorCount = 1;
+		bindings[0].stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
+		bindings[1].binding = 1;
+		bindings[1].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+		bindings[1].descriptorCount = 1;
+		bindings[1].stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+
+		VkDescriptorSetLayoutCreateInfo info = {};
+		info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+		info.bindingCount = bindings.size();
+		info.pBindings = bindings.data();
+		CHECK_VULKAN(vkCreateDescriptorSetLayout(device, &info, nullptr, &pass.desc_layout));
+	}
+
+	VkPushConstantRange push_constants = {};
+	push_constants.stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
+	push_constants.offset = 0;
+	push_constants.size = sizeof(LitMeshParams);
+
+	VkPipelineLayoutCreateInfo pipeline_info = {};
+	pipeline_info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	pipeline_info.setLayoutCount = 1;
+	pipeline_info.pSetLayouts = &pass.desc_layout;
+	pipeline_info.pushConstantRangeCount = 1;
+	pipeline_info.pPushConstantRanges = &push_constants;
+	CHECK_VULKAN(vkCreatePipelineLayout(device, &pipeline_info, nullptr, &pass.pipeline_layout));
+
+	pass.pipeline = create_lit_pipeline(device, pass.pipeline_layout, pass.render_pass, scene_pass.samples,
+			swapchain.extent);
+	pass.pipeline_handle = add_pipeline(resources, pass.pipeline);
+	return pass;
+}
+
+static void draw_lit_casters(const LitPass &pass, const std::vector<ShadowCaster> &casters, VkCommandBuffer cmd_buf,
+		VkBuffer &bound_vertices, VkBuffer &bound_indices)
+{
+	for (const auto &c : casters) {
+		LitMeshParams params;
+		params.model = c.transform;
+		params.color[0] = c.color.x;
+		params.color[1] = c.color.y;
+		params.color[2] = c.color.z;
+		params.color[3] = 1.f;
+		vkCmdPushConstants(cmd_buf, pass.pipeline_layout, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT,
+				0, sizeof(LitMeshParams), &params);
+
+		if (c.vertex_buffer != bound_vertices) {
+			const VkDeviceSize offset = 0;
+			vkCmdBindVertexBuffers(cmd_buf, 0, 1, &c.vertex_buffer, &offset);
+			bound_vertices = c.vertex_buffer;
+		}
+		if (c.index_buffer != bound_indices) {
+			vkCmdBindIndexBuffer(cmd_buf, c.index_buffer, 0, VK_INDEX_TYPE_UINT32);
+			bound_indices = c.index_buffer;
+		}
+		vkCmdDrawIndexed(cmd_buf, c.index_count, 1, c.first_index, c.vertex_offset, 0);
+	}
+}
+
+void record_lit_pass(const LitPass &pass, const ShadowMaps &shadows, VkDevice device, VkCommandBuffer cmd_buf,
+		uint32_t image_index, const Camera &camera, const vec3 &light_dir, FrameRingBuffer &ring,
+		VkDescriptorPool frame_desc_pool)
+{
+	// The uniform offset alignment is at most 256 bytes
+	const RingAllocation params_alloc = ring_alloc(ring, sizeof(LitParams), 256);
+	if (!params_alloc.data) {
+		throw std::runtime_error("Frame ring buffer is full");
+	}
+	LitParams params;
+	params.view_proj = camera.proj() * camera.view();
+	const vec3 forward = normalize(camera.target - camera.position);
+	for (size_t i = 0; i < 4; ++i) {
+		// Past the last cascade is never shadowed
+		const bool has_cascade = i < shadows.cascades.size();
+		params.light_view_proj[i] = has_cascade ? shadows.cascades[i].light_view_proj : mat4();
+		params.split_far[i] = has_cascade ? shadows.cascades[i].split_far : -1.f;
+	}
+	const float light[4] = { light_dir.x, light_dir.y, light_dir.z, 0.f };
+	const float position[4] = { camera.position.x, camera.position.y, camera.position.z, 1.f };
+	const float direction[4] = { forward.x, forward.y, forward.z, 0.f };
+	std::memcpy(params.light_dir, light, sizeof(light));
+	std::memcpy(params.camera_position, position, sizeof(position));
+	std::memcpy(params.camera_forward, direction, sizeof(direction));
+	std::memcpy(params_alloc.data, &params, sizeof(LitParams));
+
+	VkDescriptorSet desc_set = VK_NULL_HANDLE;
+	{
+		VkDescriptorSetAllocateInfo alloc_info = {};
+		alloc_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+		alloc_info.descriptorPool = frame_desc_pool;
+		alloc_info.descriptorSetCount = 1;
+		alloc_info.pSetLayouts = &pass.desc_layout;
+		CHECK_VULKAN(vkAllocateDescriptorSets(device, &alloc_info, &desc_set));
+
+		VkDescriptorBufferInfo buffer_info = {};
+		buffer_info.buffer = ring.buffer.buffer;
+		buffer_info.offset = params_alloc.offset;
+		buffer_info.range = sizeof(LitParams);
+
+		VkDescriptorImageInfo image_info = {};
+		image_info.sampler = pass.shadow_sampler;
+		image_info.imageView = shadows.shadow_depth.view;
+		image_info.imageLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+
+		std::array<VkWriteDescriptorSet, 2> writes = {};
+		writes[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		writes[0].dstSet = desc_set;
+		writes[0].dstBinding = 0;
+		writes[0].descriptorCount = 1;
+		writes[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+		writes[0].pBufferInfo = &buffer_info;
+		writes[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		writes[1].dstSet = desc_set;
+		writes[1].dstBinding = 1;
+		writes[1].descriptorCount = 1;
+		writes[1].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+		writes[1].pImageInfo = &image_info;
+		vkUpdateDescriptorSets(device, writes.size(), writes.data(), 0, nullptr);
+	}
+
+	VkRenderPassBeginInfo render_pass_info = {};
+	render_pass_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+	render_pass_info.renderPass = pass.render_pass;
+	render_pass_info.framebuffer = pass.framebuffers[image_index];
+	render_pass_info.renderArea.extent = pass.extent;
+	render_pass_info.clearValueCount = pass.clear_values.size();
+	render_pass_info.pClearValues = pass.clear_values.data();
+	vkCmdBeginRenderPass(cmd_buf, &render_pass_info, VK_SUBPASS_CONTENTS_INLINE);
+
+	vkCmdBindPipeline(cmd_buf, VK_PIPELINE_BIND_POINT_GRAPHICS, pass.pipeline);
+	vkCmdBindDescriptorSets(cmd_buf, VK_PIPELINE_BIND_POINT_GRAPHICS, pass.pipeline_layout, 0, 1,
+			&desc_set, 0, nullptr);
+	VkBuffer bound_vertices = VK_NULL_HANDLE;
+	VkBuffer bound_indices = VK_NULL_HANDLE;
+	draw_lit_casters(pass, shadows.static_casters, cmd_buf, bound_vertices, bound_indices);
+	draw_lit_casters(pass, shadows.dynamic_casters, cmd_buf, bound_vertices, bound_indices);
+	vkCmdEndRenderPass(cmd_buf);
+}
+
+void destroy_lit_pass(VkDevice device, ResourceManager &resources, LitPass &pass) {
+	release_pipeline(resources, pass.pipeline_handle);
+	vkDestroyPipelineLayout(device, pass.pipeline_layout, nullptr);
+	vkDestroyDescriptorSetLayout(device, pass.desc_layout, nullptr);
+	for (auto &fb : pass.framebuffers) {
+		vkDestroyFramebuffer(device, fb, nullptr);
+	}
+	vkDestroyRenderPass(device, pass.render_pass, nullptr);
+	release_image(resources, pass.depth_handle);
+	pass = LitPass();
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <vector>
+#include <vulkan/vulkan.h>
+#include "camera.h"
+#include "frame_resources.h"
+#include "resources.h"
+#include "scene_pass.h"
+#include "shadow_maps.h"
+#include "swapchain.h"
+#include "vulkan_utils.h"
+
+// Forward pass drawing the shadow casters lit by the directional light, with their shadows
+// looked up in the cascaded shadow maps. It clears and renders into the scene pass's color
+// target with a depth buffer of its own, and the scene pass then loads the target to draw
+// the rest of the scene over it. The depth buffer and pipeline are owned by the resource manager.
+struct LitPass {
+	VkExtent2D extent = {};
+	std::array<VkClearValue, 2> clear_values = {};
+	Image depth;
+	ImageHandle depth_handle;
+	VkRenderPass render_pass = VK_NULL_HANDLE;
+	std::vector<VkFramebuffer> framebuffers;
+
+	VkSampler shadow_sampler = VK_NULL_HANDLE;
+	VkDescriptorSetLayout desc_layout = VK_NULL_HANDLE;
+	VkPipelineLayout pipeline_layout = VK_NULL_HANDLE;
+	VkPipeline pipeline = VK_NULL_HANDLE;
+	PipelineHandle pipeline_handle;
+};
+
+// The shader takes up to 4 cascades
+LitPass create_lit_pass(VkDevice device, VkPhysicalDevice physical_device, ResourceManager &resources,
+		const Swapchain &swapchain, const ScenePass &scene_pass);
+
+// Record the pass into the swapchain image, leaving the color target in the layout the scene
+// pass's load render pass expects. The light and cascade parameters are written to the
+// frame's region of the ring buffer, which must be usable as a uniform buffer, and the
+// descriptor set is allocated from the frame's pool
+void record_lit_pass(const LitPass &pass, const ShadowMaps &shadows, VkDevice device, VkCommandBuffer cmd_buf,
+		uint32_t image_index, const Camera &camera, const vec3 &light_dir, FrameRingBuffer &ring,
+		VkDescriptorPool frame_desc_pool);
+
+// Releases the depth buffer and pipeline to the resource manager
+void destroy_lit_pass(VkDevice device, ResourceManager &resources, LitPass &pass);
@@ -0,0 +1,59 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+layout(set = 0, binding = 0, std140) uniform LitParams {
+	mat4 view_proj;
+	mat4 light_view_proj[4];
+	// The far distance of each cascade along the view direction
+	vec4 split_far;
+	vec4 light_dir;
+	vec4 camera_position;
+	vec4 camera_forward;
+};
+
+// One layer per cascade, compared against the fragment's light space depth
+layout(set = 0, binding = 1) uniform sampler2DArrayShadow shadow_maps;
+
+layout(push_constant) uniform MeshParams {
+	mat4 model;
+	vec4 color;
+};
+
+layout(location = 0) in vec3 world_pos;
+
+layout(location = 0) out vec4 out_color;
+
+float shadow_factor(uint cascade) {
+	const vec4 p = light_view_proj[cascade] * vec4(world_pos, 1.0);
+	const vec2 uv = p.xy * 0.5 + 0.5;
+	const vec2 texel = 1.0 / vec2(textureSize(shadow_maps, 0).xy);
+	// 3x3 percentage closer filtering
+	float lit = 0.0;
+	for (int y = -1; y <= 1; ++y) {
+		for (int x = -1; x <= 1; ++x) {
+			lit += texture(shadow_maps, vec4(uv + vec2(x, y) * texel, float(cascade), p.z));
+		}
+	}
+	return lit / 9.0;
+}
+
+void main() {
+	// The meshes only have positions, so light them with their flat face normals
+	vec3 normal = normalize(cross(dFdx(world_pos), dFdy(world_pos)));
+	if (dot(normal, camera_position.xyz - world_pos) < 0.0) {
+		normal = -normal;
+	}
+
+	// Past the last cascade nothing is shadowed
+	const float view_depth = dot(world_pos - camera_position.xyz, camera_forward.xyz);
+	float lit = 1.0;
+	for (uint i = 0; i < 4; ++i) {
+		if (view_depth <= split_far[i]) {
+			lit = shadow_factor(i);
+			break;
+		}
+	}
+
+	const float diffuse = max(dot(normal, -light_dir.xyz), 0.0) * lit;
+	out_color = vec4(color.rgb * (0.25 + 0.75 * diffuse), 1.0);
+}
@@ -1,36 +1,107 @@
 #include <iostream>
+#include <fstream>
 #include <vector>
 #include <string>
 #include <algorithm>
 #include <array>
+#include <chrono>
+#include <limits>
+#include <cstring>
+#include <cctype>
+#include <cstdlib>
+#include <cstdio>
+#include <cmath>
 #include <SDL.h>
-#include <SDL_syswm.h>
 #include <vulkan/vulkan.h>
-#include <vulkan/vulkan_win32.h>
+#include <SDL_vulkan.h>
 #include "spirv_shaders_embedded_spv.h"
+#include "vulkan_utils.h"
+#include "object_cache.h"
+#include "resources.h"
+#include "teardown.h"
+#include "snapshot.h"
+#include "frame_output.h"
+#include "render_server.h"
+#include "render_client.h"
+#include "external_memory.h"
+#include "view_batch.h"
+#include "submit_scheduler.h"
+#include "software_renderer.h"
+#include "multiview.h"
+#include "shadow_maps.h"
+#include "lit_pass.h"
+#include "geometry_pool.h"
+#include "scene.h"
+#include "oit.h"
+#include "font_atlas.h"
+#include "overlay.h"
+#include "particles.h"
+#include "profiler.h"
+#include "virtual_texture.h"
+#include "settings.h"
+#include "swapchain.h"
+#include "scene_pass.h"
+#include "frame_resources.h"
+#include "ui.h"
+#include "config.h"
+#include "frame_benchmark.h"
+#include "autotune.h"
+#include "compute_batch.h"
+#include "gpu_primitives.h"
 
-#define CHECK_VULKAN(FN) \
-	{ \
-		VkResult r = FN; \
-		if (r != VK_SUCCESS) {\
-			std::cout << #FN << " failed\n" << std::flush; \
-			throw std::runtime_error(#FN " failed!");  \
-		} \
+int main(int argc, const char **argv) {
+	const auto startup_time = std::chrono::steady_clock::now();
+	Config config;
+	if (!load_config(argc, argv, config)) {
+		return -1;
+	}
+	print_config(config);
+	// The settings currently in use, which the UI can change while running
+	RenderSettings settings = config.render;
+
+	// The compute-only mode, view batches and render server and client run without a window,
+	// surface or swapchain
+	const bool render_service = !config.server_socket.empty() || !config.connect_socket.empty();
+	const bool headless = config.compute_only || config.view_batch_only || render_service;
+	SDL_Window* window = nullptr;
+	if (!headless) {
+		if (SDL_Init(SDL_INIT_EVERYTHING) != 0) {
+			std::cerr << "Failed to init SDL: " << SDL_GetError() << "\n";
+			return -1;
+		}
+
+		// SDL creates the surface for whichever window system it's running on, which needs a
+		// Vulkan window. Without a Vulkan loader that fails, and the software renderer draws to
+		// a plain window instead
+		const Uint32 flags = config.software ? 0 : SDL_WINDOW_VULKAN;
+		window = SDL_CreateWindow("SDL2 + Vulkan",
+			SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED, config.window_width, config.window_height, flags);
+		if (!window && flags != 0 && config.software_fallback) {
+			std::cout << "Failed to create a Vulkan window: " << SDL_GetError() << "\n";
+			window = SDL_CreateWindow("SDL2 + Vulkan",
+				SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED, config.window_width, config.window_height, 0);
+		}
+		if (!window) {
+			std::cerr << "Failed to create the window: " << SDL_GetError() << "\n";
+			return -1;
+		}
 	}
 
-int win_width = 1280;
-int win_height = 720;
+	// The window falls back to the software renderer if there's no Vulkan loader, driver or
+	// device, the headless modes need Vulkan
+	const bool software_fallback = config.software_fallback && !headless;
+	bool use_software = !headless && (config.software || !(SDL_GetWindowFlags(window) & SDL_WINDOW_VULKAN));
 
-int main(int argc, const char **argv) {
-	if (SDL_Init(SDL_INIT_EVERYTHING) != 0) {
-		std::cerr << "Failed to init SDL: " << SDL_GetError() << "\n";
-		return -1;
+	// The Vulkan functions are loaded from the loader library at runtime rather than linked
+	if (!use_software && !load_vulkan()) {
+		if (!software_fallback) {
+			throw std::runtime_error("Vulkan is not available");
+		}
+		std::cout << "Falling back to the software renderer\n";
+		use_software = true;
 	}
 
-	SDL_Window* window = SDL_CreateWindow("SDL2 + Vulkan",
-		SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED, win_width, win_height, 0);
-	
-	{
+	if (!use_software) {
 		uint32_t extension_count = 0;
 		vkEnumerateInstanceExtensionProperties(nullptr, &extension_count, nullptr);
 		std::cout << "num extensions: " << extension_count << "\n";
@@ -42,13 +113,16 @@ int main(int argc, const char **argv) {
 		}
 	}
 
-	const std::array<const char*, 1> validation_layers = {
-		"VK_LAYER_KHRONOS_validation"
-	};
+	std::vector<const char*> validation_layers;
+	if (config.validation) {
+		for (const auto &l : config.validation_layers) {
+			validation_layers.push_back(l.c_str());
+		}
+	}
 
 	// Make the Vulkan Instance
 	VkInstance vk_instance = VK_NULL_HANDLE;
-	{
+	if (!use_software) {
 		VkApplicationInfo app_info = {};
 		app_info.sType = VK_STRUCTURE_TYPE_APPLICATION_INFO;
 		app_info.pApplicationName = "SDL2 + Vulkan";
@@ -57,9 +131,16 @@ int main(int argc, const char **argv) {
 		app_info.engineVersion = VK_MAKE_VERSION(1, 0, 0);
 		app_info.apiVersion = VK_API_VERSION_1_1;
 
-		const std::array<const char*, 2> extension_names = {
-			VK_KHR_SURFACE_EXTENSION_NAME, VK_KHR_WIN32_SURFACE_EXTENSION_NAME,
-		};
+		// The surface extensions for the window system SDL is using
+		std::vector<const char*> extension_names;
+		if (!headless) {
+			unsigned int count = 0;
+			if (!SDL_Vulkan_GetInstanceExtensions(window, &count, nullptr)) {
+				throw std::runtime_error(std::string("Failed to get the surface extensions: ") + SDL_GetError());
+			}
+			extension_names.resize(count);
+			SDL_Vulkan_GetInstanceExtensions(window, &count, extension_names.data());
+		}
 
 		VkInstanceCreateInfo create_info = {};
 		create_info.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
@@ -69,23 +150,63 @@ int main(int argc, const char **argv) {
 		create_info.enabledLayerCount = validation_layers.size();
 		create_info.ppEnabledLayerNames = validation_layers.data();
 
-		CHECK_VULKAN(vkCreateInstance(&create_info, nullptr, &vk_instance));
+		const VkResult result = vkCreateInstance(&create_info, nullptr, &vk_instance);
+		if (result != VK_SUCCESS && software_fallback) {
+			std::cout << "Failed to create the Vulkan instance, falling back to the software renderer\n";
+			use_software = true;
+		} else {
+			CHECK_VULKAN(result);
+			load_vulkan_instance(vk_instance);
+		}
+	}
+	if (!use_software && software_fallback) {
+		uint32_t device_count = 0;
+		vkEnumeratePhysicalDevices(vk_instance, &device_count, nullptr);
+		if (device_count == 0) {
+			std::cout << "No Vulkan devices found, falling back to the software renderer\n";
+			vkDestroyInstance(vk_instance, nullptr);
+			use_software = true;
+		}
+	}
+	auto run_software = [&]() {
+		// The software renderer draws with the window's surface, which a Vulkan window can't have
+		if (SDL_GetWindowFlags(window) & SDL_WINDOW_VULKAN) {
+			SDL_DestroyWindow(window);
+			window = SDL_CreateWindow("SDL2 + Vulkan",
+				SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED, config.window_width, config.window_height, 0);
+		}
+		SoftwareRendererParams params;
+		params.num_threads = config.num_threads;
+		params.clear_color = config.clear_color;
+		params.draw_meshes = config.enable_shadows;
+		run_software_renderer(window, params);
+		SDL_DestroyWindow(window);
+		SDL_Quit();
+		return 0;
+	};
+	if (use_software) {
+		return run_software();
 	}
 
 	VkSurfaceKHR vk_surface = VK_NULL_HANDLE;
-	{
-		SDL_SysWMinfo wm_info;
-		SDL_VERSION(&wm_info.version);
-		SDL_GetWindowWMInfo(window, &wm_info);
+	if (!headless && !SDL_Vulkan_CreateSurface(window, vk_instance, &vk_surface)) {
+		throw std::runtime_error(std::string("Failed to create the window surface: ") + SDL_GetError());
+	}
 
-		VkWin32SurfaceCreateInfoKHR create_info = {};
-		create_info.sType = VK_STRUCTURE_TYPE_WIN32_SURFACE_CREATE_INFO_KHR;
-		create_info.hwnd = wm_info.info.win.window;
-		create_info.hinstance = wm_info.info.win.hinstance;
-		CHECK_VULKAN(vkCreateWin32SurfaceKHR(vk_instance, &create_info, nullptr, &vk_surface));
+	// The snapshot's device choice, pipeline cache and font atlas are used if they still match,
+	// it's unmapped once they've been created
+	Snapshot snapshot;
+	if (!config.snapshot_path.empty()) {
+		open_snapshot(config.snapshot_path, snapshot);
 	}
+	const uint64_t device_options_hash = hash_snapshot_key(config.device + (config.compute_only ? ":compute" : "")
+			+ (headless ? ":headless" : ""));
+	SnapshotDevice snapshot_device;
+	const bool has_snapshot_device = read_snapshot_device(snapshot, snapshot_device);
 
 	VkPhysicalDevice vk_physical_device = VK_NULL_HANDLE;
+	uint32_t physical_device_index = 0;
+	bool device_from_snapshot = false;
 	{
 		uint32_t device_count = 0;
 		vkEnumeratePhysicalDevices(vk_instance, &device_count, nullptr);
@@ -93,14 +214,40 @@ int main(int argc, const char **argv) {
 		std::vector<VkPhysicalDevice> devices(device_count, VkPhysicalDevice{});
 		vkEnumeratePhysicalDevices(vk_instance, &device_count, devices.data());
 
-		const bool has_discrete_gpu = std::find_if(devices.begin(), devices.end(),
-			[](const VkPhysicalDevice& d) {
-				VkPhysicalDeviceProperties properties;
-				vkGetPhysicalDeviceProperties(d, &properties);
-				return properties.deviceType == VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU;
-			}) != devices.end();
+		// Skip the discovery if the snapshot's device is still there with the same driver
+		if (has_snapshot_device && snapshot_device.device_index < devices.size()) {
+			const uint32_t i = snapshot_device.device_index;
+			const SnapshotDevice current = describe_snapshot_device(devices[i], i, 0, device_options_hash);
+			if (same_snapshot_device(current, snapshot_device)) {
+				vk_physical_device = devices[i];
+				physical_device_index = i;
+				device_from_snapshot = true;
+				std::cout << "Using device " << i << " from the snapshot\n";
+			}
+		}
+
+		// Pick the preferred device type, falling back to the other type if there's none of it
+		// and then to any device, e.g. a CPU or virtual one in a container without a GPU
+		VkPhysicalDeviceType preferred_type = VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU;
+		VkPhysicalDeviceType fallback_type = VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU;
+		if (config.device == "integrated") {
+			std::swap(preferred_type, fallback_type);
+		}
+		const bool by_type = config.device == "discrete" || config.device == "integrated";
+		const bool by_index = !by_type && std::all_of(config.device.begin(), config.device.end(), ::isdigit);
+		auto has_type = [&](VkPhysicalDeviceType type) {
+			return std::find_if(devices.begin(), devices.end(),
+				[&](const VkPhysicalDevice& d) {
+					VkPhysicalDeviceProperties properties;
+					vkGetPhysicalDeviceProperties(d, &properties);
+					return properties.deviceType == type;
+				}) != devices.end();
+		};
+		const bool has_preferred_type = has_type(preferred_type);
+		const bool has_fallback_type = has_type(fallback_type);
 
-		for (const auto &d : devices) {
+		for (size_t i = 0; i < devices.size() && !device_from_snapshot; ++i) {
+			const auto &d = devices[i];
 			VkPhysicalDeviceProperties properties;
 			VkPhysicalDeviceFeatures features;
 			vkGetPhysicalDeviceProperties(d, &properties);
@@ -118,14 +265,35 @@ int main(int argc, const char **argv) {
 				std::cout << e.extensionName << "\n";
 			}
 
-			if (has_discrete_gpu && properties.deviceType == VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU) {
+			if (by_type && has_preferred_type && properties.deviceType == preferred_type) {
 				vk_physical_device = d;
 				break;
-			} else if (!has_discrete_gpu && properties.deviceType == VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU) {
+			} else if (by_type && !has_preferred_type && properties.deviceType == fallback_type) {
+				vk_physical_device = d;
+				break;
+			} else if (by_type && !has_preferred_type && !has_fallback_type) {
+				std::cout << "No discrete or integrated GPU, using " << properties.deviceName << "\n";
+				vk_physical_device = d;
+				break;
+			} else if (by_index && std::to_string(i) == config.device) {
+				vk_physical_device = d;
+				break;
+			} else if (!by_type && !by_index && std::strstr(properties.deviceName, config.device.c_str())) {
 				vk_physical_device = d;
 				break;
 			}
 		}
+		if (vk_physical_device == VK_NULL_HANDLE && software_fallback) {
+			std::cout << "No device matching '" << config.device << "' found, falling back to the software renderer\n";
+			close_snapshot(snapshot);
+			vkDestroySurfaceKHR(vk_instance, vk_surface, nullptr);
+			vkDestroyInstance(vk_instance, nullptr);
+			return run_software();
+		}
+		if (vk_physical_device == VK_NULL_HANDLE) {
+			throw std::runtime_error("No device matching '" + config.device + "' found");
+		}
+		physical_device_index = std::find(devices.begin(), devices.end(), vk_physical_device) - devices.begin();
 	}
 
 	VkDevice vk_device = VK_NULL_HANDLE;
@@ -136,15 +304,47 @@ int main(int argc, const char **argv) {
 		vkGetPhysicalDeviceQueueFamilyProperties(vk_physical_device, &num_queue_families, nullptr);
 		std::vector<VkQueueFamilyProperties> family_props(num_queue_families, VkQueueFamilyProperties{});
 		vkGetPhysicalDeviceQueueFamilyProperties(vk_physical_device, &num_queue_families, family_props.data());
-		for (uint32_t i = 0; i < num_queue_families; ++i) {
+		// The snapshot's queue family was chosen by the same search, only check it can still present
+		bool queue_from_snapshot = false;
+		if (device_from_snapshot && snapshot_device.queue_family < num_queue_families) {
+			VkBool32 present_support = headless;
+			if (!headless) {
+				vkGetPhysicalDeviceSurfaceSupportKHR(vk_physical_device, snapshot_device.queue_family, vk_surface,
+						&present_support);
+			}
+			if (present_support) {
+				graphics_queue_index = snapshot_device.queue_family;
+				queue_from_snapshot = true;
+			}
+		}
+		for (uint32_t i = 0; i < num_queue_families && !config.compute_only && !queue_from_snapshot; ++i) {
 			// We want present and graphics on the same queue (kind of assume this will be supported on any discrete GPU)
-			VkBool32 present_support = false;
-			vkGetPhysicalDeviceSurfaceSupportKHR(vk_physical_device, i, vk_surface, &present_support);
+			VkBool32 present_support = headless;
+			if (!headless) {
+				vkGetPhysicalDeviceSurfaceSupportKHR(vk_physical_device, i, vk_surface, &present_support);
+			}
 			if (present_support && (family_props[i].queueFlags & VK_QUEUE_GRAPHICS_BIT)) {
 				graphics_queue_index = i;
 			}
 		}
-		std::cout << "Graphics queue is " << graphics_queue_index << "\n";
+		// Without graphics take just a compute queue, preferring a dedicated compute family
+		for (uint32_t i = 0; i < num_queue_families && config.compute_only && !queue_from_snapshot; ++i) {
+			const VkQueueFlags flags = family_props[i].queueFlags;
+			if ((flags & VK_QUEUE_COMPUTE_BIT) && (graphics_queue_index == uint32_t(-1) || !(flags & VK_QUEUE_GRAPHICS_BIT))) {
+				graphics_queue_index = i;
+			}
+		}
+		if (graphics_queue_index == uint32_t(-1) && software_fallback) {
+			std::cout << "No queue can present to the window, falling back to the software renderer\n";
+			close_snapshot(snapshot);
+			vkDestroySurfaceKHR(vk_instance, vk_surface, nullptr);
+			vkDestroyInstance(vk_instance, nullptr);
+			return run_software();
+		}
+		if (graphics_queue_index == uint32_t(-1)) {
+			throw std::runtime_error("No suitable queue found");
+		}
+		std::cout << (config.compute_only ? "Compute" : "Graphics") << " queue is " << graphics_queue_index << "\n";
 		const float queue_priority = 1.f;
 
 		VkDeviceQueueCreateInfo queue_create_info = {};
@@ -156,12 +356,62 @@ int main(int argc, const char **argv) {
 		VkPhysicalDeviceFeatures device_features = {};
 		// TODO: RTX feature
 
-		const std::array<const char*, 1> device_extensions = {
-			VK_KHR_SWAPCHAIN_EXTENSION_NAME
-		};
+		// Weighted blended OIT blends its two targets differently, and the linked lists are
+		// built with atomics from the fragment shader
+		if (config.enable_oit || config.oit_bench_iterations > 0 || !config.server_socket.empty()
+				|| config.view_batch_only)
+		{
+			VkPhysicalDeviceFeatures supported_features = {};
+			vkGetPhysicalDeviceFeatures(vk_physical_device, &supported_features);
+			device_features.independentBlend = supported_features.independentBlend;
+			device_features.fragmentStoresAndAtomics = supported_features.fragmentStoresAndAtomics;
+			if (config.enable_oit && !oit_mode_supported(vk_physical_device, config.oit_mode)) {
+				throw std::runtime_error(std::string("OIT mode ") + oit_mode_name(config.oit_mode) + " is not supported");
+			}
+		}
+
+		// Sparse residency lets the virtual texture bind its pages directly into a sparse image
+		if (config.virtual_texture && config.virtual_texture_sparse) {
+			config.virtual_texture_sparse = virtual_texture_sparse_supported(vk_physical_device,
+					graphics_queue_index, config.vt);
+			device_features.sparseBinding = config.virtual_texture_sparse;
+			device_features.sparseResidencyImage2D = config.virtual_texture_sparse;
+		}
+
+		VkPhysicalDeviceMultiviewFeatures multiview_features = {};
+		multiview_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MULTIVIEW_FEATURES;
+		if (config.num_views > 1) {
+			if (!multiview_supported(vk_physical_device, config.num_views)) {
+				throw std::runtime_error("Multiview with the requested number of views is not supported");
+			}
+			multiview_features.multiview = VK_TRUE;
+		}
+
+		std::vector<const char*> device_extensions;
+		if (!headless) {
+			device_extensions.push_back(VK_KHR_SWAPCHAIN_EXTENSION_NAME);
+		}
+		// The render server and its clients share frames without copies if they can
+		config.external_memory = config.external_memory && render_service
+			&& external_memory_supported(vk_physical_device, VK_FORMAT_R8G8B8A8_UNORM,
+					VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT);
+		if (config.external_memory) {
+			device_extensions.insert(device_extensions.end(), std::begin(external_memory_extensions),
+					std::end(external_memory_extensions));
+		}
+		// The frame loop's submission thread merges its batches into vkQueueSubmit2 calls
+		VkPhysicalDeviceSynchronization2FeaturesKHR sync2_features = {};
+		sync2_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SYNCHRONIZATION_2_FEATURES_KHR;
+		config.submit2 = config.submit2 && !headless && submit2_supported(vk_physical_device);
+		if (config.submit2) {
+			device_extensions.push_back(VK_KHR_SYNCHRONIZATION_2_EXTENSION_NAME);
+			sync2_features.synchronization2 = VK_TRUE;
+			multiview_features.pNext = &sync2_features;
+		}
 
 		VkDeviceCreateInfo create_info = {};
 		create_info.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+		create_info.pNext = &multiview_features;
 		create_info.queueCreateInfoCount = 1;
 		create_info.pQueueCreateInfos = &queue_create_info;
 		create_info.enabledLayerCount = validation_layers.size();
@@ -170,225 +420,176 @@ int main(int argc, const char **argv) {
 		create_info.ppEnabledExtensionNames = device_extensions.data();
 		create_info.pEnabledFeatures = &device_features;
 		CHECK_VULKAN(vkCreateDevice(vk_physical_device, &create_info, nullptr, &vk_device));
+		// Dispatch straight to the driver from here on
+		load_vulkan_device(vk_device);
 
 		vkGetDeviceQueue(vk_device, graphics_queue_index, 0, &vk_queue);
 	}
 
-	// Setup swapchain, assume a real GPU so don't bother querying the capabilities, just get what we want
+	if (!config.pipeline_cache_path.empty()) {
+		create_pipeline_cache(vk_device, config.pipeline_cache_path);
+	} else if (!config.snapshot_path.empty()) {
+		const void *data = nullptr;
+		size_t size = 0;
+		read_snapshot_pipeline_cache(snapshot, data, size);
+		create_pipeline_cache(vk_device, data, size);
+	}
+	const SnapshotDevice current_device = describe_snapshot_device(vk_physical_device, physical_device_index,
+			graphics_queue_index, device_options_hash);
+	init_object_cache(vk_physical_device);
+	// Every mode drains the GPU with this deadline before destroying anything, so a hung GPU
+	// doesn't hang the shutdown too
+	const uint64_t shutdown_timeout_ns = 5000000000ull;
+
+	if (config.compute_only) {
+		const ComputeBatchResult result = run_compute_batch(vk_device, vk_physical_device, vk_queue,
+				graphics_queue_index, config.compute);
+		print_compute_batch_result(config.compute, result);
+		close_snapshot(snapshot);
+		if (!shutdown_vulkan(vk_instance, vk_surface, vk_device, vk_queue, nullptr, shutdown_timeout_ns)) {
+			return 1;
+		}
+		return result.mismatches == 0 ? 0 : 1;
+	}
+
+	// Views are batched with an order independent OIT mode unless another was given, sorting
+	// renders one view per submission
+	if (config.view_batch_only) {
+		ViewBatchParams params = config.view_batch;
+		params.num_instances = config.num_transparent;
+		params.oit_mode = config.enable_oit ? config.oit_mode
+			: oit_mode_supported(vk_physical_device, OITMode::WEIGHTED_BLENDED) ? OITMode::WEIGHTED_BLENDED
+			: oit_mode_supported(vk_physical_device, OITMode::LINKED_LIST) ? OITMode::LINKED_LIST : OITMode::SORTED;
+		const ViewBatchResult result = run_view_batch(vk_device, vk_physical_device, vk_queue,
+				graphics_queue_index, params);
+		print_view_batch_result(params, result);
+		close_snapshot(snapshot);
+		const bool drained = shutdown_vulkan(vk_instance, vk_surface, vk_device, vk_queue, nullptr,
+				shutdown_timeout_ns);
+		return drained ? 0 : 1;
+	}
+
+	// The server renders each client's scene with the OIT mode if one was given
+	if (!config.server_socket.empty()) {
+		RenderServerParams params;
+		params.socket_path = config.server_socket;
+		params.oit_mode = config.enable_oit ? config.oit_mode : OITMode::SORTED;
+		params.external_memory = config.external_memory;
+		run_render_server(vk_device, vk_physical_device, vk_queue, graphics_queue_index, params);
+		close_snapshot(snapshot);
+		const bool drained = shutdown_vulkan(vk_instance, vk_surface, vk_device, vk_queue, nullptr,
+				shutdown_timeout_ns);
+		return drained ? 0 : 1;
+	}
+
+	if (!config.connect_socket.empty()) {
+		RenderClientParams params;
+		params.socket_path = config.connect_socket;
+		params.extent = { config.window_width, config.window_height };
+		params.external_memory = config.external_memory;
+		const bool ok = run_render_client(vk_device, vk_physical_device, vk_queue, graphics_queue_index, params);
+		close_snapshot(snapshot);
+		if (!shutdown_vulkan(vk_instance, vk_surface, vk_device, vk_queue, nullptr, shutdown_timeout_ns)) {
+			return 1;
+		}
+		return ok ? 0 : 1;
+	}
+
+	// Settings saved by an earlier autotuning run on this device fill in the options not set
+	// in the config, environment or command line
+	const std::string tuned_path = tuned_config_path(vk_physical_device);
+	if (config.use_tuned && !config.autotune && std::ifstream(tuned_path.c_str())) {
+		std::string error;
+		if (!load_config_file(config, tuned_path, error, true)) {
+			std::cout << "Ignoring tuned settings: " << error << "\n";
+		} else {
+			std::cout << "Loaded tuned settings " << tuned_path << "\n";
+			settings = config.render;
+		}
+	}
+
+	if (config.oit_bench_iterations > 0 || config.bench_frames > 0 || config.autotune
+			|| config.prim_bench_count > 0 || config.particle_bench_frames > 0 || config.geometry_churn_frames > 0)
+	{
+		FrameBenchmarkParams bench_params;
+		bench_params.frames_in_flight = config.render.frames_in_flight;
+		bench_params.recording_mode = config.render.recording_mode;
+		bench_params.num_threads = config.num_threads;
+		bench_params.draws_per_frame = config.draws_per_frame;
+		bench_params.batch_size = config.batch_size;
+		bench_params.sort_draws = config.sort_draws;
+		bench_params.track_state = config.track_draw_state;
+		if (config.bench_frames > 0) {
+			bench_params.frames = config.bench_frames;
+		}
+
+		if (config.oit_bench_iterations > 0) {
+			run_oit_benchmark(vk_device, vk_physical_device, vk_queue, graphics_queue_index,
+					config.num_transparent, config.oit_bench_iterations);
+		}
+		if (config.prim_bench_count > 0) {
+			run_gpu_primitives_benchmark(vk_device, vk_physical_device, vk_queue, graphics_queue_index,
+					config.prim_bench_count, 20);
+		}
+		if (config.particle_bench_frames > 0) {
+			run_particle_benchmark(vk_device, vk_physical_device, vk_queue, graphics_queue_index,
+					config.num_particles > 0 ? config.num_particles : 1 << 20, config.particle_bench_frames);
+		}
+		bool churn_ok = true;
+		if (config.geometry_churn_frames > 0) {
+			churn_ok = run_geometry_churn(vk_device, vk_physical_device, vk_queue, graphics_queue_index,
+					config.geometry_churn_frames, VkDeviceSize(config.defrag_budget_kb) * 1024);
+		}
+		if (config.autotune) {
+			run_autotune(vk_device, vk_physical_device, vk_queue, graphics_queue_index,
+					config.autotune_objective, bench_params);
+		} else if (config.bench_frames > 0) {
+			const FrameBenchmarkResult result = run_frame_benchmark(vk_device, vk_physical_device,
+					vk_queue, graphics_queue_index, bench_params);
+			print_frame_benchmark_result(bench_params, result);
+		}
+		close_snapshot(snapshot);
+		const bool drained = shutdown_vulkan(vk_instance, vk_surface, vk_device, vk_queue, nullptr,
+				shutdown_timeout_ns);
+		SDL_DestroyWindow(window);
+		SDL_Quit();
+		return drained && churn_ok ? 0 : 1;
+	}
+
+
+	// Setup swapchain, assume a real GPU so don't bother querying much, just get what we want
 	VkExtent2D swapchain_extent = {};
-	swapchain_extent.width = win_width;
-	swapchain_extent.height = win_height;
+	swapchain_extent.width = config.window_width;
+	swapchain_extent.height = config.window_height;
 	const VkFormat swapchain_img_format = VK_FORMAT_B8G8R8A8_UNORM;
+	VkImageUsageFlags swapchain_usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+	// The multiview layers are blitted into the swapchain images
+	if (config.num_views > 1) {
+		swapchain_usage |= VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+	}
+	// The frame output copies the rendered images
+	if (!config.output_target.empty()) {
+		swapchain_usage |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+	}
+	const std::vector<VkPresentModeKHR> present_modes = supported_present_modes(vk_physical_device, vk_surface);
 
-	VkSwapchainKHR vk_swapchain = VK_NULL_HANDLE;
-	std::vector<VkImage> swapchain_images;
-	std::vector<VkImageView> swapchain_image_views;
-	{
-		VkSwapchainCreateInfoKHR create_info = {};
-		create_info.sType = VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR;
-		create_info.surface = vk_surface;
-		create_info.minImageCount = 2;
-		create_info.imageFormat = swapchain_img_format;
-		create_info.imageColorSpace = VK_COLOR_SPACE_SRGB_NONLINEAR_KHR;
-		create_info.imageExtent = swapchain_extent;
-		create_info.imageArrayLayers = 1;
-		create_info.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
-		// We only have 1 queue
-		create_info.imageSharingMode = VK_SHARING_MODE_EXCLUSIVE;
-		create_info.preTransform = VK_SURFACE_TRANSFORM_IDENTITY_BIT_KHR;
-		create_info.compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;
-		create_info.presentMode = VK_PRESENT_MODE_FIFO_KHR;
-		create_info.clipped = true;
-		create_info.oldSwapchain = VK_NULL_HANDLE;
-		CHECK_VULKAN(vkCreateSwapchainKHR(vk_device, &create_info, nullptr, &vk_swapchain));
-
-		// Get the swap chain images
-		uint32_t num_swapchain_imgs = 0;
-		vkGetSwapchainImagesKHR(vk_device, vk_swapchain, &num_swapchain_imgs, nullptr);
-		swapchain_images.resize(num_swapchain_imgs);
-		vkGetSwapchainImagesKHR(vk_device, vk_swapchain, &num_swapchain_imgs, swapchain_images.data());
-
-		for (const auto &img : swapchain_images) {
-			VkImageViewCreateInfo view_create_info = {};
-			view_create_info.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
-			view_create_info.image = img;
-			view_create_info.viewType = VK_IMAGE_VIEW_TYPE_2D;
-			view_create_info.format = swapchain_img_format;
-
-			view_create_info.components.r = VK_COMPONENT_SWIZZLE_IDENTITY;
-			view_create_info.components.g = VK_COMPONENT_SWIZZLE_IDENTITY;
-			view_create_info.components.b = VK_COMPONENT_SWIZZLE_IDENTITY;
-			view_create_info.components.a = VK_COMPONENT_SWIZZLE_IDENTITY;
-
-			view_create_info.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-			view_create_info.subresourceRange.baseMipLevel = 0;
-			view_create_info.subresourceRange.levelCount = 1;
-			view_create_info.subresourceRange.baseArrayLayer = 0;
-			view_create_info.subresourceRange.layerCount = 1;
-
-			VkImageView img_view;
-			CHECK_VULKAN(vkCreateImageView(vk_device, &view_create_info, nullptr, &img_view));
-			swapchain_image_views.push_back(img_view);
-		}
-	}
-
-	// Build the pipeline
-	VkPipelineLayout vk_pipeline_layout;
-	VkRenderPass vk_render_pass;
-	VkPipeline vk_pipeline;
-	{
-		VkShaderModule vertex_shader_module = VK_NULL_HANDLE;
-
-		VkShaderModuleCreateInfo create_info = {};
-		create_info.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-		create_info.codeSize = sizeof(vert_spv);
-		create_info.pCode = vert_spv;
-		CHECK_VULKAN(vkCreateShaderModule(vk_device, &create_info, nullptr, &vertex_shader_module));
-		
-		VkPipelineShaderStageCreateInfo vertex_stage = {};
-		vertex_stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-		vertex_stage.stage = VK_SHADER_STAGE_VERTEX_BIT;
-		vertex_stage.module = vertex_shader_module;
-		vertex_stage.pName = "main";
-
-		VkShaderModule fragment_shader_module = VK_NULL_HANDLE;
-		create_info.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-		create_info.codeSize = sizeof(frag_spv);
-		create_info.pCode = frag_spv;
-		CHECK_VULKAN(vkCreateShaderModule(vk_device, &create_info, nullptr, &fragment_shader_module));
-
-		VkPipelineShaderStageCreateInfo fragment_stage = {};
-		fragment_stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-		fragment_stage.stage = VK_SHADER_STAGE_FRAGMENT_BIT;
-		fragment_stage.module = fragment_shader_module;
-		fragment_stage.pName = "main";
-
-		std::array<VkPipelineShaderStageCreateInfo, 2> shader_stages = { vertex_stage, fragment_stage };
-
-		// Vertex data hard-coded in vertex shader
-		VkPipelineVertexInputStateCreateInfo vertex_input_info = {};
-		vertex_input_info.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-		vertex_input_info.vertexBindingDescriptionCount = 0;
-		vertex_input_info.vertexAttributeDescriptionCount = 0;
-
-		// Primitive type
-		VkPipelineInputAssemblyStateCreateInfo input_assembly = {};
-		input_assembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
-		input_assembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
-		input_assembly.primitiveRestartEnable = VK_FALSE;
-
-		// Viewport config
-		VkViewport viewport = {};
-		viewport.x = 0.0f;
-		viewport.y = 0.0f;
-		viewport.width = win_width;
-		viewport.height = win_height;
-		viewport.minDepth = 0.0f;
-		viewport.maxDepth = 1.0f;
-
-		// Scissor rect config
-		VkRect2D scissor = {};
-		scissor.offset.x = 0;
-		scissor.offset.y = 0;
-		scissor.extent = swapchain_extent;
-
-		VkPipelineViewportStateCreateInfo viewport_state_info = {};
-		viewport_state_info.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
-		viewport_state_info.viewportCount = 1;
-		viewport_state_info.pViewports = &viewport;
-		viewport_state_info.scissorCount = 1;
-		viewport_state_info.pScissors = &scissor;
-
-		VkPipelineRasterizationStateCreateInfo rasterizer_info = {};
-		rasterizer_info.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
-		rasterizer_info.depthClampEnable = VK_FALSE;
-		rasterizer_info.rasterizerDiscardEnable = VK_FALSE;
-		rasterizer_info.polygonMode = VK_POLYGON_MODE_FILL;
-		rasterizer_info.lineWidth = 1.f;
-		rasterizer_info.cullMode = VK_CULL_MODE_BACK_BIT;
-		rasterizer_info.frontFace = VK_FRONT_FACE_CLOCKWISE;
-		rasterizer_info.depthBiasEnable = VK_FALSE;
-
-		VkPipelineMultisampleStateCreateInfo multisampling = {};
-		multisampling.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
-		multisampling.sampleShadingEnable = VK_FALSE;
-		multisampling.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
-
-		VkPipelineColorBlendAttachmentState blend_mode = {};
-		blend_mode.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
-		blend_mode.blendEnable = VK_FALSE;
-
-		VkPipelineColorBlendStateCreateInfo blend_info = {};
-		blend_info.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
-		blend_info.logicOpEnable = VK_FALSE;
-		blend_info.attachmentCount = 1;
-		blend_info.pAttachments = &blend_mode;
-
-		VkPipelineLayoutCreateInfo pipeline_info = {};
-		pipeline_info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-		CHECK_VULKAN(vkCreatePipelineLayout(vk_device, &pipeline_info, nullptr, &vk_pipeline_layout));
-
-		VkAttachmentDescription color_attachment = {};
-		color_attachment.format = swapchain_img_format;
-		color_attachment.samples = VK_SAMPLE_COUNT_1_BIT;
-		color_attachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-		color_attachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
-		color_attachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
-		color_attachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-		color_attachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-		color_attachment.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
-
-		VkAttachmentReference color_attachment_ref = {};
-		color_attachment_ref.attachment = 0;
-		color_attachment_ref.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
-
-		VkSubpassDescription subpass = {};
-		subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
-		subpass.colorAttachmentCount = 1;
-		subpass.pColorAttachments = &color_attachment_ref;
-
-		VkRenderPassCreateInfo render_pass_info = {};
-		render_pass_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
-		render_pass_info.attachmentCount = 1;
-		render_pass_info.pAttachments = &color_attachment;
-		render_pass_info.subpassCount = 1;
-		render_pass_info.pSubpasses = &subpass;
-		CHECK_VULKAN(vkCreateRenderPass(vk_device, &render_pass_info, nullptr, &vk_render_pass));
-
-		VkGraphicsPipelineCreateInfo graphics_pipeline_info = {};
-		graphics_pipeline_info.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
-		graphics_pipeline_info.stageCount = 2;
-		graphics_pipeline_info.pStages = shader_stages.data();
-		graphics_pipeline_info.pVertexInputState = &vertex_input_info;
-		graphics_pipeline_info.pInputAssemblyState = &input_assembly;
-		graphics_pipeline_info.pViewportState = &viewport_state_info;
-		graphics_pipeline_info.pRasterizationState = &rasterizer_info;
-		graphics_pipeline_info.pMultisampleState = &multisampling;
-		graphics_pipeline_info.pColorBlendState = &blend_info;
-		graphics_pipeline_info.layout = vk_pipeline_layout;
-		graphics_pipeline_info.renderPass = vk_render_pass;
-		graphics_pipeline_info.subpass = 0;
-		CHECK_VULKAN(vkCreateGraphicsPipelines(vk_device, VK_NULL_HANDLE, 1, &graphics_pipeline_info, nullptr, &vk_pipeline));
-
-		vkDestroyShaderModule(vk_device, vertex_shader_module, nullptr);
-		vkDestroyShaderModule(vk_device, fragment_shader_module, nullptr);
-	}
-
-	// Setup framebuffers
-	std::vector<VkFramebuffer> framebuffers;
-	for (const auto &v : swapchain_image_views) {
-		std::array<VkImageView, 1> attachments = { v };
-		VkFramebufferCreateInfo create_info = {};
-		create_info.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
-		create_info.renderPass = vk_render_pass;
-		create_info.attachmentCount = 1;
-		create_info.pAttachments = attachments.data();
-		create_info.width = win_width;
-		create_info.height = win_height;
-		create_info.layers = 1;
-		VkFramebuffer fb = VK_NULL_HANDLE;
-		CHECK_VULKAN(vkCreateFramebuffer(vk_device, &create_info, nullptr, &fb));
-		framebuffers.push_back(fb);
+	// OIT and multiview render straight into the swapchain images, in those modes the scene
+	// pass only draws the UI over them and isn't multisampled
+	const bool draw_triangle = config.num_views == 1 && !config.enable_oit;
+	if (!draw_triangle) {
+		settings.msaa_samples = VK_SAMPLE_COUNT_1_BIT;
+	}
+	settings.msaa_samples = supported_sample_count(vk_physical_device, settings.msaa_samples);
+	const VkSampleCountFlagBits max_msaa_samples = supported_sample_count(vk_physical_device, VK_SAMPLE_COUNT_8_BIT);
+
+	MultiviewPass multiview_pass;
+	if (config.num_views > 1) {
+		VkExtent2D view_extent = {};
+		view_extent.width = config.window_width / config.num_views;
+		view_extent.height = config.window_height;
+		multiview_pass = create_multiview_pass(vk_device, vk_physical_device, config.num_views,
+				view_extent, swapchain_img_format, config.clear_color);
+		std::cout << "Rendering " << config.num_views << " views with multiview\n";
 	}
 
 	// Setup the command pool
@@ -396,74 +597,281 @@ int main(int argc, const char **argv) {
 	{
 		VkCommandPoolCreateInfo create_info = {};
 		create_info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+		// The per-frame command buffers are re-recorded each frame they're used
+		create_info.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
 		create_info.queueFamilyIndex = graphics_queue_index;
 		CHECK_VULKAN(vkCreateCommandPool(vk_device, &create_info, nullptr, &vk_command_pool));
 	}
 
-	std::vector<VkCommandBuffer> command_buffers(framebuffers.size(), VkCommandBuffer{});
-	{
-		VkCommandBufferAllocateInfo info = {};
-		info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-		info.commandPool = vk_command_pool;
-		info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-		info.commandBufferCount = command_buffers.size();
-		CHECK_VULKAN(vkAllocateCommandBuffers(vk_device, &info, command_buffers.data()));
+	// Resources which may be replaced while frames using them are in flight
+	ResourceManager resources;
+
+	// Shadow casting demo scene: a static ground plane and ring of pillars which are cached
+	// in the shadow maps, and a box orbiting between them which is redrawn each frame. The
+	// casters share the geometry pool's block, so each cascade binds its buffers once
+	Camera camera;
+	camera.aspect = float(config.window_width) / config.window_height;
+	const vec3 light_dir = normalize(vec3(-0.4f, -1.f, -0.3f));
+	ShadowMaps shadow_maps;
+	GeometryPool geometry = create_geometry_pool(sizeof(vec3), 1 << 16, 1 << 18);
+	GeometryDefragmenter geometry_defrag;
+	geometry_defrag.params.max_bytes_per_step = VkDeviceSize(config.defrag_budget_kb) * 1024;
+	// The casters' meshes, for refreshing their placement when the defragmenter moves them
+	std::vector<GeometryHandle> static_caster_meshes;
+	std::vector<GeometryHandle> dynamic_caster_meshes;
+	uint64_t caster_geometry_version = 0;
+	auto place_caster = [&](ShadowCaster &caster, GeometryHandle handle) {
+		const GeometryMesh &mesh = get_geometry(geometry, handle);
+		const GeometryBlock &block = geometry.blocks[mesh.block];
+		caster.vertex_buffer = get_buffer(resources, block.vertices).buffer;
+		caster.index_buffer = get_buffer(resources, block.indices).buffer;
+		caster.vertex_offset = mesh.vertex_offset;
+		caster.first_index = mesh.first_index;
+		caster.index_count = mesh.index_count;
+	};
+	if (config.enable_shadows) {
+		shadow_maps = create_shadow_maps(vk_device, vk_physical_device, resources, 4, 2048);
+
+		VkCommandBuffer upload_cmd_buf = begin_one_time_commands(vk_device, vk_command_pool);
+		auto add_caster = [&](const std::vector<vec3> &positions, const vec3 &color, std::vector<ShadowCaster> &casters,
+				std::vector<GeometryHandle> &meshes)
+		{
+			std::vector<vec3> vertices;
+			std::vector<uint32_t> indices;
+			make_indexed(positions, vertices, indices);
+			meshes.push_back(add_geometry(vk_device, vk_physical_device, geometry, resources,
+					upload_cmd_buf, vertices.data(), vertices.size(), indices.data(), indices.size()));
+
+			ShadowCaster caster;
+			place_caster(caster, meshes.back());
+			compute_bounds(positions, caster.bounds_min, caster.bounds_max);
+			caster.color = color;
+			casters.push_back(caster);
+		};
+		add_caster(make_ground_plane(30.f, 0.f), vec3(0.6f, 0.65f, 0.55f), shadow_maps.static_casters,
+				static_caster_meshes);
+		for (int i = 0; i < 8; ++i) {
+			const float angle = i * 6.2831853f / 8.f;
+			add_caster(make_box(vec3(6.f * std::cos(angle), 1.f, 6.f * std::sin(angle)), vec3(0.5f, 1.f, 0.5f)),
+					vec3(0.75f, 0.7f, 0.6f), shadow_maps.static_casters, static_caster_meshes);
+		}
+		add_caster(make_box(vec3(0.f, 0.f, 0.f), vec3(0.5f, 0.5f, 0.5f)), vec3(0.8f, 0.3f, 0.2f),
+				shadow_maps.dynamic_casters, dynamic_caster_meshes);
+		caster_geometry_version = geometry.version;
+		++shadow_maps.static_version;
+		end_one_time_commands(vk_device, vk_queue, vk_command_pool, upload_cmd_buf);
+		// The upload waited for the queue, so its staging buffers can go
+		flush_released_resources(vk_device, resources);
 	}
 
-	// Now record the rendering commands (TODO: Could also do this pre-recording in the DXR backend
-	// of rtobj. Will there be much perf. difference?)
-	for (size_t i = 0; i < command_buffers.size(); ++i) {
-		auto& cmd_buf = command_buffers[i];
+	// Transparent quads rendered with OIT directly into the swapchain images
+	std::vector<TransparentInstance> transparent_instances;
+	if (config.enable_oit) {
+		transparent_instances = make_transparent_instances(config.num_transparent, 1);
+		std::cout << "Rendering " << config.num_transparent << " transparent quads with " << oit_mode_name(config.oit_mode) << "\n";
+	}
 
-		VkCommandBufferBeginInfo begin_info = {};
-		begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-		CHECK_VULKAN(vkBeginCommandBuffer(cmd_buf, &begin_info));
+	// The font is shared by the profiler HUD and the settings UI. Its pixels are kept for
+	// saving to the snapshot
+	FontAtlasPixels font_pixels;
+	if (!read_snapshot_font_atlas(snapshot, config.font_path, config.font_size, font_pixels)) {
+		font_pixels = rasterize_font_atlas(config.font_path, config.font_size);
+	}
+	FontAtlas font = create_font_atlas(vk_device, vk_physical_device, vk_queue, vk_command_pool, font_pixels);
+	close_snapshot(snapshot);
+
+	GpuProfiler profiler;
+	FrameTimes frame_times;
+	uint32_t shadows_scope = 0;
+	uint32_t scene_scope = 0;
+	uint32_t ui_scope = 0;
+	uint32_t overlay_scope = 0;
+	uint32_t particles_scope = 0;
+	if (config.enable_hud) {
+		profiler = create_gpu_profiler(vk_device, vk_physical_device, vk_queue, graphics_queue_index,
+				vk_command_pool);
+		shadows_scope = add_gpu_scope(profiler, "shadows");
+		scene_scope = add_gpu_scope(profiler, "scene");
+		ui_scope = add_gpu_scope(profiler, "ui");
+		overlay_scope = add_gpu_scope(profiler, "overlay");
+		particles_scope = add_gpu_scope(profiler, "particles");
+	}
 
-		VkRenderPassBeginInfo render_pass_info = {};
-		render_pass_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-		render_pass_info.renderPass = vk_render_pass;
-		render_pass_info.framebuffer = framebuffers[i];
-		render_pass_info.renderArea.offset.x = 0;
-		render_pass_info.renderArea.offset.y = 0;
-		render_pass_info.renderArea.extent = swapchain_extent;
-		
-		VkClearValue clear_color = { 0.f, 0.f, 0.f, 1.f };
-		render_pass_info.clearValueCount = 1;
-		render_pass_info.pClearValues = &clear_color;
+	// The UI's geometry and descriptor sets, and the lit pass's parameters, only live for the
+	// frame, so they come from the frame's region of the ring buffer and the frame's descriptor pool
+	UI ui = create_ui(vk_device, font);
+	FrameRingBuffer frame_ring = create_frame_ring_buffer(vk_device, vk_physical_device, 1 << 20,
+			MAX_FRAMES_IN_FLIGHT, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT
+			| VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT);
+	FrameDescriptorPools frame_desc_pools;
+	{
+		std::vector<VkDescriptorPoolSize> pool_sizes(2);
+		pool_sizes[0].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+		pool_sizes[0].descriptorCount = 16;
+		pool_sizes[1].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+		pool_sizes[1].descriptorCount = 4;
+		frame_desc_pools = create_frame_descriptor_pools(vk_device, MAX_FRAMES_IN_FLIGHT, 16, pool_sizes);
+	}
+	std::vector<FrameContext> frames = create_frame_contexts(vk_device, vk_command_pool, MAX_FRAMES_IN_FLIGHT);
+	SubmitScheduler submit_scheduler = create_submit_scheduler(vk_device, vk_queue, config.submit2);
+
+	// The particles are updated each frame before the scene's rendering, which draws them
+	// indirectly, so the pre-recorded command buffers draw the current particles too
+	ParticleSystem particles;
+	if (config.num_particles > 0) {
+		particles = create_particle_system(vk_device, vk_physical_device, vk_queue, vk_command_pool,
+				config.num_particles);
+	}
+	uint32_t last_ticks = SDL_GetTicks();
+
+	// The virtual textured terrain is drawn under the scene, its pages are streamed in based
+	// on the feedback rendered each frame
+	VirtualTexture virtual_texture;
+	if (config.virtual_texture) {
+		virtual_texture = create_virtual_texture(vk_device, vk_physical_device, vk_queue, vk_command_pool,
+				config.vt, MAX_FRAMES_IN_FLIGHT, config.virtual_texture_sparse);
+	}
 
-		vkCmdBeginRenderPass(cmd_buf, &render_pass_info, VK_SUBPASS_CONTENTS_INLINE);
+	// Everything rendering to the swapchain images, rebuilt when the present mode or MSAA changes
+	Swapchain swapchain;
+	ScenePass scene_pass;
+	// Draws the shadow casters under the scene when shadows are on
+	const bool draw_lit_pass = config.enable_shadows && draw_triangle;
+	LitPass lit_pass;
+	OITRenderer oit;
+	Overlay overlay;
+	std::vector<VkCommandBuffer> command_buffers;
+	// The fence of the frame which last rendered to each swapchain image
+	std::vector<VkFence> images_in_flight;
+
+	// Record the scene rendering to the swapchain image. When a descriptor pool is passed the UI
+	// is drawn in the scene pass, which is only possible when recording each frame
+	auto record_scene_commands = [&](VkCommandBuffer cmd_buf, uint32_t i, VkDescriptorPool ui_desc_pool) {
+		begin_gpu_scope(profiler, cmd_buf, scene_scope);
+		if (config.num_views > 1) {
+			record_multiview_pass(multiview_pass, cmd_buf, swapchain.images[i], swapchain.extent);
+		} else if (config.enable_oit) {
+			record_oit(oit, cmd_buf, i, camera);
+		} else {
+			begin_scene_pass(scene_pass, cmd_buf, i, draw_lit_pass);
+			if (config.virtual_texture) {
+				draw_virtual_texture(virtual_texture, cmd_buf, camera);
+			}
+			draw_scene(scene_pass, cmd_buf);
+			if (config.num_particles > 0) {
+				draw_particles(particles, cmd_buf, camera);
+			}
+			if (ui_desc_pool != VK_NULL_HANDLE) {
+				record_ui(ui, vk_device, cmd_buf, frame_ring, ui_desc_pool, swapchain.extent);
+			}
+			vkCmdEndRenderPass(cmd_buf);
+		}
+		end_gpu_scope(profiler, cmd_buf, scene_scope);
+	};
 
-		vkCmdBindPipeline(cmd_buf, VK_PIPELINE_BIND_POINT_GRAPHICS, vk_pipeline);
+	auto create_swapchain_resources = [&]() {
+		// Mailbox needs a spare image to render to while one is queued
+		uint32_t min_images = settings.present_mode == VK_PRESENT_MODE_MAILBOX_KHR ? 3 : 2;
+		if (config.swapchain_images != 0) {
+			min_images = config.swapchain_images;
+		}
+		swapchain = create_swapchain(vk_device, vk_physical_device, vk_surface, swapchain_extent,
+				swapchain_img_format, settings.present_mode, swapchain_usage, min_images);
+		settings.present_mode = swapchain.present_mode;
+
+		scene_pass = create_scene_pass(vk_device, vk_physical_device, resources, swapchain, settings.msaa_samples,
+				config.clear_color);
+		if (draw_lit_pass) {
+			lit_pass = create_lit_pass(vk_device, vk_physical_device, resources, swapchain, scene_pass);
+		}
+		create_ui_pipeline(vk_device, ui, scene_pass.render_pass, scene_pass.samples, swapchain.extent);
+		if (config.num_particles > 0) {
+			create_particle_pipeline(vk_device, resources, particles, scene_pass.render_pass, scene_pass.samples,
+					swapchain.extent);
+		}
+		if (config.virtual_texture) {
+			create_virtual_texture_pipelines(vk_device, vk_physical_device, virtual_texture,
+					scene_pass.render_pass, scene_pass.samples, swapchain.extent);
+		}
+		if (config.enable_oit) {
+			oit = create_oit_renderer(vk_device, vk_physical_device, resources, config.oit_mode, swapchain.extent,
+					swapchain.format, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR, swapchain.image_views, transparent_instances);
+			// The camera is fixed so the instances are only sorted once, re-sorting each frame
+			// would also overwrite the instances while earlier frames in flight read them
+			sort_transparent_instances(oit, camera);
+		}
+		// The profiler HUD is drawn in the overlay, which is re-recorded each frame in its own
+		// command buffer after the frame's rendering
+		if (config.enable_hud) {
+			overlay = create_overlay(vk_device, vk_physical_device, resources, font, swapchain.extent, swapchain.format,
+					VK_IMAGE_LAYOUT_PRESENT_SRC_KHR, swapchain.image_views, MAX_FRAMES_IN_FLIGHT);
+		}
+		images_in_flight = std::vector<VkFence>(swapchain.images.size(), VK_NULL_HANDLE);
 
-		// Draw our "triangle" embedded in the shader
-		vkCmdDraw(cmd_buf, 3, 1, 0, 0);
+		command_buffers.resize(swapchain.images.size());
+		VkCommandBufferAllocateInfo info = {};
+		info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+		info.commandPool = vk_command_pool;
+		info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+		info.commandBufferCount = command_buffers.size();
+		CHECK_VULKAN(vkAllocateCommandBuffers(vk_device, &info, command_buffers.data()));
 
-		vkCmdEndRenderPass(cmd_buf);
+		// Pre-record the rendering commands for each swapchain image. They're kept up to date
+		// even when recording each frame so switching back doesn't need a rebuild
+		for (size_t i = 0; i < command_buffers.size(); ++i) {
+			VkCommandBufferBeginInfo begin_info = {};
+			begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+			CHECK_VULKAN(vkBeginCommandBuffer(command_buffers[i], &begin_info));
+			record_scene_commands(command_buffers[i], i, VK_NULL_HANDLE);
+			CHECK_VULKAN(vkEndCommandBuffer(command_buffers[i]));
+		}
 
-		CHECK_VULKAN(vkEndCommandBuffer(cmd_buf));
-	}
+		std::cout << "Present mode " << present_mode_name(settings.present_mode)
+			<< ", " << settings.msaa_samples << "x MSAA, " << settings.frames_in_flight << " frames in flight, "
+			<< recording_mode_name(settings.recording_mode) << " recording\n";
+	};
 
-	VkSemaphore img_avail_semaphore = VK_NULL_HANDLE;
-	VkSemaphore render_finished_semaphore = VK_NULL_HANDLE;
-	{
-		VkSemaphoreCreateInfo info = {};
-		info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+	// At shutdown the GPU was already drained with a deadline, otherwise wait for it here, as
+	// the render passes, framebuffers and swapchain are destroyed right away. The passes' images
+	// and pipelines are released to the resource manager, which destroys them once the next
+	// frame completes
+	auto destroy_swapchain_resources = [&](bool drained) {
+		if (!drained) {
+			wait_submit_scheduler_idle(submit_scheduler);
+			CHECK_VULKAN(vkDeviceWaitIdle(vk_device));
+		}
+		complete_all_resource_timeline(vk_device, resources);
+		vkFreeCommandBuffers(vk_device, vk_command_pool, command_buffers.size(), command_buffers.data());
+		command_buffers.clear();
+		if (config.enable_hud) {
+			destroy_overlay(vk_device, resources, overlay);
+		}
+		if (config.enable_oit) {
+			destroy_oit_renderer(vk_device, resources, oit);
+		}
+		if (draw_lit_pass) {
+			destroy_lit_pass(vk_device, resources, lit_pass);
+		}
+		destroy_scene_pass(vk_device, resources, scene_pass);
+		destroy_swapchain(vk_device, swapchain);
+	};
 
-		CHECK_VULKAN(vkCreateSemaphore(vk_device, &info, nullptr, &img_avail_semaphore));
-		CHECK_VULKAN(vkCreateSemaphore(vk_device, &info, nullptr, &render_finished_semaphore));
-	}
+	create_swapchain_resources();
 
-	// We use a fence to wait for the rendering work to finish
-	VkFence vk_fence = VK_NULL_HANDLE;
-	{
-		VkFenceCreateInfo info = {};
-		info.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
-		CHECK_VULKAN(vkCreateFence(vk_device, &info, nullptr, &vk_fence));
+	FrameOutput frame_output;
+	if (!config.output_target.empty()) {
+		frame_output = create_frame_output(vk_device, vk_physical_device, config.output_target, swapchain.extent,
+				MAX_FRAMES_IN_FLIGHT);
 	}
 
 	std::cout << "Running loop\n";
+	UIInput ui_input;
+	uint32_t frame_index = 0;
+	bool first_frame_presented = false;
 	bool done = false;
 	while (!done) {
+		record_frame_time(frame_times);
+
 		SDL_Event event;
 		while (SDL_PollEvent(&event)) {
 			if (event.type == SDL_QUIT) {
@@ -472,72 +880,354 @@ int main(int argc, const char **argv) {
 			if (event.type == SDL_KEYDOWN && event.key.keysym.sym == SDLK_ESCAPE) {
 				done = true;
 			}
+			if (event.type == SDL_KEYDOWN && event.key.keysym.sym == SDLK_F1) {
+				config.show_ui = !config.show_ui;
+			}
+			if (event.type == SDL_MOUSEMOTION) {
+				ui_input.mouse_x = event.motion.x;
+				ui_input.mouse_y = event.motion.y;
+			}
+			if ((event.type == SDL_MOUSEBUTTONDOWN || event.type == SDL_MOUSEBUTTONUP)
+					&& event.button.button == SDL_BUTTON_LEFT) {
+				ui_input.mouse_down = event.type == SDL_MOUSEBUTTONDOWN;
+			}
 			if (event.type == SDL_WINDOWEVENT && event.window.event == SDL_WINDOWEVENT_CLOSE
 					&& event.window.windowID == SDL_GetWindowID(window)) {
 				done = true;
 			}
 		}
 
-		// Get an image from the swap chain
+		// Wait for the frame's previous use to finish before reusing its command buffers,
+		// semaphores and its regions of the ring and overlay buffers
+		FrameContext &frame = frames[frame_index];
+		CHECK_VULKAN(vkWaitForFences(vk_device, 1, &frame.fence, true, std::numeric_limits<uint64_t>::max()));
+		complete_resource_timeline(vk_device, resources, frame.timeline_value);
+		collect_geometry_frees(geometry, resources);
+		if (!config.output_target.empty()) {
+			frame_output_begin_frame(frame_output, frame_index);
+		}
+		update_gpu_profiler(vk_device, profiler);
+
+		// Get an image from the swap chain. The submission thread may still be submitting and
+		// presenting the previous frames, only the acquire is serialized against its presents
 		uint32_t img_index = 0;
-		CHECK_VULKAN(vkAcquireNextImageKHR(vk_device, vk_swapchain, std::numeric_limits<uint64_t>::max(),
-			img_avail_semaphore, VK_NULL_HANDLE, &img_index));
+		CHECK_VULKAN(acquire_next_image(submit_scheduler, vk_device, swapchain.swapchain,
+			frame.img_avail_semaphore, img_index));
+
+		// The image's pre-recorded command buffer can't be resubmitted until the frame which
+		// last rendered to the image is done
+		if (images_in_flight[img_index] != VK_NULL_HANDLE && images_in_flight[img_index] != frame.fence) {
+			CHECK_VULKAN(vkWaitForFences(vk_device, 1, &images_in_flight[img_index], true,
+					std::numeric_limits<uint64_t>::max()));
+		}
+		images_in_flight[img_index] = frame.fence;
+		CHECK_VULKAN(vkResetFences(vk_device, 1, &frame.fence));
+
+		ring_begin_frame(frame_ring, frame_index);
+		VkDescriptorPool frame_desc_pool = begin_frame_descriptor_pool(vk_device, frame_desc_pools, frame_index);
+
+		// Settings changed in the UI are applied once the frame is submitted
+		RenderSettings requested = settings;
+		ui_begin_frame(ui, ui_input);
+		if (config.show_ui) {
+			ui_begin_panel(ui, "Settings (F1)", swapchain.extent.width - 328.f, 8.f, 320.f);
+			if (ui_cycle(ui, "present mode", present_mode_name(settings.present_mode))) {
+				auto it = std::find(present_modes.begin(), present_modes.end(), settings.present_mode);
+				requested.present_mode = it == present_modes.end() || it + 1 == present_modes.end()
+					? present_modes.front() : *(it + 1);
+			}
+			if (draw_triangle) {
+				const std::string msaa = std::to_string(settings.msaa_samples) + "x";
+				if (ui_cycle(ui, "msaa", msaa.c_str())) {
+					requested.msaa_samples = settings.msaa_samples >= max_msaa_samples
+						? VK_SAMPLE_COUNT_1_BIT : VkSampleCountFlagBits(settings.msaa_samples << 1);
+				}
+			}
+			const std::string num_frames = std::to_string(settings.frames_in_flight);
+			if (ui_cycle(ui, "frames in flight", num_frames.c_str())) {
+				requested.frames_in_flight = settings.frames_in_flight % MAX_FRAMES_IN_FLIGHT + 1;
+			}
+			if (ui_cycle(ui, "recording", recording_mode_name(settings.recording_mode))) {
+				requested.recording_mode = settings.recording_mode == RecordingMode::PRERECORDED
+					? RecordingMode::PER_FRAME : RecordingMode::PRERECORDED;
+			}
+			std::array<char, 64> text = {};
+			std::snprintf(text.data(), text.size(), "frame %.2f ms", average_frame_time(frame_times));
+			ui_label(ui, text.data());
+			ui_end_panel(ui);
+		}
+
+		// Only the cascades whose bounds or contents changed are rendered, when nothing
+		// changed the shadow maps from the previous frame are reused as is
+		// The uploads and compute work are scheduled ahead of the rendering, which is the
+		// only batch waiting for the swapchain image
+		SubmitBatch render_batch;
+		VkSemaphore vt_bind_semaphore = VK_NULL_HANDLE;
+		if (config.virtual_texture) {
+			VkCommandBufferBeginInfo begin_info = {};
+			begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+			begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+			CHECK_VULKAN(vkBeginCommandBuffer(frame.virtual_texture_command_buffer, &begin_info));
+			vt_bind_semaphore = update_virtual_texture(virtual_texture, submit_scheduler,
+					frame.virtual_texture_command_buffer, frame_index);
+			record_virtual_texture_feedback(virtual_texture, frame.virtual_texture_command_buffer, frame_index,
+					camera);
+			CHECK_VULKAN(vkEndCommandBuffer(frame.virtual_texture_command_buffer));
+
+			// The uploads wait for the page binds
+			SubmitBatch upload_batch;
+			upload_batch.command_buffers.push_back(frame.virtual_texture_command_buffer);
+			if (vt_bind_semaphore != VK_NULL_HANDLE) {
+				upload_batch.waits.push_back({ vt_bind_semaphore, VK_PIPELINE_STAGE_TRANSFER_BIT });
+			}
+			schedule_submit(submit_scheduler, upload_batch);
+		}
+		if (config.num_particles > 0) {
+			// Clamp the step so a long stall doesn't launch the whole fountain at once
+			const uint32_t ticks = SDL_GetTicks();
+			const float dt = std::min((ticks - last_ticks) / 1000.f, 0.1f);
+			last_ticks = ticks;
+
+			VkCommandBufferBeginInfo begin_info = {};
+			begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+			begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+			CHECK_VULKAN(vkBeginCommandBuffer(frame.particle_command_buffer, &begin_info));
+			begin_gpu_scope(profiler, frame.particle_command_buffer, particles_scope);
+			record_particle_update(particles, frame.particle_command_buffer, dt);
+			end_gpu_scope(profiler, frame.particle_command_buffer, particles_scope);
+			CHECK_VULKAN(vkEndCommandBuffer(frame.particle_command_buffer));
+			SubmitBatch compute_batch;
+			compute_batch.command_buffers.push_back(frame.particle_command_buffer);
+			schedule_submit(submit_scheduler, compute_batch);
+		}
+		if (config.enable_shadows) {
+			const float t = SDL_GetTicks() / 1000.f;
+			ShadowCaster &orbiter = shadow_maps.dynamic_casters[0];
+			orbiter.transform = rotate_y(t) * translate(vec3(3.f, 1.5f, 0.f));
+			const vec3 orbiter_center = transform_point(orbiter.transform, vec3(0.f, 0.f, 0.f));
+			orbiter.bounds_min = orbiter_center - vec3(0.87f, 0.87f, 0.87f);
+			orbiter.bounds_max = orbiter_center + vec3(0.87f, 0.87f, 0.87f);
+
+			update_shadow_cascades(shadow_maps, camera, light_dir);
+			// The defragmenter's copies go ahead of the shadow passes drawing the moved meshes.
+			// Moving them doesn't change what's drawn, so the cached cascades stay valid
+			const bool defragment = config.defrag_budget_kb > 0
+				&& geometry_defrag_pending(geometry_defrag, geometry);
+			if (shadow_maps_need_update(shadow_maps) || defragment) {
+				VkCommandBufferBeginInfo begin_info = {};
+				begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+				begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+				CHECK_VULKAN(vkBeginCommandBuffer(frame.shadow_command_buffer, &begin_info));
+				if (defragment) {
+					defragment_geometry_step(geometry_defrag, geometry, resources, frame.shadow_command_buffer);
+				}
+				if (geometry.version != caster_geometry_version) {
+					for (size_t i = 0; i < static_caster_meshes.size(); ++i) {
+						place_caster(shadow_maps.static_casters[i], static_caster_meshes[i]);
+					}
+					for (size_t i = 0; i < dynamic_caster_meshes.size(); ++i) {
+						place_caster(shadow_maps.dynamic_casters[i], dynamic_caster_meshes[i]);
+					}
+					caster_geometry_version = geometry.version;
+				}
+				begin_gpu_scope(profiler, frame.shadow_command_buffer, shadows_scope);
+				record_shadow_maps(shadow_maps, frame.shadow_command_buffer);
+				end_gpu_scope(profiler, frame.shadow_command_buffer, shadows_scope);
+				CHECK_VULKAN(vkEndCommandBuffer(frame.shadow_command_buffer));
+				SubmitBatch shadow_batch;
+				shadow_batch.command_buffers.push_back(frame.shadow_command_buffer);
+				schedule_submit(submit_scheduler, shadow_batch);
+			}
+		}
+
+		// When recording each frame the UI is drawn in the scene pass, otherwise it's drawn
+		// over the rendered frame in a pass loading the swapchain image
+		const bool ui_in_scene_pass = config.show_ui && draw_triangle && settings.recording_mode == RecordingMode::PER_FRAME;
+		// The lit casters move each frame, so they're recorded each frame whatever the recording
+		// mode, and the scene pass loads their rendering
+		if (draw_lit_pass) {
+			VkCommandBufferBeginInfo begin_info = {};
+			begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+			begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+			CHECK_VULKAN(vkBeginCommandBuffer(frame.lit_command_buffer, &begin_info));
+			record_lit_pass(lit_pass, shadow_maps, vk_device, frame.lit_command_buffer, img_index, camera, light_dir,
+					frame_ring, frame_desc_pool);
+			CHECK_VULKAN(vkEndCommandBuffer(frame.lit_command_buffer));
+			render_batch.command_buffers.push_back(frame.lit_command_buffer);
+		}
+		if (settings.recording_mode == RecordingMode::PER_FRAME) {
+			VkCommandBufferBeginInfo begin_info = {};
+			begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+			begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+			CHECK_VULKAN(vkBeginCommandBuffer(frame.command_buffer, &begin_info));
+			record_scene_commands(frame.command_buffer, img_index, ui_in_scene_pass ? frame_desc_pool : VK_NULL_HANDLE);
+			CHECK_VULKAN(vkEndCommandBuffer(frame.command_buffer));
+			render_batch.command_buffers.push_back(frame.command_buffer);
+		} else {
+			render_batch.command_buffers.push_back(command_buffers[img_index]);
+		}
+
+		if (config.show_ui && !ui_in_scene_pass) {
+			VkCommandBufferBeginInfo begin_info = {};
+			begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+			begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+			CHECK_VULKAN(vkBeginCommandBuffer(frame.ui_command_buffer, &begin_info));
+			begin_gpu_scope(profiler, frame.ui_command_buffer, ui_scope);
+			begin_scene_pass(scene_pass, frame.ui_command_buffer, img_index, true);
+			record_ui(ui, vk_device, frame.ui_command_buffer, frame_ring, frame_desc_pool, swapchain.extent);
+			vkCmdEndRenderPass(frame.ui_command_buffer);
+			end_gpu_scope(profiler, frame.ui_command_buffer, ui_scope);
+			CHECK_VULKAN(vkEndCommandBuffer(frame.ui_command_buffer));
+			render_batch.command_buffers.push_back(frame.ui_command_buffer);
+		}
+
+		if (config.enable_hud) {
+			overlay_begin_frame(overlay, frame_index);
+			draw_profiler_hud(overlay, frame_times, profiler);
+
+			VkCommandBufferBeginInfo begin_info = {};
+			begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+			begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+			CHECK_VULKAN(vkBeginCommandBuffer(frame.overlay_command_buffer, &begin_info));
+			begin_gpu_scope(profiler, frame.overlay_command_buffer, overlay_scope);
+			record_overlay(overlay, frame.overlay_command_buffer, img_index);
+			end_gpu_scope(profiler, frame.overlay_command_buffer, overlay_scope);
+			CHECK_VULKAN(vkEndCommandBuffer(frame.overlay_command_buffer));
+			render_batch.command_buffers.push_back(frame.overlay_command_buffer);
+		}
+
+		if (!config.output_target.empty()) {
+			VkCommandBufferBeginInfo begin_info = {};
+			begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+			begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+			CHECK_VULKAN(vkBeginCommandBuffer(frame.output_command_buffer, &begin_info));
+			record_frame_output(frame_output, frame.output_command_buffer, frame_index, swapchain.images[img_index]);
+			CHECK_VULKAN(vkEndCommandBuffer(frame.output_command_buffer));
+			render_batch.command_buffers.push_back(frame.output_command_buffer);
+		}
 
 		// We need to wait for the image before we can run the commands to draw to it, and signal
-		// the render finished one when we're done
-		const std::array<VkSemaphore, 1> wait_semaphores = { img_avail_semaphore };
-		const std::array<VkSemaphore, 1> signal_semaphores = { render_finished_semaphore };
-		const std::array<VkPipelineStageFlags, 1> wait_stages = { VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT };
-
-		CHECK_VULKAN(vkResetFences(vk_device, 1, &vk_fence));
-		
-		VkSubmitInfo submit_info = {};
-		submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-		submit_info.waitSemaphoreCount = wait_semaphores.size();
-		submit_info.pWaitSemaphores = wait_semaphores.data();
-		submit_info.pWaitDstStageMask = wait_stages.data();
-		submit_info.commandBufferCount = 1;
-		submit_info.pCommandBuffers = &command_buffers[img_index];
-		submit_info.signalSemaphoreCount = signal_semaphores.size();
-		submit_info.pSignalSemaphores = signal_semaphores.data();
-		CHECK_VULKAN(vkQueueSubmit(vk_queue, 1, &submit_info, vk_fence));
-
-		// Finally, present the updated image in the swap chain
-		std::array<VkSwapchainKHR, 1> present_chain = { vk_swapchain };
-		VkPresentInfoKHR present_info = {};
-		present_info.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
-		present_info.waitSemaphoreCount = signal_semaphores.size();
-		present_info.pWaitSemaphores = signal_semaphores.data();
-		present_info.swapchainCount = present_chain.size();
-		present_info.pSwapchains = present_chain.data();
-		present_info.pImageIndices = &img_index;
-		CHECK_VULKAN(vkQueuePresentKHR(vk_queue, &present_info));
-
-		// Wait for the frame to finish
-		CHECK_VULKAN(vkWaitForFences(vk_device, 1, &vk_fence, true, std::numeric_limits<uint64_t>::max()));
-	}
-
-	vkDestroySemaphore(vk_device, img_avail_semaphore, nullptr);
-	vkDestroySemaphore(vk_device, render_finished_semaphore, nullptr);
-	vkDestroyFence(vk_device, vk_fence, nullptr);
+		// the render finished one when we're done. The fence ends the frame's submission call,
+		// so it covers the earlier batches too
+		render_batch.waits.push_back({ frame.img_avail_semaphore, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT });
+		render_batch.signals.push_back(frame.render_finished_semaphore);
+		render_batch.fence = frame.fence;
+		schedule_submit(submit_scheduler, render_batch);
+		frame.timeline_value = submit_resource_timeline(resources);
+
+		// Finally, present the updated image in the swap chain, which also hands the frame's
+		// work to the submission thread
+		schedule_present(submit_scheduler, swapchain.swapchain, img_index, frame.render_finished_semaphore);
+		// The present is made on the submission thread, so it's reported once the thread has made it
+		if (!first_frame_presented) {
+			const auto first_present = submit_scheduler_stats(submit_scheduler).first_present;
+			if (first_present != std::chrono::steady_clock::time_point()) {
+				std::cout << "First frame presented "
+					<< std::chrono::duration_cast<std::chrono::milliseconds>(first_present - startup_time).count()
+					<< "ms after startup\n";
+				first_frame_presented = true;
+			}
+		}
+
+		frame_index = (frame_index + 1) % settings.frames_in_flight;
+
+		// Changing the present mode or MSAA rebuilds everything rendering to the swapchain,
+		// the other settings only need the frames in flight to finish
+		if (requested.present_mode != settings.present_mode || requested.msaa_samples != settings.msaa_samples) {
+			destroy_swapchain_resources(false);
+			if (!config.output_target.empty()) {
+				flush_frame_output(frame_output);
+			}
+			settings = requested;
+			create_swapchain_resources();
+			frame_index = 0;
+		} else if (requested.frames_in_flight != settings.frames_in_flight
+				|| requested.recording_mode != settings.recording_mode)
+		{
+			wait_submit_scheduler_idle(submit_scheduler);
+			CHECK_VULKAN(vkDeviceWaitIdle(vk_device));
+			complete_all_resource_timeline(vk_device, resources);
+			if (!config.output_target.empty()) {
+				flush_frame_output(frame_output);
+			}
+			settings = requested;
+			frame_index = 0;
+			std::cout << settings.frames_in_flight << " frames in flight, "
+				<< recording_mode_name(settings.recording_mode) << " recording\n";
+		}
+	}
+
+	// Drain the GPU once before tearing anything down, with a deadline so a hung GPU doesn't
+	// hang the shutdown too. Everything after only destroys objects the GPU is done with
+	{
+		wait_submit_scheduler_idle(submit_scheduler);
+		const SubmitSchedulerStats submit_stats = submit_scheduler_stats(submit_scheduler);
+		const bool used_submit2 = submit_scheduler.use_submit2;
+		destroy_submit_scheduler(submit_scheduler);
+		std::cout << "Submissions: " << submit_stats.batches << " batches in " << submit_stats.submit_calls
+			<< (used_submit2 ? " vkQueueSubmit2 calls, " : " vkQueueSubmit calls, ") << submit_stats.submit_infos
+			<< " submit infos, " << submit_stats.binds << " sparse binds, " << submit_stats.presents
+			<< " presents\n";
+
+		if (!drain_queue(vk_device, vk_queue, shutdown_timeout_ns)) {
+			SDL_DestroyWindow(window);
+			SDL_Quit();
+			return 1;
+		}
+	}
+	destroy_swapchain_resources(true);
+	if (!config.output_target.empty()) {
+		destroy_frame_output(vk_device, frame_output);
+	}
+	if (config.enable_shadows) {
+		std::cout << "Shadow cascades: " << shadow_maps.static_cascade_renders << " static renders, "
+			<< shadow_maps.shadow_cascade_updates << " updates\n";
+		print_geometry_pool_stats(geometry);
+		print_geometry_defrag_stats(geometry_defrag);
+		destroy_shadow_maps(vk_device, resources, shadow_maps);
+		destroy_geometry_pool(geometry, resources);
+	}
+	if (config.enable_hud) {
+		destroy_gpu_profiler(vk_device, profiler);
+	}
+	if (config.num_particles > 0) {
+		destroy_particle_system(vk_device, resources, particles);
+	}
+	if (config.virtual_texture) {
+		const VirtualTextureStats &stats = virtual_texture.stats;
+		std::cout << "Virtual texture: " << stats.pages_requested << " pages requested, "
+			<< stats.pages_uploaded << " uploaded, " << stats.pages_evicted << " evicted\n";
+		destroy_virtual_texture(vk_device, virtual_texture);
+	}
+	destroy_frame_contexts(vk_device, vk_command_pool, frames);
+	destroy_frame_descriptor_pools(vk_device, frame_desc_pools);
+	destroy_frame_ring_buffer(vk_device, frame_ring);
+	destroy_ui(vk_device, ui);
+	destroy_font_atlas(vk_device, font);
 	vkDestroyCommandPool(vk_device, vk_command_pool, nullptr);
-	vkDestroySwapchainKHR(vk_device, vk_swapchain, nullptr);
-	for (auto &fb : framebuffers) {
-		vkDestroyFramebuffer(vk_device, fb, nullptr);
-	}
-	vkDestroyPipeline(vk_device, vk_pipeline, nullptr);
-	vkDestroyRenderPass(vk_device, vk_render_pass, nullptr);
-	vkDestroyPipelineLayout(vk_device, vk_pipeline_layout, nullptr);
-	for (auto &v : swapchain_image_views) {
-		vkDestroyImageView(vk_device, v, nullptr);
-	}	
-	vkDestroySurfaceKHR(vk_instance, vk_surface, nullptr);
-	vkDestroyDevice(vk_device, nullptr);
-	vkDestroyInstance(vk_instance, nullptr);
+	if (config.num_views > 1) {
+		destroy_multiview_pass(vk_device, multiview_pass);
+	}
+	{
+		const ObjectCacheStats &stats = object_cache_stats();
+		std::cout << "Object cache: " << stats.samplers_created << " samplers created, " << stats.sampler_hits
+			<< " reused, " << stats.image_views_created << " image views created, " << stats.image_view_hits
+			<< " reused\n";
+	}
+	if (!config.snapshot_path.empty()) {
+		SnapshotContents contents;
+		contents.device = current_device;
+		contents.pipeline_cache = pipeline_cache_data(vk_device);
+		contents.font_path = config.font_path;
+		contents.font_size = config.font_size;
+		contents.font = &font_pixels;
+		write_snapshot(config.snapshot_path, contents);
+	}
+	const bool drained = shutdown_vulkan(vk_instance, vk_surface, vk_device, VK_NULL_HANDLE, &resources,
+			shutdown_timeout_ns);
 
 	SDL_DestroyWindow(window);
 	SDL_Quit();
 
-	return 0;
+	return drained ? 0 : 1;
 }
-
@@ -0,0 +1,289 @@
+#include <array>
+#include "multiview.h"
+#include "spirv_shaders_embedded_spv.h"
+
+struct ViewParams {
+	uint32_t num_views;
+	float view_separation;
+};
+
+bool multiview_supported(VkPhysicalDevice physical_device, uint32_t num_views) {
+	VkPhysicalDeviceMultiviewFeatures multiview_features = {};
+	multiview_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MULTIVIEW_FEATURES;
+
+	VkPhysicalDeviceFeatures2 features = {};
+	features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+	features.pNext = &multiview_features;
+	vkGetPhysicalDeviceFeatures2(physical_device, &features);
+
+	VkPhysicalDeviceMultiviewProperties multiview_props = {};
+	multiview_props.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MULTIVIEW_PROPERTIES;
+
+	VkPhysicalDeviceProperties2 props = {};
+	props.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+	props.pNext = &multiview_props;
+	vkGetPhysicalDeviceProperties2(physical_device, &props);
+
+	std::cout << "Multiview supported: " << (multiview_features.multiview ? "yes" : "no")
+		<< ", max views: " << multiview_props.maxMultiviewViewCount << "\n";
+	return multiview_features.multiview && num_views <= multiview_props.maxMultiviewViewCount;
+}
+
+MultiviewPass create_multiview_pass(VkDevice device, VkPhysicalDevice physical_device,
+		uint32_t num_views, VkExtent2D view_extent, VkFormat format, const std::array<float, 4> &clear_color)
+{
+	MultiviewPass pass;
+	pass.num_views = num_views;
+	pass.view_extent = view_extent;
+	for (size_t i = 0; i < clear_color.size(); ++i) {
+		pass.clear_value.color.float32[i] = clear_color[i];
+	}
+	pass.color_target = create_image(device, physical_device, view_extent, num_views, format,
+			VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT, VK_IMAGE_ASPECT_COLOR_BIT);
+
+	// The render pass writes all views in the single subpass, and leaves the layers ready to blit
+	{
+		VkAttachmentDescription color_attachment = {};
+		color_attachment.format = format;
+		color_attachment.samples = VK_SAMPLE_COUNT_1_BIT;
+		color_attachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+		color_attachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+		color_attachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+		color_attachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+		color_attachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		color_attachment.finalLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+
+		VkAttachmentReference color_attachment_ref = {};
+		color_attachment_ref.attachment = 0;
+		color_attachment_ref.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+		VkSubpassDescription subpass = {};
+		subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+		subpass.colorAttachmentCount = 1;
+		subpass.pColorAttachments = &color_attachment_ref;
+
+		// The previous frame's blit must finish reading the layers before we clear them again
+		std::array<VkSubpassDependency, 2> dependencies = {};
+		dependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
+		dependencies[0].dstSubpass = 0;
+		dependencies[0].srcStageMask = VK_PIPELINE_STAGE_TRANSFER_BIT;
+		dependencies[0].dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+		dependencies[0].srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+		dependencies[0].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+
+		dependencies[1].srcSubpass = 0;
+		dependencies[1].dstSubpass = VK_SUBPASS_EXTERNAL;
+		dependencies[1].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+		dependencies[1].dstStageMask = VK_PIPELINE_STAGE_TRANSFER_BIT;
+		dependencies[1].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+		dependencies[1].dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+
+		// Broadcast the subpass to every layer, and tell the driver the views are spatially
+		// correlated so it can share work between them
+		const uint32_t view_mask = (1u << num_views) - 1;
+		VkRenderPassMultiviewCreateInfo multiview_info = {};
+		multiview_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_MULTIVIEW_CREATE_INFO;
+		multiview_info.subpassCount = 1;
+		multiview_info.pViewMasks = &view_mask;
+		multiview_info.correlationMaskCount = 1;
+		multiview_info.pCorrelationMasks = &view_mask;
+
+		VkRenderPassCreateInfo render_pass_info = {};
+		render_pass_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+		render_pass_info.pNext = &multiview_info;
+		render_pass_info.attachmentCount = 1;
+		render_pass_info.pAttachments = &color_attachment;
+		render_pass_info.subpassCount = 1;
+		render_pass_info.pSubpasses = &subpass;
+		render_pass_info.dependencyCount = dependencies.size();
+		render_pass_info.pDependencies = dependencies.data();
+		CHECK_VULKAN(vkCreateRenderPass(device, &render_pass_info, nullptr, &pass.render_pass));
+	}
+
+	// With multiview the framebuffer has a single layer, the view mask selects the image layers
+	{
+		VkFramebufferCreateInfo create_info = {};
+		create_info.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+		create_info.renderPass = pass.render_pass;
+		create_info.attachmentCount = 1;
+		create_info.pAttachments = &pass.color_target.view;
+		create_info.width = view_extent.width;
+		create_info.height = view_extent.height;
+		create_info.layers = 1;
+		CHECK_VULKAN(vkCreateFramebuffer(device, &create_info, nullptr, &pass.framebuffer));
+	}
+
+	{
+		VkShaderModule vertex_shader_module = create_shader_module(device, multiview_spv, sizeof(multiview_spv));
+		VkShaderModule fragment_shader_module = create_shader_module(device, frag_spv, sizeof(frag_spv));
+
+		VkPipelineShaderStageCreateInfo vertex_stage = {};
+		vertex_stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+		vertex_stage.stage = VK_SHADER_STAGE_VERTEX_BIT;
+		vertex_stage.module = vertex_shader_module;
+		vertex_stage.pName = "main";
+
+		VkPipelineShaderStageCreateInfo fragment_stage = {};
+		fragment_stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+		fragment_stage.stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+		fragment_stage.module = fragment_shader_module;
+		fragment_stage.pName = "main";
+
+		std::array<VkPipelineShaderStageCreateInfo, 2> shader_stages = { vertex_stage, fragment_stage };
+
+		VkPipelineVertexInputStateCreateInfo vertex_input_info = {};
+		vertex_input_info.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+
+		VkPipelineInputAssemblyStateCreateInfo input_assembly = {};
+		input_assembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+		input_assembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+		input_assembly.primitiveRestartEnable = VK_FALSE;
+
+		VkViewport viewport = {};
+		viewport.x = 0.0f;
+		viewport.y = 0.0f;
+		viewport.width = view_extent.width;
+		viewport.height = view_extent.height;
+		viewport.minDepth = 0.0f;
+		viewport.maxDepth = 1.0f;
+
+		VkRect2D scissor = {};
+		scissor.extent = view_extent;
+
+		VkPipelineViewportStateCreateInfo viewport_state_info = {};
+		viewport_state_info.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+		viewport_state_info.viewportCount = 1;
+		viewport_state_info.pViewports = &viewport;
+		viewport_state_info.scissorCount = 1;
+		viewport_state_info.pScissors = &scissor;
+
+		VkPipelineRasterizationStateCreateInfo rasterizer_info = {};
+		rasterizer_info.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+		rasterizer_info.depthClampEnable = VK_FALSE;
+		rasterizer_info.rasterizerDiscardEnable = VK_FALSE;
+		rasterizer_info.polygonMode = VK_POLYGON_MODE_FILL;
+		rasterizer_info.lineWidth = 1.f;
+		rasterizer_info.cullMode = VK_CULL_MODE_BACK_BIT;
+		rasterizer_info.frontFace = VK_FRONT_FACE_CLOCKWISE;
+		rasterizer_info.depthBiasEnable = VK_FALSE;
+
+		VkPipelineMultisampleStateCreateInfo multisampling = {};
+		multisampling.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+		multisampling.sampleShadingEnable = VK_FALSE;
+		multisampling.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+
+		VkPipelineColorBlendAttachmentState blend_mode = {};
+		blend_mode.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+		blend_mode.blendEnable = VK_FALSE;
+
+		VkPipelineColorBlendStateCreateInfo blend_info = {};
+		blend_info.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+		blend_info.logicOpEnable = VK_FALSE;
+		blend_info.attachmentCount = 1;
+		blend_info.pAttachments = &blend_mode;
+
+		VkPushConstantRange push_constants = {};
+		push_constants.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+		push_constants.offset = 0;
+		push_constants.size = sizeof(ViewParams);
+
+		VkPipelineLayoutCreateInfo pipeline_info = {};
+		pipeline_info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+		pipeline_info.pushConstantRangeCount = 1;
+		pipeline_info.pPushConstantRanges = &push_constants;
+		CHECK_VULKAN(vkCreatePipelineLayout(device, &pipeline_info, nullptr, &pass.pipeline_layout));
+
+		VkGraphicsPipelineCreateInfo graphics_pipeline_info = {};
+		graphics_pipeline_info.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+		graphics_pipeline_info.stageCount = shader_stages.size();
+		graphics_pipeline_info.pStages = shader_stages.data();
+		graphics_pipeline_info.pVertexInputState = &vertex_input_info;
+		graphics_pipeline_info.pInputAssemblyState = &input_assembly;
+		graphics_pipeline_info.pViewportState = &viewport_state_info;
+		graphics_pipeline_info.pRasterizationState = &rasterizer_info;
+		graphics_pipeline_info.pMultisampleState = &multisampling;
+		graphics_pipeline_info.pColorBlendState = &blend_info;
+		graphics_pipeline_info.layout = pass.pipeline_layout;
+		graphics_pipeline_info.renderPass = pass.render_pass;
+		graphics_pipeline_info.subpass = 0;
+		CHECK_VULKAN(vkCreateGraphicsPipelines(device, pipeline_cache(), 1, &graphics_pipeline_info, nullptr, &pass.pipeline));
+
+		vkDestroyShaderModule(device, vertex_shader_module, nullptr);
+		vkDestroyShaderModule(device, fragment_shader_module, nullptr);
+	}
+	return pass;
+}
+
+void record_multiview_pass(const MultiviewPass &pass, VkCommandBuffer cmd_buf,
+		VkImage swapchain_image, VkExtent2D swapchain_extent)
+{
+	VkRenderPassBeginInfo render_pass_info = {};
+	render_pass_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+	render_pass_info.renderPass = pass.render_pass;
+	render_pass_info.framebuffer = pass.framebuffer;
+	render_pass_info.renderArea.offset.x = 0;
+	render_pass_info.renderArea.offset.y = 0;
+	render_pass_info.renderArea.extent = pass.view_extent;
+
+	render_pass_info.clearValueCount = 1;
+	render_pass_info.pClearValues = &pass.clear_value;
+
+	vkCmdBeginRenderPass(cmd_buf, &render_pass_info, VK_SUBPASS_CONTENTS_INLINE);
+
+	vkCmdBindPipeline(cmd_buf, VK_PIPELINE_BIND_POINT_GRAPHICS, pass.pipeline);
+
+	ViewParams params = {};
+	params.num_views = pass.num_views;
+	params.view_separation = 0.1f;
+	vkCmdPushConstants(cmd_buf, pass.pipeline_layout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(ViewParams), &params);
+
+	// One draw, broadcast to every view by the render pass view mask
+	vkCmdDraw(cmd_buf, 3, 1, 0, 0);
+
+	vkCmdEndRenderPass(cmd_buf);
+
+	image_barrier(cmd_buf, swapchain_image, VK_IMAGE_ASPECT_COLOR_BIT,
+			VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+			0, VK_ACCESS_TRANSFER_WRITE_BIT,
+			VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+
+	// Lay the views out side by side across the swapchain image
+	const int32_t dst_width = swapchain_extent.width / pass.num_views;
+	for (uint32_t i = 0; i < pass.num_views; ++i) {
+		VkImageBlit blit = {};
+		blit.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		blit.srcSubresource.mipLevel = 0;
+		blit.srcSubresource.baseArrayLayer = i;
+		blit.srcSubresource.layerCount = 1;
+		blit.srcOffsets[1].x = pass.view_extent.width;
+		blit.srcOffsets[1].y = pass.view_extent.height;
+		blit.srcOffsets[1].z = 1;
+
+		blit.dstSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		blit.dstSubresource.mipLevel = 0;
+		blit.dstSubresource.baseArrayLayer = 0;
+		blit.dstSubresource.layerCount = 1;
+		blit.dstOffsets[0].x = i * dst_width;
+		blit.dstOffsets[1].x = (i + 1) * dst_width;
+		blit.dstOffsets[1].y = swapchain_extent.height;
+		blit.dstOffsets[1].z = 1;
+
+		vkCmdBlitImage(cmd_buf, pass.color_target.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+				swapchain_image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &blit, VK_FILTER_LINEAR);
+	}
+
+	image_barrier(cmd_buf, swapchain_image, VK_IMAGE_ASPECT_COLOR_BIT,
+			VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
+			VK_ACCESS_TRANSFER_WRITE_BIT, 0,
+			VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT);
+}
+
+void destroy_multiview_pass(VkDevice device, MultiviewPass &pass) {
+	vkDestroyPipeline(device, pass.pipeline, nullptr);
+	vkDestroyPipelineLayout(device, pass.pipeline_layout, nullptr);
+	vkDestroyFramebuffer(device, pass.framebuffer, nullptr);
+	vkDestroyRenderPass(device, pass.render_pass, nullptr);
+	destroy_image(device, pass.color_target);
+	pass = MultiviewPass();
+}
+
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <array>
+#include <vulkan/vulkan.h>
+#include "vulkan_utils.h"
+
+// Renders a single draw stream into several layers of an array image in one pass using
+// multiview (VK_KHR_multiview, core in Vulkan 1.1). The views are then blitted side by side
+// into the swapchain image for display, e.g. the left and right eyes of a stereo pair.
+struct MultiviewPass {
+	uint32_t num_views = 0;
+	VkExtent2D view_extent = {};
+	VkClearValue clear_value = {};
+	Image color_target;
+	VkRenderPass render_pass = VK_NULL_HANDLE;
+	VkFramebuffer framebuffer = VK_NULL_HANDLE;
+	VkPipelineLayout pipeline_layout = VK_NULL_HANDLE;
+	VkPipeline pipeline = VK_NULL_HANDLE;
+};
+
+// Check if the device supports multiview rendering with the requested number of views
+bool multiview_supported(VkPhysicalDevice physical_device, uint32_t num_views);
+
+MultiviewPass create_multiview_pass(VkDevice device, VkPhysicalDevice physical_device,
+		uint32_t num_views, VkExtent2D view_extent, VkFormat format, const std::array<float, 4> &clear_color);
+
+// Record the multiview pass and the blits of each view into the swapchain image, leaving
+// the swapchain image in the present layout
+void record_multiview_pass(const MultiviewPass &pass, VkCommandBuffer cmd_buf,
+		VkImage swapchain_image, VkExtent2D swapchain_extent);
+
+void destroy_multiview_pass(VkDevice device, MultiviewPass &pass);
+
@@ -0,0 +1,30 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+#extension GL_EXT_multiview : enable
+
+layout(push_constant) uniform ViewParams {
+	uint num_views;
+	float view_separation;
+};
+
+layout(location = 0) out vec3 frag_color;
+
+vec2 positions[3] = vec2[](
+	vec2(0.0, -0.5),
+	vec2(0.5, 0.5),
+	vec2(-0.5, 0.5)
+);
+
+vec3 colors[3] = vec3[](
+	vec3(1.0, 0.0, 0.0),
+	vec3(0.0, 1.0, 0.0),
+	vec3(0.0, 0.0, 1.0)
+);
+
+void main() {
+	// Each view sees the triangle shifted about the center, like the eyes of a stereo pair
+	const float view_offset = float(gl_ViewIndex) - 0.5 * float(num_views - 1);
+	gl_Position = vec4(positions[gl_VertexIndex] + vec2(view_offset * view_separation, 0.0), 0.0, 1.0);
+	frag_color = colors[gl_VertexIndex];
+}
+
@@ -0,0 +1,154 @@
+#include <functional>
+#include <string>
+#include <unordered_map>
+#include "object_cache.h"
+#include "vulkan_utils.h"
+
+static ObjectCacheStats stats;
+static uint32_t max_samplers = 0;
+
+// Combine the hash of each field into the seed, as boost::hash_combine
+template<typename T>
+static void hash_combine(size_t &seed, const T &v) {
+	seed ^= std::hash<T>()(v) + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+}
+
+struct SamplerKeyHash {
+	size_t operator()(const VkSamplerCreateInfo &i) const {
+		size_t h = 0;
+		hash_combine(h, uint32_t(i.flags));
+		hash_combine(h, uint32_t(i.magFilter));
+		hash_combine(h, uint32_t(i.minFilter));
+		hash_combine(h, uint32_t(i.mipmapMode));
+		hash_combine(h, uint32_t(i.addressModeU));
+		hash_combine(h, uint32_t(i.addressModeV));
+		hash_combine(h, uint32_t(i.addressModeW));
+		hash_combine(h, i.mipLodBias);
+		hash_combine(h, uint32_t(i.anisotropyEnable));
+		hash_combine(h, i.maxAnisotropy);
+		hash_combine(h, uint32_t(i.compareEnable));
+		hash_combine(h, uint32_t(i.compareOp));
+		hash_combine(h, i.minLod);
+		hash_combine(h, i.maxLod);
+		hash_combine(h, uint32_t(i.borderColor));
+		hash_combine(h, uint32_t(i.unnormalizedCoordinates));
+		return h;
+	}
+};
+
+struct SamplerKeyEqual {
+	bool operator()(const VkSamplerCreateInfo &a, const VkSamplerCreateInfo &b) const {
+		return a.flags == b.flags && a.magFilter == b.magFilter && a.minFilter == b.minFilter
+			&& a.mipmapMode == b.mipmapMode && a.addressModeU == b.addressModeU
+			&& a.addressModeV == b.addressModeV && a.addressModeW == b.addressModeW
+			&& a.mipLodBias == b.mipLodBias && a.anisotropyEnable == b.anisotropyEnable
+			&& a.maxAnisotropy == b.maxAnisotropy && a.compareEnable == b.compareEnable
+			&& a.compareOp == b.compareOp && a.minLod == b.minLod && a.maxLod == b.maxLod
+			&& a.borderColor == b.borderColor && a.unnormalizedCoordinates == b.unnormalizedCoordinates;
+	}
+};
+
+struct ImageViewKeyHash {
+	size_t operator()(const VkImageViewCreateInfo &i) const {
+		size_t h = 0;
+		hash_combine(h, uint32_t(i.flags));
+		hash_combine(h, reinterpret_cast<uint64_t>(i.image));
+		hash_combine(h, uint32_t(i.viewType));
+		hash_combine(h, uint32_t(i.format));
+		hash_combine(h, uint32_t(i.components.r));
+		hash_combine(h, uint32_t(i.components.g));
+		hash_combine(h, uint32_t(i.components.b));
+		hash_combine(h, uint32_t(i.components.a));
+		hash_combine(h, uint32_t(i.subresourceRange.aspectMask));
+		hash_combine(h, i.subresourceRange.baseMipLevel);
+		hash_combine(h, i.subresourceRange.levelCount);
+		hash_combine(h, i.subresourceRange.baseArrayLayer);
+		hash_combine(h, i.subresourceRange.layerCount);
+		return h;
+	}
+};
+
+struct ImageViewKeyEqual {
+	bool operator()(const VkImageViewCreateInfo &a, const VkImageViewCreateInfo &b) const {
+		const VkImageSubresourceRange &ra = a.subresourceRange;
+		const VkImageSubresourceRange &rb = b.subresourceRange;
+		return a.flags == b.flags && a.image == b.image && a.viewType == b.viewType && a.format == b.format
+			&& a.components.r == b.components.r && a.components.g == b.components.g
+			&& a.components.b == b.components.b && a.components.a == b.components.a
+			&& ra.aspectMask == rb.aspectMask && ra.baseMipLevel == rb.baseMipLevel
+			&& ra.levelCount == rb.levelCount && ra.baseArrayLayer == rb.baseArrayLayer
+			&& ra.layerCount == rb.layerCount;
+	}
+};
+
+static std::unordered_map<VkSamplerCreateInfo, VkSampler, SamplerKeyHash, SamplerKeyEqual> samplers;
+static std::unordered_map<VkImageViewCreateInfo, VkImageView, ImageViewKeyHash, ImageViewKeyEqual> image_views;
+
+const ObjectCacheStats& object_cache_stats() {
+	return stats;
+}
+
+void init_object_cache(VkPhysicalDevice physical_device) {
+	VkPhysicalDeviceProperties properties = {};
+	vkGetPhysicalDeviceProperties(physical_device, &properties);
+	max_samplers = properties.limits.maxSamplerAllocationCount;
+}
+
+VkSampler get_sampler(VkDevice device, const VkSamplerCreateInfo &info) {
+	if (info.pNext != nullptr) {
+		throw std::runtime_error("Samplers with a pNext chain can't be cached");
+	}
+	auto fnd = samplers.find(info);
+	if (fnd != samplers.end()) {
+		++stats.sampler_hits;
+		return fnd->second;
+	}
+	if (max_samplers != 0 && samplers.size() >= max_samplers) {
+		throw std::runtime_error("Exceeded maxSamplerAllocationCount of " + std::to_string(max_samplers)
+				+ " unique samplers");
+	}
+	VkSampler sampler = VK_NULL_HANDLE;
+	CHECK_VULKAN(vkCreateSampler(device, &info, nullptr, &sampler));
+	samplers[info] = sampler;
+	++stats.samplers_created;
+	return sampler;
+}
+
+VkImageView get_image_view(VkDevice device, const VkImageViewCreateInfo &info) {
+	if (info.pNext != nullptr) {
+		throw std::runtime_error("Image views with a pNext chain can't be cached");
+	}
+	auto fnd = image_views.find(info);
+	if (fnd != image_views.end()) {
+		++stats.image_view_hits;
+		return fnd->second;
+	}
+	VkImageView view = VK_NULL_HANDLE;
+	CHECK_VULKAN(vkCreateImageView(device, &info, nullptr, &view));
+	image_views[info] = view;
+	++stats.image_views_created;
+	return view;
+}
+
+void release_image_views(VkDevice device, VkImage image) {
+	for (auto it = image_views.begin(); it != image_views.end();) {
+		if (it->first.image == image) {
+			vkDestroyImageView(device, it->second, nullptr);
+			it = image_views.erase(it);
+		} else {
+			++it;
+		}
+	}
+}
+
+void destroy_object_cache(VkDevice device) {
+	for (auto &s : samplers) {
+		vkDestroySampler(device, s.second, nullptr);
+	}
+	for (auto &v : image_views) {
+		vkDestroyImageView(device, v.second, nullptr);
+	}
+	samplers.clear();
+	image_views.clear();
+	stats = ObjectCacheStats();
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+// Samplers and image views shared by everything using them, deduplicated by their create
+// info. Identical samplers are only created once, which keeps the number of samplers under
+// maxSamplerAllocationCount, and reused views aren't recreated when loading. Since the objects
+// are shared they're never destroyed individually: image views are released with their image
+// and samplers when the cache is destroyed.
+
+struct ObjectCacheStats {
+	uint32_t samplers_created = 0;
+	uint32_t sampler_hits = 0;
+	uint32_t image_views_created = 0;
+	uint32_t image_view_hits = 0;
+};
+
+const ObjectCacheStats& object_cache_stats();
+
+// Read the device's sampler limit, creating more samplers than it allows throws
+void init_object_cache(VkPhysicalDevice physical_device);
+
+// The create info must not have a pNext chain
+VkSampler get_sampler(VkDevice device, const VkSamplerCreateInfo &info);
+
+VkImageView get_image_view(VkDevice device, const VkImageViewCreateInfo &info);
+
+// Destroy the cached views of the image, before the image is destroyed
+void release_image_views(VkDevice device, VkImage image);
+
+// Destroy all samplers and the remaining image views
+void destroy_object_cache(VkDevice device);
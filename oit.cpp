@@ -0,0 +1,594 @@
+#include <array>
+#include <cstddef>
+#include <algorithm>
+#include <random>
+#include "oit.h"
+#include "spirv_shaders_embedded_spv.h"
+
+struct CameraParams {
+	mat4 view_proj;
+	float cam_right[4];
+	float cam_up[4];
+};
+
+const char* oit_mode_name(OITMode mode) {
+	switch (mode) {
+		case OITMode::SORTED: return "sorted";
+		case OITMode::WEIGHTED_BLENDED: return "weighted_blended";
+		case OITMode::LINKED_LIST: return "linked_list";
+	}
+	return "unknown";
+}
+
+bool parse_oit_mode(const std::string &name, OITMode &mode) {
+	for (const auto m : { OITMode::SORTED, OITMode::WEIGHTED_BLENDED, OITMode::LINKED_LIST }) {
+		if (name == oit_mode_name(m)) {
+			mode = m;
+			return true;
+		}
+	}
+	return false;
+}
+
+bool oit_mode_supported(VkPhysicalDevice physical_device, OITMode mode) {
+	VkPhysicalDeviceFeatures features = {};
+	vkGetPhysicalDeviceFeatures(physical_device, &features);
+	switch (mode) {
+		case OITMode::SORTED: return true;
+		case OITMode::WEIGHTED_BLENDED: return features.independentBlend;
+		case OITMode::LINKED_LIST: return features.fragmentStoresAndAtomics;
+	}
+	return false;
+}
+
+std::vector<TransparentInstance> make_transparent_instances(uint32_t count, uint32_t seed) {
+	std::mt19937 rng(seed);
+	std::uniform_real_distribution<float> pos_distrib(-4.f, 4.f);
+	std::uniform_real_distribution<float> size_distrib(0.1f, 0.6f);
+	std::uniform_real_distribution<float> color_distrib(0.f, 1.f);
+	std::uniform_real_distribution<float> alpha_distrib(0.2f, 0.8f);
+
+	std::vector<TransparentInstance> instances(count, TransparentInstance{});
+	for (auto &inst : instances) {
+		inst.center = vec3(pos_distrib(rng), pos_distrib(rng), pos_distrib(rng));
+		inst.size = size_distrib(rng);
+		inst.color[0] = color_distrib(rng);
+		inst.color[1] = color_distrib(rng);
+		inst.color[2] = color_distrib(rng);
+		inst.color[3] = alpha_distrib(rng);
+	}
+	return instances;
+}
+
+static VkAttachmentDescription color_attachment_desc(VkFormat format, VkImageLayout final_layout) {
+	VkAttachmentDescription attachment = {};
+	attachment.format = format;
+	attachment.samples = VK_SAMPLE_COUNT_1_BIT;
+	attachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+	attachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+	attachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+	attachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+	attachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	attachment.finalLayout = final_layout;
+	return attachment;
+}
+
+static VkRenderPass create_oit_render_pass(VkDevice device, OITMode mode, VkFormat target_format,
+		VkImageLayout target_final_layout)
+{
+	std::vector<VkAttachmentDescription> attachments = {
+		color_attachment_desc(target_format, target_final_layout)
+	};
+	const VkAttachmentReference target_ref = { 0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL };
+
+	std::vector<VkSubpassDescription> subpasses;
+	std::vector<VkSubpassDependency> dependencies;
+
+	VkSubpassDependency external_dependency = {};
+	external_dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
+	external_dependency.dstSubpass = 0;
+	external_dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+	external_dependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+	external_dependency.srcAccessMask = 0;
+	external_dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+	dependencies.push_back(external_dependency);
+
+	// The OIT targets only live for the pass, so they're transient and never stored
+	std::array<VkAttachmentReference, 2> oit_refs = {};
+	VkSubpassDescription subpass = {};
+	subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+	if (mode == OITMode::SORTED) {
+		subpass.colorAttachmentCount = 1;
+		subpass.pColorAttachments = &target_ref;
+		subpasses.push_back(subpass);
+	} else if (mode == OITMode::WEIGHTED_BLENDED) {
+		VkAttachmentDescription accum = color_attachment_desc(VK_FORMAT_R16G16B16A16_SFLOAT,
+				VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+		accum.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+		VkAttachmentDescription revealage = accum;
+		revealage.format = VK_FORMAT_R16_SFLOAT;
+		attachments.push_back(accum);
+		attachments.push_back(revealage);
+
+		oit_refs[0] = { 1, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL };
+		oit_refs[1] = { 2, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL };
+		subpass.colorAttachmentCount = oit_refs.size();
+		subpass.pColorAttachments = oit_refs.data();
+		subpasses.push_back(subpass);
+	} else {
+		// Building the lists writes no attachments
+		subpasses.push_back(subpass);
+	}
+
+	std::array<VkAttachmentReference, 2> input_refs = {};
+	if (mode != OITMode::SORTED) {
+		VkSubpassDescription resolve_subpass = {};
+		resolve_subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+		resolve_subpass.colorAttachmentCount = 1;
+		resolve_subpass.pColorAttachments = &target_ref;
+
+		VkSubpassDependency dependency = {};
+		dependency.srcSubpass = 0;
+		dependency.dstSubpass = 1;
+		dependency.dstStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+		if (mode == OITMode::WEIGHTED_BLENDED) {
+			input_refs[0] = { 1, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL };
+			input_refs[1] = { 2, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL };
+			resolve_subpass.inputAttachmentCount = input_refs.size();
+			resolve_subpass.pInputAttachments = input_refs.data();
+
+			dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+			dependency.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+			dependency.dstAccessMask = VK_ACCESS_INPUT_ATTACHMENT_READ_BIT;
+			dependency.dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
+		} else {
+			dependency.srcStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+			dependency.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+			dependency.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+		}
+		subpasses.push_back(resolve_subpass);
+		dependencies.push_back(dependency);
+	}
+
+	VkRenderPassCreateInfo render_pass_info = {};
+	render_pass_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+	render_pass_info.attachmentCount = attachments.size();
+	render_pass_info.pAttachments = attachments.data();
+	render_pass_info.subpassCount = subpasses.size();
+	render_pass_info.pSubpasses = subpasses.data();
+	render_pass_info.dependencyCount = dependencies.size();
+	render_pass_info.pDependencies = dependencies.data();
+
+	VkRenderPass render_pass = VK_NULL_HANDLE;
+	CHECK_VULKAN(vkCreateRenderPass(device, &render_pass_info, nullptr, &render_pass));
+	return render_pass;
+}
+
+static VkPipeline create_oit_pipeline(VkDevice device, VkPipelineLayout layout, VkRenderPass render_pass,
+		uint32_t subpass, VkExtent2D extent, VkShaderModule vertex_shader_module,
+		VkShaderModule fragment_shader_module, bool instanced,
+		const std::vector<VkPipelineColorBlendAttachmentState> &blend_modes)
+{
+	VkPipelineShaderStageCreateInfo vertex_stage = {};
+	vertex_stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	vertex_stage.stage = VK_SHADER_STAGE_VERTEX_BIT;
+	vertex_stage.module = vertex_shader_module;
+	vertex_stage.pName = "main";
+
+	VkPipelineShaderStageCreateInfo fragment_stage = {};
+	fragment_stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	fragment_stage.stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+	fragment_stage.module = fragment_shader_module;
+	fragment_stage.pName = "main";
+
+	std::array<VkPipelineShaderStageCreateInfo, 2> shader_stages = { vertex_stage, fragment_stage };
+
+	// The instances are read per instance, the quad corners come from the vertex index
+	VkVertexInputBindingDescription instance_binding = {};
+	instance_binding.binding = 0;
+	instance_binding.stride = sizeof(TransparentInstance);
+	instance_binding.inputRate = VK_VERTEX_INPUT_RATE_INSTANCE;
+
+	std::array<VkVertexInputAttributeDescription, 2> instance_attribs = {};
+	instance_attribs[0].location = 0;
+	instance_attribs[0].binding = 0;
+	instance_attribs[0].format = VK_FORMAT_R32G32B32A32_SFLOAT;
+	instance_attribs[0].offset = 0;
+	instance_attribs[1].location = 1;
+	instance_attribs[1].binding = 0;
+	instance_attribs[1].format = VK_FORMAT_R32G32B32A32_SFLOAT;
+	instance_attribs[1].offset = offsetof(TransparentInstance, color);
+
+	VkPipelineVertexInputStateCreateInfo vertex_input_info = {};
+	vertex_input_info.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+	if (instanced) {
+		vertex_input_info.vertexBindingDescriptionCount = 1;
+		vertex_input_info.pVertexBindingDescriptions = &instance_binding;
+		vertex_input_info.vertexAttributeDescriptionCount = instance_attribs.size();
+		vertex_input_info.pVertexAttributeDescriptions = instance_attribs.data();
+	}
+
+	VkPipelineInputAssemblyStateCreateInfo input_assembly = {};
+	input_assembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+	input_assembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+	input_assembly.primitiveRestartEnable = VK_FALSE;
+
+	VkViewport viewport = {};
+	viewport.x = 0.0f;
+	viewport.y = 0.0f;
+	viewport.width = extent.width;
+	viewport.height = extent.height;
+	viewport.minDepth = 0.0f;
+	viewport.maxDepth = 1.0f;
+
+	VkRect2D scissor = {};
+	scissor.extent = extent;
+
+	VkPipelineViewportStateCreateInfo viewport_state_info = {};
+	viewport_state_info.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+	viewport_state_info.viewportCount = 1;
+	viewport_state_info.pViewports = &viewport;
+	viewport_state_info.scissorCount = 1;
+	viewport_state_info.pScissors = &scissor;
+
+	VkPipelineRasterizationStateCreateInfo rasterizer_info = {};
+	rasterizer_info.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+	rasterizer_info.depthClampEnable = VK_FALSE;
+	rasterizer_info.rasterizerDiscardEnable = VK_FALSE;
+	rasterizer_info.polygonMode = VK_POLYGON_MODE_FILL;
+	rasterizer_info.lineWidth = 1.f;
+	rasterizer_info.cullMode = VK_CULL_MODE_NONE;
+	rasterizer_info.frontFace = VK_FRONT_FACE_CLOCKWISE;
+	rasterizer_info.depthBiasEnable = VK_FALSE;
+
+	VkPipelineMultisampleStateCreateInfo multisampling = {};
+	multisampling.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+	multisampling.sampleShadingEnable = VK_FALSE;
+	multisampling.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+
+	VkPipelineColorBlendStateCreateInfo blend_info = {};
+	blend_info.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+	blend_info.logicOpEnable = VK_FALSE;
+	blend_info.attachmentCount = blend_modes.size();
+	blend_info.pAttachments = blend_modes.data();
+
+	VkGraphicsPipelineCreateInfo graphics_pipeline_info = {};
+	graphics_pipeline_info.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+	graphics_pipeline_info.stageCount = shader_stages.size();
+	graphics_pipeline_info.pStages = shader_stages.data();
+	graphics_pipeline_info.pVertexInputState = &vertex_input_info;
+	graphics_pipeline_info.pInputAssemblyState = &input_assembly;
+	graphics_pipeline_info.pViewportState = &viewport_state_info;
+	graphics_pipeline_info.pRasterizationState = &rasterizer_info;
+	graphics_pipeline_info.pMultisampleState = &multisampling;
+	graphics_pipeline_info.pColorBlendState = &blend_info;
+	graphics_pipeline_info.layout = layout;
+	graphics_pipeline_info.renderPass = render_pass;
+	graphics_pipeline_info.subpass = subpass;
+
+	VkPipeline pipeline = VK_NULL_HANDLE;
+	CHECK_VULKAN(vkCreateGraphicsPipelines(device, pipeline_cache(), 1, &graphics_pipeline_info, nullptr, &pipeline));
+	return pipeline;
+}
+
+static VkPipelineColorBlendAttachmentState blend_state(bool enable, VkBlendFactor src, VkBlendFactor dst) {
+	VkPipelineColorBlendAttachmentState blend_mode = {};
+	blend_mode.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+	blend_mode.blendEnable = enable ? VK_TRUE : VK_FALSE;
+	blend_mode.srcColorBlendFactor = src;
+	blend_mode.dstColorBlendFactor = dst;
+	blend_mode.colorBlendOp = VK_BLEND_OP_ADD;
+	blend_mode.srcAlphaBlendFactor = src;
+	blend_mode.dstAlphaBlendFactor = dst;
+	blend_mode.alphaBlendOp = VK_BLEND_OP_ADD;
+	return blend_mode;
+}
+
+OITRenderer create_oit_renderer(VkDevice device, VkPhysicalDevice physical_device, ResourceManager &resources,
+		OITMode mode, VkExtent2D extent, VkFormat target_format, VkImageLayout target_final_layout,
+		const std::vector<VkImageView> &target_views, const std::vector<TransparentInstance> &instances)
+{
+	OITRenderer oit;
+	oit.mode = mode;
+	oit.extent = extent;
+	oit.instances = instances;
+
+	const VkDeviceSize instance_bytes = instances.size() * sizeof(TransparentInstance);
+	oit.instance_buffer = create_host_buffer(device, physical_device, instances.data(), instance_bytes,
+			VK_BUFFER_USAGE_VERTEX_BUFFER_BIT);
+	CHECK_VULKAN(vkMapMemory(device, oit.instance_buffer.mem, 0, instance_bytes, 0,
+			reinterpret_cast<void**>(&oit.instance_mapping)));
+
+	oit.render_pass = create_oit_render_pass(device, mode, target_format, target_final_layout);
+
+	std::vector<VkDescriptorSetLayoutBinding> bindings;
+	std::vector<VkDescriptorPoolSize> pool_sizes;
+	if (mode == OITMode::WEIGHTED_BLENDED) {
+		oit.accum = create_image(device, physical_device, extent, 1, VK_FORMAT_R16G16B16A16_SFLOAT,
+				VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT,
+				VK_IMAGE_ASPECT_COLOR_BIT);
+		oit.revealage = create_image(device, physical_device, extent, 1, VK_FORMAT_R16_SFLOAT,
+				VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT,
+				VK_IMAGE_ASPECT_COLOR_BIT);
+		oit.accum_handle = add_image(resources, oit.accum);
+		oit.revealage_handle = add_image(resources, oit.revealage);
+
+		for (uint32_t i = 0; i < 2; ++i) {
+			VkDescriptorSetLayoutBinding binding = {};
+			binding.binding = i;
+			binding.descriptorType = VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT;
+			binding.descriptorCount = 1;
+			binding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+			bindings.push_back(binding);
+		}
+		pool_sizes.push_back(VkDescriptorPoolSize{VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT, 2});
+	} else if (mode == OITMode::LINKED_LIST) {
+		oit.list_heads = create_image(device, physical_device, extent, 1, VK_FORMAT_R32_UINT,
+				VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT, VK_IMAGE_ASPECT_COLOR_BIT);
+		oit.list_heads_handle = add_image(resources, oit.list_heads);
+		// Enough nodes for an average of 4 transparent layers per pixel, the header holds
+		// the allocation counter and node count
+		oit.max_nodes = extent.width * extent.height * 4;
+		oit.list_nodes = create_buffer(device, physical_device, 16 + VkDeviceSize(oit.max_nodes) * 16,
+				VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+				VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+		VkDescriptorSetLayoutBinding binding = {};
+		binding.binding = 0;
+		binding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+		binding.descriptorCount = 1;
+		binding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+		bindings.push_back(binding);
+		binding.binding = 1;
+		binding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		bindings.push_back(binding);
+		pool_sizes.push_back(VkDescriptorPoolSize{VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1});
+		pool_sizes.push_back(VkDescriptorPoolSize{VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1});
+	}
+
+	if (!bindings.empty()) {
+		VkDescriptorSetLayoutCreateInfo layout_info = {};
+		layout_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+		layout_info.bindingCount = bindings.size();
+		layout_info.pBindings = bindings.data();
+		CHECK_VULKAN(vkCreateDescriptorSetLayout(device, &layout_info, nullptr, &oit.desc_layout));
+
+		VkDescriptorPoolCreateInfo pool_info = {};
+		pool_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+		pool_info.maxSets = 1;
+		pool_info.poolSizeCount = pool_sizes.size();
+		pool_info.pPoolSizes = pool_sizes.data();
+		CHECK_VULKAN(vkCreateDescriptorPool(device, &pool_info, nullptr, &oit.desc_pool));
+
+		VkDescriptorSetAllocateInfo alloc_info = {};
+		alloc_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+		alloc_info.descriptorPool = oit.desc_pool;
+		alloc_info.descriptorSetCount = 1;
+		alloc_info.pSetLayouts = &oit.desc_layout;
+		CHECK_VULKAN(vkAllocateDescriptorSets(device, &alloc_info, &oit.desc_set));
+
+		std::array<VkDescriptorImageInfo, 2> image_infos = {};
+		VkDescriptorBufferInfo buffer_info = {};
+		std::array<VkWriteDescriptorSet, 2> writes = {};
+		for (uint32_t i = 0; i < 2; ++i) {
+			writes[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+			writes[i].dstSet = oit.desc_set;
+			writes[i].dstBinding = i;
+			writes[i].descriptorCount = 1;
+			writes[i].descriptorType = bindings[i].descriptorType;
+		}
+		if (mode == OITMode::WEIGHTED_BLENDED) {
+			image_infos[0].imageView = oit.accum.view;
+			image_infos[0].imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+			image_infos[1].imageView = oit.revealage.view;
+			image_infos[1].imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+			writes[0].pImageInfo = &image_infos[0];
+			writes[1].pImageInfo = &image_infos[1];
+		} else {
+			image_infos[0].imageView = oit.list_heads.view;
+			image_infos[0].imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+			buffer_info.buffer = oit.list_nodes.buffer;
+			buffer_info.offset = 0;
+			buffer_info.range = VK_WHOLE_SIZE;
+			writes[0].pImageInfo = &image_infos[0];
+			writes[1].pBufferInfo = &buffer_info;
+		}
+		vkUpdateDescriptorSets(device, writes.size(), writes.data(), 0, nullptr);
+	}
+
+	for (const auto &v : target_views) {
+		std::vector<VkImageView> attachments = { v };
+		if (mode == OITMode::WEIGHTED_BLENDED) {
+			attachments.push_back(oit.accum.view);
+			attachments.push_back(oit.revealage.view);
+		}
+		VkFramebufferCreateInfo create_info = {};
+		create_info.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+		create_info.renderPass = oit.render_pass;
+		create_info.attachmentCount = attachments.size();
+		create_info.pAttachments = attachments.data();
+		create_info.width = extent.width;
+		create_info.height = extent.height;
+		create_info.layers = 1;
+		VkFramebuffer fb = VK_NULL_HANDLE;
+		CHECK_VULKAN(vkCreateFramebuffer(device, &create_info, nullptr, &fb));
+		oit.framebuffers.push_back(fb);
+	}
+
+	VkPushConstantRange push_constants = {};
+	push_constants.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+	push_constants.offset = 0;
+	push_constants.size = sizeof(CameraParams);
+
+	VkPipelineLayoutCreateInfo pipeline_info = {};
+	pipeline_info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	pipeline_info.setLayoutCount = oit.desc_layout != VK_NULL_HANDLE ? 1 : 0;
+	pipeline_info.pSetLayouts = &oit.desc_layout;
+	pipeline_info.pushConstantRangeCount = 1;
+	pipeline_info.pPushConstantRanges = &push_constants;
+	CHECK_VULKAN(vkCreatePipelineLayout(device, &pipeline_info, nullptr, &oit.pipeline_layout));
+
+	VkShaderModule quad_vs = create_shader_module(device, oit_quad_spv, sizeof(oit_quad_spv));
+	VkShaderModule fullscreen_vs = create_shader_module(device, fullscreen_spv, sizeof(fullscreen_spv));
+	if (mode == OITMode::SORTED) {
+		VkShaderModule fs = create_shader_module(device, oit_sorted_spv, sizeof(oit_sorted_spv));
+		oit.transparent_pipeline = create_oit_pipeline(device, oit.pipeline_layout, oit.render_pass, 0, extent,
+				quad_vs, fs, true,
+				{ blend_state(true, VK_BLEND_FACTOR_SRC_ALPHA, VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA) });
+		vkDestroyShaderModule(device, fs, nullptr);
+	} else if (mode == OITMode::WEIGHTED_BLENDED) {
+		VkShaderModule accum_fs = create_shader_module(device, oit_wb_accum_spv, sizeof(oit_wb_accum_spv));
+		VkShaderModule composite_fs = create_shader_module(device, oit_wb_composite_spv, sizeof(oit_wb_composite_spv));
+		// Accumulate the weighted colors additively and multiply down the revealage
+		oit.transparent_pipeline = create_oit_pipeline(device, oit.pipeline_layout, oit.render_pass, 0, extent,
+				quad_vs, accum_fs, true,
+				{
+					blend_state(true, VK_BLEND_FACTOR_ONE, VK_BLEND_FACTOR_ONE),
+					blend_state(true, VK_BLEND_FACTOR_ZERO, VK_BLEND_FACTOR_ONE_MINUS_SRC_COLOR)
+				});
+		oit.resolve_pipeline = create_oit_pipeline(device, oit.pipeline_layout, oit.render_pass, 1, extent,
+				fullscreen_vs, composite_fs, false,
+				{ blend_state(true, VK_BLEND_FACTOR_SRC_ALPHA, VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA) });
+		vkDestroyShaderModule(device, accum_fs, nullptr);
+		vkDestroyShaderModule(device, composite_fs, nullptr);
+	} else {
+		VkShaderModule insert_fs = create_shader_module(device, oit_list_insert_spv, sizeof(oit_list_insert_spv));
+		VkShaderModule resolve_fs = create_shader_module(device, oit_list_resolve_spv, sizeof(oit_list_resolve_spv));
+		oit.transparent_pipeline = create_oit_pipeline(device, oit.pipeline_layout, oit.render_pass, 0, extent,
+				quad_vs, insert_fs, true, {});
+		// The resolve outputs premultiplied color
+		oit.resolve_pipeline = create_oit_pipeline(device, oit.pipeline_layout, oit.render_pass, 1, extent,
+				fullscreen_vs, resolve_fs, false,
+				{ blend_state(true, VK_BLEND_FACTOR_ONE, VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA) });
+		vkDestroyShaderModule(device, insert_fs, nullptr);
+		vkDestroyShaderModule(device, resolve_fs, nullptr);
+	}
+	vkDestroyShaderModule(device, quad_vs, nullptr);
+	vkDestroyShaderModule(device, fullscreen_vs, nullptr);
+	oit.transparent_pipeline_handle = add_pipeline(resources, oit.transparent_pipeline);
+	if (oit.resolve_pipeline != VK_NULL_HANDLE) {
+		oit.resolve_pipeline_handle = add_pipeline(resources, oit.resolve_pipeline);
+	}
+
+	return oit;
+}
+
+void sort_transparent_instances(OITRenderer &oit, const Camera &camera) {
+	if (oit.mode != OITMode::SORTED) {
+		return;
+	}
+	const vec3 forward = normalize(camera.target - camera.position);
+	std::vector<std::pair<float, uint32_t>> depths(oit.instances.size());
+	for (uint32_t i = 0; i < oit.instances.size(); ++i) {
+		depths[i] = std::make_pair(dot(oit.instances[i].center - camera.position, forward), i);
+	}
+	std::sort(depths.begin(), depths.end(),
+		[](const std::pair<float, uint32_t> &a, const std::pair<float, uint32_t> &b) {
+			return a.first > b.first;
+		});
+	for (size_t i = 0; i < depths.size(); ++i) {
+		oit.instance_mapping[i] = oit.instances[depths[i].second];
+	}
+}
+
+void record_oit(const OITRenderer &oit, VkCommandBuffer cmd_buf, uint32_t target_index, const Camera &camera) {
+	if (oit.mode == OITMode::LINKED_LIST) {
+		// Reset the list heads to empty and the node allocator to 0
+		image_barrier(cmd_buf, oit.list_heads.image, VK_IMAGE_ASPECT_COLOR_BIT,
+				VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL,
+				VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_TRANSFER_WRITE_BIT,
+				VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+
+		VkClearColorValue list_end = {};
+		list_end.uint32[0] = 0xffffffff;
+		VkImageSubresourceRange range = {};
+		range.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		range.levelCount = 1;
+		range.layerCount = 1;
+		vkCmdClearColorImage(cmd_buf, oit.list_heads.image, VK_IMAGE_LAYOUT_GENERAL, &list_end, 1, &range);
+
+		const std::array<uint32_t, 2> header = { 0, oit.max_nodes };
+		vkCmdUpdateBuffer(cmd_buf, oit.list_nodes.buffer, 0, sizeof(header), header.data());
+
+		VkMemoryBarrier barrier = {};
+		barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+		vkCmdPipelineBarrier(cmd_buf, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+				0, 1, &barrier, 0, nullptr, 0, nullptr);
+	}
+
+	VkRenderPassBeginInfo render_pass_info = {};
+	render_pass_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+	render_pass_info.renderPass = oit.render_pass;
+	render_pass_info.framebuffer = oit.framebuffers[target_index];
+	render_pass_info.renderArea.extent = oit.extent;
+
+	// Background, accumulation and revealage clear values
+	std::array<VkClearValue, 3> clear_values = {};
+	clear_values[0].color.float32[0] = 0.1f;
+	clear_values[0].color.float32[1] = 0.1f;
+	clear_values[0].color.float32[2] = 0.1f;
+	clear_values[0].color.float32[3] = 1.f;
+	clear_values[2].color.float32[0] = 1.f;
+	render_pass_info.clearValueCount = oit.mode == OITMode::WEIGHTED_BLENDED ? 3 : 1;
+	render_pass_info.pClearValues = clear_values.data();
+
+	vkCmdBeginRenderPass(cmd_buf, &render_pass_info, VK_SUBPASS_CONTENTS_INLINE);
+
+	const vec3 forward = normalize(camera.target - camera.position);
+	const vec3 right = normalize(cross(forward, camera.up));
+	const vec3 up = cross(right, forward);
+	CameraParams params = {};
+	params.view_proj = camera.proj() * camera.view();
+	params.cam_right[0] = right.x;
+	params.cam_right[1] = right.y;
+	params.cam_right[2] = right.z;
+	params.cam_up[0] = up.x;
+	params.cam_up[1] = up.y;
+	params.cam_up[2] = up.z;
+	vkCmdPushConstants(cmd_buf, oit.pipeline_layout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(CameraParams), &params);
+
+	if (oit.desc_set != VK_NULL_HANDLE) {
+		vkCmdBindDescriptorSets(cmd_buf, VK_PIPELINE_BIND_POINT_GRAPHICS, oit.pipeline_layout, 0, 1, &oit.desc_set,
+				0, nullptr);
+	}
+
+	vkCmdBindPipeline(cmd_buf, VK_PIPELINE_BIND_POINT_GRAPHICS, oit.transparent_pipeline);
+	const VkDeviceSize offset = 0;
+	vkCmdBindVertexBuffers(cmd_buf, 0, 1, &oit.instance_buffer.buffer, &offset);
+	vkCmdDraw(cmd_buf, 6, oit.instances.size(), 0, 0);
+
+	if (oit.mode != OITMode::SORTED) {
+		vkCmdNextSubpass(cmd_buf, VK_SUBPASS_CONTENTS_INLINE);
+		vkCmdBindPipeline(cmd_buf, VK_PIPELINE_BIND_POINT_GRAPHICS, oit.resolve_pipeline);
+		vkCmdDraw(cmd_buf, 3, 1, 0, 0);
+	}
+
+	vkCmdEndRenderPass(cmd_buf);
+}
+
+void destroy_oit_renderer(VkDevice device, ResourceManager &resources, OITRenderer &oit) {
+	release_pipeline(resources, oit.transparent_pipeline_handle);
+	if (is_valid(resources, oit.resolve_pipeline_handle)) {
+		release_pipeline(resources, oit.resolve_pipeline_handle);
+	}
+	vkDestroyPipelineLayout(device, oit.pipeline_layout, nullptr);
+	for (auto &fb : oit.framebuffers) {
+		vkDestroyFramebuffer(device, fb, nullptr);
+	}
+	vkDestroyRenderPass(device, oit.render_pass, nullptr);
+	vkDestroyDescriptorPool(device, oit.desc_pool, nullptr);
+	vkDestroyDescriptorSetLayout(device, oit.desc_layout, nullptr);
+	if (oit.mode == OITMode::WEIGHTED_BLENDED) {
+		release_image(resources, oit.accum_handle);
+		release_image(resources, oit.revealage_handle);
+	} else if (oit.mode == OITMode::LINKED_LIST) {
+		release_image(resources, oit.list_heads_handle);
+		destroy_buffer(device, oit.list_nodes);
+	}
+	vkUnmapMemory(device, oit.instance_buffer.mem);
+	destroy_buffer(device, oit.instance_buffer);
+	oit = OITRenderer();
+}
+
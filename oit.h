@@ -0,0 +1,93 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <vulkan/vulkan.h>
+#include "camera.h"
+#include "resources.h"
+#include "vulkan_utils.h"
+
+enum class OITMode {
+	// Objects sorted back to front on the CPU each frame and alpha blended
+	SORTED,
+	// Weighted blended OIT, order independent in a single geometry pass
+	WEIGHTED_BLENDED,
+	// Per-pixel linked lists sorted and blended in a resolve pass, exact up to 16 layers
+	LINKED_LIST
+};
+
+const char* oit_mode_name(OITMode mode);
+
+bool parse_oit_mode(const std::string &name, OITMode &mode);
+
+// The linked list mode requires the fragmentStoresAndAtomics feature, and weighted blended
+// requires independentBlend. These must be enabled on the device to use the mode
+bool oit_mode_supported(VkPhysicalDevice physical_device, OITMode mode);
+
+// A camera facing transparent quad
+struct TransparentInstance {
+	vec3 center;
+	float size = 1.f;
+	float color[4] = { 1.f, 1.f, 1.f, 1.f };
+};
+
+// Random transparent quads scattered in a box around the origin
+std::vector<TransparentInstance> make_transparent_instances(uint32_t count, uint32_t seed);
+
+// Renders transparent instances over a cleared color target with one of the OIT modes.
+// Framebuffers are made for each target view, e.g. one per swapchain image. The targets and
+// pipelines are owned by the resource manager.
+struct OITRenderer {
+	OITMode mode = OITMode::WEIGHTED_BLENDED;
+	VkExtent2D extent = {};
+
+	// The unsorted instances, and the persistently mapped buffer the draw reads from
+	std::vector<TransparentInstance> instances;
+	Buffer instance_buffer;
+	TransparentInstance *instance_mapping = nullptr;
+
+	// Weighted blended accumulation and revealage targets
+	Image accum;
+	Image revealage;
+	ImageHandle accum_handle;
+	ImageHandle revealage_handle;
+
+	// Linked list heads and node pool
+	Image list_heads;
+	ImageHandle list_heads_handle;
+	Buffer list_nodes;
+	uint32_t max_nodes = 0;
+
+	VkDescriptorSetLayout desc_layout = VK_NULL_HANDLE;
+	VkDescriptorPool desc_pool = VK_NULL_HANDLE;
+	VkDescriptorSet desc_set = VK_NULL_HANDLE;
+
+	VkRenderPass render_pass = VK_NULL_HANDLE;
+	std::vector<VkFramebuffer> framebuffers;
+	VkPipelineLayout pipeline_layout = VK_NULL_HANDLE;
+	// Draws the transparent instances
+	VkPipeline transparent_pipeline = VK_NULL_HANDLE;
+	// Composites or resolves the OIT targets over the color target, unused when sorting
+	VkPipeline resolve_pipeline = VK_NULL_HANDLE;
+	PipelineHandle transparent_pipeline_handle;
+	PipelineHandle resolve_pipeline_handle;
+};
+
+OITRenderer create_oit_renderer(VkDevice device, VkPhysicalDevice physical_device, ResourceManager &resources,
+		OITMode mode, VkExtent2D extent, VkFormat target_format, VkImageLayout target_final_layout,
+		const std::vector<VkImageView> &target_views, const std::vector<TransparentInstance> &instances);
+
+// In the sorted mode sort the instances back to front for the camera and upload them,
+// the other modes draw the instances in any order and this does nothing
+void sort_transparent_instances(OITRenderer &oit, const Camera &camera);
+
+void record_oit(const OITRenderer &oit, VkCommandBuffer cmd_buf, uint32_t target_index, const Camera &camera);
+
+// Releases the targets and pipelines to the resource manager
+void destroy_oit_renderer(VkDevice device, ResourceManager &resources, OITRenderer &oit);
+
+// Render the same transparent scene with each supported mode offscreen and report the CPU
+// sorting and GPU rendering times, averaged over the iterations
+void run_oit_benchmark(VkDevice device, VkPhysicalDevice physical_device, VkQueue queue,
+		uint32_t queue_family, uint32_t num_instances, uint32_t iterations);
+
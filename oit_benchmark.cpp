@@ -0,0 +1,146 @@
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <limits>
+#include "oit.h"
+
+void run_oit_benchmark(VkDevice device, VkPhysicalDevice physical_device, VkQueue queue,
+		uint32_t queue_family, uint32_t num_instances, uint32_t iterations)
+{
+	const VkExtent2D extent = { 1280, 720 };
+	const VkFormat target_format = VK_FORMAT_R8G8B8A8_UNORM;
+	Image target = create_image(device, physical_device, extent, 1, target_format,
+			VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT, VK_IMAGE_ASPECT_COLOR_BIT);
+
+	VkCommandPool command_pool = VK_NULL_HANDLE;
+	{
+		VkCommandPoolCreateInfo create_info = {};
+		create_info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+		create_info.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+		create_info.queueFamilyIndex = queue_family;
+		CHECK_VULKAN(vkCreateCommandPool(device, &create_info, nullptr, &command_pool));
+	}
+
+	VkCommandBuffer cmd_buf = VK_NULL_HANDLE;
+	{
+		VkCommandBufferAllocateInfo info = {};
+		info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+		info.commandPool = command_pool;
+		info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+		info.commandBufferCount = 1;
+		CHECK_VULKAN(vkAllocateCommandBuffers(device, &info, &cmd_buf));
+	}
+
+	VkFence fence = VK_NULL_HANDLE;
+	{
+		VkFenceCreateInfo info = {};
+		info.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+		CHECK_VULKAN(vkCreateFence(device, &info, nullptr, &fence));
+	}
+
+	// Timestamps around the OIT rendering, if the queue supports them
+	VkPhysicalDeviceProperties properties = {};
+	vkGetPhysicalDeviceProperties(physical_device, &properties);
+	uint32_t num_families = 0;
+	vkGetPhysicalDeviceQueueFamilyProperties(physical_device, &num_families, nullptr);
+	std::vector<VkQueueFamilyProperties> family_props(num_families, VkQueueFamilyProperties{});
+	vkGetPhysicalDeviceQueueFamilyProperties(physical_device, &num_families, family_props.data());
+	const bool gpu_timing = family_props[queue_family].timestampValidBits != 0;
+
+	VkQueryPool query_pool = VK_NULL_HANDLE;
+	if (gpu_timing) {
+		VkQueryPoolCreateInfo info = {};
+		info.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+		info.queryType = VK_QUERY_TYPE_TIMESTAMP;
+		info.queryCount = 2;
+		CHECK_VULKAN(vkCreateQueryPool(device, &info, nullptr, &query_pool));
+	}
+
+	const std::vector<TransparentInstance> instances = make_transparent_instances(num_instances, 1);
+	std::cout << "OIT benchmark: " << num_instances << " transparent quads at " << extent.width << "x"
+		<< extent.height << ", " << iterations << " iterations\n";
+
+	for (const auto mode : { OITMode::SORTED, OITMode::WEIGHTED_BLENDED, OITMode::LINKED_LIST }) {
+		if (!oit_mode_supported(physical_device, mode)) {
+			std::cout << oit_mode_name(mode) << ": not supported\n";
+			continue;
+		}
+
+		ResourceManager resources;
+		OITRenderer oit = create_oit_renderer(device, physical_device, resources, mode, extent, target_format,
+				VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, { target.view }, instances);
+
+		Camera camera;
+		camera.position = vec3(0.f, 2.f, 10.f);
+		camera.aspect = float(extent.width) / extent.height;
+
+		// The first few iterations warm up the caches and clocks and aren't counted
+		const uint32_t warmup = 5;
+		double sort_ms = 0.0;
+		double gpu_ms = 0.0;
+		double frame_ms = 0.0;
+		for (uint32_t i = 0; i < iterations + warmup; ++i) {
+			// Orbit the camera so the sorted order changes each frame
+			const float angle = i * 0.01f;
+			camera.position = vec3(10.f * std::sin(angle), 2.f, 10.f * std::cos(angle));
+
+			const auto frame_start = std::chrono::high_resolution_clock::now();
+			sort_transparent_instances(oit, camera);
+			const auto sort_end = std::chrono::high_resolution_clock::now();
+
+			VkCommandBufferBeginInfo begin_info = {};
+			begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+			begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+			CHECK_VULKAN(vkBeginCommandBuffer(cmd_buf, &begin_info));
+			if (gpu_timing) {
+				vkCmdResetQueryPool(cmd_buf, query_pool, 0, 2);
+				vkCmdWriteTimestamp(cmd_buf, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, query_pool, 0);
+			}
+			record_oit(oit, cmd_buf, 0, camera);
+			if (gpu_timing) {
+				vkCmdWriteTimestamp(cmd_buf, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, query_pool, 1);
+			}
+			CHECK_VULKAN(vkEndCommandBuffer(cmd_buf));
+
+			VkSubmitInfo submit_info = {};
+			submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+			submit_info.commandBufferCount = 1;
+			submit_info.pCommandBuffers = &cmd_buf;
+			CHECK_VULKAN(vkResetFences(device, 1, &fence));
+			CHECK_VULKAN(vkQueueSubmit(queue, 1, &submit_info, fence));
+			CHECK_VULKAN(vkWaitForFences(device, 1, &fence, true, std::numeric_limits<uint64_t>::max()));
+			const auto frame_end = std::chrono::high_resolution_clock::now();
+
+			if (i < warmup) {
+				continue;
+			}
+			sort_ms += std::chrono::duration<double, std::milli>(sort_end - frame_start).count();
+			frame_ms += std::chrono::duration<double, std::milli>(frame_end - frame_start).count();
+			if (gpu_timing) {
+				std::array<uint64_t, 2> timestamps = {};
+				CHECK_VULKAN(vkGetQueryPoolResults(device, query_pool, 0, 2, sizeof(timestamps), timestamps.data(),
+						sizeof(uint64_t), VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT));
+				gpu_ms += (timestamps[1] - timestamps[0]) * properties.limits.timestampPeriod * 1e-6;
+			}
+		}
+
+		std::cout << oit_mode_name(mode) << ": CPU sort " << sort_ms / iterations << "ms, GPU ";
+		if (gpu_timing) {
+			std::cout << gpu_ms / iterations << "ms";
+		} else {
+			std::cout << "n/a";
+		}
+		std::cout << ", frame " << frame_ms / iterations << "ms\n";
+
+		destroy_oit_renderer(device, resources, oit);
+		destroy_resource_manager(device, resources);
+	}
+
+	if (gpu_timing) {
+		vkDestroyQueryPool(device, query_pool, nullptr);
+	}
+	vkDestroyFence(device, fence, nullptr);
+	vkDestroyCommandPool(device, command_pool, nullptr);
+	destroy_image(device, target);
+}
@@ -0,0 +1,28 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+// Per-pixel linked list construction. Each fragment allocates a node and pushes it on the
+// front of its pixel's list, nothing is written to the color target
+layout(early_fragment_tests) in;
+
+layout(set = 0, binding = 0, r32ui) uniform coherent uimage2D list_heads;
+
+layout(set = 0, binding = 1, std430) buffer ListNodes {
+	uint node_counter;
+	uint max_nodes;
+	uvec2 pad;
+	// Packed color, depth, next node
+	uvec4 nodes[];
+};
+
+layout(location = 0) in vec4 frag_color;
+
+void main() {
+	const uint node = atomicAdd(node_counter, 1);
+	if (node >= max_nodes) {
+		return;
+	}
+	const uint next = imageAtomicExchange(list_heads, ivec2(gl_FragCoord.xy), node);
+	nodes[node] = uvec4(packUnorm4x8(frag_color), floatBitsToUint(gl_FragCoord.z), next, 0);
+}
+
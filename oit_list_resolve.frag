@@ -0,0 +1,52 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+// Sorts each pixel's fragments back to front and blends them, outputting premultiplied
+// color to be composited over the background
+#define MAX_FRAGMENTS 16
+#define LIST_END 0xffffffffu
+
+layout(set = 0, binding = 0, r32ui) uniform coherent uimage2D list_heads;
+
+layout(set = 0, binding = 1, std430) buffer ListNodes {
+	uint node_counter;
+	uint max_nodes;
+	uvec2 pad;
+	uvec4 nodes[];
+};
+
+layout(location = 0) out vec4 color;
+
+void main() {
+	uvec2 fragments[MAX_FRAGMENTS];
+	int count = 0;
+	uint node = imageLoad(list_heads, ivec2(gl_FragCoord.xy)).r;
+	while (node != LIST_END && count < MAX_FRAGMENTS) {
+		fragments[count++] = nodes[node].xy;
+		node = nodes[node].z;
+	}
+	if (count == 0) {
+		discard;
+	}
+
+	// Insertion sort by depth, farthest first
+	for (int i = 1; i < count; ++i) {
+		const uvec2 f = fragments[i];
+		int j = i - 1;
+		while (j >= 0 && uintBitsToFloat(fragments[j].y) < uintBitsToFloat(f.y)) {
+			fragments[j + 1] = fragments[j];
+			--j;
+		}
+		fragments[j + 1] = f;
+	}
+
+	vec3 accum = vec3(0.0);
+	float transmittance = 1.0;
+	for (int i = 0; i < count; ++i) {
+		const vec4 f = unpackUnorm4x8(fragments[i].x);
+		accum = f.rgb * f.a + accum * (1.0 - f.a);
+		transmittance *= 1.0 - f.a;
+	}
+	color = vec4(accum, 1.0 - transmittance);
+}
+
@@ -0,0 +1,31 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+// Per instance camera facing quads, expanded from 6 vertices per instance
+layout(location = 0) in vec4 center_size;
+layout(location = 1) in vec4 color;
+
+layout(push_constant) uniform CameraParams {
+	mat4 view_proj;
+	vec4 cam_right;
+	vec4 cam_up;
+};
+
+layout(location = 0) out vec4 frag_color;
+
+vec2 corners[6] = vec2[](
+	vec2(-1.0, -1.0),
+	vec2(1.0, -1.0),
+	vec2(1.0, 1.0),
+	vec2(-1.0, -1.0),
+	vec2(1.0, 1.0),
+	vec2(-1.0, 1.0)
+);
+
+void main() {
+	const vec2 c = corners[gl_VertexIndex];
+	const vec3 pos = center_size.xyz + (cam_right.xyz * c.x + cam_up.xyz * c.y) * center_size.w;
+	gl_Position = view_proj * vec4(pos, 1.0);
+	frag_color = color;
+}
+
@@ -0,0 +1,20 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+// Weighted blended OIT accumulation (McGuire and Bavoil 2013). The accumulation target
+// is blended additively and the revealage multiplicatively, so draw order doesn't matter
+layout(location = 0) in vec4 frag_color;
+
+layout(location = 0) out vec4 accum;
+layout(location = 1) out float revealage;
+
+void main() {
+	const float a = frag_color.a;
+	// Weight nearer and more opaque fragments higher, using the depth based weight
+	// function from the paper
+	const float w = clamp(pow(min(1.0, a * 10.0) + 0.01, 3.0) * 1e8 * pow(1.0 - gl_FragCoord.z * 0.9, 3.0),
+			1e-2, 3e3);
+	accum = vec4(frag_color.rgb * a, a) * w;
+	revealage = a;
+}
+
@@ -0,0 +1,17 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+layout(input_attachment_index = 0, set = 0, binding = 0) uniform subpassInput accum_input;
+layout(input_attachment_index = 1, set = 0, binding = 1) uniform subpassInput revealage_input;
+
+layout(location = 0) out vec4 color;
+
+void main() {
+	const float revealage = subpassLoad(revealage_input).r;
+	if (revealage >= 1.0) {
+		discard;
+	}
+	const vec4 accum = subpassLoad(accum_input);
+	color = vec4(accum.rgb / max(accum.a, 1e-5), 1.0 - revealage);
+}
+
@@ -0,0 +1,352 @@
+#include <array>
+#include <cstddef>
+#include "overlay.h"
+#include "spirv_shaders_embedded_spv.h"
+
+Overlay create_overlay(VkDevice device, VkPhysicalDevice physical_device, ResourceManager &resources,
+		const FontAtlas &font, VkExtent2D extent, VkFormat target_format, VkImageLayout target_layout,
+		const std::vector<VkImageView> &target_views, uint32_t num_frames, uint32_t max_quads)
+{
+	Overlay overlay;
+	overlay.extent = extent;
+	overlay.font = &font;
+	overlay.num_frames = num_frames;
+	overlay.max_vertices = max_quads * 6;
+
+	const VkDeviceSize vertex_bytes = VkDeviceSize(overlay.max_vertices) * num_frames * sizeof(OverlayVertex);
+	overlay.vertex_buffer = create_buffer(device, physical_device, vertex_bytes, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+	CHECK_VULKAN(vkMapMemory(device, overlay.vertex_buffer.mem, 0, vertex_bytes, 0,
+			reinterpret_cast<void**>(&overlay.vertex_mapping)));
+
+	overlay.desc_layout = create_overlay_desc_layout(device);
+	{
+		VkDescriptorPoolSize pool_size = {};
+		pool_size.type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+		pool_size.descriptorCount = 1;
+
+		VkDescriptorPoolCreateInfo pool_info = {};
+		pool_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+		pool_info.maxSets = 1;
+		pool_info.poolSizeCount = 1;
+		pool_info.pPoolSizes = &pool_size;
+		CHECK_VULKAN(vkCreateDescriptorPool(device, &pool_info, nullptr, &overlay.desc_pool));
+
+		VkDescriptorSetAllocateInfo alloc_info = {};
+		alloc_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+		alloc_info.descriptorPool = overlay.desc_pool;
+		alloc_info.descriptorSetCount = 1;
+		alloc_info.pSetLayouts = &overlay.desc_layout;
+		CHECK_VULKAN(vkAllocateDescriptorSets(device, &alloc_info, &overlay.desc_set));
+
+		VkDescriptorImageInfo image_info = {};
+		image_info.sampler = font.sampler;
+		image_info.imageView = font.image.view;
+		image_info.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+		VkWriteDescriptorSet write = {};
+		write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		write.dstSet = overlay.desc_set;
+		write.dstBinding = 0;
+		write.descriptorCount = 1;
+		write.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+		write.pImageInfo = &image_info;
+		vkUpdateDescriptorSets(device, 1, &write, 0, nullptr);
+	}
+
+	// The overlay is drawn over whatever was rendered to the target, by a render pass or a copy
+	{
+		VkAttachmentDescription color_attachment = {};
+		color_attachment.format = target_format;
+		color_attachment.samples = VK_SAMPLE_COUNT_1_BIT;
+		color_attachment.loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
+		color_attachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+		color_attachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+		color_attachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+		color_attachment.initialLayout = target_layout;
+		color_attachment.finalLayout = target_layout;
+
+		VkAttachmentReference color_attachment_ref = {};
+		color_attachment_ref.attachment = 0;
+		color_attachment_ref.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+		VkSubpassDescription subpass = {};
+		subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+		subpass.colorAttachmentCount = 1;
+		subpass.pColorAttachments = &color_attachment_ref;
+
+		VkSubpassDependency dependency = {};
+		dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
+		dependency.dstSubpass = 0;
+		dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT;
+		dependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+		dependency.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+		dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+
+		VkRenderPassCreateInfo render_pass_info = {};
+		render_pass_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+		render_pass_info.attachmentCount = 1;
+		render_pass_info.pAttachments = &color_attachment;
+		render_pass_info.subpassCount = 1;
+		render_pass_info.pSubpasses = &subpass;
+		render_pass_info.dependencyCount = 1;
+		render_pass_info.pDependencies = &dependency;
+		CHECK_VULKAN(vkCreateRenderPass(device, &render_pass_info, nullptr, &overlay.render_pass));
+	}
+
+	for (const auto &v : target_views) {
+		VkFramebufferCreateInfo create_info = {};
+		create_info.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+		create_info.renderPass = overlay.render_pass;
+		create_info.attachmentCount = 1;
+		create_info.pAttachments = &v;
+		create_info.width = extent.width;
+		create_info.height = extent.height;
+		create_info.layers = 1;
+		VkFramebuffer fb = VK_NULL_HANDLE;
+		CHECK_VULKAN(vkCreateFramebuffer(device, &create_info, nullptr, &fb));
+		overlay.framebuffers.push_back(fb);
+	}
+
+	overlay.pipeline_layout = create_overlay_pipeline_layout(device, overlay.desc_layout);
+	overlay.pipeline = create_overlay_pipeline(device, overlay.pipeline_layout, overlay.render_pass,
+			VK_SAMPLE_COUNT_1_BIT, extent);
+	overlay.pipeline_handle = add_pipeline(resources, overlay.pipeline);
+
+	return overlay;
+}
+
+void overlay_begin_frame(Overlay &overlay, uint32_t frame) {
+	overlay.frame = frame;
+	overlay.num_vertices = 0;
+}
+
+static void overlay_quad(Overlay &overlay, float x0, float y0, float x1, float y1,
+		float u0, float v0, float u1, float v1, uint32_t color)
+{
+	if (overlay.num_vertices + 6 > overlay.max_vertices) {
+		return;
+	}
+	OverlayVertex *v = overlay.vertex_mapping + overlay.frame * overlay.max_vertices + overlay.num_vertices;
+	v[0] = OverlayVertex{{x0, y0}, {u0, v0}, color};
+	v[1] = OverlayVertex{{x1, y0}, {u1, v0}, color};
+	v[2] = OverlayVertex{{x1, y1}, {u1, v1}, color};
+	v[3] = v[0];
+	v[4] = v[2];
+	v[5] = OverlayVertex{{x0, y1}, {u0, v1}, color};
+	overlay.num_vertices += 6;
+}
+
+void overlay_rect(Overlay &overlay, float x, float y, float w, float h, uint32_t color) {
+	const FontAtlas &font = *overlay.font;
+	overlay_quad(overlay, x, y, x + w, y + h, font.white_u, font.white_v, font.white_u, font.white_v, color);
+}
+
+float overlay_text(Overlay &overlay, float x, float y, const char *text, uint32_t color) {
+	for (const char *c = text; *c; ++c) {
+		const Glyph &g = find_glyph(*overlay.font, *c);
+		if (g.width > 0.f) {
+			const float gx = x + g.x_offset;
+			const float gy = y + g.y_offset;
+			overlay_quad(overlay, gx, gy, gx + g.width, gy + g.height, g.u0, g.v0, g.u1, g.v1, color);
+		}
+		x += g.advance;
+	}
+	return x;
+}
+
+void record_overlay(const Overlay &overlay, VkCommandBuffer cmd_buf, uint32_t target_index) {
+	if (overlay.num_vertices == 0) {
+		return;
+	}
+
+	VkRenderPassBeginInfo render_pass_info = {};
+	render_pass_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+	render_pass_info.renderPass = overlay.render_pass;
+	render_pass_info.framebuffer = overlay.framebuffers[target_index];
+	render_pass_info.renderArea.extent = overlay.extent;
+	vkCmdBeginRenderPass(cmd_buf, &render_pass_info, VK_SUBPASS_CONTENTS_INLINE);
+
+	vkCmdBindPipeline(cmd_buf, VK_PIPELINE_BIND_POINT_GRAPHICS, overlay.pipeline);
+	vkCmdBindDescriptorSets(cmd_buf, VK_PIPELINE_BIND_POINT_GRAPHICS, overlay.pipeline_layout, 0, 1,
+			&overlay.desc_set, 0, nullptr);
+
+	const std::array<float, 2> pixel_scale = { 2.f / overlay.extent.width, 2.f / overlay.extent.height };
+	vkCmdPushConstants(cmd_buf, overlay.pipeline_layout, VK_SHADER_STAGE_VERTEX_BIT, 0,
+			sizeof(pixel_scale), pixel_scale.data());
+
+	const VkDeviceSize offset = VkDeviceSize(overlay.frame) * overlay.max_vertices * sizeof(OverlayVertex);
+	vkCmdBindVertexBuffers(cmd_buf, 0, 1, &overlay.vertex_buffer.buffer, &offset);
+	vkCmdDraw(cmd_buf, overlay.num_vertices, 1, 0, 0);
+
+	vkCmdEndRenderPass(cmd_buf);
+}
+
+void destroy_overlay(VkDevice device, ResourceManager &resources, Overlay &overlay) {
+	release_pipeline(resources, overlay.pipeline_handle);
+	vkDestroyPipelineLayout(device, overlay.pipeline_layout, nullptr);
+	for (auto &fb : overlay.framebuffers) {
+		vkDestroyFramebuffer(device, fb, nullptr);
+	}
+	vkDestroyRenderPass(device, overlay.render_pass, nullptr);
+	vkDestroyDescriptorPool(device, overlay.desc_pool, nullptr);
+	vkDestroyDescriptorSetLayout(device, overlay.desc_layout, nullptr);
+	vkUnmapMemory(device, overlay.vertex_buffer.mem);
+	destroy_buffer(device, overlay.vertex_buffer);
+	overlay = Overlay();
+}
+
+VkDescriptorSetLayout create_overlay_desc_layout(VkDevice device) {
+	VkDescriptorSetLayoutBinding binding = {};
+	binding.binding = 0;
+	binding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	binding.descriptorCount = 1;
+	binding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+
+	VkDescriptorSetLayoutCreateInfo layout_info = {};
+	layout_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	layout_info.bindingCount = 1;
+	layout_info.pBindings = &binding;
+	VkDescriptorSetLayout desc_layout = VK_NULL_HANDLE;
+	CHECK_VULKAN(vkCreateDescriptorSetLayout(device, &layout_info, nullptr, &desc_layout));
+	return desc_layout;
+}
+
+VkPipelineLayout create_overlay_pipeline_layout(VkDevice device, VkDescriptorSetLayout desc_layout) {
+	VkPushConstantRange push_constants = {};
+	push_constants.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+	push_constants.offset = 0;
+	push_constants.size = 2 * sizeof(float);
+
+	VkPipelineLayoutCreateInfo pipeline_info = {};
+	pipeline_info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	pipeline_info.setLayoutCount = 1;
+	pipeline_info.pSetLayouts = &desc_layout;
+	pipeline_info.pushConstantRangeCount = 1;
+	pipeline_info.pPushConstantRanges = &push_constants;
+	VkPipelineLayout layout = VK_NULL_HANDLE;
+	CHECK_VULKAN(vkCreatePipelineLayout(device, &pipeline_info, nullptr, &layout));
+	return layout;
+}
+
+VkPipeline create_overlay_pipeline(VkDevice device, VkPipelineLayout layout, VkRenderPass render_pass,
+		VkSampleCountFlagBits samples, VkExtent2D extent)
+{
+	VkShaderModule vertex_shader_module = create_shader_module(device, overlay_spv, sizeof(overlay_spv));
+	VkShaderModule fragment_shader_module =
+		create_shader_module(device, overlay_atlas_spv, sizeof(overlay_atlas_spv));
+
+	VkPipelineShaderStageCreateInfo vertex_stage = {};
+	vertex_stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	vertex_stage.stage = VK_SHADER_STAGE_VERTEX_BIT;
+	vertex_stage.module = vertex_shader_module;
+	vertex_stage.pName = "main";
+
+	VkPipelineShaderStageCreateInfo fragment_stage = {};
+	fragment_stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	fragment_stage.stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+	fragment_stage.module = fragment_shader_module;
+	fragment_stage.pName = "main";
+
+	std::array<VkPipelineShaderStageCreateInfo, 2> shader_stages = { vertex_stage, fragment_stage };
+
+	VkVertexInputBindingDescription vertex_binding = {};
+	vertex_binding.binding = 0;
+	vertex_binding.stride = sizeof(OverlayVertex);
+	vertex_binding.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+
+	std::array<VkVertexInputAttributeDescription, 3> vertex_attribs = {};
+	vertex_attribs[0].location = 0;
+	vertex_attribs[0].binding = 0;
+	vertex_attribs[0].format = VK_FORMAT_R32G32_SFLOAT;
+	vertex_attribs[0].offset = offsetof(OverlayVertex, pos);
+	vertex_attribs[1].location = 1;
+	vertex_attribs[1].binding = 0;
+	vertex_attribs[1].format = VK_FORMAT_R32G32_SFLOAT;
+	vertex_attribs[1].offset = offsetof(OverlayVertex, uv);
+	vertex_attribs[2].location = 2;
+	vertex_attribs[2].binding = 0;
+	vertex_attribs[2].format = VK_FORMAT_R8G8B8A8_UNORM;
+	vertex_attribs[2].offset = offsetof(OverlayVertex, color);
+
+	VkPipelineVertexInputStateCreateInfo vertex_input_info = {};
+	vertex_input_info.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+	vertex_input_info.vertexBindingDescriptionCount = 1;
+	vertex_input_info.pVertexBindingDescriptions = &vertex_binding;
+	vertex_input_info.vertexAttributeDescriptionCount = vertex_attribs.size();
+	vertex_input_info.pVertexAttributeDescriptions = vertex_attribs.data();
+
+	VkPipelineInputAssemblyStateCreateInfo input_assembly = {};
+	input_assembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+	input_assembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+	input_assembly.primitiveRestartEnable = VK_FALSE;
+
+	VkViewport viewport = {};
+	viewport.x = 0.0f;
+	viewport.y = 0.0f;
+	viewport.width = extent.width;
+	viewport.height = extent.height;
+	viewport.minDepth = 0.0f;
+	viewport.maxDepth = 1.0f;
+
+	VkRect2D scissor = {};
+	scissor.extent = extent;
+
+	VkPipelineViewportStateCreateInfo viewport_state_info = {};
+	viewport_state_info.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+	viewport_state_info.viewportCount = 1;
+	viewport_state_info.pViewports = &viewport;
+	viewport_state_info.scissorCount = 1;
+	viewport_state_info.pScissors = &scissor;
+
+	VkPipelineRasterizationStateCreateInfo rasterizer_info = {};
+	rasterizer_info.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+	rasterizer_info.depthClampEnable = VK_FALSE;
+	rasterizer_info.rasterizerDiscardEnable = VK_FALSE;
+	rasterizer_info.polygonMode = VK_POLYGON_MODE_FILL;
+	rasterizer_info.lineWidth = 1.f;
+	rasterizer_info.cullMode = VK_CULL_MODE_NONE;
+	rasterizer_info.frontFace = VK_FRONT_FACE_CLOCKWISE;
+	rasterizer_info.depthBiasEnable = VK_FALSE;
+
+	VkPipelineMultisampleStateCreateInfo multisampling = {};
+	multisampling.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+	multisampling.sampleShadingEnable = VK_FALSE;
+	multisampling.rasterizationSamples = samples;
+
+	VkPipelineColorBlendAttachmentState blend_mode = {};
+	blend_mode.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+	blend_mode.blendEnable = VK_TRUE;
+	blend_mode.srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
+	blend_mode.dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+	blend_mode.colorBlendOp = VK_BLEND_OP_ADD;
+	blend_mode.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+	blend_mode.dstAlphaBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+	blend_mode.alphaBlendOp = VK_BLEND_OP_ADD;
+
+	VkPipelineColorBlendStateCreateInfo blend_info = {};
+	blend_info.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+	blend_info.logicOpEnable = VK_FALSE;
+	blend_info.attachmentCount = 1;
+	blend_info.pAttachments = &blend_mode;
+
+	VkGraphicsPipelineCreateInfo graphics_pipeline_info = {};
+	graphics_pipeline_info.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+	graphics_pipeline_info.stageCount = shader_stages.size();
+	graphics_pipeline_info.pStages = shader_stages.data();
+	graphics_pipeline_info.pVertexInputState = &vertex_input_info;
+	graphics_pipeline_info.pInputAssemblyState = &input_assembly;
+	graphics_pipeline_info.pViewportState = &viewport_state_info;
+	graphics_pipeline_info.pRasterizationState = &rasterizer_info;
+	graphics_pipeline_info.pMultisampleState = &multisampling;
+	graphics_pipeline_info.pColorBlendState = &blend_info;
+	graphics_pipeline_info.layout = layout;
+	graphics_pipeline_info.renderPass = render_pass;
+	graphics_pipeline_info.subpass = 0;
+	VkPipeline pipeline = VK_NULL_HANDLE;
+	CHECK_VULKAN(vkCreateGraphicsPipelines(device, pipeline_cache(), 1, &graphics_pipeline_info, nullptr, &pipeline));
+
+	vkDestroyShaderModule(device, vertex_shader_module, nullptr);
+	vkDestroyShaderModule(device, fragment_shader_module, nullptr);
+	return pipeline;
+}
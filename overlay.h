@@ -0,0 +1,79 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <vulkan/vulkan.h>
+#include "font_atlas.h"
+#include "resources.h"
+#include "vulkan_utils.h"
+
+struct OverlayVertex {
+	float pos[2];
+	float uv[2];
+	// RGBA8, red in the low byte
+	uint32_t color;
+};
+
+inline uint32_t overlay_color(uint8_t r, uint8_t g, uint8_t b, uint8_t a = 255) {
+	return uint32_t(r) | (uint32_t(g) << 8) | (uint32_t(b) << 16) | (uint32_t(a) << 24);
+}
+
+// Batched 2D overlay of text and solid rectangles, in pixel coordinates from the top left.
+// The quads for a frame are written into that frame's region of a persistently mapped vertex
+// buffer and drawn with a single call, in a render pass loading the target so it's drawn
+// over the rendered frame. The pipeline is owned by the resource manager.
+struct Overlay {
+	VkExtent2D extent = {};
+	const FontAtlas *font = nullptr;
+
+	// The vertex buffer is split into one region per frame in flight so a frame's vertices
+	// aren't overwritten while the GPU may still be reading them
+	uint32_t max_vertices = 0;
+	uint32_t num_frames = 0;
+	uint32_t frame = 0;
+	Buffer vertex_buffer;
+	OverlayVertex *vertex_mapping = nullptr;
+	uint32_t num_vertices = 0;
+
+	VkDescriptorSetLayout desc_layout = VK_NULL_HANDLE;
+	VkDescriptorPool desc_pool = VK_NULL_HANDLE;
+	VkDescriptorSet desc_set = VK_NULL_HANDLE;
+
+	VkRenderPass render_pass = VK_NULL_HANDLE;
+	std::vector<VkFramebuffer> framebuffers;
+	VkPipelineLayout pipeline_layout = VK_NULL_HANDLE;
+	VkPipeline pipeline = VK_NULL_HANDLE;
+	PipelineHandle pipeline_handle;
+};
+
+// The targets are expected to be in target_layout before and after the overlay is drawn.
+// The font must outlive the overlay
+Overlay create_overlay(VkDevice device, VkPhysicalDevice physical_device, ResourceManager &resources,
+		const FontAtlas &font, VkExtent2D extent, VkFormat target_format, VkImageLayout target_layout,
+		const std::vector<VkImageView> &target_views, uint32_t num_frames, uint32_t max_quads = 8192);
+
+// Start a new batch in the frame's region of the vertex buffer
+void overlay_begin_frame(Overlay &overlay, uint32_t frame);
+
+// Quads past the buffer capacity are dropped
+void overlay_rect(Overlay &overlay, float x, float y, float w, float h, uint32_t color);
+
+// Draw a line of text with its top left at x, y and return the x position after it
+float overlay_text(Overlay &overlay, float x, float y, const char *text, uint32_t color);
+
+void record_overlay(const Overlay &overlay, VkCommandBuffer cmd_buf, uint32_t target_index);
+
+// Releases the pipeline to the resource manager
+void destroy_overlay(VkDevice device, ResourceManager &resources, Overlay &overlay);
+
+// Create the pipeline drawing OverlayVertex triangles with the overlay shaders, for other 2D
+// renderers drawing in their own render passes. The layout takes a font atlas sampler in set 0
+// and the 2 / target size scale in a vertex push constant
+VkPipeline create_overlay_pipeline(VkDevice device, VkPipelineLayout layout, VkRenderPass render_pass,
+		VkSampleCountFlagBits samples, VkExtent2D extent);
+
+// The descriptor set layout with the font atlas sampler
+VkDescriptorSetLayout create_overlay_desc_layout(VkDevice device);
+
+VkPipelineLayout create_overlay_pipeline_layout(VkDevice device, VkDescriptorSetLayout desc_layout);
+
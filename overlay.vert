@@ -0,0 +1,21 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+// 2D overlay vertices in pixels from the top left of the target
+layout(location = 0) in vec2 pos;
+layout(location = 1) in vec2 uv;
+layout(location = 2) in vec4 color;
+
+layout(push_constant) uniform OverlayParams {
+	// 2 / target size
+	vec2 pixel_scale;
+};
+
+layout(location = 0) out vec2 frag_uv;
+layout(location = 1) out vec4 frag_color;
+
+void main() {
+	gl_Position = vec4(pos * pixel_scale - 1.0, 0.0, 1.0);
+	frag_uv = uv;
+	frag_color = color;
+}
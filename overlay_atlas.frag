@@ -0,0 +1,14 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+// The glyph atlas stores coverage, with an opaque texel for the solid rectangles
+layout(set = 0, binding = 0) uniform sampler2D atlas;
+
+layout(location = 0) in vec2 frag_uv;
+layout(location = 1) in vec4 frag_color;
+
+layout(location = 0) out vec4 color;
+
+void main() {
+	color = vec4(frag_color.rgb, frag_color.a * texture(atlas, frag_uv).r);
+}
@@ -0,0 +1,46 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+// Camera facing billboards for the alive particles, expanded from 6 vertices per instance.
+// The instance count comes from the compaction on the GPU
+struct Particle {
+	vec4 position_life;
+	vec4 velocity_size;
+};
+
+layout(set = 0, binding = 0, std430) readonly buffer Particles {
+	Particle particles[];
+};
+
+layout(set = 0, binding = 2, std430) readonly buffer AliveIndices {
+	uint alive_indices[];
+};
+
+layout(push_constant) uniform CameraParams {
+	mat4 view_proj;
+	vec4 cam_right;
+	vec4 cam_up;
+};
+
+layout(location = 0) out vec2 frag_uv;
+layout(location = 1) out vec4 frag_color;
+
+vec2 corners[6] = vec2[](
+	vec2(-1.0, -1.0),
+	vec2(1.0, -1.0),
+	vec2(1.0, 1.0),
+	vec2(-1.0, -1.0),
+	vec2(1.0, 1.0),
+	vec2(-1.0, 1.0)
+);
+
+void main() {
+	const Particle p = particles[alive_indices[gl_InstanceIndex]];
+	const vec2 c = corners[gl_VertexIndex];
+	const vec3 pos = p.position_life.xyz + (cam_right.xyz * c.x + cam_up.xyz * c.y) * p.velocity_size.w;
+	gl_Position = view_proj * vec4(pos, 1.0);
+	frag_uv = c;
+	// Hot and bright when emitted, fading to a dim red
+	const float heat = clamp(p.position_life.w / 4.0, 0.0, 1.0);
+	frag_color = vec4(mix(vec3(0.6, 0.1, 0.05), vec3(1.0, 0.8, 0.4), heat), heat * 0.8 + 0.2);
+}
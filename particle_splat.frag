@@ -0,0 +1,15 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+layout(location = 0) in vec2 frag_uv;
+layout(location = 1) in vec4 frag_color;
+
+layout(location = 0) out vec4 color;
+
+void main() {
+	const float falloff = 1.0 - dot(frag_uv, frag_uv);
+	if (falloff <= 0.0) {
+		discard;
+	}
+	color = vec4(frag_color.rgb, frag_color.a * falloff);
+}
@@ -0,0 +1,391 @@
+#include <algorithm>
+#include <cmath>
+#include <array>
+#include <cstring>
+#include <iostream>
+#include <limits>
+#include <numeric>
+#include <vector>
+#include "particles.h"
+#include "spirv_shaders_embedded_spv.h"
+
+// Matches the shaders' Particle
+struct GpuParticle {
+	float position_life[4];
+	float velocity_size[4];
+};
+
+struct EmitParams {
+	uint32_t head = 0;
+	uint32_t count = 0;
+	uint32_t capacity = 0;
+	uint32_t seed = 0;
+};
+
+struct SimulateParams {
+	uint32_t capacity = 0;
+	float dt = 0.f;
+};
+
+struct ParticleCameraParams {
+	mat4 view_proj;
+	float cam_right[4];
+	float cam_up[4];
+};
+
+// Longest a particle lives, for the default emit rate
+static const float max_particle_life = 4.f;
+
+static VkPipeline create_particle_compute_pipeline(VkDevice device, VkPipelineLayout layout, const uint32_t *code,
+		size_t code_size)
+{
+	VkShaderModule module = create_shader_module(device, code, code_size);
+
+	VkComputePipelineCreateInfo create_info = {};
+	create_info.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+	create_info.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	create_info.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+	create_info.stage.module = module;
+	create_info.stage.pName = "main";
+	create_info.layout = layout;
+
+	VkPipeline pipeline = VK_NULL_HANDLE;
+	CHECK_VULKAN(vkCreateComputePipelines(device, pipeline_cache(), 1, &create_info, nullptr, &pipeline));
+	vkDestroyShaderModule(device, module, nullptr);
+	return pipeline;
+}
+
+ParticleSystem create_particle_system(VkDevice device, VkPhysicalDevice physical_device, VkQueue queue,
+		VkCommandPool command_pool, uint32_t capacity, float emit_rate)
+{
+	ParticleSystem particles;
+	particles.capacity = capacity;
+	particles.emit_rate = emit_rate > 0.f ? emit_rate : capacity / max_particle_life;
+
+	const VkDeviceSize index_bytes = capacity * sizeof(uint32_t);
+	particles.particles = create_buffer(device, physical_device, capacity * sizeof(GpuParticle),
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+	particles.alive_flags = create_buffer(device, physical_device, index_bytes,
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+	particles.slot_indices = create_buffer(device, physical_device, index_bytes,
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+	particles.alive_indices = create_buffer(device, physical_device, index_bytes,
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+	particles.alive_count = create_buffer(device, physical_device, sizeof(uint32_t),
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+	particles.draw_indirect = create_buffer(device, physical_device, sizeof(VkDrawIndirectCommand),
+			VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+	// Start with every particle dead and nothing to draw
+	{
+		std::vector<uint32_t> indices(capacity, 0);
+		std::iota(indices.begin(), indices.end(), 0);
+		Buffer index_upload = create_host_buffer(device, physical_device, indices.data(), index_bytes,
+				VK_BUFFER_USAGE_TRANSFER_SRC_BIT);
+
+		VkDrawIndirectCommand draw = {};
+		draw.vertexCount = 6;
+		Buffer draw_upload = create_host_buffer(device, physical_device, &draw, sizeof(draw),
+				VK_BUFFER_USAGE_TRANSFER_SRC_BIT);
+
+		VkCommandBuffer cmd_buf = begin_one_time_commands(device, command_pool);
+		vkCmdFillBuffer(cmd_buf, particles.particles.buffer, 0, VK_WHOLE_SIZE, 0);
+		VkBufferCopy region = {};
+		region.size = index_bytes;
+		vkCmdCopyBuffer(cmd_buf, index_upload.buffer, particles.slot_indices.buffer, 1, &region);
+		region.size = sizeof(draw);
+		vkCmdCopyBuffer(cmd_buf, draw_upload.buffer, particles.draw_indirect.buffer, 1, &region);
+		end_one_time_commands(device, queue, command_pool, cmd_buf);
+
+		destroy_buffer(device, index_upload);
+		destroy_buffer(device, draw_upload);
+	}
+
+	particles.prims = create_gpu_primitives(device, physical_device);
+	particles.compact = create_gpu_compact(device, physical_device, particles.prims, particles.slot_indices.buffer,
+			particles.alive_flags.buffer, particles.alive_indices.buffer, particles.alive_count.buffer, capacity);
+
+	// The compute and draw pipelines share the set: the particles, the alive flags written by
+	// the simulation and the compacted alive indices read by the draw
+	{
+		std::array<VkDescriptorSetLayoutBinding, 3> bindings = {};
+		for (uint32_t i = 0; i < bindings.size(); ++i) {
+			bindings[i].binding = i;
+			bindings[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+			bindings[i].descriptorCount = 1;
+			bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT | VK_SHADER_STAGE_VERTEX_BIT;
+		}
+
+		VkDescriptorSetLayoutCreateInfo info = {};
+		info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+		info.bindingCount = bindings.size();
+		info.pBindings = bindings.data();
+		CHECK_VULKAN(vkCreateDescriptorSetLayout(device, &info, nullptr, &particles.desc_layout));
+	}
+	{
+		VkDescriptorPoolSize pool_size = {};
+		pool_size.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		pool_size.descriptorCount = 3;
+
+		VkDescriptorPoolCreateInfo info = {};
+		info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+		info.maxSets = 1;
+		info.poolSizeCount = 1;
+		info.pPoolSizes = &pool_size;
+		CHECK_VULKAN(vkCreateDescriptorPool(device, &info, nullptr, &particles.desc_pool));
+
+		VkDescriptorSetAllocateInfo alloc_info = {};
+		alloc_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+		alloc_info.descriptorPool = particles.desc_pool;
+		alloc_info.descriptorSetCount = 1;
+		alloc_info.pSetLayouts = &particles.desc_layout;
+		CHECK_VULKAN(vkAllocateDescriptorSets(device, &alloc_info, &particles.desc_set));
+
+		const std::array<VkBuffer, 3> buffers = {
+			particles.particles.buffer, particles.alive_flags.buffer, particles.alive_indices.buffer
+		};
+		std::array<VkDescriptorBufferInfo, 3> buf_infos = {};
+		std::array<VkWriteDescriptorSet, 3> writes = {};
+		for (uint32_t i = 0; i < writes.size(); ++i) {
+			buf_infos[i].buffer = buffers[i];
+			buf_infos[i].range = VK_WHOLE_SIZE;
+
+			writes[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+			writes[i].dstSet = particles.desc_set;
+			writes[i].dstBinding = i;
+			writes[i].descriptorCount = 1;
+			writes[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+			writes[i].pBufferInfo = &buf_infos[i];
+		}
+		vkUpdateDescriptorSets(device, writes.size(), writes.data(), 0, nullptr);
+	}
+
+	{
+		VkPushConstantRange push_range = {};
+		push_range.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+		push_range.size = std::max(sizeof(EmitParams), sizeof(SimulateParams));
+
+		VkPipelineLayoutCreateInfo info = {};
+		info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+		info.setLayoutCount = 1;
+		info.pSetLayouts = &particles.desc_layout;
+		info.pushConstantRangeCount = 1;
+		info.pPushConstantRanges = &push_range;
+		CHECK_VULKAN(vkCreatePipelineLayout(device, &info, nullptr, &particles.compute_layout));
+
+		push_range.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+		push_range.size = sizeof(ParticleCameraParams);
+		CHECK_VULKAN(vkCreatePipelineLayout(device, &info, nullptr, &particles.draw_layout));
+	}
+	particles.emit_pipeline = create_particle_compute_pipeline(device, particles.compute_layout,
+			particle_emit_spv, sizeof(particle_emit_spv));
+	particles.simulate_pipeline = create_particle_compute_pipeline(device, particles.compute_layout,
+			particle_simulate_spv, sizeof(particle_simulate_spv));
+	return particles;
+}
+
+void create_particle_pipeline(VkDevice device, ResourceManager &resources, ParticleSystem &particles,
+		VkRenderPass render_pass, VkSampleCountFlagBits samples, VkExtent2D extent)
+{
+	if (is_valid(resources, particles.draw_pipeline_handle)) {
+		release_pipeline(resources, particles.draw_pipeline_handle);
+	}
+
+	VkShaderModule vertex_shader_module = create_shader_module(device, particle_spv, sizeof(particle_spv));
+	VkShaderModule fragment_shader_module = create_shader_module(device, particle_splat_spv, sizeof(particle_splat_spv));
+
+	VkPipelineShaderStageCreateInfo vertex_stage = {};
+	vertex_stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	vertex_stage.stage = VK_SHADER_STAGE_VERTEX_BIT;
+	vertex_stage.module = vertex_shader_module;
+	vertex_stage.pName = "main";
+
+	VkPipelineShaderStageCreateInfo fragment_stage = {};
+	fragment_stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	fragment_stage.stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+	fragment_stage.module = fragment_shader_module;
+	fragment_stage.pName = "main";
+
+	std::array<VkPipelineShaderStageCreateInfo, 2> shader_stages = { vertex_stage, fragment_stage };
+
+	// The billboards are expanded from the vertex and instance index, no vertex buffers
+	VkPipelineVertexInputStateCreateInfo vertex_input_info = {};
+	vertex_input_info.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+
+	VkPipelineInputAssemblyStateCreateInfo input_assembly = {};
+	input_assembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+	input_assembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+	input_assembly.primitiveRestartEnable = VK_FALSE;
+
+	VkViewport viewport = {};
+	viewport.x = 0.0f;
+	viewport.y = 0.0f;
+	viewport.width = extent.width;
+	viewport.height = extent.height;
+	viewport.minDepth = 0.0f;
+	viewport.maxDepth = 1.0f;
+
+	VkRect2D scissor = {};
+	scissor.extent = extent;
+
+	VkPipelineViewportStateCreateInfo viewport_state_info = {};
+	viewport_state_info.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+	viewport_state_info.viewportCount = 1;
+	viewport_state_info.pViewports = &viewport;
+	viewport_state_info.scissorCount = 1;
+	viewport_state_info.pScissors = &scissor;
+
+	VkPipelineRasterizationStateCreateInfo rasterizer_info = {};
+	rasterizer_info.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+	rasterizer_info.depthClampEnable = VK_FALSE;
+	rasterizer_info.rasterizerDiscardEnable = VK_FALSE;
+	rasterizer_info.polygonMode = VK_POLYGON_MODE_FILL;
+	rasterizer_info.lineWidth = 1.f;
+	rasterizer_info.cullMode = VK_CULL_MODE_NONE;
+	rasterizer_info.frontFace = VK_FRONT_FACE_CLOCKWISE;
+	rasterizer_info.depthBiasEnable = VK_FALSE;
+
+	VkPipelineMultisampleStateCreateInfo multisampling = {};
+	multisampling.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+	multisampling.sampleShadingEnable = VK_FALSE;
+	multisampling.rasterizationSamples = samples;
+
+	// Additive so the particles can be drawn in any order
+	VkPipelineColorBlendAttachmentState blend_mode = {};
+	blend_mode.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+	blend_mode.blendEnable = VK_TRUE;
+	blend_mode.srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
+	blend_mode.dstColorBlendFactor = VK_BLEND_FACTOR_ONE;
+	blend_mode.colorBlendOp = VK_BLEND_OP_ADD;
+	blend_mode.srcAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
+	blend_mode.dstAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+	blend_mode.alphaBlendOp = VK_BLEND_OP_ADD;
+
+	VkPipelineColorBlendStateCreateInfo blend_info = {};
+	blend_info.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+	blend_info.logicOpEnable = VK_FALSE;
+	blend_info.attachmentCount = 1;
+	blend_info.pAttachments = &blend_mode;
+
+	VkGraphicsPipelineCreateInfo graphics_pipeline_info = {};
+	graphics_pipeline_info.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+	graphics_pipeline_info.stageCount = shader_stages.size();
+	graphics_pipeline_info.pStages = shader_stages.data();
+	graphics_pipeline_info.pVertexInputState = &vertex_input_info;
+	graphics_pipeline_info.pInputAssemblyState = &input_assembly;
+	graphics_pipeline_info.pViewportState = &viewport_state_info;
+	graphics_pipeline_info.pRasterizationState = &rasterizer_info;
+	graphics_pipeline_info.pMultisampleState = &multisampling;
+	graphics_pipeline_info.pColorBlendState = &blend_info;
+	graphics_pipeline_info.layout = particles.draw_layout;
+	graphics_pipeline_info.renderPass = render_pass;
+	graphics_pipeline_info.subpass = 0;
+	CHECK_VULKAN(vkCreateGraphicsPipelines(device, pipeline_cache(), 1, &graphics_pipeline_info, nullptr,
+				&particles.draw_pipeline));
+	particles.draw_pipeline_handle = add_pipeline(resources, particles.draw_pipeline);
+
+	vkDestroyShaderModule(device, vertex_shader_module, nullptr);
+	vkDestroyShaderModule(device, fragment_shader_module, nullptr);
+}
+
+static void particle_barrier(VkCommandBuffer cmd_buf, VkAccessFlags src_access, VkAccessFlags dst_access,
+		VkPipelineStageFlags src_stage, VkPipelineStageFlags dst_stage)
+{
+	VkMemoryBarrier barrier = {};
+	barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	barrier.srcAccessMask = src_access;
+	barrier.dstAccessMask = dst_access;
+	vkCmdPipelineBarrier(cmd_buf, src_stage, dst_stage, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+}
+
+void record_particle_update(ParticleSystem &particles, VkCommandBuffer cmd_buf, float dt) {
+	// The emission carries over fractions of a particle so low rates still emit
+	const float to_emit = particles.emit_rate * dt + particles.emit_remainder;
+	EmitParams emit;
+	emit.head = particles.emit_head;
+	emit.count = std::min(uint32_t(to_emit), particles.capacity);
+	emit.capacity = particles.capacity;
+	emit.seed = particles.emit_seed++;
+	particles.emit_remainder = to_emit - std::floor(to_emit);
+	particles.emit_head = (particles.emit_head + emit.count) % particles.capacity;
+
+	// The previous frame's draw reads the particles, alive indices and draw command
+	particle_barrier(cmd_buf, 0, 0,
+			VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT,
+			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT);
+
+	vkCmdBindDescriptorSets(cmd_buf, VK_PIPELINE_BIND_POINT_COMPUTE, particles.compute_layout, 0, 1,
+			&particles.desc_set, 0, nullptr);
+	if (emit.count > 0) {
+		vkCmdBindPipeline(cmd_buf, VK_PIPELINE_BIND_POINT_COMPUTE, particles.emit_pipeline);
+		vkCmdPushConstants(cmd_buf, particles.compute_layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(emit), &emit);
+		vkCmdDispatch(cmd_buf, (emit.count + 255) / 256, 1, 1);
+		particle_barrier(cmd_buf, VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT,
+				VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+	}
+
+	SimulateParams simulate;
+	simulate.capacity = particles.capacity;
+	simulate.dt = dt;
+	vkCmdBindPipeline(cmd_buf, VK_PIPELINE_BIND_POINT_COMPUTE, particles.simulate_pipeline);
+	vkCmdPushConstants(cmd_buf, particles.compute_layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(simulate), &simulate);
+	vkCmdDispatch(cmd_buf, (particles.capacity + 255) / 256, 1, 1);
+	particle_barrier(cmd_buf, VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT,
+			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+
+	record_gpu_compact(cmd_buf, particles.prims, particles.compact, particles.capacity);
+
+	// The alive count becomes the draw's instance count
+	particle_barrier(cmd_buf, VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_TRANSFER_READ_BIT,
+			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+	VkBufferCopy region = {};
+	region.dstOffset = offsetof(VkDrawIndirectCommand, instanceCount);
+	region.size = sizeof(uint32_t);
+	vkCmdCopyBuffer(cmd_buf, particles.alive_count.buffer, particles.draw_indirect.buffer, 1, &region);
+
+	particle_barrier(cmd_buf, VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT,
+			VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_INDIRECT_COMMAND_READ_BIT,
+			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT,
+			VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT);
+}
+
+void draw_particles(const ParticleSystem &particles, VkCommandBuffer cmd_buf, const Camera &camera) {
+	const vec3 forward = normalize(camera.target - camera.position);
+	const vec3 right = normalize(cross(forward, camera.up));
+	const vec3 up = cross(right, forward);
+	ParticleCameraParams params = {};
+	params.view_proj = camera.proj() * camera.view();
+	params.cam_right[0] = right.x;
+	params.cam_right[1] = right.y;
+	params.cam_right[2] = right.z;
+	params.cam_up[0] = up.x;
+	params.cam_up[1] = up.y;
+	params.cam_up[2] = up.z;
+
+	vkCmdBindPipeline(cmd_buf, VK_PIPELINE_BIND_POINT_GRAPHICS, particles.draw_pipeline);
+	vkCmdBindDescriptorSets(cmd_buf, VK_PIPELINE_BIND_POINT_GRAPHICS, particles.draw_layout, 0, 1,
+			&particles.desc_set, 0, nullptr);
+	vkCmdPushConstants(cmd_buf, particles.draw_layout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(params), &params);
+	vkCmdDrawIndirect(cmd_buf, particles.draw_indirect.buffer, 0, 1, sizeof(VkDrawIndirectCommand));
+}
+
+void destroy_particle_system(VkDevice device, ResourceManager &resources, ParticleSystem &particles) {
+	if (is_valid(resources, particles.draw_pipeline_handle)) {
+		release_pipeline(resources, particles.draw_pipeline_handle);
+	}
+	vkDestroyPipeline(device, particles.emit_pipeline, nullptr);
+	vkDestroyPipeline(device, particles.simulate_pipeline, nullptr);
+	vkDestroyPipelineLayout(device, particles.draw_layout, nullptr);
+	vkDestroyPipelineLayout(device, particles.compute_layout, nullptr);
+	vkDestroyDescriptorPool(device, particles.desc_pool, nullptr);
+	vkDestroyDescriptorSetLayout(device, particles.desc_layout, nullptr);
+
+	destroy_gpu_compact(device, particles.compact);
+	destroy_gpu_primitives(device, particles.prims);
+	for (auto *b : { &particles.particles, &particles.alive_flags, &particles.slot_indices,
+			&particles.alive_indices, &particles.alive_count, &particles.draw_indirect })
+	{
+		destroy_buffer(device, *b);
+	}
+	particles = ParticleSystem();
+}
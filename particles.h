@@ -0,0 +1,71 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include "camera.h"
+#include "gpu_primitives.h"
+#include "resources.h"
+#include "vulkan_utils.h"
+
+// A particle fountain simulated and drawn entirely on the GPU. Emitted particles are written
+// into a ring buffer at the head, overwriting the oldest when it's full, the simulation ages
+// and moves them and flags the alive ones, and the flagged slots are compacted into the list
+// of particles to draw. The compaction's count is copied into the indirect draw's instance
+// count, so the CPU never reads anything back.
+struct ParticleSystem {
+	uint32_t capacity = 0;
+	// Particles emitted per second
+	float emit_rate = 0.f;
+	// The next slot of the ring buffer to emit into, and the fraction of a particle left over
+	// from the last update
+	uint32_t emit_head = 0;
+	float emit_remainder = 0.f;
+	uint32_t emit_seed = 0;
+
+	Buffer particles;
+	Buffer alive_flags;
+	// The slot indices 0..capacity-1, compacted by the alive flags into the alive indices
+	Buffer slot_indices;
+	Buffer alive_indices;
+	Buffer alive_count;
+	// A VkDrawIndirectCommand drawing 6 vertices for each alive particle
+	Buffer draw_indirect;
+
+	GpuPrimitives prims;
+	GpuCompact compact;
+
+	VkDescriptorSetLayout desc_layout = VK_NULL_HANDLE;
+	VkDescriptorPool desc_pool = VK_NULL_HANDLE;
+	VkDescriptorSet desc_set = VK_NULL_HANDLE;
+	VkPipelineLayout compute_layout = VK_NULL_HANDLE;
+	VkPipeline emit_pipeline = VK_NULL_HANDLE;
+	VkPipeline simulate_pipeline = VK_NULL_HANDLE;
+
+	// Owned by the resource manager, so it can be replaced while frames drawing with it are in flight
+	VkPipelineLayout draw_layout = VK_NULL_HANDLE;
+	VkPipeline draw_pipeline = VK_NULL_HANDLE;
+	PipelineHandle draw_pipeline_handle;
+};
+
+// Up to 16M particles. The emit rate defaults to keeping the ring buffer about full
+ParticleSystem create_particle_system(VkDevice device, VkPhysicalDevice physical_device, VkQueue queue,
+		VkCommandPool command_pool, uint32_t capacity, float emit_rate = 0.f);
+
+// (Re)create the billboard pipeline for the render pass the particles are drawn in, the
+// previous one is released to the resource manager
+void create_particle_pipeline(VkDevice device, ResourceManager &resources, ParticleSystem &particles,
+		VkRenderPass render_pass, VkSampleCountFlagBits samples, VkExtent2D extent);
+
+// Record the emission, simulation and compaction for the time step, outside a render pass.
+// Waits for the previous frame's particle draw before overwriting what it reads
+void record_particle_update(ParticleSystem &particles, VkCommandBuffer cmd_buf, float dt);
+
+// Draw the alive particles additively in the current render pass
+void draw_particles(const ParticleSystem &particles, VkCommandBuffer cmd_buf, const Camera &camera);
+
+void destroy_particle_system(VkDevice device, ResourceManager &resources, ParticleSystem &particles);
+
+// Simulate and draw the particles offscreen for the number of frames and print the update
+// and draw GPU times
+void run_particle_benchmark(VkDevice device, VkPhysicalDevice physical_device, VkQueue queue,
+		uint32_t queue_family, uint32_t capacity, uint32_t frames);
+
@@ -0,0 +1,196 @@
+#include <algorithm>
+#include <array>
+#include <iostream>
+#include <limits>
+#include <vector>
+#include "particles.h"
+
+static VkRenderPass create_particle_benchmark_render_pass(VkDevice device, VkFormat format) {
+	VkAttachmentDescription color_attachment = {};
+	color_attachment.format = format;
+	color_attachment.samples = VK_SAMPLE_COUNT_1_BIT;
+	color_attachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+	color_attachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+	color_attachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+	color_attachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+	color_attachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	color_attachment.finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+	VkAttachmentReference color_attachment_ref = {};
+	color_attachment_ref.attachment = 0;
+	color_attachment_ref.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+	VkSubpassDescription subpass = {};
+	subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+	subpass.colorAttachmentCount = 1;
+	subpass.pColorAttachments = &color_attachment_ref;
+
+	VkRenderPassCreateInfo render_pass_info = {};
+	render_pass_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+	render_pass_info.attachmentCount = 1;
+	render_pass_info.pAttachments = &color_attachment;
+	render_pass_info.subpassCount = 1;
+	render_pass_info.pSubpasses = &subpass;
+	VkRenderPass render_pass = VK_NULL_HANDLE;
+	CHECK_VULKAN(vkCreateRenderPass(device, &render_pass_info, nullptr, &render_pass));
+	return render_pass;
+}
+
+void run_particle_benchmark(VkDevice device, VkPhysicalDevice physical_device, VkQueue queue,
+		uint32_t queue_family, uint32_t capacity, uint32_t frames)
+{
+	VkPhysicalDeviceProperties properties = {};
+	vkGetPhysicalDeviceProperties(physical_device, &properties);
+	uint32_t num_families = 0;
+	vkGetPhysicalDeviceQueueFamilyProperties(physical_device, &num_families, nullptr);
+	std::vector<VkQueueFamilyProperties> family_props(num_families, VkQueueFamilyProperties{});
+	vkGetPhysicalDeviceQueueFamilyProperties(physical_device, &num_families, family_props.data());
+	if (family_props[queue_family].timestampValidBits == 0) {
+		std::cout << "Particle benchmark: the queue doesn't support timestamps\n";
+		return;
+	}
+
+	VkCommandPool command_pool = VK_NULL_HANDLE;
+	{
+		VkCommandPoolCreateInfo info = {};
+		info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+		info.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+		info.queueFamilyIndex = queue_family;
+		CHECK_VULKAN(vkCreateCommandPool(device, &info, nullptr, &command_pool));
+	}
+
+	VkCommandBuffer cmd_buf = VK_NULL_HANDLE;
+	{
+		VkCommandBufferAllocateInfo info = {};
+		info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+		info.commandPool = command_pool;
+		info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+		info.commandBufferCount = 1;
+		CHECK_VULKAN(vkAllocateCommandBuffers(device, &info, &cmd_buf));
+	}
+
+	VkFence fence = VK_NULL_HANDLE;
+	{
+		VkFenceCreateInfo info = {};
+		info.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+		CHECK_VULKAN(vkCreateFence(device, &info, nullptr, &fence));
+	}
+
+	// Before the update, between the update and draw, and after the draw
+	VkQueryPool query_pool = VK_NULL_HANDLE;
+	{
+		VkQueryPoolCreateInfo info = {};
+		info.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+		info.queryType = VK_QUERY_TYPE_TIMESTAMP;
+		info.queryCount = 3;
+		CHECK_VULKAN(vkCreateQueryPool(device, &info, nullptr, &query_pool));
+	}
+
+	const VkExtent2D extent = { 1920, 1080 };
+	const VkFormat target_format = VK_FORMAT_R8G8B8A8_UNORM;
+	VkRenderPass render_pass = create_particle_benchmark_render_pass(device, target_format);
+	Image target = create_image(device, physical_device, extent, 1, target_format,
+			VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT, VK_IMAGE_ASPECT_COLOR_BIT);
+	VkFramebuffer framebuffer = VK_NULL_HANDLE;
+	{
+		VkFramebufferCreateInfo info = {};
+		info.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+		info.renderPass = render_pass;
+		info.attachmentCount = 1;
+		info.pAttachments = &target.view;
+		info.width = extent.width;
+		info.height = extent.height;
+		info.layers = 1;
+		CHECK_VULKAN(vkCreateFramebuffer(device, &info, nullptr, &framebuffer));
+	}
+
+	ResourceManager resources;
+	ParticleSystem particles = create_particle_system(device, physical_device, queue, command_pool, capacity);
+	create_particle_pipeline(device, resources, particles, render_pass, VK_SAMPLE_COUNT_1_BIT, extent);
+
+	Buffer alive_readback = create_buffer(device, physical_device, sizeof(uint32_t),
+			VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+
+	Camera camera;
+	camera.position = vec3(0.f, 4.f, 14.f);
+	camera.target = vec3(0.f, 4.f, 0.f);
+	camera.aspect = float(extent.width) / extent.height;
+
+	// Only time the frames after the ring buffer has filled up
+	const float dt = 1.f / 60.f;
+	const uint32_t warmup_frames = 4 * 60;
+	double update_ms = 0.0;
+	double draw_ms = 0.0;
+	for (uint32_t i = 0; i < warmup_frames + frames; ++i) {
+		VkCommandBufferBeginInfo begin_info = {};
+		begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+		begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+		CHECK_VULKAN(vkBeginCommandBuffer(cmd_buf, &begin_info));
+		vkCmdResetQueryPool(cmd_buf, query_pool, 0, 3);
+
+		vkCmdWriteTimestamp(cmd_buf, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, query_pool, 0);
+		record_particle_update(particles, cmd_buf, dt);
+		vkCmdWriteTimestamp(cmd_buf, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, query_pool, 1);
+
+		VkRenderPassBeginInfo render_pass_info = {};
+		render_pass_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+		render_pass_info.renderPass = render_pass;
+		render_pass_info.framebuffer = framebuffer;
+		render_pass_info.renderArea.extent = extent;
+		VkClearValue clear_value = {};
+		render_pass_info.clearValueCount = 1;
+		render_pass_info.pClearValues = &clear_value;
+		vkCmdBeginRenderPass(cmd_buf, &render_pass_info, VK_SUBPASS_CONTENTS_INLINE);
+		draw_particles(particles, cmd_buf, camera);
+		vkCmdEndRenderPass(cmd_buf);
+		vkCmdWriteTimestamp(cmd_buf, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, query_pool, 2);
+
+		if (i + 1 == warmup_frames + frames) {
+			VkBufferCopy region = {};
+			region.size = sizeof(uint32_t);
+			vkCmdCopyBuffer(cmd_buf, particles.alive_count.buffer, alive_readback.buffer, 1, &region);
+		}
+		CHECK_VULKAN(vkEndCommandBuffer(cmd_buf));
+
+		VkSubmitInfo submit_info = {};
+		submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+		submit_info.commandBufferCount = 1;
+		submit_info.pCommandBuffers = &cmd_buf;
+		CHECK_VULKAN(vkQueueSubmit(queue, 1, &submit_info, fence));
+		CHECK_VULKAN(vkWaitForFences(device, 1, &fence, VK_TRUE, std::numeric_limits<uint64_t>::max()));
+		CHECK_VULKAN(vkResetFences(device, 1, &fence));
+
+		if (i >= warmup_frames) {
+			std::array<uint64_t, 3> timestamps = {};
+			CHECK_VULKAN(vkGetQueryPoolResults(device, query_pool, 0, 3, sizeof(timestamps), timestamps.data(),
+					sizeof(uint64_t), VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT));
+			update_ms += (timestamps[1] - timestamps[0]) * properties.limits.timestampPeriod * 1e-6;
+			draw_ms += (timestamps[2] - timestamps[1]) * properties.limits.timestampPeriod * 1e-6;
+		}
+	}
+
+	uint32_t alive = 0;
+	{
+		void *mapping = nullptr;
+		CHECK_VULKAN(vkMapMemory(device, alive_readback.mem, 0, sizeof(uint32_t), 0, &mapping));
+		alive = *reinterpret_cast<uint32_t*>(mapping);
+		vkUnmapMemory(device, alive_readback.mem);
+	}
+
+	const uint32_t timed = std::max(frames, 1u);
+	std::cout << "Particle benchmark: " << capacity << " particles, " << alive << " alive, "
+		<< timed << " frames\n"
+		<< "  update: " << update_ms / timed << "ms/frame\n"
+		<< "  draw: " << draw_ms / timed << "ms/frame\n";
+
+	destroy_buffer(device, alive_readback);
+	destroy_particle_system(device, resources, particles);
+	destroy_resource_manager(device, resources);
+	vkDestroyFramebuffer(device, framebuffer, nullptr);
+	destroy_image(device, target);
+	vkDestroyRenderPass(device, render_pass, nullptr);
+	vkDestroyQueryPool(device, query_pool, nullptr);
+	vkDestroyFence(device, fence, nullptr);
+	vkDestroyCommandPool(device, command_pool, nullptr);
+}
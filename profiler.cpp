@@ -0,0 +1,159 @@
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdio>
+#include "profiler.h"
+
+void record_frame_time(FrameTimes &times) {
+	const uint64_t now = std::chrono::duration_cast<std::chrono::microseconds>(
+			std::chrono::steady_clock::now().time_since_epoch()).count();
+	if (times.last_ticks != 0) {
+		times.history_ms[times.next] = (now - times.last_ticks) / 1000.f;
+		times.next = (times.next + 1) % times.history_ms.size();
+		times.count = std::min(times.count + 1, uint32_t(times.history_ms.size()));
+	}
+	times.last_ticks = now;
+}
+
+float average_frame_time(const FrameTimes &times) {
+	if (times.count == 0) {
+		return 0.f;
+	}
+	float sum = 0.f;
+	for (uint32_t i = 0; i < times.count; ++i) {
+		sum += times.history_ms[i];
+	}
+	return sum / times.count;
+}
+
+float max_frame_time(const FrameTimes &times) {
+	if (times.count == 0) {
+		return 0.f;
+	}
+	return *std::max_element(times.history_ms.begin(), times.history_ms.begin() + times.count);
+}
+
+GpuProfiler create_gpu_profiler(VkDevice device, VkPhysicalDevice physical_device, VkQueue queue,
+		uint32_t queue_family, VkCommandPool command_pool, uint32_t max_scopes)
+{
+	GpuProfiler profiler;
+
+	uint32_t num_families = 0;
+	vkGetPhysicalDeviceQueueFamilyProperties(physical_device, &num_families, nullptr);
+	std::vector<VkQueueFamilyProperties> family_props(num_families, VkQueueFamilyProperties{});
+	vkGetPhysicalDeviceQueueFamilyProperties(physical_device, &num_families, family_props.data());
+	if (family_props[queue_family].timestampValidBits == 0) {
+		std::cout << "Queue doesn't support timestamps, GPU profiling disabled\n";
+		return profiler;
+	}
+
+	VkPhysicalDeviceProperties properties = {};
+	vkGetPhysicalDeviceProperties(physical_device, &properties);
+	profiler.timestamp_period = properties.limits.timestampPeriod;
+	profiler.max_scopes = max_scopes;
+
+	VkQueryPoolCreateInfo info = {};
+	info.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+	info.queryType = VK_QUERY_TYPE_TIMESTAMP;
+	info.queryCount = 2 * max_scopes;
+	CHECK_VULKAN(vkCreateQueryPool(device, &info, nullptr, &profiler.query_pool));
+
+	// Queries must be reset before they can be read, even if the scope never runs
+	VkCommandBuffer cmd_buf = begin_one_time_commands(device, command_pool);
+	vkCmdResetQueryPool(cmd_buf, profiler.query_pool, 0, 2 * max_scopes);
+	end_one_time_commands(device, queue, command_pool, cmd_buf);
+
+	profiler.enabled = true;
+	return profiler;
+}
+
+uint32_t add_gpu_scope(GpuProfiler &profiler, const std::string &name) {
+	if (profiler.scope_names.size() >= profiler.max_scopes && profiler.enabled) {
+		throw std::runtime_error("Too many GPU profiler scopes");
+	}
+	profiler.scope_names.push_back(name);
+	profiler.scope_ms.push_back(0.f);
+	return profiler.scope_names.size() - 1;
+}
+
+void begin_gpu_scope(const GpuProfiler &profiler, VkCommandBuffer cmd_buf, uint32_t scope) {
+	if (!profiler.enabled) {
+		return;
+	}
+	vkCmdResetQueryPool(cmd_buf, profiler.query_pool, 2 * scope, 2);
+	vkCmdWriteTimestamp(cmd_buf, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, profiler.query_pool, 2 * scope);
+}
+
+void end_gpu_scope(const GpuProfiler &profiler, VkCommandBuffer cmd_buf, uint32_t scope) {
+	if (!profiler.enabled) {
+		return;
+	}
+	vkCmdWriteTimestamp(cmd_buf, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, profiler.query_pool, 2 * scope + 1);
+}
+
+void update_gpu_profiler(VkDevice device, GpuProfiler &profiler) {
+	if (!profiler.enabled || profiler.scope_names.empty()) {
+		return;
+	}
+	// Each query's value followed by its availability
+	const uint32_t num_queries = 2 * profiler.scope_names.size();
+	std::vector<uint64_t> results(2 * num_queries, 0);
+	const VkResult r = vkGetQueryPoolResults(device, profiler.query_pool, 0, num_queries,
+			results.size() * sizeof(uint64_t), results.data(), 2 * sizeof(uint64_t),
+			VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT);
+	if (r != VK_SUCCESS && r != VK_NOT_READY) {
+		CHECK_VULKAN(r);
+	}
+	for (size_t i = 0; i < profiler.scope_names.size(); ++i) {
+		const uint64_t *begin = &results[4 * i];
+		const uint64_t *end = &results[4 * i + 2];
+		if (!begin[1] || !end[1]) {
+			continue;
+		}
+		const float ms = (end[0] - begin[0]) * profiler.timestamp_period * 1e-6f;
+		profiler.scope_ms[i] = profiler.scope_ms[i] * 0.9f + ms * 0.1f;
+	}
+}
+
+void destroy_gpu_profiler(VkDevice device, GpuProfiler &profiler) {
+	vkDestroyQueryPool(device, profiler.query_pool, nullptr);
+	profiler = GpuProfiler();
+}
+
+void draw_profiler_hud(Overlay &overlay, const FrameTimes &frame_times, const GpuProfiler &profiler) {
+	const float x = 8.f;
+	const float line = overlay.font->line_height;
+	const uint32_t num_lines = 3 + (profiler.enabled ? profiler.scope_names.size() : 1);
+	overlay_rect(overlay, x - 4.f, x - 4.f, 34.f * overlay.font->glyphs[0].advance + 8.f, num_lines * line + 8.f,
+			overlay_color(0, 0, 0, 160));
+
+	const uint32_t white = overlay_color(255, 255, 255);
+	const uint32_t green = overlay_color(120, 230, 120);
+	std::array<char, 128> text = {};
+	float y = x;
+
+	const float avg_ms = average_frame_time(frame_times);
+	std::snprintf(text.data(), text.size(), "frame %6.2f ms  %5.1f fps", avg_ms, avg_ms > 0.f ? 1000.f / avg_ms : 0.f);
+	overlay_text(overlay, x, y, text.data(), white);
+	y += line;
+	std::snprintf(text.data(), text.size(), "max   %6.2f ms", max_frame_time(frame_times));
+	overlay_text(overlay, x, y, text.data(), white);
+	y += line;
+
+	if (profiler.enabled) {
+		for (size_t i = 0; i < profiler.scope_names.size(); ++i) {
+			std::snprintf(text.data(), text.size(), "gpu %-10s %6.3f ms", profiler.scope_names[i].c_str(),
+					profiler.scope_ms[i]);
+			overlay_text(overlay, x, y, text.data(), green);
+			y += line;
+		}
+	} else {
+		overlay_text(overlay, x, y, "gpu timing unavailable", green);
+		y += line;
+	}
+
+	const MemoryStats &mem = memory_stats();
+	std::snprintf(text.data(), text.size(), "mem %.1f MB dev %.1f MB host %u",
+			mem.device_bytes / (1024.f * 1024.f), mem.host_bytes / (1024.f * 1024.f), mem.num_allocations);
+	overlay_text(overlay, x, y, text.data(), white);
+}
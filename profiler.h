@@ -0,0 +1,56 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <vulkan/vulkan.h>
+#include "overlay.h"
+
+// CPU frame times over a sliding window of recent frames
+struct FrameTimes {
+	std::vector<float> history_ms = std::vector<float>(120, 0.f);
+	uint32_t next = 0;
+	uint32_t count = 0;
+	uint64_t last_ticks = 0;
+};
+
+// Record the time since the previous call as a frame time
+void record_frame_time(FrameTimes &times);
+
+float average_frame_time(const FrameTimes &times);
+
+float max_frame_time(const FrameTimes &times);
+
+// GPU timings of named passes using timestamp queries. Each scope has its own query pair
+// which is reset and written by the command buffers it's recorded in, so it works for both
+// pre-recorded and per-frame command buffers. When the queue doesn't support timestamps the
+// profiler is disabled and the scope functions do nothing.
+struct GpuProfiler {
+	bool enabled = false;
+	VkQueryPool query_pool = VK_NULL_HANDLE;
+	uint32_t max_scopes = 0;
+	float timestamp_period = 1.f;
+	std::vector<std::string> scope_names;
+	// Exponentially smoothed pass times
+	std::vector<float> scope_ms;
+};
+
+GpuProfiler create_gpu_profiler(VkDevice device, VkPhysicalDevice physical_device, VkQueue queue,
+		uint32_t queue_family, VkCommandPool command_pool, uint32_t max_scopes = 16);
+
+// Register a named scope and return its id
+uint32_t add_gpu_scope(GpuProfiler &profiler, const std::string &name);
+
+// Scopes must begin and end outside of render passes
+void begin_gpu_scope(const GpuProfiler &profiler, VkCommandBuffer cmd_buf, uint32_t scope);
+
+void end_gpu_scope(const GpuProfiler &profiler, VkCommandBuffer cmd_buf, uint32_t scope);
+
+// Read back the finished scopes after the frame's fence has signaled. Scopes which didn't run
+// this frame keep their previous time
+void update_gpu_profiler(VkDevice device, GpuProfiler &profiler);
+
+void destroy_gpu_profiler(VkDevice device, GpuProfiler &profiler);
+
+// Draw the frame times, GPU pass times and memory use in the top left of the overlay
+void draw_profiler_hud(Overlay &overlay, const FrameTimes &frame_times, const GpuProfiler &profiler);
+
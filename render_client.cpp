@@ -0,0 +1,324 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <limits>
+#include <vector>
+#include "camera.h"
+#include "external_memory.h"
+#include "render_client.h"
+#include "render_protocol.h"
+
+#ifdef _WIN32
+
+bool run_render_client(VkDevice device, VkPhysicalDevice physical_device, VkQueue queue, uint32_t queue_family,
+		const RenderClientParams &params)
+{
+	std::cout << "The render client needs Unix domain sockets and POSIX shared memory, "
+		<< "it isn't supported on this platform\n";
+	return false;
+}
+
+#else
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+static bool send_message(int fd, RenderMessageType type, const void *payload, uint32_t size) {
+	std::vector<uint8_t> msg(sizeof(RenderMessageHeader) + size, 0);
+	RenderMessageHeader header = {};
+	header.type = type;
+	header.size = size;
+	std::memcpy(msg.data(), &header, sizeof(header));
+	std::memcpy(msg.data() + sizeof(header), payload, size);
+	return send(fd, msg.data(), msg.size(), MSG_NOSIGNAL) == ssize_t(msg.size());
+}
+
+// Block until a whole message arrives, along with any file descriptors sent with it. Returns
+// false if the connection closed or the payload isn't the expected size
+static bool receive_message(int fd, RenderMessageType type, void *payload, uint32_t size,
+		std::vector<int> *fds = nullptr)
+{
+	RenderMessageHeader header = {};
+	iovec iov = {};
+	iov.iov_base = &header;
+	iov.iov_len = sizeof(header);
+	msghdr hdr = {};
+	hdr.msg_iov = &iov;
+	hdr.msg_iovlen = 1;
+	uint8_t control[CMSG_SPACE(4 * sizeof(int))] = {};
+	hdr.msg_control = control;
+	hdr.msg_controllen = sizeof(control);
+	if (recvmsg(fd, &hdr, MSG_WAITALL) != ssize_t(sizeof(header))) {
+		return false;
+	}
+	for (cmsghdr *cmsg = CMSG_FIRSTHDR(&hdr); cmsg; cmsg = CMSG_NXTHDR(&hdr, cmsg)) {
+		if (cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS) {
+			continue;
+		}
+		std::vector<int> received((cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int), -1);
+		std::memcpy(received.data(), CMSG_DATA(cmsg), received.size() * sizeof(int));
+		for (int r : received) {
+			if (fds) {
+				fds->push_back(r);
+			} else {
+				close(r);
+			}
+		}
+	}
+
+	if (header.type == RENDER_MSG_ERROR) {
+		std::cout << "Render client: the server reported an error\n";
+		return false;
+	}
+	if (header.type != type || header.size != size) {
+		std::cout << "Render client: unexpected message type " << header.type << "\n";
+		return false;
+	}
+	return recv(fd, payload, size, MSG_WAITALL) == ssize_t(size);
+}
+
+static uint64_t checksum_frame(const uint8_t *pixels, size_t size) {
+	uint64_t hash = 14695981039346656037ull;
+	for (size_t i = 0; i < size; ++i) {
+		hash = (hash ^ pixels[i]) * 1099511628211ull;
+	}
+	return hash;
+}
+
+// Acquire the shared target from the server and copy it to the readback buffer
+static void record_frame_copy(VkCommandBuffer cmd_buf, VkImage image, VkImageLayout layout, VkExtent2D extent,
+		VkBuffer readback, uint32_t queue_family)
+{
+	VkImageMemoryBarrier acquire = {};
+	acquire.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+	acquire.srcAccessMask = 0;
+	acquire.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+	acquire.oldLayout = layout;
+	acquire.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+	acquire.srcQueueFamilyIndex = VK_QUEUE_FAMILY_EXTERNAL;
+	acquire.dstQueueFamilyIndex = queue_family;
+	acquire.image = image;
+	acquire.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	acquire.subresourceRange.levelCount = 1;
+	acquire.subresourceRange.layerCount = 1;
+	vkCmdPipelineBarrier(cmd_buf, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+			0, nullptr, 0, nullptr, 1, &acquire);
+
+	VkBufferImageCopy copy = {};
+	copy.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	copy.imageSubresource.layerCount = 1;
+	copy.imageExtent.width = extent.width;
+	copy.imageExtent.height = extent.height;
+	copy.imageExtent.depth = 1;
+	vkCmdCopyImageToBuffer(cmd_buf, image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, readback, 1, &copy);
+
+	VkBufferMemoryBarrier barrier = {};
+	barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+	barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+	barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.buffer = readback;
+	barrier.size = VK_WHOLE_SIZE;
+	vkCmdPipelineBarrier(cmd_buf, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0,
+			0, nullptr, 1, &barrier, 0, nullptr);
+}
+
+bool run_render_client(VkDevice device, VkPhysicalDevice physical_device, VkQueue queue, uint32_t queue_family,
+		const RenderClientParams &params)
+{
+	sockaddr_un addr = {};
+	addr.sun_family = AF_UNIX;
+	if (params.socket_path.size() >= sizeof(addr.sun_path)) {
+		throw std::runtime_error("Render server socket path is too long: " + params.socket_path);
+	}
+	std::strncpy(addr.sun_path, params.socket_path.c_str(), sizeof(addr.sun_path) - 1);
+	const int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (fd < 0 || connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0) {
+		std::cout << "Render client: failed to connect to " << params.socket_path << "\n";
+		if (fd >= 0) {
+			close(fd);
+		}
+		return false;
+	}
+
+	RenderHello hello = {};
+	hello.version = render_protocol_version;
+	hello.width = params.extent.width;
+	hello.height = params.extent.height;
+	if (params.external_memory) {
+		const ExternalDeviceId id = external_device_id(physical_device);
+		hello.flags = RENDER_HELLO_EXTERNAL_MEMORY;
+		std::memcpy(hello.device_uuid, id.device_uuid, VK_UUID_SIZE);
+		std::memcpy(hello.driver_uuid, id.driver_uuid, VK_UUID_SIZE);
+	}
+	RenderWelcome welcome = {};
+	std::vector<int> fds;
+	if (!send_message(fd, RENDER_MSG_HELLO, &hello, sizeof(hello))
+			|| !receive_message(fd, RENDER_MSG_WELCOME, &welcome, sizeof(welcome), &fds)
+			|| (welcome.external_memory && fds.size() != 2))
+	{
+		for (int f : fds) {
+			close(f);
+		}
+		close(fd);
+		return false;
+	}
+
+	const uint8_t *shm = nullptr;
+	Image target;
+	VkSemaphore frame_semaphore = VK_NULL_HANDLE;
+	Buffer readback;
+	const uint8_t *readback_mapping = nullptr;
+	VkCommandPool command_pool = VK_NULL_HANDLE;
+	VkCommandBuffer cmd_buf = VK_NULL_HANDLE;
+	VkFence fence = VK_NULL_HANDLE;
+	if (welcome.external_memory) {
+		// The image and semaphore own their file descriptors once imported. If importing or setting
+		// up the readback fails everything created so far is released, as when the handshake fails
+		try {
+			target = import_image(device, physical_device, fds[0], params.extent, VK_FORMAT_R8G8B8A8_UNORM,
+					VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT, welcome.allocation_size);
+			fds[0] = -1;
+			frame_semaphore = import_semaphore(device, fds[1]);
+			fds[1] = -1;
+
+			readback = create_buffer(device, physical_device, welcome.frame_bytes, VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+					VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+			void *mapping = nullptr;
+			CHECK_VULKAN(vkMapMemory(device, readback.mem, 0, welcome.frame_bytes, 0, &mapping));
+			readback_mapping = reinterpret_cast<const uint8_t*>(mapping);
+
+			VkCommandPoolCreateInfo pool_info = {};
+			pool_info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+			pool_info.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+			pool_info.queueFamilyIndex = queue_family;
+			CHECK_VULKAN(vkCreateCommandPool(device, &pool_info, nullptr, &command_pool));
+
+			VkCommandBufferAllocateInfo alloc_info = {};
+			alloc_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+			alloc_info.commandPool = command_pool;
+			alloc_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+			alloc_info.commandBufferCount = 1;
+			CHECK_VULKAN(vkAllocateCommandBuffers(device, &alloc_info, &cmd_buf));
+
+			VkFenceCreateInfo fence_info = {};
+			fence_info.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+			CHECK_VULKAN(vkCreateFence(device, &fence_info, nullptr, &fence));
+		} catch (const std::exception &e) {
+			std::cout << "Render client: failed to import the server's frame: " << e.what() << "\n";
+			vkDestroyFence(device, fence, nullptr);
+			vkDestroyCommandPool(device, command_pool, nullptr);
+			if (readback_mapping) {
+				vkUnmapMemory(device, readback.mem);
+			}
+			destroy_buffer(device, readback);
+			vkDestroySemaphore(device, frame_semaphore, nullptr);
+			destroy_image(device, target);
+			for (int f : fds) {
+				if (f >= 0) {
+					close(f);
+				}
+			}
+			close(fd);
+			return false;
+		}
+	} else {
+		const int shm_fd = shm_open(welcome.shm_name, O_RDONLY, 0);
+		void *mapping = MAP_FAILED;
+		if (shm_fd >= 0) {
+			mapping = mmap(nullptr, welcome.frame_bytes, PROT_READ, MAP_SHARED, shm_fd, 0);
+			close(shm_fd);
+		}
+		if (mapping == MAP_FAILED) {
+			std::cout << "Render client: failed to map shared memory " << welcome.shm_name << "\n";
+			close(fd);
+			return false;
+		}
+		shm = reinterpret_cast<const uint8_t*>(mapping);
+	}
+
+	Camera camera;
+	bool ok = true;
+	double total_ms = 0.0;
+	uint64_t checksum = 0;
+	uint64_t batched = 0;
+	for (uint32_t i = 0; i < params.frames && ok; ++i) {
+		const float angle = i * 0.02f;
+		RenderCamera camera_msg = {};
+		camera_msg.position[0] = 14.f * std::sin(angle);
+		camera_msg.position[1] = 4.f;
+		camera_msg.position[2] = 14.f * std::cos(angle);
+		camera_msg.target[1] = 4.f;
+		camera_msg.fovy = camera.fovy;
+		RenderFrameRequest request = {};
+		request.request_id = i;
+
+		const auto start = std::chrono::steady_clock::now();
+		RenderFrameReady ready = {};
+		ok = send_message(fd, RENDER_MSG_CAMERA, &camera_msg, sizeof(camera_msg))
+			&& send_message(fd, RENDER_MSG_FRAME_REQUEST, &request, sizeof(request))
+			&& receive_message(fd, RENDER_MSG_FRAME_READY, &ready, sizeof(ready));
+		if (!ok) {
+			break;
+		}
+
+		const uint8_t *pixels = shm;
+		if (welcome.external_memory) {
+			VkCommandBufferBeginInfo begin_info = {};
+			begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+			begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+			CHECK_VULKAN(vkBeginCommandBuffer(cmd_buf, &begin_info));
+			record_frame_copy(cmd_buf, target.image, VkImageLayout(welcome.layout), params.extent, readback.buffer,
+					queue_family);
+			CHECK_VULKAN(vkEndCommandBuffer(cmd_buf));
+
+			// Done reading the target once the fence is signaled, so the next request can
+			// overwrite it
+			const VkPipelineStageFlags wait_stage = VK_PIPELINE_STAGE_TRANSFER_BIT;
+			VkSubmitInfo submit_info = {};
+			submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+			submit_info.waitSemaphoreCount = 1;
+			submit_info.pWaitSemaphores = &frame_semaphore;
+			submit_info.pWaitDstStageMask = &wait_stage;
+			submit_info.commandBufferCount = 1;
+			submit_info.pCommandBuffers = &cmd_buf;
+			CHECK_VULKAN(vkQueueSubmit(queue, 1, &submit_info, fence));
+			CHECK_VULKAN(vkWaitForFences(device, 1, &fence, VK_TRUE, std::numeric_limits<uint64_t>::max()));
+			CHECK_VULKAN(vkResetFences(device, 1, &fence));
+			pixels = readback_mapping;
+		}
+		total_ms += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		batched += ready.batch_size > 1;
+		if (i + 1 == params.frames) {
+			checksum = checksum_frame(pixels, welcome.frame_bytes);
+		}
+	}
+
+	if (ok) {
+		std::cout << "Render client: " << params.frames << " frames "
+			<< (welcome.external_memory ? "through external memory" : "through shared memory") << ", "
+			<< total_ms / std::max(params.frames, 1u) << "ms/frame, " << batched << " batched with other clients\n"
+			<< "  last frame checksum: " << std::hex << checksum << std::dec << "\n";
+	}
+
+	if (welcome.external_memory) {
+		vkDestroyFence(device, fence, nullptr);
+		vkDestroyCommandPool(device, command_pool, nullptr);
+		vkUnmapMemory(device, readback.mem);
+		destroy_buffer(device, readback);
+		vkDestroySemaphore(device, frame_semaphore, nullptr);
+		destroy_image(device, target);
+	} else {
+		munmap(const_cast<uint8_t*>(shm), welcome.frame_bytes);
+	}
+	close(fd);
+	return ok;
+}
+
+#endif
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <string>
+#include <vulkan/vulkan.h>
+
+// A client of the render server, to exercise it from another process. It requests frames of
+// the server's default scene with an orbiting camera and reads each one, from shared memory
+// or by copying the shared render target on its own device, then prints the time from each
+// request to the frame being readable and a checksum of the last frame. The checksum is the
+// same with and without external memory for the same server and frame count.
+//
+// Only supported on POSIX systems, elsewhere the client reports that and returns.
+struct RenderClientParams {
+	std::string socket_path;
+	VkExtent2D extent = { 1280, 720 };
+	uint32_t frames = 300;
+	// Ask to share the render target, the device must have been created with the external
+	// memory extensions
+	bool external_memory = false;
+};
+
+// Returns false if the connection failed or the server reported an error
+bool run_render_client(VkDevice device, VkPhysicalDevice physical_device, VkQueue queue, uint32_t queue_family,
+		const RenderClientParams &params);
@@ -0,0 +1,99 @@
+#pragma once
+
+#include <cstdint>
+
+// The binary protocol of the render server, for clients to include. Messages are a header
+// followed by the type's payload, in the host's byte order since clients are local. After
+// the hello the server creates a shared memory segment the client's frames are written to,
+// a frame is valid in it from its frame ready reply until the client's next frame request.
+//
+// A client asking for external memory in its hello, with the same device and driver as the
+// server (see external_memory.h), instead shares the server's render target without any
+// copies. The welcome then carries two file descriptors as SCM_RIGHTS ancillary data: the
+// target's memory, for an R8G8B8A8_UNORM optimal tiling 2D image with transfer source usage,
+// and a binary semaphore. The frame ready reply is sent as soon as the frame is submitted,
+// and the semaphore is signaled when it's rendered, in the welcome's layout with its
+// ownership released to VK_QUEUE_FAMILY_EXTERNAL. The client must wait on the semaphore
+// exactly once for each frame, and be done reading the target before its next frame request.
+//
+// Client to server:
+//   HELLO         RenderHello, must be first
+//   SCENE         RenderSceneHeader followed by num_instances RenderInstance
+//   CAMERA        RenderCamera
+//   FRAME_REQUEST RenderFrameRequest, one at a time
+// Server to client:
+//   WELCOME       RenderWelcome, in reply to the hello
+//   FRAME_READY   RenderFrameReady, once the requested frame is in shared memory
+//   ERROR         no payload, the server closes the connection after it
+
+enum RenderMessageType : uint32_t {
+	RENDER_MSG_HELLO = 1,
+	RENDER_MSG_SCENE = 2,
+	RENDER_MSG_CAMERA = 3,
+	RENDER_MSG_FRAME_REQUEST = 4,
+	RENDER_MSG_WELCOME = 101,
+	RENDER_MSG_FRAME_READY = 102,
+	RENDER_MSG_ERROR = 103,
+};
+
+static const uint32_t render_protocol_version = 2;
+
+enum RenderHelloFlags : uint32_t {
+	RENDER_HELLO_EXTERNAL_MEMORY = 1,
+};
+
+struct RenderMessageHeader {
+	uint32_t type;
+	// Bytes of payload after the header
+	uint32_t size;
+};
+
+struct RenderHello {
+	uint32_t version;
+	uint32_t width;
+	uint32_t height;
+	uint32_t flags;
+	// The client's VkPhysicalDeviceIDProperties, for external memory
+	uint8_t device_uuid[16];
+	uint8_t driver_uuid[16];
+};
+
+struct RenderWelcome {
+	// The shared memory segment to open, and its size: width * height RGBA8 pixels. The name
+	// is empty when sharing external memory
+	char shm_name[64];
+	uint64_t frame_bytes;
+	// Nonzero if the frames are shared as external memory, which may be refused even if the
+	// client asked for it
+	uint32_t external_memory;
+	// The VkImageLayout of a rendered frame
+	uint32_t layout;
+	// The allocation size to import the memory with
+	uint64_t allocation_size;
+};
+
+struct RenderInstance {
+	float center[3];
+	float size;
+	float color[4];
+};
+
+struct RenderSceneHeader {
+	uint32_t num_instances;
+};
+
+struct RenderCamera {
+	float position[3];
+	float target[3];
+	float fovy;
+};
+
+struct RenderFrameRequest {
+	uint32_t request_id;
+};
+
+struct RenderFrameReady {
+	uint32_t request_id;
+	// How many requests were rendered in the same submission, including this one
+	uint32_t batch_size;
+};
@@ -0,0 +1,577 @@
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <vector>
+#include "external_memory.h"
+#include "render_protocol.h"
+#include "render_server.h"
+
+#ifdef _WIN32
+
+void run_render_server(VkDevice device, VkPhysicalDevice physical_device, VkQueue queue, uint32_t queue_family,
+		const RenderServerParams &params)
+{
+	std::cout << "The render server needs Unix domain sockets and POSIX shared memory, "
+		<< "it isn't supported on this platform\n";
+}
+
+#else
+
+#include <cerrno>
+#include <csignal>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+// Larger messages are a protocol error, a scene of 1M instances fits
+static const uint32_t max_message_size = sizeof(RenderSceneHeader) + (1u << 20) * sizeof(RenderInstance);
+
+static volatile std::sig_atomic_t stop_requested = 0;
+
+static void request_stop(int) {
+	stop_requested = 1;
+}
+
+struct RenderClient {
+	uint32_t id = 0;
+	int fd = -1;
+	// Received bytes not forming a whole message yet
+	std::vector<uint8_t> received;
+	bool welcomed = false;
+	bool closed = false;
+
+	VkExtent2D extent = {};
+	std::string shm_name;
+	uint8_t *shm = nullptr;
+	size_t shm_size = 0;
+
+	// Sharing the target as external memory instead of copying it to shared memory, with the
+	// semaphore signaled when each frame is rendered
+	bool external_memory = false;
+	VkDeviceSize allocation_size = 0;
+	VkSemaphore frame_semaphore = VK_NULL_HANDLE;
+
+	Image target;
+	// Owns the OIT renderer's targets and pipelines
+	ResourceManager resources;
+	OITRenderer oit;
+	Buffer readback;
+	const uint8_t *readback_mapping = nullptr;
+	Camera camera;
+
+	bool frame_requested = false;
+	uint32_t request_id = 0;
+};
+
+// The file descriptors are sent along with the message, and stay open in the server
+static bool send_message(RenderClient &client, RenderMessageType type, const void *payload, uint32_t size,
+		const std::vector<int> &fds = std::vector<int>())
+{
+	std::vector<uint8_t> msg(sizeof(RenderMessageHeader) + size, 0);
+	RenderMessageHeader header = {};
+	header.type = type;
+	header.size = size;
+	std::memcpy(msg.data(), &header, sizeof(header));
+	if (size != 0) {
+		std::memcpy(msg.data() + sizeof(header), payload, size);
+	}
+	iovec iov = {};
+	iov.iov_base = msg.data();
+	iov.iov_len = msg.size();
+	msghdr hdr = {};
+	hdr.msg_iov = &iov;
+	hdr.msg_iovlen = 1;
+	std::vector<uint8_t> control;
+	if (!fds.empty()) {
+		control.resize(CMSG_SPACE(fds.size() * sizeof(int)), 0);
+		hdr.msg_control = control.data();
+		hdr.msg_controllen = control.size();
+		cmsghdr *cmsg = CMSG_FIRSTHDR(&hdr);
+		cmsg->cmsg_level = SOL_SOCKET;
+		cmsg->cmsg_type = SCM_RIGHTS;
+		cmsg->cmsg_len = CMSG_LEN(fds.size() * sizeof(int));
+		std::memcpy(CMSG_DATA(cmsg), fds.data(), fds.size() * sizeof(int));
+	}
+	// Replies are small, a client which doesn't read them in time is dropped
+	const ssize_t sent = sendmsg(client.fd, &hdr, MSG_NOSIGNAL);
+	if (sent != ssize_t(msg.size())) {
+		client.closed = true;
+		return false;
+	}
+	return true;
+}
+
+static void client_error(RenderClient &client, const std::string &error) {
+	std::cout << "Render client " << client.id << ": " << error << "\n";
+	send_message(client, RENDER_MSG_ERROR, nullptr, 0);
+	client.closed = true;
+}
+
+static std::vector<TransparentInstance> to_transparent_instances(const RenderInstance *instances, uint32_t count) {
+	std::vector<TransparentInstance> result(count, TransparentInstance{});
+	for (uint32_t i = 0; i < count; ++i) {
+		result[i].center = vec3(instances[i].center[0], instances[i].center[1], instances[i].center[2]);
+		result[i].size = instances[i].size;
+		std::copy(instances[i].color, instances[i].color + 4, result[i].color);
+	}
+	return result;
+}
+
+static void create_client_resources(VkDevice device, VkPhysicalDevice physical_device,
+		const RenderServerParams &params, RenderClient &client)
+{
+	const VkImageUsageFlags usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+	if (client.external_memory) {
+		client.target = create_exportable_image(device, physical_device, client.extent, VK_FORMAT_R8G8B8A8_UNORM,
+				usage, client.allocation_size);
+		client.frame_semaphore = create_exportable_semaphore(device);
+	} else {
+		client.target = create_image(device, physical_device, client.extent, 1, VK_FORMAT_R8G8B8A8_UNORM, usage,
+				VK_IMAGE_ASPECT_COLOR_BIT);
+	}
+	client.oit = create_oit_renderer(device, physical_device, client.resources, params.oit_mode, client.extent,
+			VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, { client.target.view },
+			make_transparent_instances(params.default_instances, client.id));
+	client.camera.aspect = float(client.extent.width) / client.extent.height;
+	if (client.external_memory) {
+		return;
+	}
+
+	const VkDeviceSize frame_bytes = VkDeviceSize(client.extent.width) * client.extent.height * 4;
+	client.readback = create_buffer(device, physical_device, frame_bytes, VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+	void *mapping = nullptr;
+	CHECK_VULKAN(vkMapMemory(device, client.readback.mem, 0, frame_bytes, 0, &mapping));
+	client.readback_mapping = reinterpret_cast<const uint8_t*>(mapping);
+}
+
+static void destroy_client(VkDevice device, RenderClient &client) {
+	if (client.welcomed) {
+		destroy_oit_renderer(device, client.resources, client.oit);
+		destroy_resource_manager(device, client.resources);
+		destroy_image(device, client.target);
+		if (client.external_memory) {
+			vkDestroySemaphore(device, client.frame_semaphore, nullptr);
+		} else {
+			vkUnmapMemory(device, client.readback.mem);
+			destroy_buffer(device, client.readback);
+		}
+	}
+	if (client.shm) {
+		munmap(client.shm, client.shm_size);
+		shm_unlink(client.shm_name.c_str());
+	}
+	close(client.fd);
+}
+
+static void handle_hello(VkDevice device, VkPhysicalDevice physical_device, const RenderServerParams &params,
+		RenderClient &client, const uint8_t *payload, uint32_t size)
+{
+	RenderHello hello = {};
+	if (size != sizeof(hello)) {
+		client_error(client, "malformed hello");
+		return;
+	}
+	std::memcpy(&hello, payload, sizeof(hello));
+	if (hello.version != render_protocol_version) {
+		client_error(client, "unsupported protocol version " + std::to_string(hello.version));
+		return;
+	}
+	if (hello.width == 0 || hello.height == 0 || hello.width > params.max_extent || hello.height > params.max_extent) {
+		client_error(client, "unsupported frame size");
+		return;
+	}
+	client.extent.width = hello.width;
+	client.extent.height = hello.height;
+
+	ExternalDeviceId client_device;
+	std::memcpy(client_device.device_uuid, hello.device_uuid, VK_UUID_SIZE);
+	std::memcpy(client_device.driver_uuid, hello.driver_uuid, VK_UUID_SIZE);
+	client.external_memory = (hello.flags & RENDER_HELLO_EXTERNAL_MEMORY) && params.external_memory
+		&& same_external_device(client_device, external_device_id(physical_device));
+	if (client.external_memory) {
+		create_client_resources(device, physical_device, params, client);
+		client.welcomed = true;
+
+		// The client gets its own references to the memory and semaphore
+		std::vector<int> fds = {
+			export_memory_fd(device, client.target.mem),
+			export_semaphore_fd(device, client.frame_semaphore)
+		};
+		RenderWelcome welcome = {};
+		welcome.frame_bytes = VkDeviceSize(hello.width) * hello.height * 4;
+		welcome.external_memory = 1;
+		welcome.layout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+		welcome.allocation_size = client.allocation_size;
+		send_message(client, RENDER_MSG_WELCOME, &welcome, sizeof(welcome), fds);
+		for (int fd : fds) {
+			close(fd);
+		}
+		std::cout << "Render client " << client.id << " connected, " << hello.width << "x" << hello.height
+			<< " sharing external memory\n";
+		return;
+	}
+
+	// The segment is only for this client, and unlinked when it disconnects
+	client.shm_name = "/sdl2_vulkan_" + std::to_string(getpid()) + "_" + std::to_string(client.id);
+	client.shm_size = size_t(hello.width) * hello.height * 4;
+	const int shm_fd = shm_open(client.shm_name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+	if (shm_fd < 0) {
+		client_error(client, "failed to create shared memory " + client.shm_name);
+		return;
+	}
+	void *shm = MAP_FAILED;
+	if (ftruncate(shm_fd, client.shm_size) == 0) {
+		shm = mmap(nullptr, client.shm_size, PROT_READ | PROT_WRITE, MAP_SHARED, shm_fd, 0);
+	}
+	close(shm_fd);
+	if (shm == MAP_FAILED) {
+		shm_unlink(client.shm_name.c_str());
+		client_error(client, "failed to map shared memory " + client.shm_name);
+		return;
+	}
+	client.shm = reinterpret_cast<uint8_t*>(shm);
+
+	create_client_resources(device, physical_device, params, client);
+	client.welcomed = true;
+
+	RenderWelcome welcome = {};
+	std::strncpy(welcome.shm_name, client.shm_name.c_str(), sizeof(welcome.shm_name) - 1);
+	welcome.frame_bytes = client.shm_size;
+	welcome.layout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+	send_message(client, RENDER_MSG_WELCOME, &welcome, sizeof(welcome));
+	std::cout << "Render client " << client.id << " connected, " << hello.width << "x" << hello.height << "\n";
+}
+
+// Nothing is rendering between batches, so the renderer can be replaced right away
+static void handle_scene(VkDevice device, VkPhysicalDevice physical_device, const RenderServerParams &params,
+		RenderClient &client, const uint8_t *payload, uint32_t size)
+{
+	RenderSceneHeader header = {};
+	if (size < sizeof(header)) {
+		client_error(client, "malformed scene");
+		return;
+	}
+	std::memcpy(&header, payload, sizeof(header));
+	if (header.num_instances == 0 || size != sizeof(header) + uint64_t(header.num_instances) * sizeof(RenderInstance)) {
+		client_error(client, "malformed scene");
+		return;
+	}
+	std::vector<RenderInstance> instances(header.num_instances, RenderInstance{});
+	std::memcpy(instances.data(), payload + sizeof(header), instances.size() * sizeof(RenderInstance));
+	std::vector<TransparentInstance> scene = to_transparent_instances(instances.data(), instances.size());
+
+	if (scene.size() == client.oit.instances.size()) {
+		client.oit.instances = scene;
+		std::copy(scene.begin(), scene.end(), client.oit.instance_mapping);
+	} else {
+		// Messages are only handled while nothing is rendering
+		destroy_oit_renderer(device, client.resources, client.oit);
+		flush_released_resources(device, client.resources);
+		client.oit = create_oit_renderer(device, physical_device, client.resources, params.oit_mode, client.extent,
+				VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, { client.target.view }, scene);
+	}
+}
+
+static void handle_message(VkDevice device, VkPhysicalDevice physical_device, const RenderServerParams &params,
+		RenderClient &client, uint32_t type, const uint8_t *payload, uint32_t size)
+{
+	if (!client.welcomed && type != RENDER_MSG_HELLO) {
+		client_error(client, "expected a hello");
+		return;
+	}
+	if (type == RENDER_MSG_HELLO) {
+		if (client.welcomed) {
+			client_error(client, "unexpected hello");
+			return;
+		}
+		handle_hello(device, physical_device, params, client, payload, size);
+	} else if (type == RENDER_MSG_SCENE) {
+		handle_scene(device, physical_device, params, client, payload, size);
+	} else if (type == RENDER_MSG_CAMERA) {
+		RenderCamera camera = {};
+		if (size != sizeof(camera)) {
+			client_error(client, "malformed camera");
+			return;
+		}
+		std::memcpy(&camera, payload, sizeof(camera));
+		client.camera.position = vec3(camera.position[0], camera.position[1], camera.position[2]);
+		client.camera.target = vec3(camera.target[0], camera.target[1], camera.target[2]);
+		client.camera.fovy = camera.fovy;
+	} else if (type == RENDER_MSG_FRAME_REQUEST) {
+		RenderFrameRequest request = {};
+		if (size != sizeof(request) || client.frame_requested) {
+			client_error(client, "malformed or overlapping frame request");
+			return;
+		}
+		std::memcpy(&request, payload, sizeof(request));
+		client.frame_requested = true;
+		client.request_id = request.request_id;
+	} else {
+		client_error(client, "unknown message type " + std::to_string(type));
+	}
+}
+
+// Read what's available and handle the whole messages received
+static void receive_messages(VkDevice device, VkPhysicalDevice physical_device, const RenderServerParams &params,
+		RenderClient &client)
+{
+	uint8_t buf[64 * 1024];
+	while (true) {
+		const ssize_t n = recv(client.fd, buf, sizeof(buf), 0);
+		if (n > 0) {
+			client.received.insert(client.received.end(), buf, buf + n);
+			continue;
+		}
+		if (n == 0 || (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)) {
+			client.closed = true;
+		}
+		if (n == 0 || errno != EINTR) {
+			break;
+		}
+	}
+
+	size_t offset = 0;
+	while (!client.closed && client.received.size() - offset >= sizeof(RenderMessageHeader)) {
+		RenderMessageHeader header = {};
+		std::memcpy(&header, client.received.data() + offset, sizeof(header));
+		if (header.size > max_message_size) {
+			client_error(client, "message too large");
+			break;
+		}
+		if (client.received.size() - offset - sizeof(header) < header.size) {
+			break;
+		}
+		handle_message(device, physical_device, params, client, header.type,
+				client.received.data() + offset + sizeof(header), header.size);
+		offset += sizeof(header) + header.size;
+	}
+	client.received.erase(client.received.begin(), client.received.begin() + offset);
+}
+
+static void record_client_frame(RenderClient &client, VkCommandBuffer cmd_buf, uint32_t queue_family) {
+	sort_transparent_instances(client.oit, client.camera);
+	record_oit(client.oit, cmd_buf, 0, client.camera);
+
+	if (client.external_memory) {
+		// Release the target to the client, the next frame's render pass discards its contents
+		// so it's never acquired back
+		VkImageMemoryBarrier barrier = {};
+		barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+		barrier.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+		barrier.dstAccessMask = 0;
+		barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+		barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+		barrier.srcQueueFamilyIndex = queue_family;
+		barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_EXTERNAL;
+		barrier.image = client.target.image;
+		barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		barrier.subresourceRange.levelCount = 1;
+		barrier.subresourceRange.layerCount = 1;
+		vkCmdPipelineBarrier(cmd_buf, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+				VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+		return;
+	}
+
+	VkBufferImageCopy copy = {};
+	copy.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	copy.imageSubresource.layerCount = 1;
+	copy.imageExtent.width = client.extent.width;
+	copy.imageExtent.height = client.extent.height;
+	copy.imageExtent.depth = 1;
+	vkCmdCopyImageToBuffer(cmd_buf, client.target.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+			client.readback.buffer, 1, &copy);
+
+	VkBufferMemoryBarrier barrier = {};
+	barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+	barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+	barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.buffer = client.readback.buffer;
+	barrier.size = VK_WHOLE_SIZE;
+	vkCmdPipelineBarrier(cmd_buf, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0,
+			0, nullptr, 1, &barrier, 0, nullptr);
+}
+
+static void send_frame_ready(RenderClient &client, uint32_t batch_size) {
+	client.frame_requested = false;
+	RenderFrameReady ready = {};
+	ready.request_id = client.request_id;
+	ready.batch_size = batch_size;
+	send_message(client, RENDER_MSG_FRAME_READY, &ready, sizeof(ready));
+}
+
+static int create_listen_socket(const std::string &path) {
+	sockaddr_un addr = {};
+	addr.sun_family = AF_UNIX;
+	if (path.size() >= sizeof(addr.sun_path)) {
+		throw std::runtime_error("Render server socket path is too long: " + path);
+	}
+	std::strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+
+	const int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (fd < 0) {
+		throw std::runtime_error("Failed to create the render server socket");
+	}
+	// Replace the socket left by a previous server which didn't shut down cleanly
+	unlink(path.c_str());
+	if (bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 || listen(fd, 16) != 0) {
+		close(fd);
+		throw std::runtime_error("Failed to listen on " + path);
+	}
+	fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+	return fd;
+}
+
+void run_render_server(VkDevice device, VkPhysicalDevice physical_device, VkQueue queue, uint32_t queue_family,
+		const RenderServerParams &params)
+{
+	VkCommandPool command_pool = VK_NULL_HANDLE;
+	{
+		VkCommandPoolCreateInfo info = {};
+		info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+		info.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+		info.queueFamilyIndex = queue_family;
+		CHECK_VULKAN(vkCreateCommandPool(device, &info, nullptr, &command_pool));
+	}
+
+	VkCommandBuffer cmd_buf = VK_NULL_HANDLE;
+	{
+		VkCommandBufferAllocateInfo info = {};
+		info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+		info.commandPool = command_pool;
+		info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+		info.commandBufferCount = 1;
+		CHECK_VULKAN(vkAllocateCommandBuffers(device, &info, &cmd_buf));
+	}
+
+	VkFence fence = VK_NULL_HANDLE;
+	{
+		VkFenceCreateInfo info = {};
+		info.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+		CHECK_VULKAN(vkCreateFence(device, &info, nullptr, &fence));
+	}
+
+	const int listen_fd = create_listen_socket(params.socket_path);
+	stop_requested = 0;
+	std::signal(SIGINT, request_stop);
+	std::signal(SIGTERM, request_stop);
+	std::cout << "Render server listening on " << params.socket_path << " with "
+		<< oit_mode_name(params.oit_mode) << " OIT" << (params.external_memory ? " and external memory" : "") << "\n";
+
+	std::vector<std::unique_ptr<RenderClient>> clients;
+	uint32_t next_client_id = 1;
+	uint64_t frames_rendered = 0;
+	uint64_t submissions = 0;
+	while (!stop_requested) {
+		std::vector<pollfd> fds(clients.size() + 1, pollfd{});
+		fds[0].fd = listen_fd;
+		fds[0].events = POLLIN;
+		for (size_t i = 0; i < clients.size(); ++i) {
+			fds[i + 1].fd = clients[i]->fd;
+			fds[i + 1].events = POLLIN;
+		}
+		// Wake up regularly to check for the stop signal
+		if (poll(fds.data(), fds.size(), 100) < 0 && errno != EINTR) {
+			std::cout << "Render server poll failed\n";
+			break;
+		}
+
+		for (size_t i = 0; i < clients.size(); ++i) {
+			if (fds[i + 1].revents & (POLLIN | POLLHUP | POLLERR)) {
+				receive_messages(device, physical_device, params, *clients[i]);
+			}
+		}
+		if (fds[0].revents & POLLIN) {
+			const int fd = accept(listen_fd, nullptr, nullptr);
+			if (fd >= 0 && clients.size() >= params.max_clients) {
+				close(fd);
+			} else if (fd >= 0) {
+				fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+				std::unique_ptr<RenderClient> client(new RenderClient());
+				client->id = next_client_id++;
+				client->fd = fd;
+				clients.push_back(std::move(client));
+			}
+		}
+
+		// Render everything requested since the last batch in one submission
+		std::vector<RenderClient*> batch;
+		for (auto &c : clients) {
+			if (c->frame_requested && !c->closed) {
+				batch.push_back(c.get());
+			}
+		}
+		if (!batch.empty()) {
+			VkCommandBufferBeginInfo begin_info = {};
+			begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+			begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+			CHECK_VULKAN(vkBeginCommandBuffer(cmd_buf, &begin_info));
+			std::vector<VkSemaphore> signal_semaphores;
+			for (auto *c : batch) {
+				record_client_frame(*c, cmd_buf, queue_family);
+				if (c->external_memory) {
+					signal_semaphores.push_back(c->frame_semaphore);
+				}
+			}
+			CHECK_VULKAN(vkEndCommandBuffer(cmd_buf));
+
+			VkSubmitInfo submit_info = {};
+			submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+			submit_info.commandBufferCount = 1;
+			submit_info.pCommandBuffers = &cmd_buf;
+			submit_info.signalSemaphoreCount = signal_semaphores.size();
+			submit_info.pSignalSemaphores = signal_semaphores.data();
+			CHECK_VULKAN(vkQueueSubmit(queue, 1, &submit_info, fence));
+			++submissions;
+
+			// Clients sharing their target wait on its semaphore so they're told right away, the
+			// others once their frame is copied
+			for (auto *c : batch) {
+				if (c->external_memory) {
+					send_frame_ready(*c, batch.size());
+				}
+			}
+			CHECK_VULKAN(vkWaitForFences(device, 1, &fence, VK_TRUE, std::numeric_limits<uint64_t>::max()));
+			CHECK_VULKAN(vkResetFences(device, 1, &fence));
+			for (auto *c : batch) {
+				if (!c->external_memory) {
+					std::memcpy(c->shm, c->readback_mapping, c->shm_size);
+					send_frame_ready(*c, batch.size());
+				}
+			}
+			frames_rendered += batch.size();
+		}
+
+		// Nothing is rendering, so disconnected clients' resources can be destroyed right away
+		for (auto it = clients.begin(); it != clients.end();) {
+			if ((*it)->closed) {
+				std::cout << "Render client " << (*it)->id << " disconnected\n";
+				destroy_client(device, **it);
+				it = clients.erase(it);
+			} else {
+				++it;
+			}
+		}
+	}
+
+	std::cout << "Render server stopping, rendered " << frames_rendered << " frames in " << submissions
+		<< " submissions\n";
+	for (auto &c : clients) {
+		destroy_client(device, *c);
+	}
+	std::signal(SIGINT, SIG_DFL);
+	std::signal(SIGTERM, SIG_DFL);
+	close(listen_fd);
+	unlink(params.socket_path.c_str());
+	vkDestroyFence(device, fence, nullptr);
+	vkDestroyCommandPool(device, command_pool, nullptr);
+}
+
+#endif
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <string>
+#include <vulkan/vulkan.h>
+#include "oit.h"
+
+// A headless render server sharing one device between local clients. Clients connect to a
+// Unix domain socket, send scene and camera updates and request frames with the protocol in
+// render_protocol.h, and read the rendered frames from shared memory, or share the render
+// target itself through external memory if they're on the same device. Each client's scene is
+// drawn with the OIT renderer into its own target, and all the frame requests received since
+// the last submission are rendered together in a single submission.
+//
+// Only supported on POSIX systems, elsewhere the server reports that and returns.
+struct RenderServerParams {
+	std::string socket_path;
+	OITMode oit_mode = OITMode::SORTED;
+	// The scene a client renders until it sends its own
+	uint32_t default_instances = 1024;
+	uint32_t max_clients = 16;
+	// Largest frame a client can ask for
+	uint32_t max_extent = 4096;
+	// Share render targets with the clients asking for it, the device must have been created
+	// with the external memory extensions
+	bool external_memory = false;
+};
+
+// Serve until SIGINT or SIGTERM
+void run_render_server(VkDevice device, VkPhysicalDevice physical_device, VkQueue queue, uint32_t queue_family,
+		const RenderServerParams &params);
@@ -0,0 +1,170 @@
+#include "resources.h"
+
+template<typename T>
+static ResourceHandle<T> add_resource(ResourcePool<T> &pool, const T &resource) {
+	uint32_t index = 0;
+	if (!pool.free_slots.empty()) {
+		index = pool.free_slots.back();
+		pool.free_slots.pop_back();
+	} else {
+		index = pool.slots.size();
+		pool.slots.emplace_back();
+	}
+	auto &slot = pool.slots[index];
+	slot.resource = resource;
+	slot.used = true;
+
+	ResourceHandle<T> handle;
+	handle.index = index;
+	handle.generation = slot.generation;
+	return handle;
+}
+
+template<typename T>
+static bool resource_valid(const ResourcePool<T> &pool, ResourceHandle<T> handle) {
+	return handle.index < pool.slots.size() && pool.slots[handle.index].used
+		&& pool.slots[handle.index].generation == handle.generation;
+}
+
+template<typename T>
+static const T& get_resource(const ResourcePool<T> &pool, ResourceHandle<T> handle) {
+	if (!resource_valid(pool, handle)) {
+		throw std::runtime_error("Stale resource handle");
+	}
+	return pool.slots[handle.index].resource;
+}
+
+// Free the handle's slot for reuse and queue its resource for destruction
+template<typename T>
+static void release_resource(ResourcePool<T> &pool, std::deque<DeferredDestroy<T>> &deferred,
+		ResourceHandle<T> handle, uint64_t value)
+{
+	if (!resource_valid(pool, handle)) {
+		throw std::runtime_error("Releasing a stale resource handle");
+	}
+	auto &slot = pool.slots[handle.index];
+	DeferredDestroy<T> d;
+	d.resource = slot.resource;
+	d.value = value;
+	deferred.push_back(d);
+
+	slot.resource = T();
+	slot.used = false;
+	++slot.generation;
+	pool.free_slots.push_back(handle.index);
+}
+
+// The deferred destructions are queued in increasing value order
+template<typename T, typename F>
+static void collect_deferred(std::deque<DeferredDestroy<T>> &deferred, uint64_t completed_value, F destroy) {
+	while (!deferred.empty() && deferred.front().value <= completed_value) {
+		destroy(deferred.front().resource);
+		deferred.pop_front();
+	}
+}
+
+BufferHandle add_buffer(ResourceManager &resources, const Buffer &buffer) {
+	++resources.stats.live_buffers;
+	return add_resource(resources.buffers, buffer);
+}
+
+ImageHandle add_image(ResourceManager &resources, const Image &image) {
+	++resources.stats.live_images;
+	return add_resource(resources.images, image);
+}
+
+PipelineHandle add_pipeline(ResourceManager &resources, VkPipeline pipeline) {
+	++resources.stats.live_pipelines;
+	return add_resource(resources.pipelines, pipeline);
+}
+
+bool is_valid(const ResourceManager &resources, BufferHandle handle) {
+	return resource_valid(resources.buffers, handle);
+}
+
+bool is_valid(const ResourceManager &resources, ImageHandle handle) {
+	return resource_valid(resources.images, handle);
+}
+
+bool is_valid(const ResourceManager &resources, PipelineHandle handle) {
+	return resource_valid(resources.pipelines, handle);
+}
+
+const Buffer& get_buffer(const ResourceManager &resources, BufferHandle handle) {
+	return get_resource(resources.buffers, handle);
+}
+
+const Image& get_image(const ResourceManager &resources, ImageHandle handle) {
+	return get_resource(resources.images, handle);
+}
+
+VkPipeline get_pipeline(const ResourceManager &resources, PipelineHandle handle) {
+	return get_resource(resources.pipelines, handle);
+}
+
+void release_buffer(ResourceManager &resources, BufferHandle handle) {
+	release_resource(resources.buffers, resources.deferred_buffers, handle, resources.recording_value);
+	--resources.stats.live_buffers;
+}
+
+void release_image(ResourceManager &resources, ImageHandle handle) {
+	release_resource(resources.images, resources.deferred_images, handle, resources.recording_value);
+	--resources.stats.live_images;
+}
+
+void release_pipeline(ResourceManager &resources, PipelineHandle handle) {
+	release_resource(resources.pipelines, resources.deferred_pipelines, handle, resources.recording_value);
+	--resources.stats.live_pipelines;
+}
+
+uint64_t submit_resource_timeline(ResourceManager &resources) {
+	return resources.recording_value++;
+}
+
+void complete_resource_timeline(VkDevice device, ResourceManager &resources, uint64_t value) {
+	if (value <= resources.completed_value) {
+		return;
+	}
+	resources.completed_value = value;
+	uint64_t &num_destroyed = resources.stats.deferred_destroys;
+	collect_deferred(resources.deferred_buffers, value, [&](Buffer &b) {
+		destroy_buffer(device, b);
+		++num_destroyed;
+	});
+	collect_deferred(resources.deferred_images, value, [&](Image &img) {
+		destroy_image(device, img);
+		++num_destroyed;
+	});
+	collect_deferred(resources.deferred_pipelines, value, [&](VkPipeline &p) {
+		vkDestroyPipeline(device, p, nullptr);
+		++num_destroyed;
+	});
+}
+
+void complete_all_resource_timeline(VkDevice device, ResourceManager &resources) {
+	complete_resource_timeline(device, resources, resources.recording_value - 1);
+}
+
+void flush_released_resources(VkDevice device, ResourceManager &resources) {
+	complete_resource_timeline(device, resources, resources.recording_value++);
+}
+
+void destroy_resource_manager(VkDevice device, ResourceManager &resources) {
+	flush_released_resources(device, resources);
+	for (auto &s : resources.buffers.slots) {
+		if (s.used) {
+			destroy_buffer(device, s.resource);
+		}
+	}
+	for (auto &s : resources.images.slots) {
+		if (s.used) {
+			destroy_image(device, s.resource);
+		}
+	}
+	for (auto &s : resources.pipelines.slots) {
+		if (s.used) {
+			vkDestroyPipeline(device, s.resource, nullptr);
+		}
+	}
+	resources = ResourceManager();
+}
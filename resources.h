@@ -0,0 +1,109 @@
+#pragma once
+
+#include <deque>
+#include <vector>
+#include <vulkan/vulkan.h>
+#include "vulkan_utils.h"
+
+// Buffers, images and pipelines referenced by generational handles, whose destruction is
+// deferred until the GPU is done with them. Releasing a resource frees its slot right away
+// and bumps the slot's generation, so handles to the released resource no longer resolve
+// even once the slot is reused, while the resource itself is queued for destruction once the
+// submission being recorded completes. Resources can then be replaced while frames using
+// them are in flight, without waiting for the device to go idle.
+//
+// GPU progress is tracked with a timeline of submission values: each submission is assigned
+// the next value and when its fence is waited on its value is completed. Submissions to the
+// queue complete in order, so completing a value completes all earlier ones. The frames
+// already wait on their fences before reusing their command buffers, so this needs no
+// VK_KHR_timeline_semaphore, which isn't supported by every Vulkan 1.1 driver.
+
+template<typename T>
+struct ResourceHandle {
+	uint32_t index = 0;
+	// Slot generations start at 1, so a default constructed handle never resolves
+	uint32_t generation = 0;
+};
+
+using BufferHandle = ResourceHandle<Buffer>;
+using ImageHandle = ResourceHandle<Image>;
+using PipelineHandle = ResourceHandle<VkPipeline>;
+
+template<typename T>
+struct ResourcePool {
+	struct Slot {
+		T resource = T();
+		uint32_t generation = 1;
+		bool used = false;
+	};
+	std::vector<Slot> slots;
+	std::vector<uint32_t> free_slots;
+};
+
+// A released resource waiting for the submission value to complete
+template<typename T>
+struct DeferredDestroy {
+	T resource = T();
+	uint64_t value = 0;
+};
+
+struct ResourceStats {
+	uint32_t live_buffers = 0;
+	uint32_t live_images = 0;
+	uint32_t live_pipelines = 0;
+	uint64_t deferred_destroys = 0;
+};
+
+struct ResourceManager {
+	ResourcePool<Buffer> buffers;
+	ResourcePool<Image> images;
+	ResourcePool<VkPipeline> pipelines;
+
+	std::deque<DeferredDestroy<Buffer>> deferred_buffers;
+	std::deque<DeferredDestroy<Image>> deferred_images;
+	std::deque<DeferredDestroy<VkPipeline>> deferred_pipelines;
+
+	// The value of the submission being recorded, and the last completed one
+	uint64_t recording_value = 1;
+	uint64_t completed_value = 0;
+
+	ResourceStats stats;
+};
+
+// Take ownership of the resource, it's destroyed by the manager once released
+BufferHandle add_buffer(ResourceManager &resources, const Buffer &buffer);
+ImageHandle add_image(ResourceManager &resources, const Image &image);
+PipelineHandle add_pipeline(ResourceManager &resources, VkPipeline pipeline);
+
+bool is_valid(const ResourceManager &resources, BufferHandle handle);
+bool is_valid(const ResourceManager &resources, ImageHandle handle);
+bool is_valid(const ResourceManager &resources, PipelineHandle handle);
+
+// Throws if the handle's resource was released
+const Buffer& get_buffer(const ResourceManager &resources, BufferHandle handle);
+const Image& get_image(const ResourceManager &resources, ImageHandle handle);
+VkPipeline get_pipeline(const ResourceManager &resources, PipelineHandle handle);
+
+// Invalidate the handle and destroy the resource once the submission being recorded and all
+// earlier ones complete. Releasing an invalid handle throws
+void release_buffer(ResourceManager &resources, BufferHandle handle);
+void release_image(ResourceManager &resources, ImageHandle handle);
+void release_pipeline(ResourceManager &resources, PipelineHandle handle);
+
+// Called when the recorded commands are submitted, returns the submission's value to complete
+// once its fence is signaled
+uint64_t submit_resource_timeline(ResourceManager &resources);
+
+// Complete the submission value and destroy the resources released before it
+void complete_resource_timeline(VkDevice device, ResourceManager &resources, uint64_t value);
+
+// Complete all submitted values, after waiting for the device to go idle
+void complete_all_resource_timeline(VkDevice device, ResourceManager &resources);
+
+// Destroy all released resources, including those released while recording a submission
+// that was never made. That submission's value is skipped, so later submissions get values
+// which haven't completed yet. The device must be idle
+void flush_released_resources(VkDevice device, ResourceManager &resources);
+
+// Destroy the released and all live resources, the device must be idle
+void destroy_resource_manager(VkDevice device, ResourceManager &resources);
@@ -0,0 +1,80 @@
+#include <array>
+#include <limits>
+#include <map>
+#include "scene.h"
+
+std::vector<vec3> make_box(const vec3 &center, const vec3 &half_extents) {
+	const std::array<vec3, 8> corners = {
+		center + vec3(-half_extents.x, -half_extents.y, -half_extents.z),
+		center + vec3(half_extents.x, -half_extents.y, -half_extents.z),
+		center + vec3(half_extents.x, half_extents.y, -half_extents.z),
+		center + vec3(-half_extents.x, half_extents.y, -half_extents.z),
+		center + vec3(-half_extents.x, -half_extents.y, half_extents.z),
+		center + vec3(half_extents.x, -half_extents.y, half_extents.z),
+		center + vec3(half_extents.x, half_extents.y, half_extents.z),
+		center + vec3(-half_extents.x, half_extents.y, half_extents.z)
+	};
+	// Two triangles per face, each face listed as a quad wound clockwise seen from outside
+	const std::array<std::array<int, 4>, 6> faces = {{
+		{{4, 7, 6, 5}}, // +z
+		{{1, 2, 3, 0}}, // -z
+		{{5, 6, 2, 1}}, // +x
+		{{0, 3, 7, 4}}, // -x
+		{{7, 3, 2, 6}}, // +y
+		{{0, 4, 5, 1}}  // -y
+	}};
+	std::vector<vec3> positions;
+	positions.reserve(36);
+	for (const auto &f : faces) {
+		positions.push_back(corners[f[0]]);
+		positions.push_back(corners[f[1]]);
+		positions.push_back(corners[f[2]]);
+
+		positions.push_back(corners[f[0]]);
+		positions.push_back(corners[f[2]]);
+		positions.push_back(corners[f[3]]);
+	}
+	return positions;
+}
+
+std::vector<vec3> make_ground_plane(float half_size, float height) {
+	const vec3 a(-half_size, height, -half_size);
+	const vec3 b(half_size, height, -half_size);
+	const vec3 c(half_size, height, half_size);
+	const vec3 d(-half_size, height, half_size);
+	return std::vector<vec3>{a, b, c, a, c, d};
+}
+
+void make_indexed(const std::vector<vec3> &positions, std::vector<vec3> &vertices, std::vector<uint32_t> &indices) {
+	auto less = [](const vec3 &a, const vec3 &b) {
+		if (a.x != b.x) {
+			return a.x < b.x;
+		}
+		if (a.y != b.y) {
+			return a.y < b.y;
+		}
+		return a.z < b.z;
+	};
+	std::map<vec3, uint32_t, decltype(less)> vertex_indices(less);
+	vertices.clear();
+	indices.clear();
+	for (const auto &p : positions) {
+		auto it = vertex_indices.find(p);
+		if (it == vertex_indices.end()) {
+			it = vertex_indices.emplace(p, uint32_t(vertices.size())).first;
+			vertices.push_back(p);
+		}
+		indices.push_back(it->second);
+	}
+}
+
+void compute_bounds(const std::vector<vec3> &positions, vec3 &bounds_min, vec3 &bounds_max) {
+	bounds_min = vec3(std::numeric_limits<float>::infinity(), std::numeric_limits<float>::infinity(),
+			std::numeric_limits<float>::infinity());
+	bounds_max = bounds_min * -1.f;
+	for (const auto &p : positions) {
+		bounds_min = min(bounds_min, p);
+		bounds_max = max(bounds_max, p);
+	}
+}
+
@@ -0,0 +1,19 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include "linalg.h"
+
+// Procedural geometry for the demo scenes, as non-indexed triangle lists of positions.
+// Faces are wound clockwise when viewed from outside in the y-up world space
+
+std::vector<vec3> make_box(const vec3 &center, const vec3 &half_extents);
+
+// A square in the xz plane at the given height, facing up
+std::vector<vec3> make_ground_plane(float half_size, float height);
+
+// Merge the triangle list's identical positions into indexed vertices, for the geometry pool
+void make_indexed(const std::vector<vec3> &positions, std::vector<vec3> &vertices, std::vector<uint32_t> &indices);
+
+void compute_bounds(const std::vector<vec3> &positions, vec3 &bounds_min, vec3 &bounds_max);
+
@@ -0,0 +1,267 @@
+#include <array>
+#include "scene_pass.h"
+#include "spirv_shaders_embedded_spv.h"
+
+static VkRenderPass create_scene_render_pass(VkDevice device, VkFormat format, VkSampleCountFlagBits samples,
+		bool load)
+{
+	std::vector<VkAttachmentDescription> attachments;
+	VkAttachmentDescription color_attachment = {};
+	color_attachment.format = format;
+	color_attachment.samples = samples;
+	color_attachment.loadOp = load ? VK_ATTACHMENT_LOAD_OP_LOAD : VK_ATTACHMENT_LOAD_OP_CLEAR;
+	color_attachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+	color_attachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+	color_attachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+	if (samples == VK_SAMPLE_COUNT_1_BIT) {
+		color_attachment.initialLayout = load ? VK_IMAGE_LAYOUT_PRESENT_SRC_KHR : VK_IMAGE_LAYOUT_UNDEFINED;
+		color_attachment.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+		attachments.push_back(color_attachment);
+	} else {
+		color_attachment.initialLayout = load ? VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL : VK_IMAGE_LAYOUT_UNDEFINED;
+		color_attachment.finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+		attachments.push_back(color_attachment);
+
+		// The resolve overwrites the whole swapchain image
+		VkAttachmentDescription resolve_attachment = color_attachment;
+		resolve_attachment.samples = VK_SAMPLE_COUNT_1_BIT;
+		resolve_attachment.loadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+		resolve_attachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		resolve_attachment.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+		attachments.push_back(resolve_attachment);
+	}
+
+	VkAttachmentReference color_attachment_ref = {};
+	color_attachment_ref.attachment = 0;
+	color_attachment_ref.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+	VkAttachmentReference resolve_attachment_ref = {};
+	resolve_attachment_ref.attachment = 1;
+	resolve_attachment_ref.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+	VkSubpassDescription subpass = {};
+	subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+	subpass.colorAttachmentCount = 1;
+	subpass.pColorAttachments = &color_attachment_ref;
+	if (samples != VK_SAMPLE_COUNT_1_BIT) {
+		subpass.pResolveAttachments = &resolve_attachment_ref;
+	}
+
+	// Loading the targets must wait for the previous rendering to them in the frame, and the
+	// multisampled image is shared by the frames in flight
+	VkSubpassDependency dependency = {};
+	dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
+	dependency.dstSubpass = 0;
+	dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT;
+	dependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+	dependency.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+	dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+
+	VkRenderPassCreateInfo render_pass_info = {};
+	render_pass_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+	render_pass_info.attachmentCount = attachments.size();
+	render_pass_info.pAttachments = attachments.data();
+	render_pass_info.subpassCount = 1;
+	render_pass_info.pSubpasses = &subpass;
+	render_pass_info.dependencyCount = 1;
+	render_pass_info.pDependencies = &dependency;
+	VkRenderPass render_pass = VK_NULL_HANDLE;
+	CHECK_VULKAN(vkCreateRenderPass(device, &render_pass_info, nullptr, &render_pass));
+	return render_pass;
+}
+
+VkPipeline create_scene_pipeline(VkDevice device, VkPipelineLayout layout, VkRenderPass render_pass,
+		VkSampleCountFlagBits samples, VkExtent2D extent)
+{
+	VkShaderModule vertex_shader_module = create_shader_module(device, vert_spv, sizeof(vert_spv));
+	VkShaderModule fragment_shader_module = create_shader_module(device, frag_spv, sizeof(frag_spv));
+
+	VkPipelineShaderStageCreateInfo vertex_stage = {};
+	vertex_stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	vertex_stage.stage = VK_SHADER_STAGE_VERTEX_BIT;
+	vertex_stage.module = vertex_shader_module;
+	vertex_stage.pName = "main";
+
+	VkPipelineShaderStageCreateInfo fragment_stage = {};
+	fragment_stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	fragment_stage.stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+	fragment_stage.module = fragment_shader_module;
+	fragment_stage.pName = "main";
+
+	std::array<VkPipelineShaderStageCreateInfo, 2> shader_stages = { vertex_stage, fragment_stage };
+
+	// Vertex data hard-coded in vertex shader
+	VkPipelineVertexInputStateCreateInfo vertex_input_info = {};
+	vertex_input_info.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+	vertex_input_info.vertexBindingDescriptionCount = 0;
+	vertex_input_info.vertexAttributeDescriptionCount = 0;
+
+	// Primitive type
+	VkPipelineInputAssemblyStateCreateInfo input_assembly = {};
+	input_assembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+	input_assembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+	input_assembly.primitiveRestartEnable = VK_FALSE;
+
+	// Viewport config
+	VkViewport viewport = {};
+	viewport.x = 0.0f;
+	viewport.y = 0.0f;
+	viewport.width = extent.width;
+	viewport.height = extent.height;
+	viewport.minDepth = 0.0f;
+	viewport.maxDepth = 1.0f;
+
+	// Scissor rect config
+	VkRect2D scissor = {};
+	scissor.offset.x = 0;
+	scissor.offset.y = 0;
+	scissor.extent = extent;
+
+	VkPipelineViewportStateCreateInfo viewport_state_info = {};
+	viewport_state_info.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+	viewport_state_info.viewportCount = 1;
+	viewport_state_info.pViewports = &viewport;
+	viewport_state_info.scissorCount = 1;
+	viewport_state_info.pScissors = &scissor;
+
+	VkPipelineRasterizationStateCreateInfo rasterizer_info = {};
+	rasterizer_info.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+	rasterizer_info.depthClampEnable = VK_FALSE;
+	rasterizer_info.rasterizerDiscardEnable = VK_FALSE;
+	rasterizer_info.polygonMode = VK_POLYGON_MODE_FILL;
+	rasterizer_info.lineWidth = 1.f;
+	rasterizer_info.cullMode = VK_CULL_MODE_BACK_BIT;
+	rasterizer_info.frontFace = VK_FRONT_FACE_CLOCKWISE;
+	rasterizer_info.depthBiasEnable = VK_FALSE;
+
+	VkPipelineMultisampleStateCreateInfo multisampling = {};
+	multisampling.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+	multisampling.sampleShadingEnable = VK_FALSE;
+	multisampling.rasterizationSamples = samples;
+
+	VkPipelineColorBlendAttachmentState blend_mode = {};
+	blend_mode.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+	blend_mode.blendEnable = VK_FALSE;
+
+	VkPipelineColorBlendStateCreateInfo blend_info = {};
+	blend_info.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+	blend_info.logicOpEnable = VK_FALSE;
+	blend_info.attachmentCount = 1;
+	blend_info.pAttachments = &blend_mode;
+
+	VkGraphicsPipelineCreateInfo graphics_pipeline_info = {};
+	graphics_pipeline_info.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+	graphics_pipeline_info.stageCount = 2;
+	graphics_pipeline_info.pStages = shader_stages.data();
+	graphics_pipeline_info.pVertexInputState = &vertex_input_info;
+	graphics_pipeline_info.pInputAssemblyState = &input_assembly;
+	graphics_pipeline_info.pViewportState = &viewport_state_info;
+	graphics_pipeline_info.pRasterizationState = &rasterizer_info;
+	graphics_pipeline_info.pMultisampleState = &multisampling;
+	graphics_pipeline_info.pColorBlendState = &blend_info;
+	graphics_pipeline_info.layout = layout;
+	graphics_pipeline_info.renderPass = render_pass;
+	graphics_pipeline_info.subpass = 0;
+	VkPipeline pipeline = VK_NULL_HANDLE;
+	CHECK_VULKAN(vkCreateGraphicsPipelines(device, pipeline_cache(), 1, &graphics_pipeline_info, nullptr, &pipeline));
+
+	vkDestroyShaderModule(device, vertex_shader_module, nullptr);
+	vkDestroyShaderModule(device, fragment_shader_module, nullptr);
+	return pipeline;
+}
+
+VkSampleCountFlagBits supported_sample_count(VkPhysicalDevice physical_device, VkSampleCountFlagBits requested) {
+	VkPhysicalDeviceProperties properties = {};
+	vkGetPhysicalDeviceProperties(physical_device, &properties);
+	const VkSampleCountFlags supported = properties.limits.framebufferColorSampleCounts;
+	uint32_t samples = requested;
+	while (samples > 1 && !(supported & samples)) {
+		samples >>= 1;
+	}
+	return VkSampleCountFlagBits(samples);
+}
+
+ScenePass create_scene_pass(VkDevice device, VkPhysicalDevice physical_device, ResourceManager &resources,
+		const Swapchain &swapchain, VkSampleCountFlagBits samples, const std::array<float, 4> &clear_color)
+{
+	ScenePass pass;
+	pass.samples = samples;
+	pass.extent = swapchain.extent;
+	for (size_t i = 0; i < clear_color.size(); ++i) {
+		pass.clear_value.color.float32[i] = clear_color[i];
+	}
+
+	if (samples != VK_SAMPLE_COUNT_1_BIT) {
+		pass.msaa_color = create_image(device, physical_device, swapchain.extent, 1, swapchain.format,
+				VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT, VK_IMAGE_ASPECT_COLOR_BIT, samples);
+		pass.msaa_color_handle = add_image(resources, pass.msaa_color);
+	}
+
+	pass.render_pass = create_scene_render_pass(device, swapchain.format, samples, false);
+	pass.load_render_pass = create_scene_render_pass(device, swapchain.format, samples, true);
+
+	for (const auto &v : swapchain.image_views) {
+		std::vector<VkImageView> attachments;
+		if (samples != VK_SAMPLE_COUNT_1_BIT) {
+			attachments.push_back(pass.msaa_color.view);
+		}
+		attachments.push_back(v);
+
+		VkFramebufferCreateInfo create_info = {};
+		create_info.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+		create_info.renderPass = pass.render_pass;
+		create_info.attachmentCount = attachments.size();
+		create_info.pAttachments = attachments.data();
+		create_info.width = swapchain.extent.width;
+		create_info.height = swapchain.extent.height;
+		create_info.layers = 1;
+		VkFramebuffer fb = VK_NULL_HANDLE;
+		CHECK_VULKAN(vkCreateFramebuffer(device, &create_info, nullptr, &fb));
+		pass.framebuffers.push_back(fb);
+	}
+
+	VkPipelineLayoutCreateInfo pipeline_info = {};
+	pipeline_info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	CHECK_VULKAN(vkCreatePipelineLayout(device, &pipeline_info, nullptr, &pass.pipeline_layout));
+
+	pass.pipeline = create_scene_pipeline(device, pass.pipeline_layout, pass.render_pass, samples, swapchain.extent);
+	pass.pipeline_handle = add_pipeline(resources, pass.pipeline);
+	return pass;
+}
+
+void begin_scene_pass(const ScenePass &pass, VkCommandBuffer cmd_buf, uint32_t image_index, bool load) {
+	VkRenderPassBeginInfo render_pass_info = {};
+	render_pass_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+	render_pass_info.renderPass = load ? pass.load_render_pass : pass.render_pass;
+	render_pass_info.framebuffer = pass.framebuffers[image_index];
+	render_pass_info.renderArea.offset.x = 0;
+	render_pass_info.renderArea.offset.y = 0;
+	render_pass_info.renderArea.extent = pass.extent;
+
+	if (!load) {
+		render_pass_info.clearValueCount = 1;
+		render_pass_info.pClearValues = &pass.clear_value;
+	}
+	vkCmdBeginRenderPass(cmd_buf, &render_pass_info, VK_SUBPASS_CONTENTS_INLINE);
+}
+
+void draw_scene(const ScenePass &pass, VkCommandBuffer cmd_buf) {
+	vkCmdBindPipeline(cmd_buf, VK_PIPELINE_BIND_POINT_GRAPHICS, pass.pipeline);
+
+	// Draw our "triangle" embedded in the shader
+	vkCmdDraw(cmd_buf, 3, 1, 0, 0);
+}
+
+void destroy_scene_pass(VkDevice device, ResourceManager &resources, ScenePass &pass) {
+	release_pipeline(resources, pass.pipeline_handle);
+	vkDestroyPipelineLayout(device, pass.pipeline_layout, nullptr);
+	for (auto &fb : pass.framebuffers) {
+		vkDestroyFramebuffer(device, fb, nullptr);
+	}
+	vkDestroyRenderPass(device, pass.render_pass, nullptr);
+	vkDestroyRenderPass(device, pass.load_render_pass, nullptr);
+	if (is_valid(resources, pass.msaa_color_handle)) {
+		release_image(resources, pass.msaa_color_handle);
+	}
+	pass = ScenePass();
+}
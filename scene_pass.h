@@ -0,0 +1,50 @@
+#pragma once
+
+#include <array>
+#include <vector>
+#include <vulkan/vulkan.h>
+#include "resources.h"
+#include "swapchain.h"
+#include "vulkan_utils.h"
+
+// The main render pass drawing the triangle into the swapchain images. With MSAA the triangle
+// is drawn into a multisampled image which is resolved into the swapchain image at the end
+// of the pass. The image and pipeline are owned by the resource manager, so frames still in
+// flight can use them after the pass is destroyed.
+struct ScenePass {
+	VkSampleCountFlagBits samples = VK_SAMPLE_COUNT_1_BIT;
+	VkExtent2D extent = {};
+	VkClearValue clear_value = {};
+	// Only used with MSAA, its contents are kept so the load pass can draw over them
+	Image msaa_color;
+	ImageHandle msaa_color_handle;
+
+	// Clears the targets and transitions the swapchain image for present
+	VkRenderPass render_pass = VK_NULL_HANDLE;
+	// Compatible with render_pass but loads the targets, for drawing over a frame which
+	// was already rendered in another command buffer or by another renderer
+	VkRenderPass load_render_pass = VK_NULL_HANDLE;
+	std::vector<VkFramebuffer> framebuffers;
+
+	VkPipelineLayout pipeline_layout = VK_NULL_HANDLE;
+	VkPipeline pipeline = VK_NULL_HANDLE;
+	PipelineHandle pipeline_handle;
+};
+
+// The highest sample count supported for color attachments which is at most the requested count
+VkSampleCountFlagBits supported_sample_count(VkPhysicalDevice physical_device, VkSampleCountFlagBits requested);
+
+ScenePass create_scene_pass(VkDevice device, VkPhysicalDevice physical_device, ResourceManager &resources,
+		const Swapchain &swapchain, VkSampleCountFlagBits samples, const std::array<float, 4> &clear_color);
+
+// The triangle pipeline, for drawing it in other render passes
+VkPipeline create_scene_pipeline(VkDevice device, VkPipelineLayout layout, VkRenderPass render_pass,
+		VkSampleCountFlagBits samples, VkExtent2D extent);
+
+void begin_scene_pass(const ScenePass &pass, VkCommandBuffer cmd_buf, uint32_t image_index, bool load);
+
+void draw_scene(const ScenePass &pass, VkCommandBuffer cmd_buf);
+
+// Releases the image and pipeline to the resource manager
+void destroy_scene_pass(VkDevice device, ResourceManager &resources, ScenePass &pass);
+
@@ -0,0 +1,42 @@
+#include "settings.h"
+
+const char* recording_mode_name(RecordingMode mode) {
+	switch (mode) {
+		case RecordingMode::PRERECORDED: return "prerecorded";
+		case RecordingMode::PER_FRAME: return "per_frame";
+	}
+	return "unknown";
+}
+
+bool parse_recording_mode(const std::string &name, RecordingMode &mode) {
+	for (const auto m : { RecordingMode::PRERECORDED, RecordingMode::PER_FRAME }) {
+		if (name == recording_mode_name(m)) {
+			mode = m;
+			return true;
+		}
+	}
+	return false;
+}
+
+const char* present_mode_name(VkPresentModeKHR mode) {
+	switch (mode) {
+		case VK_PRESENT_MODE_IMMEDIATE_KHR: return "immediate";
+		case VK_PRESENT_MODE_MAILBOX_KHR: return "mailbox";
+		case VK_PRESENT_MODE_FIFO_KHR: return "fifo";
+		case VK_PRESENT_MODE_FIFO_RELAXED_KHR: return "fifo_relaxed";
+		default: break;
+	}
+	return "unknown";
+}
+
+bool parse_present_mode(const std::string &name, VkPresentModeKHR &mode) {
+	for (const auto m : { VK_PRESENT_MODE_IMMEDIATE_KHR, VK_PRESENT_MODE_MAILBOX_KHR, VK_PRESENT_MODE_FIFO_KHR,
+			VK_PRESENT_MODE_FIFO_RELAXED_KHR })
+	{
+		if (name == present_mode_name(m)) {
+			mode = m;
+			return true;
+		}
+	}
+	return false;
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <string>
+#include <vulkan/vulkan.h>
+
+// The most frames which can be in flight, per-frame resources are allocated for this many
+const uint32_t MAX_FRAMES_IN_FLIGHT = 3;
+
+enum class RecordingMode {
+	// The scene command buffers are recorded once per swapchain image and resubmitted
+	PRERECORDED,
+	// Each frame's commands are recorded fresh into the frame's command buffer
+	PER_FRAME
+};
+
+const char* recording_mode_name(RecordingMode mode);
+
+bool parse_recording_mode(const std::string &name, RecordingMode &mode);
+
+const char* present_mode_name(VkPresentModeKHR mode);
+
+bool parse_present_mode(const std::string &name, VkPresentModeKHR &mode);
+
+// Rendering settings which can be changed at runtime. Changing the present mode or MSAA
+// rebuilds the swapchain and the resources depending on it
+struct RenderSettings {
+	VkPresentModeKHR present_mode = VK_PRESENT_MODE_FIFO_KHR;
+	VkSampleCountFlagBits msaa_samples = VK_SAMPLE_COUNT_1_BIT;
+	uint32_t frames_in_flight = 1;
+	RecordingMode recording_mode = RecordingMode::PRERECORDED;
+};
+
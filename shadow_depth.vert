@@ -0,0 +1,13 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+layout(location = 0) in vec3 position;
+
+layout(push_constant) uniform CasterParams {
+	mat4 light_view_proj_model;
+};
+
+void main() {
+	gl_Position = light_view_proj_model * vec4(position, 1.0);
+}
+
@@ -0,0 +1,468 @@
+#include <array>
+#include <algorithm>
+#include <limits>
+#include "shadow_maps.h"
+#include "spirv_shaders_embedded_spv.h"
+
+static VkFormat pick_depth_format(VkPhysicalDevice physical_device) {
+	const std::array<VkFormat, 2> candidates = { VK_FORMAT_D32_SFLOAT, VK_FORMAT_D16_UNORM };
+	for (const auto &f : candidates) {
+		VkFormatProperties props = {};
+		vkGetPhysicalDeviceFormatProperties(physical_device, f, &props);
+		const VkFormatFeatureFlags required = VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT
+			| VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT;
+		if ((props.optimalTilingFeatures & required) == required) {
+			return f;
+		}
+	}
+	throw std::runtime_error("No supported shadow map depth format");
+}
+
+static VkRenderPass create_depth_render_pass(VkDevice device, VkFormat format, VkAttachmentLoadOp load_op) {
+	// Layout transitions are done explicitly around the pass since the cascades move
+	// between rendering, copying and sampling
+	VkAttachmentDescription depth_attachment = {};
+	depth_attachment.format = format;
+	depth_attachment.samples = VK_SAMPLE_COUNT_1_BIT;
+	depth_attachment.loadOp = load_op;
+	depth_attachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+	depth_attachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+	depth_attachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+	depth_attachment.initialLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+	depth_attachment.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+	VkAttachmentReference depth_attachment_ref = {};
+	depth_attachment_ref.attachment = 0;
+	depth_attachment_ref.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+	VkSubpassDescription subpass = {};
+	subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+	subpass.colorAttachmentCount = 0;
+	subpass.pDepthStencilAttachment = &depth_attachment_ref;
+
+	VkRenderPassCreateInfo render_pass_info = {};
+	render_pass_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+	render_pass_info.attachmentCount = 1;
+	render_pass_info.pAttachments = &depth_attachment;
+	render_pass_info.subpassCount = 1;
+	render_pass_info.pSubpasses = &subpass;
+
+	VkRenderPass render_pass = VK_NULL_HANDLE;
+	CHECK_VULKAN(vkCreateRenderPass(device, &render_pass_info, nullptr, &render_pass));
+	return render_pass;
+}
+
+ShadowMaps create_shadow_maps(VkDevice device, VkPhysicalDevice physical_device, ResourceManager &resources,
+		uint32_t num_cascades, uint32_t resolution)
+{
+	ShadowMaps shadows;
+	shadows.resolution = resolution;
+	shadows.cascades.resize(num_cascades);
+
+	const VkFormat depth_format = pick_depth_format(physical_device);
+	VkExtent2D extent = {};
+	extent.width = resolution;
+	extent.height = resolution;
+
+	shadows.shadow_depth = create_image(device, physical_device, extent, num_cascades, depth_format,
+			VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT,
+			VK_IMAGE_ASPECT_DEPTH_BIT);
+	shadows.static_depth = create_image(device, physical_device, extent, num_cascades, depth_format,
+			VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT,
+			VK_IMAGE_ASPECT_DEPTH_BIT);
+	shadows.shadow_depth_handle = add_image(resources, shadows.shadow_depth);
+	shadows.static_depth_handle = add_image(resources, shadows.static_depth);
+
+	shadows.clear_render_pass = create_depth_render_pass(device, depth_format, VK_ATTACHMENT_LOAD_OP_CLEAR);
+	shadows.load_render_pass = create_depth_render_pass(device, depth_format, VK_ATTACHMENT_LOAD_OP_LOAD);
+
+	for (uint32_t i = 0; i < num_cascades; ++i) {
+		shadows.shadow_layer_views.push_back(create_image_view(device, shadows.shadow_depth.image,
+					VK_IMAGE_VIEW_TYPE_2D, depth_format, VK_IMAGE_ASPECT_DEPTH_BIT, i, 1));
+		shadows.static_layer_views.push_back(create_image_view(device, shadows.static_depth.image,
+					VK_IMAGE_VIEW_TYPE_2D, depth_format, VK_IMAGE_ASPECT_DEPTH_BIT, i, 1));
+
+		VkFramebufferCreateInfo create_info = {};
+		create_info.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+		create_info.renderPass = shadows.load_render_pass;
+		create_info.attachmentCount = 1;
+		create_info.pAttachments = &shadows.shadow_layer_views.back();
+		create_info.width = resolution;
+		create_info.height = resolution;
+		create_info.layers = 1;
+		VkFramebuffer fb = VK_NULL_HANDLE;
+		CHECK_VULKAN(vkCreateFramebuffer(device, &create_info, nullptr, &fb));
+		shadows.shadow_framebuffers.push_back(fb);
+
+		create_info.renderPass = shadows.clear_render_pass;
+		create_info.pAttachments = &shadows.static_layer_views.back();
+		CHECK_VULKAN(vkCreateFramebuffer(device, &create_info, nullptr, &fb));
+		shadows.static_framebuffers.push_back(fb);
+	}
+
+	// Depth only pipeline, there's no fragment shader. The depth bias is dynamic so it can
+	// be scaled with each cascade's texel size
+	{
+		VkShaderModule vertex_shader_module = create_shader_module(device, shadow_depth_spv, sizeof(shadow_depth_spv));
+
+		VkPipelineShaderStageCreateInfo vertex_stage = {};
+		vertex_stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+		vertex_stage.stage = VK_SHADER_STAGE_VERTEX_BIT;
+		vertex_stage.module = vertex_shader_module;
+		vertex_stage.pName = "main";
+
+		VkVertexInputBindingDescription vertex_binding = {};
+		vertex_binding.binding = 0;
+		vertex_binding.stride = sizeof(vec3);
+		vertex_binding.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+
+		VkVertexInputAttributeDescription position_attrib = {};
+		position_attrib.location = 0;
+		position_attrib.binding = 0;
+		position_attrib.format = VK_FORMAT_R32G32B32_SFLOAT;
+		position_attrib.offset = 0;
+
+		VkPipelineVertexInputStateCreateInfo vertex_input_info = {};
+		vertex_input_info.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+		vertex_input_info.vertexBindingDescriptionCount = 1;
+		vertex_input_info.pVertexBindingDescriptions = &vertex_binding;
+		vertex_input_info.vertexAttributeDescriptionCount = 1;
+		vertex_input_info.pVertexAttributeDescriptions = &position_attrib;
+
+		VkPipelineInputAssemblyStateCreateInfo input_assembly = {};
+		input_assembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+		input_assembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+		input_assembly.primitiveRestartEnable = VK_FALSE;
+
+		VkViewport viewport = {};
+		viewport.x = 0.0f;
+		viewport.y = 0.0f;
+		viewport.width = resolution;
+		viewport.height = resolution;
+		viewport.minDepth = 0.0f;
+		viewport.maxDepth = 1.0f;
+
+		VkRect2D scissor = {};
+		scissor.extent = extent;
+
+		VkPipelineViewportStateCreateInfo viewport_state_info = {};
+		viewport_state_info.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+		viewport_state_info.viewportCount = 1;
+		viewport_state_info.pViewports = &viewport;
+		viewport_state_info.scissorCount = 1;
+		viewport_state_info.pScissors = &scissor;
+
+		// Casters are drawn double sided so thin and open geometry still casts shadows,
+		// the depth bias keeps the lit faces from self shadowing
+		VkPipelineRasterizationStateCreateInfo rasterizer_info = {};
+		rasterizer_info.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+		rasterizer_info.depthClampEnable = VK_FALSE;
+		rasterizer_info.rasterizerDiscardEnable = VK_FALSE;
+		rasterizer_info.polygonMode = VK_POLYGON_MODE_FILL;
+		rasterizer_info.lineWidth = 1.f;
+		rasterizer_info.cullMode = VK_CULL_MODE_NONE;
+		rasterizer_info.frontFace = VK_FRONT_FACE_CLOCKWISE;
+		rasterizer_info.depthBiasEnable = VK_TRUE;
+
+		VkPipelineMultisampleStateCreateInfo multisampling = {};
+		multisampling.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+		multisampling.sampleShadingEnable = VK_FALSE;
+		multisampling.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+
+		VkPipelineDepthStencilStateCreateInfo depth_stencil_info = {};
+		depth_stencil_info.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+		depth_stencil_info.depthTestEnable = VK_TRUE;
+		depth_stencil_info.depthWriteEnable = VK_TRUE;
+		depth_stencil_info.depthCompareOp = VK_COMPARE_OP_LESS_OR_EQUAL;
+
+		VkPipelineColorBlendStateCreateInfo blend_info = {};
+		blend_info.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+		blend_info.logicOpEnable = VK_FALSE;
+		blend_info.attachmentCount = 0;
+
+		const std::array<VkDynamicState, 1> dynamic_states = { VK_DYNAMIC_STATE_DEPTH_BIAS };
+		VkPipelineDynamicStateCreateInfo dynamic_state_info = {};
+		dynamic_state_info.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+		dynamic_state_info.dynamicStateCount = dynamic_states.size();
+		dynamic_state_info.pDynamicStates = dynamic_states.data();
+
+		VkPushConstantRange push_constants = {};
+		push_constants.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+		push_constants.offset = 0;
+		push_constants.size = sizeof(mat4);
+
+		VkPipelineLayoutCreateInfo pipeline_info = {};
+		pipeline_info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+		pipeline_info.pushConstantRangeCount = 1;
+		pipeline_info.pPushConstantRanges = &push_constants;
+		CHECK_VULKAN(vkCreatePipelineLayout(device, &pipeline_info, nullptr, &shadows.pipeline_layout));
+
+		VkGraphicsPipelineCreateInfo graphics_pipeline_info = {};
+		graphics_pipeline_info.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+		graphics_pipeline_info.stageCount = 1;
+		graphics_pipeline_info.pStages = &vertex_stage;
+		graphics_pipeline_info.pVertexInputState = &vertex_input_info;
+		graphics_pipeline_info.pInputAssemblyState = &input_assembly;
+		graphics_pipeline_info.pViewportState = &viewport_state_info;
+		graphics_pipeline_info.pRasterizationState = &rasterizer_info;
+		graphics_pipeline_info.pMultisampleState = &multisampling;
+		graphics_pipeline_info.pDepthStencilState = &depth_stencil_info;
+		graphics_pipeline_info.pColorBlendState = &blend_info;
+		graphics_pipeline_info.pDynamicState = &dynamic_state_info;
+		graphics_pipeline_info.layout = shadows.pipeline_layout;
+		graphics_pipeline_info.renderPass = shadows.clear_render_pass;
+		graphics_pipeline_info.subpass = 0;
+		CHECK_VULKAN(vkCreateGraphicsPipelines(device, pipeline_cache(), 1, &graphics_pipeline_info, nullptr, &shadows.pipeline));
+
+		vkDestroyShaderModule(device, vertex_shader_module, nullptr);
+	}
+	shadows.pipeline_handle = add_pipeline(resources, shadows.pipeline);
+	return shadows;
+}
+
+// Check if the caster's bounds overlap the cascade's region of the shadow map. Casters
+// between the light and the cascade are kept since the depth range covers them
+static bool caster_in_cascade(const ShadowCaster &caster, const ShadowCascade &cascade) {
+	vec3 ndc_min(std::numeric_limits<float>::infinity(), std::numeric_limits<float>::infinity(),
+			std::numeric_limits<float>::infinity());
+	vec3 ndc_max = ndc_min * -1.f;
+	for (int i = 0; i < 8; ++i) {
+		const vec3 corner((i & 1) ? caster.bounds_max.x : caster.bounds_min.x,
+				(i & 2) ? caster.bounds_max.y : caster.bounds_min.y,
+				(i & 4) ? caster.bounds_max.z : caster.bounds_min.z);
+		const vec3 p = transform_point(cascade.light_view_proj, corner);
+		ndc_min = min(ndc_min, p);
+		ndc_max = max(ndc_max, p);
+	}
+	return ndc_max.x >= -1.f && ndc_min.x <= 1.f && ndc_max.y >= -1.f && ndc_min.y <= 1.f && ndc_min.z <= 1.f;
+}
+
+void update_shadow_cascades(ShadowMaps &shadows, const Camera &camera, const vec3 &light_dir) {
+	const vec3 forward = normalize(camera.target - camera.position);
+	const vec3 right = normalize(cross(forward, camera.up));
+	const vec3 up = cross(right, forward);
+	const float tan_half_y = std::tan(camera.fovy / 2.f);
+	const float tan_half_x = tan_half_y * camera.aspect;
+
+	// The light space rotation shared by all cascades, the translation is folded into the
+	// snapped ortho bounds instead so that it's quantized to texels
+	const vec3 light_up = std::abs(light_dir.y) > 0.99f ? vec3(0.f, 0.f, 1.f) : vec3(0.f, 1.f, 0.f);
+	const mat4 light_view = look_at(vec3(0.f, 0.f, 0.f), light_dir, light_up);
+
+	// Casters outside the view frustum but between it and the light must still be in the
+	// depth range, so find how far towards the light the static casters reach
+	float max_caster_z = -std::numeric_limits<float>::infinity();
+	for (const auto &c : shadows.static_casters) {
+		for (int i = 0; i < 8; ++i) {
+			const vec3 corner((i & 1) ? c.bounds_max.x : c.bounds_min.x,
+					(i & 2) ? c.bounds_max.y : c.bounds_min.y,
+					(i & 4) ? c.bounds_max.z : c.bounds_min.z);
+			max_caster_z = std::max(max_caster_z, transform_point(light_view, corner).z);
+		}
+	}
+
+	const float near_plane = camera.near_plane;
+	const float far_plane = std::min(camera.far_plane, shadows.shadow_distance);
+	const size_t num_cascades = shadows.cascades.size();
+	float split_near = near_plane;
+	for (size_t i = 0; i < num_cascades; ++i) {
+		ShadowCascade &cascade = shadows.cascades[i];
+
+		const float p = float(i + 1) / num_cascades;
+		const float log_split = near_plane * std::pow(far_plane / near_plane, p);
+		const float uniform_split = near_plane + (far_plane - near_plane) * p;
+		const float split_far = shadows.split_lambda * log_split + (1.f - shadows.split_lambda) * uniform_split;
+		cascade.split_near = split_near;
+		cascade.split_far = split_far;
+		split_near = split_far;
+
+		std::array<vec3, 8> corners;
+		vec3 center;
+		for (int j = 0; j < 8; ++j) {
+			const float d = (j & 4) ? cascade.split_far : cascade.split_near;
+			const float sx = (j & 1) ? 1.f : -1.f;
+			const float sy = (j & 2) ? 1.f : -1.f;
+			corners[j] = camera.position + forward * d + right * (sx * d * tan_half_x) + up * (sy * d * tan_half_y);
+			center = center + corners[j];
+		}
+		center = center / 8.f;
+
+		float radius = 0.f;
+		for (const auto &c : corners) {
+			radius = std::max(radius, length(c - center));
+		}
+		// Quantize the radius too so floating point noise doesn't change the projection
+		radius = std::ceil(radius * 16.f) / 16.f;
+
+		const float texel_size = 2.f * radius / shadows.resolution;
+		vec3 light_center = transform_point(light_view, center);
+		light_center.x = std::floor(light_center.x / texel_size) * texel_size;
+		light_center.y = std::floor(light_center.y / texel_size) * texel_size;
+
+		// The light looks down -z, so the near and far planes are distances along -z
+		const float z_near = -std::max(light_center.z + radius, max_caster_z);
+		const float z_far = -(light_center.z - radius);
+		cascade.light_view_proj = ortho(light_center.x - radius, light_center.x + radius,
+				light_center.y - radius, light_center.y + radius, z_near, z_far) * light_view;
+
+		cascade.static_dirty = !cascade.cache_valid
+			|| cascade.cached_light_view_proj != cascade.light_view_proj
+			|| cascade.cached_static_version != shadows.static_version;
+
+		cascade.dynamic_casters = false;
+		for (const auto &c : shadows.dynamic_casters) {
+			if (caster_in_cascade(c, cascade)) {
+				cascade.dynamic_casters = true;
+				break;
+			}
+		}
+		cascade.shadow_dirty = cascade.static_dirty || cascade.dynamic_casters || cascade.had_dynamic_casters;
+	}
+}
+
+bool shadow_maps_need_update(const ShadowMaps &shadows) {
+	return std::find_if(shadows.cascades.begin(), shadows.cascades.end(),
+		[](const ShadowCascade &c) {
+			return c.shadow_dirty;
+		}) != shadows.cascades.end();
+}
+
+static void draw_casters(const ShadowMaps &shadows, const std::vector<ShadowCaster> &casters,
+		const ShadowCascade &cascade, VkCommandBuffer cmd_buf)
+{
+	VkBuffer bound_vertices = VK_NULL_HANDLE;
+	VkBuffer bound_indices = VK_NULL_HANDLE;
+	for (const auto &c : casters) {
+		if (!caster_in_cascade(c, cascade)) {
+			continue;
+		}
+		const mat4 light_view_proj_model = cascade.light_view_proj * c.transform;
+		vkCmdPushConstants(cmd_buf, shadows.pipeline_layout, VK_SHADER_STAGE_VERTEX_BIT,
+				0, sizeof(mat4), &light_view_proj_model);
+
+		if (c.vertex_buffer != bound_vertices) {
+			const VkDeviceSize offset = 0;
+			vkCmdBindVertexBuffers(cmd_buf, 0, 1, &c.vertex_buffer, &offset);
+			bound_vertices = c.vertex_buffer;
+		}
+		if (c.index_buffer != bound_indices) {
+			vkCmdBindIndexBuffer(cmd_buf, c.index_buffer, 0, VK_INDEX_TYPE_UINT32);
+			bound_indices = c.index_buffer;
+		}
+		vkCmdDrawIndexed(cmd_buf, c.index_count, 1, c.first_index, c.vertex_offset, 0);
+	}
+}
+
+static void begin_depth_pass(const ShadowMaps &shadows, VkRenderPass render_pass, VkFramebuffer framebuffer,
+		uint32_t cascade_index, VkCommandBuffer cmd_buf)
+{
+	VkRenderPassBeginInfo render_pass_info = {};
+	render_pass_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+	render_pass_info.renderPass = render_pass;
+	render_pass_info.framebuffer = framebuffer;
+	render_pass_info.renderArea.extent = shadows.shadow_depth.extent;
+
+	VkClearValue clear_depth = {};
+	clear_depth.depthStencil.depth = 1.f;
+	render_pass_info.clearValueCount = 1;
+	render_pass_info.pClearValues = &clear_depth;
+
+	vkCmdBeginRenderPass(cmd_buf, &render_pass_info, VK_SUBPASS_CONTENTS_INLINE);
+	vkCmdBindPipeline(cmd_buf, VK_PIPELINE_BIND_POINT_GRAPHICS, shadows.pipeline);
+
+	// The farther cascades cover more world space per texel and need more bias
+	const float bias_scale = float(cascade_index + 1);
+	vkCmdSetDepthBias(cmd_buf, shadows.depth_bias_constant * bias_scale, 0.f,
+			shadows.depth_bias_slope * bias_scale);
+}
+
+void record_shadow_maps(ShadowMaps &shadows, VkCommandBuffer cmd_buf) {
+	for (uint32_t i = 0; i < shadows.cascades.size(); ++i) {
+		ShadowCascade &cascade = shadows.cascades[i];
+		if (cascade.static_dirty) {
+			image_barrier(cmd_buf, shadows.static_depth.image, VK_IMAGE_ASPECT_DEPTH_BIT,
+					VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+					0, VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+					VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT, i, 1);
+
+			begin_depth_pass(shadows, shadows.clear_render_pass, shadows.static_framebuffers[i], i, cmd_buf);
+			draw_casters(shadows, shadows.static_casters, cascade, cmd_buf);
+			vkCmdEndRenderPass(cmd_buf);
+
+			image_barrier(cmd_buf, shadows.static_depth.image, VK_IMAGE_ASPECT_DEPTH_BIT,
+					VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+					VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT, VK_ACCESS_TRANSFER_READ_BIT,
+					VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, i, 1);
+
+			cascade.cache_valid = true;
+			cascade.cached_light_view_proj = cascade.light_view_proj;
+			cascade.cached_static_version = shadows.static_version;
+			cascade.static_dirty = false;
+			++shadows.static_cascade_renders;
+		}
+
+		if (!cascade.shadow_dirty) {
+			continue;
+		}
+
+		// Restore the static depth from the cache, then draw the dynamic casters over it
+		image_barrier(cmd_buf, shadows.shadow_depth.image, VK_IMAGE_ASPECT_DEPTH_BIT,
+				cascade.layout, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+				VK_ACCESS_SHADER_READ_BIT, VK_ACCESS_TRANSFER_WRITE_BIT,
+				VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, i, 1);
+
+		VkImageCopy copy = {};
+		copy.srcSubresource.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
+		copy.srcSubresource.mipLevel = 0;
+		copy.srcSubresource.baseArrayLayer = i;
+		copy.srcSubresource.layerCount = 1;
+		copy.dstSubresource = copy.srcSubresource;
+		copy.extent.width = shadows.resolution;
+		copy.extent.height = shadows.resolution;
+		copy.extent.depth = 1;
+		vkCmdCopyImage(cmd_buf, shadows.static_depth.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+				shadows.shadow_depth.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &copy);
+
+		if (cascade.dynamic_casters) {
+			image_barrier(cmd_buf, shadows.shadow_depth.image, VK_IMAGE_ASPECT_DEPTH_BIT,
+					VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+					VK_ACCESS_TRANSFER_WRITE_BIT,
+					VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+					VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT, i, 1);
+
+			begin_depth_pass(shadows, shadows.load_render_pass, shadows.shadow_framebuffers[i], i, cmd_buf);
+			draw_casters(shadows, shadows.dynamic_casters, cascade, cmd_buf);
+			vkCmdEndRenderPass(cmd_buf);
+
+			image_barrier(cmd_buf, shadows.shadow_depth.image, VK_IMAGE_ASPECT_DEPTH_BIT,
+					VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL,
+					VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT,
+					VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, i, 1);
+		} else {
+			image_barrier(cmd_buf, shadows.shadow_depth.image, VK_IMAGE_ASPECT_DEPTH_BIT,
+					VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL,
+					VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT,
+					VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, i, 1);
+		}
+
+		cascade.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+		cascade.had_dynamic_casters = cascade.dynamic_casters;
+		cascade.shadow_dirty = false;
+		++shadows.shadow_cascade_updates;
+	}
+}
+
+void destroy_shadow_maps(VkDevice device, ResourceManager &resources, ShadowMaps &shadows) {
+	release_pipeline(resources, shadows.pipeline_handle);
+	vkDestroyPipelineLayout(device, shadows.pipeline_layout, nullptr);
+	for (size_t i = 0; i < shadows.cascades.size(); ++i) {
+		vkDestroyFramebuffer(device, shadows.shadow_framebuffers[i], nullptr);
+		vkDestroyFramebuffer(device, shadows.static_framebuffers[i], nullptr);
+	}
+	vkDestroyRenderPass(device, shadows.clear_render_pass, nullptr);
+	vkDestroyRenderPass(device, shadows.load_render_pass, nullptr);
+	release_image(resources, shadows.shadow_depth_handle);
+	release_image(resources, shadows.static_depth_handle);
+	shadows = ShadowMaps();
+}
+
@@ -0,0 +1,104 @@
+#pragma once
+
+#include <vector>
+#include <vulkan/vulkan.h>
+#include "camera.h"
+#include "resources.h"
+#include "vulkan_utils.h"
+
+// A mesh casting shadows, drawn indexed from its range of a geometry pool block whose vertex
+// buffer holds tightly packed float3 positions. Consecutive casters in the same block share
+// the buffer binds
+struct ShadowCaster {
+	VkBuffer vertex_buffer = VK_NULL_HANDLE;
+	VkBuffer index_buffer = VK_NULL_HANDLE;
+	int32_t vertex_offset = 0;
+	uint32_t first_index = 0;
+	uint32_t index_count = 0;
+	mat4 transform;
+	// World space bounds, used to skip the cascades the caster doesn't touch
+	vec3 bounds_min;
+	vec3 bounds_max;
+	// Base color when drawn lit
+	vec3 color = vec3(0.8f, 0.8f, 0.8f);
+};
+
+struct ShadowCascade {
+	float split_near = 0.f;
+	float split_far = 0.f;
+	mat4 light_view_proj;
+
+	// The light matrix and static content version the cached static depth was rendered with
+	bool cache_valid = false;
+	mat4 cached_light_view_proj;
+	uint64_t cached_static_version = 0;
+
+	// Whether dynamic casters touch the cascade this frame and did last frame. A cascade
+	// which had dynamic casters must be restored from the cache once they leave it
+	bool dynamic_casters = false;
+	bool had_dynamic_casters = false;
+
+	bool static_dirty = true;
+	bool shadow_dirty = true;
+	VkImageLayout layout = VK_IMAGE_LAYOUT_UNDEFINED;
+};
+
+// Cascaded shadow maps for a directional light. The static casters are rendered into a
+// per-cascade depth cache which is only refreshed when the cascade bounds or the static
+// content change. Each frame the cascades touched by dynamic casters are restored from
+// the cache and the dynamic casters drawn on top, cascades with nothing new are skipped.
+// The depth images and pipeline are owned by the resource manager.
+struct ShadowMaps {
+	uint32_t resolution = 0;
+	float depth_bias_constant = 1.25f;
+	float depth_bias_slope = 1.75f;
+	// Blend between logarithmic and uniform cascade splits
+	float split_lambda = 0.75f;
+	// Maximum distance from the camera covered by the cascades
+	float shadow_distance = 50.f;
+	std::vector<ShadowCascade> cascades;
+
+	// Bump static_version after changing the static casters to invalidate the cache
+	std::vector<ShadowCaster> static_casters;
+	uint64_t static_version = 1;
+	std::vector<ShadowCaster> dynamic_casters;
+
+	// The shadow maps sampled by the lighting, and the static only depth cache. Both have
+	// one layer per cascade
+	Image shadow_depth;
+	Image static_depth;
+	ImageHandle shadow_depth_handle;
+	ImageHandle static_depth_handle;
+	std::vector<VkImageView> shadow_layer_views;
+	std::vector<VkImageView> static_layer_views;
+	std::vector<VkFramebuffer> shadow_framebuffers;
+	std::vector<VkFramebuffer> static_framebuffers;
+
+	VkRenderPass clear_render_pass = VK_NULL_HANDLE;
+	VkRenderPass load_render_pass = VK_NULL_HANDLE;
+	VkPipelineLayout pipeline_layout = VK_NULL_HANDLE;
+	VkPipeline pipeline = VK_NULL_HANDLE;
+	PipelineHandle pipeline_handle;
+
+	// Number of times a cascade's static content was rendered, to check the cache is effective
+	uint64_t static_cascade_renders = 0;
+	uint64_t shadow_cascade_updates = 0;
+};
+
+ShadowMaps create_shadow_maps(VkDevice device, VkPhysicalDevice physical_device, ResourceManager &resources,
+		uint32_t num_cascades, uint32_t resolution);
+
+// Fit the cascades to the camera frustum for the light direction and work out which need
+// re-rendering. The cascades are bounded by spheres and snapped to shadow map texels, so
+// their matrices only change when the camera moves more than a texel, not when it rotates
+void update_shadow_cascades(ShadowMaps &shadows, const Camera &camera, const vec3 &light_dir);
+
+bool shadow_maps_need_update(const ShadowMaps &shadows);
+
+// Record rendering of the dirty cascades, leaving the shadow maps ready to sample in
+// fragment shaders
+void record_shadow_maps(ShadowMaps &shadows, VkCommandBuffer cmd_buf);
+
+// Releases the depth images and pipeline to the resource manager
+void destroy_shadow_maps(VkDevice device, ResourceManager &resources, ShadowMaps &shadows);
+
@@ -0,0 +1,305 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include "snapshot.h"
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// The file starts with the header and the table of sections, followed by each section's data
+// aligned to 16 bytes
+static const char snapshot_magic[8] = { 'V', 'K', 'S', 'N', 'A', 'P', 0, 0 };
+static const uint32_t snapshot_version = 1;
+
+enum SnapshotSectionId : uint32_t {
+	SNAPSHOT_DEVICE = 1,
+	SNAPSHOT_PIPELINE_CACHE = 2,
+	SNAPSHOT_FONT_ATLAS = 3,
+};
+
+struct SnapshotHeader {
+	char magic[8];
+	uint32_t version;
+	uint32_t num_sections;
+};
+
+struct SnapshotSection {
+	uint32_t id;
+	uint32_t pad;
+	uint64_t offset;
+	uint64_t size;
+};
+
+// Followed by the atlas pixels
+struct SnapshotFontAtlas {
+	uint64_t key_hash;
+	float line_height;
+	float white_u;
+	float white_v;
+	uint32_t width;
+	uint32_t height;
+	Glyph glyphs[95];
+};
+
+static std::string font_key(const std::string &font_path, int font_size) {
+	return font_path + ":" + std::to_string(font_size);
+}
+
+uint64_t hash_snapshot_key(const std::string &key) {
+	// FNV-1a
+	uint64_t h = 14695981039346656037ull;
+	for (const char c : key) {
+		h = (h ^ uint8_t(c)) * 1099511628211ull;
+	}
+	return h;
+}
+
+SnapshotDevice describe_snapshot_device(VkPhysicalDevice physical_device, uint32_t device_index,
+		uint32_t queue_family, uint64_t options_hash)
+{
+	VkPhysicalDeviceProperties properties = {};
+	vkGetPhysicalDeviceProperties(physical_device, &properties);
+	SnapshotDevice device;
+	device.device_index = device_index;
+	device.queue_family = queue_family;
+	device.vendor_id = properties.vendorID;
+	device.device_id = properties.deviceID;
+	device.driver_version = properties.driverVersion;
+	std::memcpy(device.pipeline_cache_uuid, properties.pipelineCacheUUID, VK_UUID_SIZE);
+	device.options_hash = options_hash;
+	return device;
+}
+
+bool same_snapshot_device(const SnapshotDevice &a, const SnapshotDevice &b) {
+	return a.device_index == b.device_index && a.vendor_id == b.vendor_id && a.device_id == b.device_id
+		&& a.driver_version == b.driver_version
+		&& std::memcmp(a.pipeline_cache_uuid, b.pipeline_cache_uuid, VK_UUID_SIZE) == 0
+		&& a.options_hash == b.options_hash;
+}
+
+// Check the header and that every section is within the file
+static bool validate_snapshot(const Snapshot &snapshot) {
+	if (snapshot.size < sizeof(SnapshotHeader)) {
+		return false;
+	}
+	SnapshotHeader header = {};
+	std::memcpy(&header, snapshot.data, sizeof(header));
+	if (std::memcmp(header.magic, snapshot_magic, sizeof(snapshot_magic)) != 0
+			|| header.version != snapshot_version)
+	{
+		return false;
+	}
+	const uint64_t table_end = sizeof(SnapshotHeader) + uint64_t(header.num_sections) * sizeof(SnapshotSection);
+	if (table_end > snapshot.size) {
+		return false;
+	}
+	const SnapshotSection *sections = reinterpret_cast<const SnapshotSection*>(snapshot.data + sizeof(SnapshotHeader));
+	for (uint32_t i = 0; i < header.num_sections; ++i) {
+		if (sections[i].offset < table_end || sections[i].offset > snapshot.size
+				|| sections[i].size > snapshot.size - sections[i].offset)
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+static const uint8_t* find_section(const Snapshot &snapshot, uint32_t id, size_t &size) {
+	if (snapshot.data == nullptr) {
+		return nullptr;
+	}
+	const SnapshotHeader *header = reinterpret_cast<const SnapshotHeader*>(snapshot.data);
+	const SnapshotSection *sections = reinterpret_cast<const SnapshotSection*>(snapshot.data + sizeof(SnapshotHeader));
+	for (uint32_t i = 0; i < header->num_sections; ++i) {
+		if (sections[i].id == id) {
+			size = sections[i].size;
+			return snapshot.data + sections[i].offset;
+		}
+	}
+	return nullptr;
+}
+
+bool open_snapshot(const std::string &path, Snapshot &snapshot) {
+	snapshot = Snapshot();
+#ifdef _WIN32
+	HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+			FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (file == INVALID_HANDLE_VALUE) {
+		return false;
+	}
+	LARGE_INTEGER file_size = {};
+	HANDLE mapping = nullptr;
+	if (GetFileSizeEx(file, &file_size) && file_size.QuadPart > 0) {
+		mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	}
+	const void *view = mapping ? MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+	if (!view) {
+		if (mapping) {
+			CloseHandle(mapping);
+		}
+		CloseHandle(file);
+		return false;
+	}
+	snapshot.data = reinterpret_cast<const uint8_t*>(view);
+	snapshot.size = size_t(file_size.QuadPart);
+	snapshot.file = file;
+	snapshot.mapping = mapping;
+#else
+	const int fd = open(path.c_str(), O_RDONLY);
+	if (fd < 0) {
+		return false;
+	}
+	struct stat st = {};
+	void *view = MAP_FAILED;
+	if (fstat(fd, &st) == 0 && st.st_size > 0) {
+		view = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	}
+	// The mapping keeps the file's contents alive
+	close(fd);
+	if (view == MAP_FAILED) {
+		return false;
+	}
+	snapshot.data = reinterpret_cast<const uint8_t*>(view);
+	snapshot.size = st.st_size;
+#endif
+	if (!validate_snapshot(snapshot)) {
+		std::cout << "Ignoring invalid snapshot " << path << "\n";
+		close_snapshot(snapshot);
+		return false;
+	}
+	std::cout << "Mapped " << snapshot.size << " bytes of snapshot from " << path << "\n";
+	return true;
+}
+
+void close_snapshot(Snapshot &snapshot) {
+	if (snapshot.data == nullptr) {
+		return;
+	}
+#ifdef _WIN32
+	UnmapViewOfFile(snapshot.data);
+	CloseHandle(snapshot.mapping);
+	CloseHandle(snapshot.file);
+#else
+	munmap(const_cast<uint8_t*>(snapshot.data), snapshot.size);
+#endif
+	snapshot = Snapshot();
+}
+
+bool read_snapshot_device(const Snapshot &snapshot, SnapshotDevice &device) {
+	size_t size = 0;
+	const uint8_t *data = find_section(snapshot, SNAPSHOT_DEVICE, size);
+	if (!data || size != sizeof(SnapshotDevice)) {
+		return false;
+	}
+	std::memcpy(&device, data, sizeof(SnapshotDevice));
+	return true;
+}
+
+bool read_snapshot_pipeline_cache(const Snapshot &snapshot, const void *&data, size_t &size) {
+	data = find_section(snapshot, SNAPSHOT_PIPELINE_CACHE, size);
+	return data != nullptr;
+}
+
+bool read_snapshot_font_atlas(const Snapshot &snapshot, const std::string &font_path, int font_size,
+		FontAtlasPixels &font)
+{
+	size_t size = 0;
+	const uint8_t *data = find_section(snapshot, SNAPSHOT_FONT_ATLAS, size);
+	if (!data || size < sizeof(SnapshotFontAtlas)) {
+		return false;
+	}
+	SnapshotFontAtlas atlas = {};
+	std::memcpy(&atlas, data, sizeof(atlas));
+	if (atlas.key_hash != hash_snapshot_key(font_key(font_path, font_size))
+			|| size - sizeof(atlas) != uint64_t(atlas.width) * atlas.height)
+	{
+		return false;
+	}
+	std::copy(atlas.glyphs, atlas.glyphs + font.glyphs.size(), font.glyphs.begin());
+	font.line_height = atlas.line_height;
+	font.white_u = atlas.white_u;
+	font.white_v = atlas.white_v;
+	font.width = atlas.width;
+	font.height = atlas.height;
+	font.pixels.assign(data + sizeof(atlas), data + size);
+	return true;
+}
+
+bool write_snapshot(const std::string &path, const SnapshotContents &contents) {
+	std::vector<std::pair<uint32_t, std::vector<uint8_t>>> sections;
+	{
+		const uint8_t *device = reinterpret_cast<const uint8_t*>(&contents.device);
+		sections.emplace_back(SNAPSHOT_DEVICE, std::vector<uint8_t>(device, device + sizeof(SnapshotDevice)));
+	}
+	if (!contents.pipeline_cache.empty()) {
+		sections.emplace_back(SNAPSHOT_PIPELINE_CACHE, contents.pipeline_cache);
+	}
+	if (contents.font) {
+		const FontAtlasPixels &font = *contents.font;
+		SnapshotFontAtlas atlas = {};
+		atlas.key_hash = hash_snapshot_key(font_key(contents.font_path, contents.font_size));
+		atlas.line_height = font.line_height;
+		atlas.white_u = font.white_u;
+		atlas.white_v = font.white_v;
+		atlas.width = font.width;
+		atlas.height = font.height;
+		std::copy(font.glyphs.begin(), font.glyphs.end(), atlas.glyphs);
+
+		std::vector<uint8_t> data(sizeof(atlas) + font.pixels.size(), 0);
+		std::memcpy(data.data(), &atlas, sizeof(atlas));
+		std::memcpy(data.data() + sizeof(atlas), font.pixels.data(), font.pixels.size());
+		sections.emplace_back(SNAPSHOT_FONT_ATLAS, std::move(data));
+	}
+
+	SnapshotHeader header = {};
+	std::memcpy(header.magic, snapshot_magic, sizeof(snapshot_magic));
+	header.version = snapshot_version;
+	header.num_sections = sections.size();
+
+	std::vector<SnapshotSection> table(sections.size(), SnapshotSection{});
+	uint64_t offset = sizeof(SnapshotHeader) + table.size() * sizeof(SnapshotSection);
+	for (size_t i = 0; i < sections.size(); ++i) {
+		offset = (offset + 15) & ~uint64_t(15);
+		table[i].id = sections[i].first;
+		table[i].offset = offset;
+		table[i].size = sections[i].second.size();
+		offset += table[i].size;
+	}
+
+	const std::string tmp_path = path + ".tmp";
+	{
+		std::ofstream fout(tmp_path.c_str(), std::ios::binary);
+		fout.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		fout.write(reinterpret_cast<const char*>(table.data()), table.size() * sizeof(SnapshotSection));
+		uint64_t written = sizeof(SnapshotHeader) + table.size() * sizeof(SnapshotSection);
+		const char padding[16] = {};
+		for (size_t i = 0; i < sections.size(); ++i) {
+			fout.write(padding, table[i].offset - written);
+			fout.write(reinterpret_cast<const char*>(sections[i].second.data()), sections[i].second.size());
+			written = table[i].offset + table[i].size;
+		}
+		if (!fout.flush()) {
+			std::cout << "Failed to write the snapshot to " << tmp_path << "\n";
+			return false;
+		}
+	}
+#ifdef _WIN32
+	const bool replaced = MoveFileExA(tmp_path.c_str(), path.c_str(), MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+	const bool replaced = std::rename(tmp_path.c_str(), path.c_str()) == 0;
+#endif
+	if (!replaced) {
+		std::cout << "Failed to replace the snapshot " << path << "\n";
+		return false;
+	}
+	std::cout << "Saved " << offset << " bytes of snapshot to " << path << "\n";
+	return true;
+}
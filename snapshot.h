@@ -0,0 +1,69 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <vulkan/vulkan.h>
+#include "font_atlas.h"
+
+// A single file snapshot of the state which is slow to rebuild on each launch: the chosen
+// device and queue family, the pipeline cache and the rasterized font atlas. The file is
+// memory mapped and its sections read in place, the pipeline cache is handed to the driver
+// straight from the mapping. Each section is only used if it still matches the device and
+// config, otherwise it's rebuilt as usual, and the snapshot is rewritten on exit.
+
+// The device the snapshot was made with, identified by more than its index so a changed
+// device or driver isn't mistaken for it
+struct SnapshotDevice {
+	uint32_t device_index = 0;
+	uint32_t queue_family = 0;
+	uint32_t vendor_id = 0;
+	uint32_t device_id = 0;
+	uint32_t driver_version = 0;
+	uint8_t pipeline_cache_uuid[VK_UUID_SIZE] = {};
+	// Hash of the options the device and queue were chosen for
+	uint64_t options_hash = 0;
+};
+
+struct Snapshot {
+	const uint8_t *data = nullptr;
+	size_t size = 0;
+	// The platform's file and mapping handles
+	void *file = nullptr;
+	void *mapping = nullptr;
+};
+
+struct SnapshotContents {
+	SnapshotDevice device;
+	std::vector<uint8_t> pipeline_cache;
+	std::string font_path;
+	int font_size = 0;
+	const FontAtlasPixels *font = nullptr;
+};
+
+uint64_t hash_snapshot_key(const std::string &key);
+
+SnapshotDevice describe_snapshot_device(VkPhysicalDevice physical_device, uint32_t device_index,
+		uint32_t queue_family, uint64_t options_hash);
+
+// Whether the devices are the same and chosen for the same options, the queue family isn't
+// compared
+bool same_snapshot_device(const SnapshotDevice &a, const SnapshotDevice &b);
+
+// Map the snapshot, returns false if there's no file or it isn't a valid snapshot
+bool open_snapshot(const std::string &path, Snapshot &snapshot);
+
+// Unmap the snapshot, nothing pointing into it can be used after. Does nothing if it wasn't opened
+void close_snapshot(Snapshot &snapshot);
+
+bool read_snapshot_device(const Snapshot &snapshot, SnapshotDevice &device);
+
+// The data points into the mapping
+bool read_snapshot_pipeline_cache(const Snapshot &snapshot, const void *&data, size_t &size);
+
+// Only if the atlas was rasterized from the same font and size
+bool read_snapshot_font_atlas(const Snapshot &snapshot, const std::string &font_path, int font_size,
+		FontAtlasPixels &font);
+
+// Write the snapshot to a temporary file and then replace the file at the path with it, so
+// an interrupted write leaves the previous snapshot intact. The snapshot must not be open
+bool write_snapshot(const std::string &path, const SnapshotContents &contents);
@@ -0,0 +1,605 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <iostream>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <SDL.h>
+#include "scene.h"
+#include "software_renderer.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define SOFTWARE_RENDERER_SSE2
+#include <emmintrin.h>
+#endif
+
+// Four lanes of floats and a mask per lane, so the rasterizer is written once for SSE2 and
+// plain C++
+#ifdef SOFTWARE_RENDERER_SSE2
+struct f4 {
+	__m128 v;
+};
+struct m4 {
+	__m128 v;
+};
+
+static inline f4 splat(float x) {
+	return f4{ _mm_set1_ps(x) };
+}
+static inline f4 lane_index() {
+	return f4{ _mm_set_ps(3.f, 2.f, 1.f, 0.f) };
+}
+static inline f4 operator+(f4 a, f4 b) {
+	return f4{ _mm_add_ps(a.v, b.v) };
+}
+static inline f4 operator*(f4 a, f4 b) {
+	return f4{ _mm_mul_ps(a.v, b.v) };
+}
+static inline m4 operator<(f4 a, f4 b) {
+	return m4{ _mm_cmplt_ps(a.v, b.v) };
+}
+static inline m4 operator>(f4 a, f4 b) {
+	return m4{ _mm_cmpgt_ps(a.v, b.v) };
+}
+static inline m4 operator>=(f4 a, f4 b) {
+	return m4{ _mm_cmpge_ps(a.v, b.v) };
+}
+static inline m4 operator&(m4 a, m4 b) {
+	return m4{ _mm_and_ps(a.v, b.v) };
+}
+static inline bool any(m4 m) {
+	return _mm_movemask_ps(m.v) != 0;
+}
+static inline f4 select(m4 m, f4 a, f4 b) {
+	return f4{ _mm_or_ps(_mm_and_ps(m.v, a.v), _mm_andnot_ps(m.v, b.v)) };
+}
+static inline f4 load4(const float *p) {
+	return f4{ _mm_loadu_ps(p) };
+}
+static inline void store4(float *p, f4 a) {
+	_mm_storeu_ps(p, a.v);
+}
+
+// Write the colors of the masked lanes of the first count pixels as 0xAARRGGBB
+static inline void store_colors(uint32_t *p, uint32_t count, m4 m, f4 r, f4 g, f4 b) {
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 one = _mm_set1_ps(1.f);
+	const __m128 scale = _mm_set1_ps(255.f);
+	const __m128 half = _mm_set1_ps(0.5f);
+	// Round half up by truncating, like to_unorm8 in the scalar path
+	const __m128i ri = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(_mm_min_ps(_mm_max_ps(r.v, zero), one), scale), half));
+	const __m128i gi = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(_mm_min_ps(_mm_max_ps(g.v, zero), one), scale), half));
+	const __m128i bi = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(_mm_min_ps(_mm_max_ps(b.v, zero), one), scale), half));
+	const __m128i colors = _mm_or_si128(_mm_or_si128(_mm_slli_epi32(ri, 16), _mm_slli_epi32(gi, 8)),
+			_mm_or_si128(bi, _mm_set1_epi32(int(0xff000000u))));
+	if (count == 4) {
+		const __m128i mask = _mm_castps_si128(m.v);
+		const __m128i old = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(p),
+				_mm_or_si128(_mm_and_si128(mask, colors), _mm_andnot_si128(mask, old)));
+		return;
+	}
+	alignas(16) uint32_t lanes[4];
+	_mm_store_si128(reinterpret_cast<__m128i*>(lanes), colors);
+	const int bits = _mm_movemask_ps(m.v);
+	for (uint32_t i = 0; i < count; ++i) {
+		if (bits & (1 << i)) {
+			p[i] = lanes[i];
+		}
+	}
+}
+#else
+struct f4 {
+	float v[4];
+};
+struct m4 {
+	bool v[4];
+};
+
+static inline f4 splat(float x) {
+	return f4{ { x, x, x, x } };
+}
+static inline f4 lane_index() {
+	return f4{ { 0.f, 1.f, 2.f, 3.f } };
+}
+static inline f4 operator+(f4 a, f4 b) {
+	return f4{ { a.v[0] + b.v[0], a.v[1] + b.v[1], a.v[2] + b.v[2], a.v[3] + b.v[3] } };
+}
+static inline f4 operator*(f4 a, f4 b) {
+	return f4{ { a.v[0] * b.v[0], a.v[1] * b.v[1], a.v[2] * b.v[2], a.v[3] * b.v[3] } };
+}
+static inline m4 operator<(f4 a, f4 b) {
+	return m4{ { a.v[0] < b.v[0], a.v[1] < b.v[1], a.v[2] < b.v[2], a.v[3] < b.v[3] } };
+}
+static inline m4 operator>(f4 a, f4 b) {
+	return m4{ { a.v[0] > b.v[0], a.v[1] > b.v[1], a.v[2] > b.v[2], a.v[3] > b.v[3] } };
+}
+static inline m4 operator>=(f4 a, f4 b) {
+	return m4{ { a.v[0] >= b.v[0], a.v[1] >= b.v[1], a.v[2] >= b.v[2], a.v[3] >= b.v[3] } };
+}
+static inline m4 operator&(m4 a, m4 b) {
+	return m4{ { a.v[0] && b.v[0], a.v[1] && b.v[1], a.v[2] && b.v[2], a.v[3] && b.v[3] } };
+}
+static inline bool any(m4 m) {
+	return m.v[0] || m.v[1] || m.v[2] || m.v[3];
+}
+static inline f4 select(m4 m, f4 a, f4 b) {
+	return f4{ { m.v[0] ? a.v[0] : b.v[0], m.v[1] ? a.v[1] : b.v[1], m.v[2] ? a.v[2] : b.v[2],
+		m.v[3] ? a.v[3] : b.v[3] } };
+}
+static inline f4 load4(const float *p) {
+	return f4{ { p[0], p[1], p[2], p[3] } };
+}
+static inline void store4(float *p, f4 a) {
+	std::copy(a.v, a.v + 4, p);
+}
+
+// Round half up by truncating, matching the SSE path's conversion exactly
+static inline uint32_t to_unorm8(float x) {
+	return uint32_t(std::min(std::max(x, 0.f), 1.f) * 255.f + 0.5f);
+}
+
+// Write the colors of the masked lanes of the first count pixels as 0xAARRGGBB
+static inline void store_colors(uint32_t *p, uint32_t count, m4 m, f4 r, f4 g, f4 b) {
+	for (uint32_t i = 0; i < count; ++i) {
+		if (m.v[i]) {
+			p[i] = 0xff000000u | (to_unorm8(r.v[i]) << 16) | (to_unorm8(g.v[i]) << 8) | to_unorm8(b.v[i]);
+		}
+	}
+}
+#endif
+
+struct SoftwareWorkers {
+	std::mutex mutex;
+	std::condition_variable cv;
+	std::condition_variable done_cv;
+	std::vector<std::thread> threads;
+	// Incremented each frame to wake the threads, which count themselves back down in running
+	uint64_t generation = 0;
+	uint32_t running = 0;
+	bool quit = false;
+
+	// The frame being rendered, the tiles are taken in order by all threads
+	SoftwareRenderer *renderer = nullptr;
+	uint32_t *pixels = nullptr;
+	uint32_t pitch = 0;
+	std::atomic<uint32_t> next_tile;
+};
+
+struct ClipVertex {
+	float x, y, z, w;
+	vec3 color;
+};
+
+static ClipVertex lerp(const ClipVertex &a, const ClipVertex &b, float t) {
+	ClipVertex v;
+	v.x = a.x + (b.x - a.x) * t;
+	v.y = a.y + (b.y - a.y) * t;
+	v.z = a.z + (b.z - a.z) * t;
+	v.w = a.w + (b.w - a.w) * t;
+	v.color = a.color + (b.color - a.color) * t;
+	return v;
+}
+
+static ClipVertex to_clip(const mat4 &m, const vec3 &p, const vec3 &color) {
+	ClipVertex v;
+	v.x = m(0, 0) * p.x + m(0, 1) * p.y + m(0, 2) * p.z + m(0, 3);
+	v.y = m(1, 0) * p.x + m(1, 1) * p.y + m(1, 2) * p.z + m(1, 3);
+	v.z = m(2, 0) * p.x + m(2, 1) * p.y + m(2, 2) * p.z + m(2, 3);
+	v.w = m(3, 0) * p.x + m(3, 1) * p.y + m(3, 2) * p.z + m(3, 3);
+	v.color = color;
+	return v;
+}
+
+// Set up the triangle from its screen space vertices, returns false if it covers no pixels or
+// is culled. Front faces are clockwise on the screen, like the scene geometry seen from outside
+static bool setup_triangle(const SoftwareRenderer &renderer, const ClipVertex *v, bool cull_back, bool depth_test,
+		SoftwareTriangle &t)
+{
+	float x[3], y[3];
+	for (int i = 0; i < 3; ++i) {
+		x[i] = v[i].x;
+		y[i] = v[i].y;
+	}
+	int order[3] = { 0, 1, 2 };
+	float area = (x[1] - x[0]) * (y[2] - y[0]) - (y[1] - y[0]) * (x[2] - x[0]);
+	if (area == 0.f || !std::isfinite(area) || (area < 0.f && cull_back)) {
+		return false;
+	}
+	if (area < 0.f) {
+		std::swap(x[1], x[2]);
+		std::swap(y[1], y[2]);
+		std::swap(order[1], order[2]);
+		area = -area;
+	}
+
+	// Clamped before converting since vertices close to the near plane can be far off screen
+	const float width = float(renderer.width);
+	const float height = float(renderer.height);
+	t.min_x = int(std::floor(std::min(std::max(std::min(x[0], std::min(x[1], x[2])), 0.f), width)));
+	t.min_y = int(std::floor(std::min(std::max(std::min(y[0], std::min(y[1], y[2])), 0.f), height)));
+	t.max_x = int(std::floor(std::max(std::min(std::max(x[0], std::max(x[1], x[2])), width - 1.f), -1.f)));
+	t.max_y = int(std::floor(std::max(std::min(std::max(y[0], std::max(y[1], y[2])), height - 1.f), -1.f)));
+	if (t.min_x > t.max_x || t.min_y > t.max_y) {
+		return false;
+	}
+
+	for (int i = 0; i < 3; ++i) {
+		const int j = (i + 1) % 3;
+		const float dx = x[j] - x[i];
+		const float dy = y[j] - y[i];
+		t.edge_a[i] = -dy;
+		t.edge_b[i] = dx;
+		t.edge_c[i] = dy * x[i] - dx * y[i];
+		t.top_left[i] = (dy == 0.f && dx > 0.f) || dy < 0.f;
+	}
+
+	// Each edge's function is the barycentric weight of the vertex opposite it, scaled by the area
+	const float inv_area = 1.f / area;
+	for (int p = 0; p < 4; ++p) {
+		float value[3];
+		for (int i = 0; i < 3; ++i) {
+			const ClipVertex &src = v[order[i]];
+			value[i] = p == 0 ? src.z : p == 1 ? src.color.x : p == 2 ? src.color.y : src.color.z;
+		}
+		t.planes[p][0] = (t.edge_a[1] * value[0] + t.edge_a[2] * value[1] + t.edge_a[0] * value[2]) * inv_area;
+		t.planes[p][1] = (t.edge_b[1] * value[0] + t.edge_b[2] * value[1] + t.edge_b[0] * value[2]) * inv_area;
+		t.planes[p][2] = (t.edge_c[1] * value[0] + t.edge_c[2] * value[1] + t.edge_c[0] * value[2]) * inv_area;
+	}
+	t.depth_test = depth_test;
+	return true;
+}
+
+// Clip the triangle against the near plane, then set up and bin what's left
+static void add_triangle(SoftwareRenderer &renderer, const ClipVertex *v, bool cull_back, bool depth_test) {
+	// Vulkan's clip volume has z in [0, w]
+	ClipVertex polygon[4];
+	uint32_t count = 0;
+	for (int i = 0; i < 3; ++i) {
+		const ClipVertex &a = v[i];
+		const ClipVertex &b = v[(i + 1) % 3];
+		if (a.z >= 0.f) {
+			polygon[count++] = a;
+		}
+		if ((a.z >= 0.f) != (b.z >= 0.f)) {
+			polygon[count++] = lerp(a, b, a.z / (a.z - b.z));
+		}
+	}
+	if (count < 3) {
+		return;
+	}
+
+	for (uint32_t i = 0; i < count; ++i) {
+		ClipVertex &p = polygon[i];
+		const float inv_w = 1.f / p.w;
+		p.x = (p.x * inv_w * 0.5f + 0.5f) * renderer.width;
+		p.y = (p.y * inv_w * 0.5f + 0.5f) * renderer.height;
+		p.z *= inv_w;
+	}
+
+	const uint32_t tile_size = renderer.params.tile_size;
+	for (uint32_t i = 1; i + 1 < count; ++i) {
+		const ClipVertex fan[3] = { polygon[0], polygon[i], polygon[i + 1] };
+		SoftwareTriangle t;
+		if (!setup_triangle(renderer, fan, cull_back, depth_test, t)) {
+			continue;
+		}
+		const uint32_t index = renderer.triangles.size();
+		renderer.triangles.push_back(t);
+		++renderer.stats.triangles;
+		for (uint32_t ty = t.min_y / tile_size; ty <= t.max_y / tile_size; ++ty) {
+			for (uint32_t tx = t.min_x / tile_size; tx <= t.max_x / tile_size; ++tx) {
+				renderer.bins[ty * renderer.tiles_x + tx].push_back(index);
+				++renderer.stats.tile_triangles;
+			}
+		}
+	}
+}
+
+static inline m4 inside_edge(f4 e, bool top_left) {
+	return top_left ? e >= splat(0.f) : e > splat(0.f);
+}
+
+// Rasterize the part of the triangle inside the tile's pixels [x0, x1) x [y0, y1)
+static void rasterize_triangle(SoftwareRenderer &renderer, const SoftwareTriangle &t, int x0, int y0, int x1, int y1,
+		uint32_t *pixels, uint32_t pitch)
+{
+	// Tiles start on a multiple of 4 pixels, so the rows of 4 pixels stay in the tile
+	const int min_x = std::max(t.min_x, x0) & ~3;
+	const int min_y = std::max(t.min_y, y0);
+	const int max_x = std::min(t.max_x + 1, x1);
+	const int max_y = std::min(t.max_y + 1, y1);
+	if (min_x >= max_x || min_y >= max_y) {
+		return;
+	}
+
+	f4 edge_a[3], plane_a[4];
+	for (int i = 0; i < 3; ++i) {
+		edge_a[i] = splat(t.edge_a[i]);
+	}
+	for (int p = 0; p < 4; ++p) {
+		plane_a[p] = splat(t.planes[p][0]);
+	}
+	const f4 step = splat(4.f);
+	const f4 first_x = lane_index() + splat(min_x + 0.5f);
+	const f4 end_x = splat(float(max_x));
+
+	for (int y = min_y; y < max_y; ++y) {
+		const float py = y + 0.5f;
+		f4 edges[3], values[4];
+		for (int i = 0; i < 3; ++i) {
+			edges[i] = edge_a[i] * first_x + splat(t.edge_b[i] * py + t.edge_c[i]);
+		}
+		for (int p = 0; p < 4; ++p) {
+			values[p] = plane_a[p] * first_x + splat(t.planes[p][1] * py + t.planes[p][2]);
+		}
+		f4 px = first_x;
+		float *depth_row = renderer.depth.data() + size_t(y) * renderer.depth_pitch;
+		uint32_t *pixel_row = pixels + size_t(y) * pitch;
+
+		for (int x = min_x; x < max_x; x += 4) {
+			m4 inside = (px < end_x) & inside_edge(edges[0], t.top_left[0]) & inside_edge(edges[1], t.top_left[1])
+				& inside_edge(edges[2], t.top_left[2]);
+			if (any(inside) && t.depth_test) {
+				const f4 depth = load4(depth_row + x);
+				inside = inside & (values[0] < depth);
+				store4(depth_row + x, select(inside, values[0], depth));
+			}
+			if (any(inside)) {
+				store_colors(pixel_row + x, std::min(max_x - x, 4), inside, values[1], values[2], values[3]);
+			}
+
+			px = px + step;
+			for (int i = 0; i < 3; ++i) {
+				edges[i] = edges[i] + edge_a[i] * step;
+			}
+			for (int p = 0; p < 4; ++p) {
+				values[p] = values[p] + plane_a[p] * step;
+			}
+		}
+	}
+}
+
+static void render_tiles(SoftwareWorkers &workers) {
+	SoftwareRenderer &renderer = *workers.renderer;
+	const SoftwareRendererParams &params = renderer.params;
+	const uint32_t clear = 0xff000000u | (uint32_t(params.clear_color[0] * 255.f + 0.5f) << 16)
+		| (uint32_t(params.clear_color[1] * 255.f + 0.5f) << 8) | uint32_t(params.clear_color[2] * 255.f + 0.5f);
+	const uint32_t num_tiles = renderer.tiles_x * renderer.tiles_y;
+
+	for (uint32_t tile = workers.next_tile++; tile < num_tiles; tile = workers.next_tile++) {
+		const int x0 = (tile % renderer.tiles_x) * params.tile_size;
+		const int y0 = (tile / renderer.tiles_x) * params.tile_size;
+		const int x1 = std::min(x0 + int(params.tile_size), int(renderer.width));
+		const int y1 = std::min(y0 + int(params.tile_size), int(renderer.height));
+		for (int y = y0; y < y1; ++y) {
+			std::fill(workers.pixels + size_t(y) * workers.pitch + x0, workers.pixels + size_t(y) * workers.pitch + x1,
+					clear);
+			std::fill(renderer.depth.begin() + size_t(y) * renderer.depth_pitch + x0,
+					renderer.depth.begin() + size_t(y) * renderer.depth_pitch + x1, 1.f);
+		}
+		for (uint32_t i : renderer.bins[tile]) {
+			rasterize_triangle(renderer, renderer.triangles[i], x0, y0, x1, y1, workers.pixels, workers.pitch);
+		}
+	}
+}
+
+static void run_worker(SoftwareWorkers &workers) {
+	uint64_t generation = 0;
+	while (true) {
+		{
+			std::unique_lock<std::mutex> lock(workers.mutex);
+			workers.cv.wait(lock, [&]() { return workers.quit || workers.generation != generation; });
+			if (workers.quit) {
+				return;
+			}
+			generation = workers.generation;
+		}
+		render_tiles(workers);
+
+		std::lock_guard<std::mutex> lock(workers.mutex);
+		if (--workers.running == 0) {
+			workers.done_cv.notify_one();
+		}
+	}
+}
+
+SoftwareRenderer create_software_renderer(uint32_t width, uint32_t height, const SoftwareRendererParams &params) {
+	if (params.tile_size == 0 || params.tile_size % 4 != 0) {
+		throw std::runtime_error("The software renderer's tile size must be a multiple of 4");
+	}
+	SoftwareRenderer renderer;
+	renderer.params = params;
+	renderer.width = width;
+	renderer.height = height;
+	renderer.tiles_x = (width + params.tile_size - 1) / params.tile_size;
+	renderer.tiles_y = (height + params.tile_size - 1) / params.tile_size;
+	renderer.depth_pitch = (width + 3) & ~3u;
+	renderer.depth.resize(size_t(renderer.depth_pitch) * height, 1.f);
+	renderer.bins.resize(renderer.tiles_x * renderer.tiles_y);
+
+	// The calling thread renders tiles too
+	renderer.workers = std::make_shared<SoftwareWorkers>();
+	renderer.workers->next_tile = 0;
+	for (uint32_t i = 1; i < std::max(params.num_threads, 1u); ++i) {
+		SoftwareWorkers *workers = renderer.workers.get();
+		renderer.workers->threads.emplace_back([workers]() { run_worker(*workers); });
+	}
+	return renderer;
+}
+
+void render_software_frame(SoftwareRenderer &renderer, const Camera &camera, const std::vector<SoftwareMesh> &meshes,
+		uint32_t *pixels, uint32_t pitch)
+{
+	using namespace std::chrono;
+	const auto start = steady_clock::now();
+
+	renderer.triangles.clear();
+	for (auto &b : renderer.bins) {
+		b.clear();
+	}
+
+	const SoftwareRendererParams &params = renderer.params;
+	if (params.draw_meshes) {
+		const mat4 view_proj = camera.proj() * camera.view();
+		const vec3 to_light = normalize(params.light_dir * -1.f);
+		for (const auto &mesh : meshes) {
+			const mat4 mvp = view_proj * mesh.transform;
+			for (size_t i = 0; i + 2 < mesh.positions.size(); i += 3) {
+				const vec3 p0 = transform_point(mesh.transform, mesh.positions[i]);
+				const vec3 p1 = transform_point(mesh.transform, mesh.positions[i + 1]);
+				const vec3 p2 = transform_point(mesh.transform, mesh.positions[i + 2]);
+				// Clockwise seen from outside, so this points out
+				const vec3 n = normalize(cross(p2 - p0, p1 - p0));
+				const vec3 color = mesh.color * (0.2f + 0.8f * std::max(dot(n, to_light), 0.f));
+				const ClipVertex v[3] = {
+					to_clip(mvp, mesh.positions[i], color),
+					to_clip(mvp, mesh.positions[i + 1], color),
+					to_clip(mvp, mesh.positions[i + 2], color)
+				};
+				add_triangle(renderer, v, true, true);
+			}
+		}
+	}
+
+	// The same triangle as vert.vert in clip space, drawn over everything
+	const mat4 identity;
+	const ClipVertex triangle[3] = {
+		to_clip(identity, vec3(0.f, -0.5f, 0.f), vec3(1.f, 0.f, 0.f)),
+		to_clip(identity, vec3(0.5f, 0.5f, 0.f), vec3(0.f, 1.f, 0.f)),
+		to_clip(identity, vec3(-0.5f, 0.5f, 0.f), vec3(0.f, 0.f, 1.f))
+	};
+	add_triangle(renderer, triangle, false, false);
+
+	SoftwareWorkers &workers = *renderer.workers;
+	{
+		std::lock_guard<std::mutex> lock(workers.mutex);
+		workers.renderer = &renderer;
+		workers.pixels = pixels;
+		workers.pitch = pitch;
+		workers.next_tile = 0;
+		workers.running = workers.threads.size();
+		++workers.generation;
+	}
+	workers.cv.notify_all();
+	render_tiles(workers);
+	{
+		std::unique_lock<std::mutex> lock(workers.mutex);
+		workers.done_cv.wait(lock, [&]() { return workers.running == 0; });
+	}
+
+	++renderer.stats.frames;
+	renderer.stats.total_ms += duration_cast<duration<float, std::milli>>(steady_clock::now() - start).count();
+}
+
+void destroy_software_renderer(SoftwareRenderer &renderer) {
+	if (!renderer.workers) {
+		return;
+	}
+	{
+		std::lock_guard<std::mutex> lock(renderer.workers->mutex);
+		renderer.workers->quit = true;
+	}
+	renderer.workers->cv.notify_all();
+	for (auto &t : renderer.workers->threads) {
+		t.join();
+	}
+	renderer.workers = nullptr;
+}
+
+void run_software_renderer(SDL_Window *window, const SoftwareRendererParams &params) {
+	int width = 0;
+	int height = 0;
+	SDL_GetWindowSize(window, &width, &height);
+	SoftwareRenderer renderer = create_software_renderer(width, height, params);
+	std::cout << "Software renderer: " << width << "x" << height << " in " << renderer.tiles_x * renderer.tiles_y
+		<< " tiles on " << std::max(params.num_threads, 1u) << " threads"
+#ifdef SOFTWARE_RENDERER_SSE2
+		<< " with SSE2"
+#endif
+		<< "\n";
+
+	Camera camera;
+	camera.aspect = float(width) / height;
+	// The shadow caster scene, the orbiting box last
+	std::vector<SoftwareMesh> meshes;
+	if (params.draw_meshes) {
+		SoftwareMesh ground;
+		ground.positions = make_ground_plane(30.f, 0.f);
+		ground.color = vec3(0.5f, 0.5f, 0.45f);
+		meshes.push_back(ground);
+		for (int i = 0; i < 8; ++i) {
+			const float angle = i * 6.2831853f / 8.f;
+			SoftwareMesh pillar;
+			pillar.positions = make_box(vec3(6.f * std::cos(angle), 1.f, 6.f * std::sin(angle)), vec3(0.5f, 1.f, 0.5f));
+			pillar.color = vec3(0.8f, 0.7f, 0.55f);
+			meshes.push_back(pillar);
+		}
+		SoftwareMesh orbiter;
+		orbiter.positions = make_box(vec3(0.f, 0.f, 0.f), vec3(0.5f, 0.5f, 0.5f));
+		orbiter.color = vec3(0.9f, 0.35f, 0.2f);
+		meshes.push_back(orbiter);
+	}
+
+	// Rendered directly into the window's surface if it has the same pixel layout, otherwise
+	// into a staging surface which is converted by the blit
+	SDL_Surface *staging = nullptr;
+	bool done = false;
+	while (!done) {
+		SDL_Event event;
+		while (SDL_PollEvent(&event)) {
+			if (event.type == SDL_QUIT) {
+				done = true;
+			}
+			if (event.type == SDL_KEYDOWN && event.key.keysym.sym == SDLK_ESCAPE) {
+				done = true;
+			}
+			if (event.type == SDL_WINDOWEVENT && event.window.event == SDL_WINDOWEVENT_CLOSE
+					&& event.window.windowID == SDL_GetWindowID(window)) {
+				done = true;
+			}
+		}
+
+		if (params.draw_meshes) {
+			const float t = SDL_GetTicks() / 1000.f;
+			meshes.back().transform = rotate_y(t) * translate(vec3(3.f, 1.5f, 0.f));
+		}
+
+		SDL_Surface *surface = SDL_GetWindowSurface(window);
+		if (!surface) {
+			throw std::runtime_error(std::string("Failed to get the window surface: ") + SDL_GetError());
+		}
+		const bool direct = surface->format->format == SDL_PIXELFORMAT_ARGB8888
+			|| surface->format->format == SDL_PIXELFORMAT_RGB888;
+		if (!direct && !staging) {
+			staging = SDL_CreateRGBSurfaceWithFormat(0, width, height, 32, SDL_PIXELFORMAT_ARGB8888);
+		}
+		SDL_Surface *target = direct ? surface : staging;
+		if (SDL_MUSTLOCK(target)) {
+			SDL_LockSurface(target);
+		}
+		render_software_frame(renderer, camera, meshes, static_cast<uint32_t*>(target->pixels), target->pitch / 4);
+		if (SDL_MUSTLOCK(target)) {
+			SDL_UnlockSurface(target);
+		}
+		if (!direct) {
+			SDL_BlitSurface(staging, nullptr, surface, nullptr);
+		}
+		SDL_UpdateWindowSurface(window);
+	}
+
+	const SoftwareRendererStats &stats = renderer.stats;
+	if (stats.frames > 0) {
+		std::cout << "Software renderer: " << stats.frames << " frames, " << stats.total_ms / stats.frames
+			<< "ms/frame, " << stats.triangles / stats.frames << " triangles binned to "
+			<< stats.tile_triangles / stats.frames << " tiles per frame\n";
+	}
+	if (staging) {
+		SDL_FreeSurface(staging);
+	}
+	destroy_software_renderer(renderer);
+}
@@ -0,0 +1,96 @@
+#pragma once
+
+#include <array>
+#include <memory>
+#include <vector>
+#include "camera.h"
+#include "linalg.h"
+
+struct SDL_Window;
+
+// CPU fallback for machines without a Vulkan driver or device, and a CPU only baseline for the
+// frame time. It draws the same scene as the Vulkan path, the screen space triangle and, with
+// shadows enabled, the ground plane, pillars and orbiting box meshes lit by the light direction
+// (without the shadows themselves).
+//
+// Triangles are transformed, clipped against the near plane and binned to the screen tiles they
+// overlap, then the worker threads take whole tiles, clear them and rasterize the tile's
+// triangles in order with a depth test. The edge functions, depth and colors are evaluated for
+// four pixels at a time, with SSE2 where it's available. The pixels are 32 bit 0xAARRGGBB
+// words, i.e. BGRA in memory like the swapchain images.
+
+struct SoftwareMesh {
+	// Non-indexed triangle list wound like the scene geometry
+	std::vector<vec3> positions;
+	mat4 transform;
+	vec3 color = vec3(1.f, 1.f, 1.f);
+};
+
+struct SoftwareRendererStats {
+	uint64_t frames = 0;
+	// Triangles after clipping and culling, and the tiles they were binned to
+	uint64_t triangles = 0;
+	uint64_t tile_triangles = 0;
+	float total_ms = 0.f;
+};
+
+struct SoftwareRendererParams {
+	uint32_t num_threads = 1;
+	// Pixels per side of the tiles the threads work on, a multiple of 4
+	uint32_t tile_size = 64;
+	std::array<float, 4> clear_color = { 0.f, 0.f, 0.f, 1.f };
+	// Draw the shadow caster meshes behind the triangle
+	bool draw_meshes = false;
+	// The direction the light travels in, the same as the Vulkan path's by default
+	vec3 light_dir = vec3(-0.4f, -1.f, -0.3f);
+};
+
+// A triangle after setup, as three edge functions which are positive inside it and the planes
+// of its depth and color over the screen. The attributes are interpolated linearly in screen
+// space, which is exact for the flat shaded meshes and the screen space triangle
+struct SoftwareTriangle {
+	float edge_a[3];
+	float edge_b[3];
+	float edge_c[3];
+	// Pixel centers exactly on a top or left edge are inside, so triangles sharing an edge
+	// don't both draw it
+	bool top_left[3];
+	// a * x + b * y + c for the depth, red, green and blue
+	float planes[4][3];
+	// The pixels it may cover, inclusive
+	int min_x;
+	int min_y;
+	int max_x;
+	int max_y;
+	bool depth_test;
+};
+
+struct SoftwareWorkers;
+
+struct SoftwareRenderer {
+	SoftwareRendererParams params;
+	uint32_t width = 0;
+	uint32_t height = 0;
+	uint32_t tiles_x = 0;
+	uint32_t tiles_y = 0;
+	// Padded to a multiple of 4 pixels per row
+	uint32_t depth_pitch = 0;
+	std::vector<float> depth;
+	std::vector<SoftwareTriangle> triangles;
+	// The triangles overlapping each tile, in submission order
+	std::vector<std::vector<uint32_t>> bins;
+	std::shared_ptr<SoftwareWorkers> workers;
+	SoftwareRendererStats stats;
+};
+
+SoftwareRenderer create_software_renderer(uint32_t width, uint32_t height, const SoftwareRendererParams &params);
+
+// Render the frame into the pixels, pitch is the row length in pixels
+void render_software_frame(SoftwareRenderer &renderer, const Camera &camera, const std::vector<SoftwareMesh> &meshes,
+		uint32_t *pixels, uint32_t pitch);
+
+void destroy_software_renderer(SoftwareRenderer &renderer);
+
+// Draw the demo scene into the window's surface until it's closed or escape is pressed, then
+// print the frame time
+void run_software_renderer(SDL_Window *window, const SoftwareRendererParams &params);
@@ -0,0 +1,374 @@
+#include <condition_variable>
+#include <cstring>
+#include <exception>
+#include <iostream>
+#include <limits>
+#include <mutex>
+#include <thread>
+#include "submit_scheduler.h"
+#include "vulkan_utils.h"
+
+struct ScheduledWork {
+	SubmitBatch batch;
+	// Bind sparse memory instead of submitting the batch
+	bool bind = false;
+	SparseBindBatch sparse;
+	// Present instead of submitting the batch
+	bool present = false;
+	VkSwapchainKHR swapchain = VK_NULL_HANDLE;
+	uint32_t image_index = 0;
+	VkSemaphore present_wait = VK_NULL_HANDLE;
+};
+
+struct SubmitThread {
+	VkQueue queue = VK_NULL_HANDLE;
+	PFN_vkQueueSubmit2KHR queue_submit2 = nullptr;
+
+	std::mutex mutex;
+	// Held while presenting or acquiring, which both need the swapchain externally synchronized
+	std::mutex swapchain_mutex;
+	std::condition_variable cv;
+	std::condition_variable idle_cv;
+	// Scheduled since the last flush, and flushed but not taken by the thread yet
+	std::vector<ScheduledWork> scheduled;
+	std::vector<ScheduledWork> flushed;
+	bool busy = false;
+	bool quit = false;
+	// The first failed submission or present, after which the remaining work is discarded
+	std::exception_ptr error;
+	SubmitSchedulerStats stats;
+	std::thread thread;
+};
+
+// Adjacent batches share a submit info when nothing waits between them
+struct MergedSubmit {
+	std::vector<VkCommandBuffer> command_buffers;
+	std::vector<SubmitWait> waits;
+	std::vector<VkSemaphore> signals;
+};
+
+static std::vector<MergedSubmit> merge_batches(const std::vector<ScheduledWork> &work, size_t begin, size_t end) {
+	std::vector<MergedSubmit> merged;
+	for (size_t i = begin; i < end; ++i) {
+		const SubmitBatch &batch = work[i].batch;
+		if (merged.empty() || !batch.waits.empty() || !merged.back().signals.empty()) {
+			merged.push_back(MergedSubmit());
+			merged.back().waits = batch.waits;
+		}
+		MergedSubmit &m = merged.back();
+		m.command_buffers.insert(m.command_buffers.end(), batch.command_buffers.begin(), batch.command_buffers.end());
+		m.signals.insert(m.signals.end(), batch.signals.begin(), batch.signals.end());
+	}
+	return merged;
+}
+
+static void queue_submit(SubmitThread &st, const std::vector<MergedSubmit> &merged, VkFence fence) {
+	if (st.queue_submit2) {
+		// The legacy stage flags have the same values as their synchronization2 counterparts
+		std::vector<std::vector<VkSemaphoreSubmitInfoKHR>> waits(merged.size());
+		std::vector<std::vector<VkSemaphoreSubmitInfoKHR>> signals(merged.size());
+		std::vector<std::vector<VkCommandBufferSubmitInfoKHR>> command_buffers(merged.size());
+		std::vector<VkSubmitInfo2KHR> submits(merged.size(), VkSubmitInfo2KHR{});
+		for (size_t i = 0; i < merged.size(); ++i) {
+			for (const auto &w : merged[i].waits) {
+				VkSemaphoreSubmitInfoKHR info = {};
+				info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO_KHR;
+				info.semaphore = w.semaphore;
+				info.stageMask = VkPipelineStageFlags2KHR(w.stage);
+				waits[i].push_back(info);
+			}
+			for (VkSemaphore s : merged[i].signals) {
+				VkSemaphoreSubmitInfoKHR info = {};
+				info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO_KHR;
+				info.semaphore = s;
+				info.stageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT_KHR;
+				signals[i].push_back(info);
+			}
+			for (VkCommandBuffer c : merged[i].command_buffers) {
+				VkCommandBufferSubmitInfoKHR info = {};
+				info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_SUBMIT_INFO_KHR;
+				info.commandBuffer = c;
+				command_buffers[i].push_back(info);
+			}
+			submits[i].sType = VK_STRUCTURE_TYPE_SUBMIT_INFO_2_KHR;
+			submits[i].waitSemaphoreInfoCount = waits[i].size();
+			submits[i].pWaitSemaphoreInfos = waits[i].data();
+			submits[i].commandBufferInfoCount = command_buffers[i].size();
+			submits[i].pCommandBufferInfos = command_buffers[i].data();
+			submits[i].signalSemaphoreInfoCount = signals[i].size();
+			submits[i].pSignalSemaphoreInfos = signals[i].data();
+		}
+		CHECK_VULKAN(st.queue_submit2(st.queue, submits.size(), submits.data(), fence));
+		return;
+	}
+
+	std::vector<std::vector<VkSemaphore>> wait_semaphores(merged.size());
+	std::vector<std::vector<VkPipelineStageFlags>> wait_stages(merged.size());
+	std::vector<VkSubmitInfo> submits(merged.size(), VkSubmitInfo{});
+	for (size_t i = 0; i < merged.size(); ++i) {
+		for (const auto &w : merged[i].waits) {
+			wait_semaphores[i].push_back(w.semaphore);
+			wait_stages[i].push_back(w.stage);
+		}
+		submits[i].sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+		submits[i].waitSemaphoreCount = wait_semaphores[i].size();
+		submits[i].pWaitSemaphores = wait_semaphores[i].data();
+		submits[i].pWaitDstStageMask = wait_stages[i].data();
+		submits[i].commandBufferCount = merged[i].command_buffers.size();
+		submits[i].pCommandBuffers = merged[i].command_buffers.data();
+		submits[i].signalSemaphoreCount = merged[i].signals.size();
+		submits[i].pSignalSemaphores = merged[i].signals.data();
+	}
+	CHECK_VULKAN(vkQueueSubmit(st.queue, submits.size(), submits.data(), fence));
+}
+
+static void queue_present(SubmitThread &st, const ScheduledWork &work) {
+	VkPresentInfoKHR present_info = {};
+	present_info.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
+	present_info.waitSemaphoreCount = work.present_wait != VK_NULL_HANDLE ? 1 : 0;
+	present_info.pWaitSemaphores = &work.present_wait;
+	present_info.swapchainCount = 1;
+	present_info.pSwapchains = &work.swapchain;
+	present_info.pImageIndices = &work.image_index;
+	std::lock_guard<std::mutex> lock(st.swapchain_mutex);
+	CHECK_VULKAN(vkQueuePresentKHR(st.queue, &present_info));
+}
+
+static void queue_bind_sparse(SubmitThread &st, const SparseBindBatch &batch) {
+	VkSparseImageMemoryBindInfo image_info = {};
+	image_info.image = batch.image;
+	image_info.bindCount = batch.binds.size();
+	image_info.pBinds = batch.binds.data();
+
+	VkBindSparseInfo bind_info = {};
+	bind_info.sType = VK_STRUCTURE_TYPE_BIND_SPARSE_INFO;
+	bind_info.imageBindCount = 1;
+	bind_info.pImageBinds = &image_info;
+	bind_info.signalSemaphoreCount = batch.signals.size();
+	bind_info.pSignalSemaphores = batch.signals.data();
+	CHECK_VULKAN(vkQueueBindSparse(st.queue, 1, &bind_info, VK_NULL_HANDLE));
+}
+
+// A submission call takes the batches up to the next present or sparse bind, or up to and
+// including the next batch with a fence
+static void submit_work(SubmitThread &st, const std::vector<ScheduledWork> &work, SubmitSchedulerStats &stats) {
+	size_t i = 0;
+	while (i < work.size()) {
+		if (work[i].present) {
+			queue_present(st, work[i]);
+			if (stats.first_present == std::chrono::steady_clock::time_point()) {
+				stats.first_present = std::chrono::steady_clock::now();
+			}
+			++stats.presents;
+			++i;
+			continue;
+		}
+		if (work[i].bind) {
+			queue_bind_sparse(st, work[i].sparse);
+			++stats.binds;
+			++i;
+			continue;
+		}
+		size_t end = i;
+		while (end < work.size() && !work[end].present && !work[end].bind) {
+			++end;
+			if (work[end - 1].batch.fence != VK_NULL_HANDLE) {
+				break;
+			}
+		}
+		const std::vector<MergedSubmit> merged = merge_batches(work, i, end);
+		queue_submit(st, merged, work[end - 1].batch.fence);
+		stats.batches += end - i;
+		++stats.submit_calls;
+		stats.submit_infos += merged.size();
+		i = end;
+	}
+}
+
+static void run_submit_thread(SubmitThread &st) {
+	while (true) {
+		std::vector<ScheduledWork> work;
+		{
+			std::unique_lock<std::mutex> lock(st.mutex);
+			st.cv.wait(lock, [&]() { return st.quit || !st.flushed.empty(); });
+			// Submit the flushed work before quitting
+			if (st.flushed.empty()) {
+				return;
+			}
+			std::swap(work, st.flushed);
+			st.busy = true;
+		}
+
+		SubmitSchedulerStats stats;
+		std::exception_ptr error;
+		try {
+			submit_work(st, work, stats);
+		} catch (...) {
+			error = std::current_exception();
+		}
+
+		std::lock_guard<std::mutex> lock(st.mutex);
+		st.stats.batches += stats.batches;
+		st.stats.submit_calls += stats.submit_calls;
+		st.stats.submit_infos += stats.submit_infos;
+		st.stats.binds += stats.binds;
+		st.stats.presents += stats.presents;
+		if (st.stats.first_present == std::chrono::steady_clock::time_point()) {
+			st.stats.first_present = stats.first_present;
+		}
+		if (error && !st.error) {
+			st.error = error;
+		}
+		if (st.error) {
+			st.flushed.clear();
+		}
+		st.busy = false;
+		st.idle_cv.notify_all();
+	}
+}
+
+// Called with the mutex held
+static void rethrow_submit_error(SubmitThread &st) {
+	if (st.error) {
+		std::exception_ptr error = st.error;
+		st.error = nullptr;
+		std::rethrow_exception(error);
+	}
+}
+
+static void flush_locked(SubmitThread &st) {
+	if (st.scheduled.empty()) {
+		return;
+	}
+	st.flushed.insert(st.flushed.end(), std::make_move_iterator(st.scheduled.begin()),
+			std::make_move_iterator(st.scheduled.end()));
+	st.scheduled.clear();
+	st.cv.notify_one();
+}
+
+bool submit2_supported(VkPhysicalDevice physical_device) {
+	uint32_t extension_count = 0;
+	vkEnumerateDeviceExtensionProperties(physical_device, nullptr, &extension_count, nullptr);
+	std::vector<VkExtensionProperties> extensions(extension_count, VkExtensionProperties{});
+	vkEnumerateDeviceExtensionProperties(physical_device, nullptr, &extension_count, extensions.data());
+	bool found = false;
+	for (const auto &e : extensions) {
+		found = found || std::strcmp(e.extensionName, VK_KHR_SYNCHRONIZATION_2_EXTENSION_NAME) == 0;
+	}
+	if (!found) {
+		return false;
+	}
+
+	VkPhysicalDeviceSynchronization2FeaturesKHR sync2_features = {};
+	sync2_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SYNCHRONIZATION_2_FEATURES_KHR;
+	VkPhysicalDeviceFeatures2 features = {};
+	features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+	features.pNext = &sync2_features;
+	vkGetPhysicalDeviceFeatures2(physical_device, &features);
+	return sync2_features.synchronization2;
+}
+
+SubmitScheduler create_submit_scheduler(VkDevice device, VkQueue queue, bool use_submit2) {
+	SubmitScheduler scheduler;
+	scheduler.thread = std::make_shared<SubmitThread>();
+	SubmitThread *st = scheduler.thread.get();
+	st->queue = queue;
+	if (use_submit2) {
+		st->queue_submit2 = reinterpret_cast<PFN_vkQueueSubmit2KHR>(vkGetDeviceProcAddr(device, "vkQueueSubmit2KHR"));
+	}
+	scheduler.use_submit2 = st->queue_submit2 != nullptr;
+	st->thread = std::thread([st]() { run_submit_thread(*st); });
+	return scheduler;
+}
+
+void schedule_submit(SubmitScheduler &scheduler, const SubmitBatch &batch) {
+	SubmitThread &st = *scheduler.thread;
+	std::lock_guard<std::mutex> lock(st.mutex);
+	rethrow_submit_error(st);
+	ScheduledWork work;
+	work.batch = batch;
+	st.scheduled.push_back(work);
+}
+
+void schedule_sparse_bind(SubmitScheduler &scheduler, const SparseBindBatch &batch) {
+	SubmitThread &st = *scheduler.thread;
+	std::lock_guard<std::mutex> lock(st.mutex);
+	rethrow_submit_error(st);
+	ScheduledWork work;
+	work.bind = true;
+	work.sparse = batch;
+	st.scheduled.push_back(work);
+}
+
+void schedule_present(SubmitScheduler &scheduler, VkSwapchainKHR swapchain, uint32_t image_index,
+		VkSemaphore wait_semaphore)
+{
+	SubmitThread &st = *scheduler.thread;
+	std::lock_guard<std::mutex> lock(st.mutex);
+	rethrow_submit_error(st);
+	ScheduledWork work;
+	work.present = true;
+	work.swapchain = swapchain;
+	work.image_index = image_index;
+	work.present_wait = wait_semaphore;
+	st.scheduled.push_back(work);
+	flush_locked(st);
+}
+
+void flush_submit_scheduler(SubmitScheduler &scheduler) {
+	SubmitThread &st = *scheduler.thread;
+	std::lock_guard<std::mutex> lock(st.mutex);
+	rethrow_submit_error(st);
+	flush_locked(st);
+}
+
+void wait_submit_scheduler_idle(SubmitScheduler &scheduler) {
+	if (!scheduler.thread) {
+		return;
+	}
+	SubmitThread &st = *scheduler.thread;
+	std::unique_lock<std::mutex> lock(st.mutex);
+	flush_locked(st);
+	st.idle_cv.wait(lock, [&]() { return st.flushed.empty() && !st.busy; });
+	rethrow_submit_error(st);
+}
+
+VkResult acquire_next_image(SubmitScheduler &scheduler, VkDevice device, VkSwapchainKHR swapchain,
+		VkSemaphore semaphore, uint32_t &image_index)
+{
+	SubmitThread &st = *scheduler.thread;
+	{
+		std::lock_guard<std::mutex> lock(st.swapchain_mutex);
+		const VkResult r = vkAcquireNextImageKHR(device, swapchain, 0, semaphore, VK_NULL_HANDLE, &image_index);
+		if (r != VK_NOT_READY && r != VK_TIMEOUT) {
+			return r;
+		}
+	}
+	// Blocking while holding the lock would keep the thread from making the present which
+	// releases the image, so the presents are made first
+	wait_submit_scheduler_idle(scheduler);
+	std::lock_guard<std::mutex> lock(st.swapchain_mutex);
+	return vkAcquireNextImageKHR(device, swapchain, std::numeric_limits<uint64_t>::max(), semaphore,
+			VK_NULL_HANDLE, &image_index);
+}
+
+SubmitSchedulerStats submit_scheduler_stats(const SubmitScheduler &scheduler) {
+	SubmitThread &st = *scheduler.thread;
+	std::lock_guard<std::mutex> lock(st.mutex);
+	return st.stats;
+}
+
+void destroy_submit_scheduler(SubmitScheduler &scheduler) {
+	if (!scheduler.thread) {
+		return;
+	}
+	SubmitThread &st = *scheduler.thread;
+	{
+		std::lock_guard<std::mutex> lock(st.mutex);
+		flush_locked(st);
+		st.quit = true;
+		st.cv.notify_one();
+	}
+	st.thread.join();
+	scheduler = SubmitScheduler();
+}
@@ -0,0 +1,96 @@
+#pragma once
+
+#include <chrono>
+#include <memory>
+#include <vector>
+#include <vulkan/vulkan.h>
+
+// Gathers the command buffers of the producers in a frame (rendering, uploads, compute) as
+// separate batches, each waiting on and signaling only the semaphores it needs, and hands
+// them to a single thread owning the queue. The thread merges everything flushed since its
+// last wakeup into as few vkQueueSubmit2 calls as possible, or vkQueueSubmit without
+// VK_KHR_synchronization2, and presents in the same order. Batches are submitted in the
+// order they're scheduled, so a batch can wait on a semaphore signaled by an earlier one.
+//
+// Only the scheduler's thread accesses the queue until the scheduler is idle, see
+// wait_submit_scheduler_idle. Sparse binds go through it as bind batches, and images of the
+// presented swapchains are acquired with acquire_next_image, which is serialized against the
+// thread's presents.
+
+struct SubmitWait {
+	VkSemaphore semaphore = VK_NULL_HANDLE;
+	VkPipelineStageFlags stage = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+};
+
+struct SubmitBatch {
+	std::vector<VkCommandBuffer> command_buffers;
+	std::vector<SubmitWait> waits;
+	std::vector<VkSemaphore> signals;
+	// Signaled once the batch and everything submitted before it is done. A submission call
+	// ends at each batch with a fence
+	VkFence fence = VK_NULL_HANDLE;
+};
+
+// Sparse binds of an image's pages, submitted with vkQueueBindSparse in order with the batches
+struct SparseBindBatch {
+	VkImage image = VK_NULL_HANDLE;
+	std::vector<VkSparseImageMemoryBind> binds;
+	std::vector<VkSemaphore> signals;
+};
+
+struct SubmitSchedulerStats {
+	uint64_t batches = 0;
+	// The submission calls, and the submit infos passed to them after merging the adjacent
+	// batches which don't need a semaphore between them
+	uint64_t submit_calls = 0;
+	uint64_t submit_infos = 0;
+	uint64_t binds = 0;
+	uint64_t presents = 0;
+	// When the first present was made, the default value until then
+	std::chrono::steady_clock::time_point first_present;
+};
+
+struct SubmitThread;
+
+struct SubmitScheduler {
+	bool use_submit2 = false;
+	std::shared_ptr<SubmitThread> thread;
+};
+
+// Whether the device supports VK_KHR_synchronization2, which must then be enabled with its
+// feature for the scheduler to use vkQueueSubmit2KHR
+bool submit2_supported(VkPhysicalDevice physical_device);
+
+SubmitScheduler create_submit_scheduler(VkDevice device, VkQueue queue, bool use_submit2);
+
+// Queue the batch to be submitted at the next flush. Can be called from any thread, and
+// rethrows the error if an earlier submission or present failed
+void schedule_submit(SubmitScheduler &scheduler, const SubmitBatch &batch);
+
+// Queue the sparse binds to be submitted at the next flush, after the batches scheduled so
+// far. Can be called from any thread
+void schedule_sparse_bind(SubmitScheduler &scheduler, const SparseBindBatch &batch);
+
+// Queue presenting the image after everything scheduled so far, and flush
+void schedule_present(SubmitScheduler &scheduler, VkSwapchainKHR swapchain, uint32_t image_index,
+		VkSemaphore wait_semaphore);
+
+// Wake the thread to submit everything scheduled so far
+void flush_submit_scheduler(SubmitScheduler &scheduler);
+
+// Acquire the next image of a swapchain presented through the scheduler without waiting for
+// the thread, unless no image is available yet. Then the presents still queued may be the
+// ones releasing an image, so they're made before blocking in the acquire
+VkResult acquire_next_image(SubmitScheduler &scheduler, VkDevice device, VkSwapchainKHR swapchain,
+		VkSemaphore semaphore, uint32_t &image_index);
+
+// Flush and wait until everything scheduled has been submitted and presented. Until more is
+// scheduled the caller can then access the queue and swapchains directly, e.g. to rebuild
+// the swapchain, wait for the device to be idle or run setup work. A destroyed scheduler is
+// always idle
+void wait_submit_scheduler_idle(SubmitScheduler &scheduler);
+
+SubmitSchedulerStats submit_scheduler_stats(const SubmitScheduler &scheduler);
+
+// Submit the remaining work and stop the thread
+void destroy_submit_scheduler(SubmitScheduler &scheduler);
@@ -0,0 +1,76 @@
+#include <algorithm>
+#include <iostream>
+#include "swapchain.h"
+#include "settings.h"
+#include "object_cache.h"
+#include "vulkan_utils.h"
+
+std::vector<VkPresentModeKHR> supported_present_modes(VkPhysicalDevice physical_device, VkSurfaceKHR surface) {
+	uint32_t count = 0;
+	vkGetPhysicalDeviceSurfacePresentModesKHR(physical_device, surface, &count, nullptr);
+	std::vector<VkPresentModeKHR> modes(count, VK_PRESENT_MODE_FIFO_KHR);
+	vkGetPhysicalDeviceSurfacePresentModesKHR(physical_device, surface, &count, modes.data());
+	return modes;
+}
+
+Swapchain create_swapchain(VkDevice device, VkPhysicalDevice physical_device, VkSurfaceKHR surface,
+		VkExtent2D extent, VkFormat format, VkPresentModeKHR present_mode, VkImageUsageFlags usage,
+		uint32_t min_image_count)
+{
+	Swapchain swapchain;
+	swapchain.format = format;
+	swapchain.extent = extent;
+
+	// FIFO is always supported
+	const std::vector<VkPresentModeKHR> modes = supported_present_modes(physical_device, surface);
+	swapchain.present_mode = present_mode;
+	if (std::find(modes.begin(), modes.end(), present_mode) == modes.end()) {
+		std::cout << "Present mode " << present_mode_name(present_mode) << " is not supported, using fifo\n";
+		swapchain.present_mode = VK_PRESENT_MODE_FIFO_KHR;
+	}
+
+	VkSurfaceCapabilitiesKHR capabilities = {};
+	CHECK_VULKAN(vkGetPhysicalDeviceSurfaceCapabilitiesKHR(physical_device, surface, &capabilities));
+	uint32_t image_count = std::max(min_image_count, capabilities.minImageCount);
+	if (capabilities.maxImageCount != 0) {
+		image_count = std::min(image_count, capabilities.maxImageCount);
+	}
+
+	VkSwapchainCreateInfoKHR create_info = {};
+	create_info.sType = VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR;
+	create_info.surface = surface;
+	create_info.minImageCount = image_count;
+	create_info.imageFormat = format;
+	create_info.imageColorSpace = VK_COLOR_SPACE_SRGB_NONLINEAR_KHR;
+	create_info.imageExtent = extent;
+	create_info.imageArrayLayers = 1;
+	create_info.imageUsage = usage;
+	// We only have 1 queue
+	create_info.imageSharingMode = VK_SHARING_MODE_EXCLUSIVE;
+	create_info.preTransform = VK_SURFACE_TRANSFORM_IDENTITY_BIT_KHR;
+	create_info.compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;
+	create_info.presentMode = swapchain.present_mode;
+	create_info.clipped = true;
+	create_info.oldSwapchain = VK_NULL_HANDLE;
+	CHECK_VULKAN(vkCreateSwapchainKHR(device, &create_info, nullptr, &swapchain.swapchain));
+
+	// Get the swap chain images
+	uint32_t num_swapchain_imgs = 0;
+	vkGetSwapchainImagesKHR(device, swapchain.swapchain, &num_swapchain_imgs, nullptr);
+	swapchain.images.resize(num_swapchain_imgs);
+	vkGetSwapchainImagesKHR(device, swapchain.swapchain, &num_swapchain_imgs, swapchain.images.data());
+
+	for (const auto &img : swapchain.images) {
+		swapchain.image_views.push_back(
+				create_image_view(device, img, VK_IMAGE_VIEW_TYPE_2D, format, VK_IMAGE_ASPECT_COLOR_BIT, 0, 1));
+	}
+	return swapchain;
+}
+
+void destroy_swapchain(VkDevice device, Swapchain &swapchain) {
+	for (auto &img : swapchain.images) {
+		release_image_views(device, img);
+	}
+	vkDestroySwapchainKHR(device, swapchain.swapchain, nullptr);
+	swapchain = Swapchain();
+}
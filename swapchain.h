@@ -0,0 +1,24 @@
+#pragma once
+
+#include <vector>
+#include <vulkan/vulkan.h>
+
+struct Swapchain {
+	VkSwapchainKHR swapchain = VK_NULL_HANDLE;
+	VkFormat format = VK_FORMAT_UNDEFINED;
+	VkExtent2D extent = {};
+	VkPresentModeKHR present_mode = VK_PRESENT_MODE_FIFO_KHR;
+	std::vector<VkImage> images;
+	std::vector<VkImageView> image_views;
+};
+
+std::vector<VkPresentModeKHR> supported_present_modes(VkPhysicalDevice physical_device, VkSurfaceKHR surface);
+
+// Create the swapchain, falling back to FIFO if the present mode isn't supported. At least
+// min_image_count images are requested, clamped to what the surface allows
+Swapchain create_swapchain(VkDevice device, VkPhysicalDevice physical_device, VkSurfaceKHR surface,
+		VkExtent2D extent, VkFormat format, VkPresentModeKHR present_mode, VkImageUsageFlags usage,
+		uint32_t min_image_count);
+
+void destroy_swapchain(VkDevice device, Swapchain &swapchain);
+
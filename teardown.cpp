@@ -0,0 +1,70 @@
+#include <iostream>
+#include "object_cache.h"
+#include "teardown.h"
+
+bool drain_device(VkDevice device, const std::vector<VkFence> &fences, uint64_t timeout_ns) {
+	if (fences.empty()) {
+		return true;
+	}
+	const VkResult r = vkWaitForFences(device, fences.size(), fences.data(), VK_TRUE, timeout_ns);
+	if (r == VK_TIMEOUT) {
+		std::cout << "GPU didn't finish within " << timeout_ns / 1000000 << "ms of shutting down\n";
+		return false;
+	}
+	CHECK_VULKAN(r);
+	return true;
+}
+
+bool drain_queue(VkDevice device, VkQueue queue, uint64_t timeout_ns) {
+	// An empty submission's fence signals once everything submitted before it is done, which
+	// gives waiting for the queue a deadline vkQueueWaitIdle doesn't have
+	VkFenceCreateInfo fence_info = {};
+	fence_info.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+	VkFence fence = VK_NULL_HANDLE;
+	CHECK_VULKAN(vkCreateFence(device, &fence_info, nullptr, &fence));
+	CHECK_VULKAN(vkQueueSubmit(queue, 0, nullptr, fence));
+	// The fence may still be signaled by the GPU, so it's left to the driver if it times out
+	if (!drain_device(device, { fence }, timeout_ns)) {
+		return false;
+	}
+	vkDestroyFence(device, fence, nullptr);
+	return true;
+}
+
+uint32_t report_leaks() {
+	uint32_t total = 0;
+	for (const auto &c : live_vulkan_objects()) {
+		if (c.second > 0) {
+			std::cout << "Leaked " << c.second << " " << c.first << "\n";
+			total += c.second;
+		} else if (c.second < 0) {
+			std::cout << "Destroyed " << -c.second << " more " << c.first << " than were created\n";
+		}
+	}
+	return total;
+}
+
+bool shutdown_vulkan(VkInstance instance, VkSurfaceKHR surface, VkDevice device, VkQueue queue,
+		ResourceManager *resources, uint64_t timeout_ns)
+{
+	if (queue != VK_NULL_HANDLE && !drain_queue(device, queue, timeout_ns)) {
+		return false;
+	}
+
+	// The caches live until the end by design, what the manager still owns was never released
+	destroy_object_cache(device);
+	destroy_pipeline_cache(device);
+	if (resources) {
+		flush_released_resources(device, *resources);
+	}
+	report_leaks();
+	if (resources) {
+		destroy_resource_manager(device, *resources);
+	}
+	if (surface != VK_NULL_HANDLE) {
+		vkDestroySurfaceKHR(instance, surface, nullptr);
+	}
+	vkDestroyDevice(device, nullptr);
+	vkDestroyInstance(instance, nullptr);
+	return true;
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <vector>
+#include <vulkan/vulkan.h>
+#include "resources.h"
+
+// Shutdown helpers: drain the GPU once with a deadline before anything is destroyed, and
+// report the objects still alive once everything has been.
+
+// Wait for the fences until the timeout. Returns false if the GPU didn't finish in time, in
+// which case nothing it may still be using can be destroyed and the process should exit and
+// leave the cleanup to the driver
+bool drain_device(VkDevice device, const std::vector<VkFence> &fences, uint64_t timeout_ns);
+
+// Wait until the timeout for everything submitted to the queue so far, including work
+// submitted without a fence such as sparse binds, using the fence of an empty submission.
+// Returns false if the GPU didn't finish in time, as drain_device
+bool drain_queue(VkDevice device, VkQueue queue, uint64_t timeout_ns);
+
+// Print the count of each type of Vulkan object created and not destroyed, see
+// live_vulkan_objects. Resources still owned by a resource manager count as leaked. Call after
+// destroying everything but the device. Returns the total number leaked
+uint32_t report_leaks();
+
+// The end of every mode once it has destroyed its own objects: drain the queue with a
+// deadline, report the leaks, destroy the resource manager if one is given, the object and
+// pipeline caches, the surface if there is one, the device and the instance. A mode which
+// already drained the queue before destroying its objects passes a null queue. Returns false
+// if the GPU didn't finish in time, in which case nothing is destroyed
+bool shutdown_vulkan(VkInstance instance, VkSurfaceKHR surface, VkDevice device, VkQueue queue,
+		ResourceManager *resources, uint64_t timeout_ns);
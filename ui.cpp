@@ -0,0 +1,207 @@
+#include <array>
+#include <cstdio>
+#include <cstring>
+#include "ui.h"
+
+// Quads past what 16 bit indices can address are dropped
+static const size_t max_ui_vertices = 65536;
+static const float widget_padding = 4.f;
+
+static void ui_quad(UI &ui, float x0, float y0, float x1, float y1,
+		float u0, float v0, float u1, float v1, uint32_t color)
+{
+	if (ui.vertices.size() + 4 > max_ui_vertices) {
+		return;
+	}
+	const uint16_t base = ui.vertices.size();
+	ui.vertices.push_back(OverlayVertex{{x0, y0}, {u0, v0}, color});
+	ui.vertices.push_back(OverlayVertex{{x1, y0}, {u1, v0}, color});
+	ui.vertices.push_back(OverlayVertex{{x1, y1}, {u1, v1}, color});
+	ui.vertices.push_back(OverlayVertex{{x0, y1}, {u0, v1}, color});
+	for (const uint16_t i : { 0, 1, 2, 0, 2, 3 }) {
+		ui.indices.push_back(base + i);
+	}
+}
+
+static void ui_rect(UI &ui, float x, float y, float w, float h, uint32_t color) {
+	const FontAtlas &font = *ui.font;
+	ui_quad(ui, x, y, x + w, y + h, font.white_u, font.white_v, font.white_u, font.white_v, color);
+}
+
+static void ui_text(UI &ui, float x, float y, const char *text, uint32_t color) {
+	for (const char *c = text; *c; ++c) {
+		const Glyph &g = find_glyph(*ui.font, *c);
+		if (g.width > 0.f) {
+			const float gx = x + g.x_offset;
+			const float gy = y + g.y_offset;
+			ui_quad(ui, gx, gy, gx + g.width, gy + g.height, g.u0, g.v0, g.u1, g.v1, color);
+		}
+		x += g.advance;
+	}
+}
+
+static bool mouse_over(const UI &ui, float x, float y, float w, float h) {
+	return ui.input.mouse_x >= x && ui.input.mouse_x < x + w
+		&& ui.input.mouse_y >= y && ui.input.mouse_y < y + h;
+}
+
+UI create_ui(VkDevice device, const FontAtlas &font) {
+	UI ui;
+	ui.font = &font;
+	ui.desc_layout = create_overlay_desc_layout(device);
+	ui.pipeline_layout = create_overlay_pipeline_layout(device, ui.desc_layout);
+	return ui;
+}
+
+void create_ui_pipeline(VkDevice device, UI &ui, VkRenderPass render_pass, VkSampleCountFlagBits samples,
+		VkExtent2D extent)
+{
+	vkDestroyPipeline(device, ui.pipeline, nullptr);
+	ui.pipeline = create_overlay_pipeline(device, ui.pipeline_layout, render_pass, samples, extent);
+}
+
+void ui_begin_frame(UI &ui, const UIInput &input) {
+	ui.clicked = input.mouse_down && !ui.input.mouse_down;
+	ui.input = input;
+	ui.vertices.clear();
+	ui.indices.clear();
+}
+
+void ui_begin_panel(UI &ui, const char *title, float x, float y, float width) {
+	ui.panel_x = x;
+	ui.panel_y = y;
+	ui.panel_width = width;
+	ui.panel_background = ui.vertices.size();
+	ui_rect(ui, x, y, 0.f, 0.f, overlay_color(20, 20, 24, 200));
+
+	const float h = ui.font->line_height + 2.f * widget_padding;
+	ui_rect(ui, x, y, width, h, overlay_color(60, 70, 110, 230));
+	ui_text(ui, x + widget_padding, y + widget_padding, title, overlay_color(255, 255, 255));
+	ui.cursor_y = y + h + widget_padding;
+}
+
+void ui_end_panel(UI &ui) {
+	if (ui.panel_background + 4 > ui.vertices.size()) {
+		return;
+	}
+	const float y1 = ui.cursor_y;
+	const float x1 = ui.panel_x + ui.panel_width;
+	OverlayVertex *v = &ui.vertices[ui.panel_background];
+	v[1].pos[0] = x1;
+	v[2].pos[0] = x1;
+	v[2].pos[1] = y1;
+	v[3].pos[1] = y1;
+}
+
+void ui_label(UI &ui, const char *text) {
+	ui_text(ui, ui.panel_x + widget_padding, ui.cursor_y, text, overlay_color(220, 220, 220));
+	ui.cursor_y += ui.font->line_height + widget_padding;
+}
+
+bool ui_button(UI &ui, const char *label) {
+	const float x = ui.panel_x + widget_padding;
+	const float y = ui.cursor_y;
+	const float w = ui.panel_width - 2.f * widget_padding;
+	const float h = ui.font->line_height + 2.f * widget_padding;
+	const bool hovered = mouse_over(ui, x, y, w, h);
+
+	uint32_t color = overlay_color(50, 50, 60, 230);
+	if (hovered) {
+		color = ui.input.mouse_down ? overlay_color(90, 110, 170, 240) : overlay_color(70, 80, 100, 240);
+	}
+	ui_rect(ui, x, y, w, h, color);
+	ui_text(ui, x + widget_padding, y + widget_padding, label, overlay_color(255, 255, 255));
+	ui.cursor_y += h + widget_padding;
+	return hovered && ui.clicked;
+}
+
+bool ui_checkbox(UI &ui, const char *label, bool &value) {
+	const float x = ui.panel_x + widget_padding;
+	const float y = ui.cursor_y;
+	const float h = ui.font->line_height + 2.f * widget_padding;
+	const bool hovered = mouse_over(ui, x, y, ui.panel_width - 2.f * widget_padding, h);
+
+	ui_rect(ui, x, y, h, h, hovered ? overlay_color(70, 80, 100, 240) : overlay_color(50, 50, 60, 230));
+	if (value) {
+		ui_rect(ui, x + widget_padding, y + widget_padding, h - 2.f * widget_padding, h - 2.f * widget_padding,
+				overlay_color(120, 230, 120));
+	}
+	ui_text(ui, x + h + widget_padding, y + widget_padding, label, overlay_color(255, 255, 255));
+	ui.cursor_y += h + widget_padding;
+
+	if (hovered && ui.clicked) {
+		value = !value;
+		return true;
+	}
+	return false;
+}
+
+bool ui_cycle(UI &ui, const char *label, const char *value) {
+	std::array<char, 128> text = {};
+	std::snprintf(text.data(), text.size(), "%s: %s", label, value);
+	return ui_button(ui, text.data());
+}
+
+void record_ui(const UI &ui, VkDevice device, VkCommandBuffer cmd_buf, FrameRingBuffer &ring,
+		VkDescriptorPool frame_desc_pool, VkExtent2D extent)
+{
+	if (ui.indices.empty()) {
+		return;
+	}
+
+	const VkDeviceSize vertex_bytes = ui.vertices.size() * sizeof(OverlayVertex);
+	const VkDeviceSize index_bytes = ui.indices.size() * sizeof(uint16_t);
+	const RingAllocation vertices = ring_alloc(ring, vertex_bytes, sizeof(float));
+	const RingAllocation indices = ring_alloc(ring, index_bytes, sizeof(uint16_t));
+	if (!vertices.data || !indices.data) {
+		std::cout << "UI geometry doesn't fit in the frame ring buffer, skipping it\n";
+		return;
+	}
+	std::memcpy(vertices.data, ui.vertices.data(), vertex_bytes);
+	std::memcpy(indices.data, ui.indices.data(), index_bytes);
+
+	// The set is only used by this frame, so it's allocated from the frame's pool and released
+	// when the pool is reset instead of being kept and updated
+	VkDescriptorSet desc_set = VK_NULL_HANDLE;
+	{
+		VkDescriptorSetAllocateInfo alloc_info = {};
+		alloc_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+		alloc_info.descriptorPool = frame_desc_pool;
+		alloc_info.descriptorSetCount = 1;
+		alloc_info.pSetLayouts = &ui.desc_layout;
+		CHECK_VULKAN(vkAllocateDescriptorSets(device, &alloc_info, &desc_set));
+
+		VkDescriptorImageInfo image_info = {};
+		image_info.sampler = ui.font->sampler;
+		image_info.imageView = ui.font->image.view;
+		image_info.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+		VkWriteDescriptorSet write = {};
+		write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		write.dstSet = desc_set;
+		write.dstBinding = 0;
+		write.descriptorCount = 1;
+		write.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+		write.pImageInfo = &image_info;
+		vkUpdateDescriptorSets(device, 1, &write, 0, nullptr);
+	}
+
+	vkCmdBindPipeline(cmd_buf, VK_PIPELINE_BIND_POINT_GRAPHICS, ui.pipeline);
+	vkCmdBindDescriptorSets(cmd_buf, VK_PIPELINE_BIND_POINT_GRAPHICS, ui.pipeline_layout, 0, 1,
+			&desc_set, 0, nullptr);
+
+	const std::array<float, 2> pixel_scale = { 2.f / extent.width, 2.f / extent.height };
+	vkCmdPushConstants(cmd_buf, ui.pipeline_layout, VK_SHADER_STAGE_VERTEX_BIT, 0,
+			sizeof(pixel_scale), pixel_scale.data());
+
+	vkCmdBindVertexBuffers(cmd_buf, 0, 1, &ring.buffer.buffer, &vertices.offset);
+	vkCmdBindIndexBuffer(cmd_buf, ring.buffer.buffer, indices.offset, VK_INDEX_TYPE_UINT16);
+	vkCmdDrawIndexed(cmd_buf, ui.indices.size(), 1, 0, 0, 0);
+}
+
+void destroy_ui(VkDevice device, UI &ui) {
+	vkDestroyPipeline(device, ui.pipeline, nullptr);
+	vkDestroyPipelineLayout(device, ui.pipeline_layout, nullptr);
+	vkDestroyDescriptorSetLayout(device, ui.desc_layout, nullptr);
+	ui = UI();
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <vector>
+#include <vulkan/vulkan.h>
+#include "font_atlas.h"
+#include "frame_resources.h"
+#include "overlay.h"
+
+struct UIInput {
+	float mouse_x = 0.f;
+	float mouse_y = 0.f;
+	bool mouse_down = false;
+};
+
+// Immediate-mode debug UI: widgets are declared each frame and return whether they were
+// clicked, no widget state is kept between frames. The geometry is built on the CPU as
+// indexed quads, copied into the frame's region of the ring buffer when recorded and drawn
+// with the overlay shaders in the render pass it's recorded in.
+struct UI {
+	const FontAtlas *font = nullptr;
+
+	UIInput input;
+	// Set for the frame the mouse button went down in
+	bool clicked = false;
+
+	// Layout cursor of the current panel
+	float panel_x = 0.f;
+	float panel_y = 0.f;
+	float panel_width = 0.f;
+	float cursor_y = 0.f;
+	// The panel background quad is reserved when the panel begins so it's drawn under the
+	// widgets, and sized when it ends
+	size_t panel_background = 0;
+
+	std::vector<OverlayVertex> vertices;
+	std::vector<uint16_t> indices;
+
+	VkDescriptorSetLayout desc_layout = VK_NULL_HANDLE;
+	VkPipelineLayout pipeline_layout = VK_NULL_HANDLE;
+	VkPipeline pipeline = VK_NULL_HANDLE;
+};
+
+// The font must outlive the UI
+UI create_ui(VkDevice device, const FontAtlas &font);
+
+// (Re)create the pipeline for drawing in the render pass, which must be done before recording
+// and whenever the render pass or sample count changes
+void create_ui_pipeline(VkDevice device, UI &ui, VkRenderPass render_pass, VkSampleCountFlagBits samples,
+		VkExtent2D extent);
+
+void ui_begin_frame(UI &ui, const UIInput &input);
+
+void ui_begin_panel(UI &ui, const char *title, float x, float y, float width);
+
+void ui_end_panel(UI &ui);
+
+void ui_label(UI &ui, const char *text);
+
+bool ui_button(UI &ui, const char *label);
+
+// Toggles value when clicked, returns true if it changed
+bool ui_checkbox(UI &ui, const char *label, bool &value);
+
+// A button showing "label: value", the caller advances the value to the next option when
+// it returns true
+bool ui_cycle(UI &ui, const char *label, const char *value);
+
+// Copy the frame's geometry into the ring buffer and draw it, in a render pass compatible
+// with the pipeline's. The font descriptor set is allocated from the frame's descriptor pool
+void record_ui(const UI &ui, VkDevice device, VkCommandBuffer cmd_buf, FrameRingBuffer &ring,
+		VkDescriptorPool frame_desc_pool, VkExtent2D extent);
+
+void destroy_ui(VkDevice device, UI &ui);
+
@@ -0,0 +1,271 @@
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <random>
+#include <vector>
+#include "view_batch.h"
+
+// A submission's target with a layer per view, the renderer drawing into it and the
+// readback of all its layers
+struct ViewBatchSlot {
+	Image target;
+	OITRenderer oit;
+	Buffer readback;
+	const uint8_t *readback_mapping = nullptr;
+	VkCommandBuffer cmd_buf = VK_NULL_HANDLE;
+	VkFence fence = VK_NULL_HANDLE;
+	// The views rendered by the submission in flight, none if it's idle
+	uint32_t first_view = 0;
+	uint32_t num_views = 0;
+};
+
+// Views from evenly spread directions around the scene, kept away from the poles so the up
+// vector stays valid
+static std::vector<Camera> make_orbit_cameras(uint32_t count, float aspect) {
+	const float golden_angle = 2.39996323f;
+	std::vector<Camera> cameras(count, Camera{});
+	for (uint32_t i = 0; i < count; ++i) {
+		const float y = 0.8f * (1.f - 2.f * (i + 0.5f) / count);
+		const float r = std::sqrt(1.f - y * y);
+		const float phi = i * golden_angle;
+		cameras[i].position = vec3(r * std::cos(phi), y, r * std::sin(phi)) * 14.f;
+		cameras[i].target = vec3(0.f, 0.f, 0.f);
+		cameras[i].aspect = aspect;
+	}
+	return cameras;
+}
+
+// Six 90 degree views per probe. The projection's y already points down like the image rows,
+// the up vectors are the direction of each face's first row, and the negative aspect mirrors
+// x since a cube map is seen from the inside
+static std::vector<Camera> make_cubemap_cameras(uint32_t count) {
+	const std::array<vec3, 6> forward = {
+		vec3(1.f, 0.f, 0.f), vec3(-1.f, 0.f, 0.f), vec3(0.f, 1.f, 0.f),
+		vec3(0.f, -1.f, 0.f), vec3(0.f, 0.f, 1.f), vec3(0.f, 0.f, -1.f)
+	};
+	const std::array<vec3, 6> up = {
+		vec3(0.f, 1.f, 0.f), vec3(0.f, 1.f, 0.f), vec3(0.f, 0.f, -1.f),
+		vec3(0.f, 0.f, 1.f), vec3(0.f, 1.f, 0.f), vec3(0.f, 1.f, 0.f)
+	};
+	std::mt19937 rng(7);
+	std::uniform_real_distribution<float> pos_distrib(-4.f, 4.f);
+	std::vector<Camera> cameras(count, Camera{});
+	vec3 probe;
+	for (uint32_t i = 0; i < count; ++i) {
+		if (i % 6 == 0) {
+			probe = vec3(pos_distrib(rng), pos_distrib(rng), pos_distrib(rng));
+		}
+		cameras[i].position = probe;
+		cameras[i].target = probe + forward[i % 6];
+		cameras[i].up = up[i % 6];
+		cameras[i].fovy = 1.57079633f;
+		cameras[i].aspect = -1.f;
+	}
+	return cameras;
+}
+
+static void record_view_batch(ViewBatchSlot &slot, const std::vector<Camera> &cameras, VkExtent2D extent) {
+	VkCommandBufferBeginInfo begin_info = {};
+	begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+	CHECK_VULKAN(vkBeginCommandBuffer(slot.cmd_buf, &begin_info));
+	for (uint32_t i = 0; i < slot.num_views; ++i) {
+		const Camera &camera = cameras[slot.first_view + i];
+		sort_transparent_instances(slot.oit, camera);
+		record_oit(slot.oit, slot.cmd_buf, i, camera);
+	}
+
+	image_barrier(slot.cmd_buf, slot.target.image, VK_IMAGE_ASPECT_COLOR_BIT,
+			VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+			VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT, VK_ACCESS_TRANSFER_READ_BIT,
+			VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, slot.num_views);
+
+	// The layers are tightly packed one after another in the readback
+	VkBufferImageCopy copy = {};
+	copy.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	copy.imageSubresource.layerCount = slot.num_views;
+	copy.imageExtent.width = extent.width;
+	copy.imageExtent.height = extent.height;
+	copy.imageExtent.depth = 1;
+	vkCmdCopyImageToBuffer(slot.cmd_buf, slot.target.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+			slot.readback.buffer, 1, &copy);
+
+	VkBufferMemoryBarrier barrier = {};
+	barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+	barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+	barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.buffer = slot.readback.buffer;
+	barrier.size = VK_WHOLE_SIZE;
+	vkCmdPipelineBarrier(slot.cmd_buf, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0,
+			0, nullptr, 1, &barrier, 0, nullptr);
+	CHECK_VULKAN(vkEndCommandBuffer(slot.cmd_buf));
+}
+
+// Wait for the slot's submission and copy its views into their atlas tiles
+static void finish_view_batch(VkDevice device, ViewBatchSlot &slot, VkExtent2D extent, uint32_t atlas_columns,
+		std::vector<uint8_t> &atlas)
+{
+	if (slot.num_views == 0) {
+		return;
+	}
+	CHECK_VULKAN(vkWaitForFences(device, 1, &slot.fence, VK_TRUE, std::numeric_limits<uint64_t>::max()));
+	CHECK_VULKAN(vkResetFences(device, 1, &slot.fence));
+
+	const size_t row_bytes = size_t(extent.width) * 4;
+	const size_t atlas_row_bytes = row_bytes * atlas_columns;
+	for (uint32_t i = 0; i < slot.num_views; ++i) {
+		const uint32_t view = slot.first_view + i;
+		const uint8_t *src = slot.readback_mapping + i * row_bytes * extent.height;
+		uint8_t *dst = atlas.data() + (view / atlas_columns) * extent.height * atlas_row_bytes
+			+ (view % atlas_columns) * row_bytes;
+		for (uint32_t y = 0; y < extent.height; ++y) {
+			std::memcpy(dst + y * atlas_row_bytes, src + y * row_bytes, row_bytes);
+		}
+	}
+	slot.num_views = 0;
+}
+
+static void write_atlas_ppm(const std::string &path, const std::vector<uint8_t> &atlas, uint32_t width,
+		uint32_t height)
+{
+	std::ofstream fout(path.c_str(), std::ios::binary);
+	fout << "P6\n" << width << " " << height << "\n255\n";
+	std::vector<uint8_t> rgb(size_t(width) * height * 3, 0);
+	for (size_t i = 0; i < size_t(width) * height; ++i) {
+		std::copy(&atlas[i * 4], &atlas[i * 4] + 3, &rgb[i * 3]);
+	}
+	fout.write(reinterpret_cast<const char*>(rgb.data()), rgb.size());
+	if (!fout) {
+		std::cout << "Failed to write the view atlas " << path << "\n";
+	}
+}
+
+ViewBatchResult run_view_batch(VkDevice device, VkPhysicalDevice physical_device, VkQueue queue,
+		uint32_t queue_family, const ViewBatchParams &params)
+{
+	VkPhysicalDeviceProperties properties = {};
+	vkGetPhysicalDeviceProperties(physical_device, &properties);
+	ViewBatchResult result;
+	result.views_per_submission = params.oit_mode == OITMode::SORTED ? 1
+		: std::min(std::min(params.views_per_submission, properties.limits.maxImageArrayLayers), params.num_views);
+	result.views_per_submission = std::max(result.views_per_submission, 1u);
+
+	VkCommandPool command_pool = VK_NULL_HANDLE;
+	{
+		VkCommandPoolCreateInfo info = {};
+		info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+		info.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+		info.queueFamilyIndex = queue_family;
+		CHECK_VULKAN(vkCreateCommandPool(device, &info, nullptr, &command_pool));
+	}
+
+	const VkFormat format = VK_FORMAT_R8G8B8A8_UNORM;
+	const VkExtent2D extent = params.view_extent;
+	const VkDeviceSize view_bytes = VkDeviceSize(extent.width) * extent.height * 4;
+	const std::vector<TransparentInstance> instances = make_transparent_instances(params.num_instances, 1);
+	ResourceManager resources;
+	std::vector<ViewBatchSlot> slots(std::max(params.submissions_in_flight, 1u), ViewBatchSlot{});
+	for (auto &slot : slots) {
+		slot.target = create_image(device, physical_device, extent, result.views_per_submission, format,
+				VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT, VK_IMAGE_ASPECT_COLOR_BIT);
+		std::vector<VkImageView> layer_views;
+		for (uint32_t i = 0; i < result.views_per_submission; ++i) {
+			layer_views.push_back(create_image_view(device, slot.target.image, VK_IMAGE_VIEW_TYPE_2D, format,
+					VK_IMAGE_ASPECT_COLOR_BIT, i, 1));
+		}
+		slot.oit = create_oit_renderer(device, physical_device, resources, params.oit_mode, extent, format,
+				VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, layer_views, instances);
+
+		slot.readback = create_buffer(device, physical_device, view_bytes * result.views_per_submission,
+				VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+		void *mapping = nullptr;
+		CHECK_VULKAN(vkMapMemory(device, slot.readback.mem, 0, VK_WHOLE_SIZE, 0, &mapping));
+		slot.readback_mapping = reinterpret_cast<const uint8_t*>(mapping);
+
+		VkCommandBufferAllocateInfo alloc_info = {};
+		alloc_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+		alloc_info.commandPool = command_pool;
+		alloc_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+		alloc_info.commandBufferCount = 1;
+		CHECK_VULKAN(vkAllocateCommandBuffers(device, &alloc_info, &slot.cmd_buf));
+
+		VkFenceCreateInfo fence_info = {};
+		fence_info.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+		CHECK_VULKAN(vkCreateFence(device, &fence_info, nullptr, &slot.fence));
+	}
+
+	const std::vector<Camera> cameras = params.cubemaps ? make_cubemap_cameras(params.num_views)
+		: make_orbit_cameras(params.num_views, float(extent.width) / extent.height);
+	const uint32_t atlas_columns = params.cubemaps ? 6
+		: uint32_t(std::ceil(std::sqrt(double(params.num_views))));
+	const uint32_t atlas_rows = (params.num_views + atlas_columns - 1) / atlas_columns;
+	std::vector<uint8_t> atlas(size_t(atlas_columns) * atlas_rows * view_bytes, 0);
+
+	using clock = std::chrono::steady_clock;
+	const auto start = clock::now();
+	double record_ms = 0.0;
+	for (uint32_t first = 0; first < params.num_views; first += result.views_per_submission) {
+		ViewBatchSlot &slot = slots[result.submissions % slots.size()];
+		finish_view_batch(device, slot, extent, atlas_columns, atlas);
+
+		const auto record_start = clock::now();
+		slot.first_view = first;
+		slot.num_views = std::min(result.views_per_submission, params.num_views - first);
+		record_view_batch(slot, cameras, extent);
+
+		VkSubmitInfo submit_info = {};
+		submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+		submit_info.commandBufferCount = 1;
+		submit_info.pCommandBuffers = &slot.cmd_buf;
+		CHECK_VULKAN(vkQueueSubmit(queue, 1, &submit_info, slot.fence));
+		record_ms += std::chrono::duration<double, std::milli>(clock::now() - record_start).count();
+		++result.submissions;
+	}
+	for (auto &slot : slots) {
+		finish_view_batch(device, slot, extent, atlas_columns, atlas);
+	}
+	result.total_ms = std::chrono::duration<double, std::milli>(clock::now() - start).count();
+	result.record_ms = record_ms;
+	result.views_per_second = params.num_views / std::max(result.total_ms * 1e-3f, 1e-6f);
+
+	uint64_t hash = 14695981039346656037ull;
+	for (uint8_t b : atlas) {
+		hash = (hash ^ b) * 1099511628211ull;
+	}
+	result.atlas_checksum = hash;
+	if (!params.atlas_path.empty()) {
+		write_atlas_ppm(params.atlas_path, atlas, atlas_columns * extent.width, atlas_rows * extent.height);
+	}
+
+	for (auto &slot : slots) {
+		vkDestroyFence(device, slot.fence, nullptr);
+		vkUnmapMemory(device, slot.readback.mem);
+		destroy_buffer(device, slot.readback);
+		destroy_oit_renderer(device, resources, slot.oit);
+		destroy_image(device, slot.target);
+	}
+	destroy_resource_manager(device, resources);
+	vkDestroyCommandPool(device, command_pool, nullptr);
+	return result;
+}
+
+void print_view_batch_result(const ViewBatchParams &params, const ViewBatchResult &result) {
+	std::cout << "View batch: " << params.num_views << (params.cubemaps ? " cube map faces " : " views ")
+		<< params.view_extent.width << "x" << params.view_extent.height << " with "
+		<< oit_mode_name(params.oit_mode) << " OIT in " << result.submissions << " submissions of up to "
+		<< result.views_per_submission << " views\n"
+		<< "  total: " << result.total_ms << "ms, " << result.views_per_second << " views/s\n"
+		<< "  record and submit: " << result.record_ms << "ms\n"
+		<< "  atlas checksum: " << std::hex << result.atlas_checksum << std::dec << "\n";
+	if (!params.atlas_path.empty()) {
+		std::cout << "  atlas written to " << params.atlas_path << "\n";
+	}
+}
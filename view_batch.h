@@ -0,0 +1,42 @@
+#pragma once
+
+#include <string>
+#include <vulkan/vulkan.h>
+#include "oit.h"
+
+// Offscreen rendering of many camera views of the transparent scene for bake jobs such as
+// thumbnails and cube map probes. The views of a submission are rendered one after another
+// into the layers of an array image in a single command buffer, with the camera in push
+// constants so nothing is updated between views, and read back with a single copy. A few
+// submissions are kept in flight, each with its own target and renderer, while the finished
+// ones are copied into a CPU side atlas.
+struct ViewBatchParams {
+	uint32_t num_views = 256;
+	VkExtent2D view_extent = { 128, 128 };
+	// Clamped to the device's array layer limit, and 1 with sorted OIT since each view sorts
+	// the shared instance buffer
+	uint32_t views_per_submission = 64;
+	uint32_t submissions_in_flight = 2;
+	// Orbit the scene from evenly spread directions, or render cube map faces at probes
+	// inside it, six views per probe in the +X, -X, +Y, -Y, +Z, -Z layer order
+	bool cubemaps = false;
+	OITMode oit_mode = OITMode::WEIGHTED_BLENDED;
+	uint32_t num_instances = 1024;
+	// Write the atlas of all views as a binary PPM, a row per probe for cube maps
+	std::string atlas_path;
+};
+
+struct ViewBatchResult {
+	float total_ms = 0.f;
+	// CPU time spent recording and submitting
+	float record_ms = 0.f;
+	float views_per_second = 0.f;
+	uint32_t submissions = 0;
+	uint32_t views_per_submission = 0;
+	uint64_t atlas_checksum = 0;
+};
+
+ViewBatchResult run_view_batch(VkDevice device, VkPhysicalDevice physical_device, VkQueue queue,
+		uint32_t queue_family, const ViewBatchParams &params);
+
+void print_view_batch_result(const ViewBatchParams &params, const ViewBatchResult &result);
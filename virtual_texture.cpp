@@ -0,0 +1,1001 @@
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <limits>
+#include <mutex>
+#include <thread>
+#include "virtual_texture.h"
+#include "object_cache.h"
+#include "spirv_shaders_embedded_spv.h"
+
+// Pages are packed as mip << 28 | y << 14 | x, matching the feedback shader
+static const uint32_t no_page = 0xffffffff;
+// The slot of pages in the sparse image's mip tail, which is bound once and never evicted
+static const uint32_t mip_tail_slot = 0xffffffff;
+static const uint64_t pinned = std::numeric_limits<uint64_t>::max();
+
+static uint32_t pack_page(uint32_t x, uint32_t y, uint32_t mip) {
+	return mip << 28 | y << 14 | x;
+}
+
+static VirtualPage unpack_page(uint32_t id) {
+	VirtualPage page;
+	page.x = id & 0x3fff;
+	page.y = (id >> 14) & 0x3fff;
+	page.mip = id >> 28;
+	return page;
+}
+
+// Generates the requested pages in order, as a loader reading and decompressing them would
+struct PageStreamer {
+	VirtualPageSource source;
+	VirtualTextureParams params;
+	std::mutex mutex;
+	std::condition_variable cv;
+	std::deque<uint32_t> requests;
+	std::deque<std::pair<uint32_t, std::vector<uint8_t>>> done;
+	bool quit = false;
+	std::thread thread;
+};
+
+static void stream_pages(PageStreamer &streamer) {
+	const size_t page_bytes = streamer.params.page_size * streamer.params.page_size * 4;
+	while (true) {
+		uint32_t id = no_page;
+		{
+			std::unique_lock<std::mutex> lock(streamer.mutex);
+			streamer.cv.wait(lock, [&]() { return streamer.quit || !streamer.requests.empty(); });
+			if (streamer.quit) {
+				return;
+			}
+			id = streamer.requests.front();
+			streamer.requests.pop_front();
+		}
+		std::vector<uint8_t> data(page_bytes, 0);
+		streamer.source(unpack_page(id), streamer.params, data.data());
+
+		std::lock_guard<std::mutex> lock(streamer.mutex);
+		streamer.done.emplace_back(id, std::move(data));
+	}
+}
+
+static float hash_noise(int32_t x, int32_t y, uint32_t octave) {
+	uint32_t h = uint32_t(x) * 0x8da6b343u ^ uint32_t(y) * 0xd8163841u ^ octave * 0xcb1ab31fu;
+	h ^= h >> 16;
+	h *= 0x7feb352du;
+	h ^= h >> 15;
+	h *= 0x846ca68bu;
+	h ^= h >> 16;
+	return (h & 0xffffff) / float(0x1000000);
+}
+
+static float value_noise(float x, float y, uint32_t octave) {
+	const float fx = std::floor(x);
+	const float fy = std::floor(y);
+	const int32_t ix = int32_t(fx);
+	const int32_t iy = int32_t(fy);
+	float tx = x - fx;
+	float ty = y - fy;
+	tx = tx * tx * (3.f - 2.f * tx);
+	ty = ty * ty * (3.f - 2.f * ty);
+	const float a = hash_noise(ix, iy, octave) + tx * (hash_noise(ix + 1, iy, octave) - hash_noise(ix, iy, octave));
+	const float b = hash_noise(ix, iy + 1, octave)
+		+ tx * (hash_noise(ix + 1, iy + 1, octave) - hash_noise(ix, iy + 1, octave));
+	return a + ty * (b - a);
+}
+
+static vec3 lerp(const vec3 &a, const vec3 &b, float t) {
+	return a + (b - a) * std::min(std::max(t, 0.f), 1.f);
+}
+
+void generate_terrain_page(const VirtualPage &page, const VirtualTextureParams &params, uint8_t *rgba) {
+	const uint32_t page_size = params.page_size;
+	const float texels = float(params.pages_wide) * page_size;
+	// The size of the page's texels in the full resolution texture, octaves finer than two
+	// texels are left out, which prefilters the coarser mips
+	const float texel_size = float(1u << page.mip);
+	const float texel_uv = texel_size / texels;
+
+	for (uint32_t j = 0; j < page_size; ++j) {
+		for (uint32_t i = 0; i < page_size; ++i) {
+			const float u = ((page.x * page_size + i) + 0.5f) * texel_uv;
+			const float v = ((page.y * page_size + j) + 0.5f) * texel_uv;
+			float height = 0.f;
+			float amplitude = 0.5f;
+			float frequency = 4.f;
+			for (uint32_t octave = 0; octave < 16 && frequency * texel_uv <= 0.5f; ++octave) {
+				height += amplitude * value_noise(u * frequency, v * frequency, octave);
+				amplitude *= 0.5f;
+				frequency *= 2.f;
+			}
+
+			vec3 color;
+			if (height < 0.42f) {
+				color = lerp(vec3(0.02f, 0.08f, 0.25f), vec3(0.1f, 0.3f, 0.5f), (height - 0.3f) / 0.12f);
+			} else if (height < 0.45f) {
+				color = vec3(0.76f, 0.7f, 0.5f);
+			} else if (height < 0.6f) {
+				color = lerp(vec3(0.2f, 0.5f, 0.15f), vec3(0.1f, 0.3f, 0.08f), (height - 0.45f) / 0.15f);
+			} else if (height < 0.7f) {
+				color = lerp(vec3(0.4f, 0.35f, 0.3f), vec3(0.5f, 0.5f, 0.5f), (height - 0.6f) / 0.1f);
+			} else {
+				color = vec3(0.95f, 0.95f, 0.97f);
+			}
+			uint8_t *texel = rgba + 4 * (j * page_size + i);
+			texel[0] = uint8_t(color.x * 255.f);
+			texel[1] = uint8_t(color.y * 255.f);
+			texel[2] = uint8_t(color.z * 255.f);
+			texel[3] = 255;
+		}
+	}
+}
+
+struct VirtualTexturePushParams {
+	mat4 view_proj;
+	float plane[4];
+	float vt_params[4];
+};
+
+static VirtualTexturePushParams virtual_texture_push_params(const VirtualTexture &vt, const Camera &camera,
+		float lod_bias)
+{
+	VirtualTexturePushParams push = {};
+	push.view_proj = camera.proj() * camera.view();
+	push.plane[0] = vt.params.plane_half_size;
+	push.plane[1] = vt.params.plane_height;
+	push.plane[2] = float(vt.num_mips - 1);
+	push.vt_params[0] = float(vt.params.pages_wide);
+	push.vt_params[1] = float(vt.params.page_size);
+	push.vt_params[2] = float(vt.params.atlas_pages_wide);
+	push.vt_params[3] = lod_bias;
+	return push;
+}
+
+static size_t indirection_mip_offset(const VirtualTexture &vt, uint32_t mip) {
+	size_t offset = 0;
+	for (uint32_t m = 0; m < mip; ++m) {
+		const size_t pages = vt.params.pages_wide >> m;
+		offset += pages * pages;
+	}
+	return offset;
+}
+
+// Map each page to itself if it's resident, or to the entry of its parent. Built from the
+// coarsest mip, which is always resident
+static void build_indirection_table(VirtualTexture &vt) {
+	for (uint32_t m = vt.num_mips; m-- > 0;) {
+		const uint32_t pages = vt.params.pages_wide >> m;
+		const size_t offset = indirection_mip_offset(vt, m);
+		const size_t parent_offset = m + 1 < vt.num_mips ? indirection_mip_offset(vt, m + 1) : 0;
+		for (uint32_t y = 0; y < pages; ++y) {
+			for (uint32_t x = 0; x < pages; ++x) {
+				uint32_t &entry = vt.indirection_table[offset + y * pages + x];
+				auto fnd = vt.resident.find(pack_page(x, y, m));
+				if (fnd != vt.resident.end()) {
+					const uint32_t slot = fnd->second;
+					const uint32_t slot_x = slot == mip_tail_slot ? 0xff : slot % vt.params.atlas_pages_wide;
+					const uint32_t slot_y = slot == mip_tail_slot ? 0xff : slot / vt.params.atlas_pages_wide;
+					entry = slot_x | slot_y << 8 | m << 16 | 0xff000000;
+				} else {
+					entry = vt.indirection_table[parent_offset + (y / 2) * (pages / 2) + x / 2];
+				}
+			}
+		}
+	}
+}
+
+// A free slot, or the least recently used slot not used by any frame which may still be in
+// flight. Returns the slot count if there are none
+static uint32_t find_page_slot(const VirtualTexture &vt) {
+	const uint32_t num_slots = vt.slot_pages.size();
+	uint32_t best = num_slots;
+	for (uint32_t i = 0; i < num_slots; ++i) {
+		if (vt.slot_pages[i] == no_page) {
+			return i;
+		}
+		if (vt.slot_last_used[i] != pinned && vt.slot_last_used[i] + vt.frames.size() < vt.frame_number
+				&& (best == num_slots || vt.slot_last_used[i] < vt.slot_last_used[best]))
+		{
+			best = i;
+		}
+	}
+	return best;
+}
+
+static VkImage page_image(const VirtualTexture &vt) {
+	return vt.sparse ? vt.sparse_image : vt.atlas.image;
+}
+
+// The sparse image stays in the general layout after its first transition, so pages bound
+// later are uploaded and sampled without transitioning the partially bound image
+static VkImageLayout page_image_layout(const VirtualTexture &vt) {
+	return vt.sparse ? VK_IMAGE_LAYOUT_GENERAL : VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+}
+
+static VkImageLayout page_upload_layout(const VirtualTexture &vt) {
+	return vt.sparse ? VK_IMAGE_LAYOUT_GENERAL : VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+}
+
+static VkBufferImageCopy page_copy(const VirtualTexture &vt, const VirtualPage &page, uint32_t slot,
+		VkDeviceSize buffer_offset)
+{
+	const uint32_t page_size = vt.params.page_size;
+	VkBufferImageCopy copy = {};
+	copy.bufferOffset = buffer_offset;
+	copy.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	copy.imageSubresource.mipLevel = vt.sparse ? page.mip : 0;
+	copy.imageSubresource.layerCount = 1;
+	if (vt.sparse) {
+		copy.imageOffset.x = page.x * page_size;
+		copy.imageOffset.y = page.y * page_size;
+	} else {
+		copy.imageOffset.x = (slot % vt.params.atlas_pages_wide) * page_size;
+		copy.imageOffset.y = (slot / vt.params.atlas_pages_wide) * page_size;
+	}
+	copy.imageExtent.width = page_size;
+	copy.imageExtent.height = page_size;
+	copy.imageExtent.depth = 1;
+	return copy;
+}
+
+static VkSparseImageMemoryBind page_bind(const VirtualTexture &vt, const VirtualPage &page, uint32_t slot) {
+	VkSparseImageMemoryBind bind = {};
+	bind.subresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	bind.subresource.mipLevel = page.mip;
+	bind.offset.x = page.x * vt.params.page_size;
+	bind.offset.y = page.y * vt.params.page_size;
+	bind.extent.width = vt.params.page_size;
+	bind.extent.height = vt.params.page_size;
+	bind.extent.depth = 1;
+	bind.memory = vt.page_memory;
+	bind.memoryOffset = slot * vt.page_stride;
+	return bind;
+}
+
+static void record_indirection_upload(VirtualTexture &vt, VkCommandBuffer cmd_buf, VkBuffer staging,
+		VkDeviceSize offset)
+{
+	std::vector<VkBufferImageCopy> copies;
+	for (uint32_t m = 0; m < vt.num_mips; ++m) {
+		VkBufferImageCopy copy = {};
+		copy.bufferOffset = offset + indirection_mip_offset(vt, m) * sizeof(uint32_t);
+		copy.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		copy.imageSubresource.mipLevel = m;
+		copy.imageSubresource.layerCount = 1;
+		copy.imageExtent.width = vt.params.pages_wide >> m;
+		copy.imageExtent.height = vt.params.pages_wide >> m;
+		copy.imageExtent.depth = 1;
+		copies.push_back(copy);
+	}
+	// The whole table is replaced so the old contents are discarded
+	image_barrier(cmd_buf, vt.indirection.image, VK_IMAGE_ASPECT_COLOR_BIT,
+			VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+			0, VK_ACCESS_TRANSFER_WRITE_BIT,
+			VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+	vkCmdCopyBufferToImage(cmd_buf, staging, vt.indirection.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+			copies.size(), copies.data());
+	image_barrier(cmd_buf, vt.indirection.image, VK_IMAGE_ASPECT_COLOR_BIT,
+			VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+			VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT,
+			VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+}
+
+bool virtual_texture_sparse_supported(VkPhysicalDevice physical_device, uint32_t queue_family,
+		const VirtualTextureParams &params)
+{
+	VkPhysicalDeviceFeatures features = {};
+	vkGetPhysicalDeviceFeatures(physical_device, &features);
+	if (!features.sparseBinding || !features.sparseResidencyImage2D) {
+		return false;
+	}
+
+	uint32_t num_families = 0;
+	vkGetPhysicalDeviceQueueFamilyProperties(physical_device, &num_families, nullptr);
+	std::vector<VkQueueFamilyProperties> family_props(num_families, VkQueueFamilyProperties{});
+	vkGetPhysicalDeviceQueueFamilyProperties(physical_device, &num_families, family_props.data());
+	if (queue_family >= num_families || !(family_props[queue_family].queueFlags & VK_QUEUE_SPARSE_BINDING_BIT)) {
+		return false;
+	}
+
+	// The pages must be whole sparse blocks
+	uint32_t num_props = 0;
+	vkGetPhysicalDeviceSparseImageFormatProperties(physical_device, VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_TYPE_2D,
+			VK_SAMPLE_COUNT_1_BIT, VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT,
+			VK_IMAGE_TILING_OPTIMAL, &num_props, nullptr);
+	std::vector<VkSparseImageFormatProperties> props(num_props, VkSparseImageFormatProperties{});
+	vkGetPhysicalDeviceSparseImageFormatProperties(physical_device, VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_TYPE_2D,
+			VK_SAMPLE_COUNT_1_BIT, VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT,
+			VK_IMAGE_TILING_OPTIMAL, &num_props, props.data());
+	for (const auto &p : props) {
+		if ((p.aspectMask & VK_IMAGE_ASPECT_COLOR_BIT) && p.imageGranularity.width == params.page_size
+				&& p.imageGranularity.height == params.page_size && p.imageGranularity.depth == 1)
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+// Create the sparse image and its memory, returns false if its mip tail would cover more than
+// the last mip. The mip tail is returned to be bound with the first page
+static bool create_sparse_image(VkDevice device, VkPhysicalDevice physical_device, VirtualTexture &vt,
+		VkSparseMemoryBind &mip_tail_bind)
+{
+	const uint32_t size = vt.params.pages_wide * vt.params.page_size;
+	VkImageCreateInfo create_info = {};
+	create_info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+	create_info.flags = VK_IMAGE_CREATE_SPARSE_BINDING_BIT | VK_IMAGE_CREATE_SPARSE_RESIDENCY_BIT;
+	create_info.imageType = VK_IMAGE_TYPE_2D;
+	create_info.format = VK_FORMAT_R8G8B8A8_UNORM;
+	create_info.extent.width = size;
+	create_info.extent.height = size;
+	create_info.extent.depth = 1;
+	create_info.mipLevels = vt.num_mips;
+	create_info.arrayLayers = 1;
+	create_info.samples = VK_SAMPLE_COUNT_1_BIT;
+	create_info.tiling = VK_IMAGE_TILING_OPTIMAL;
+	create_info.usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+	create_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+	create_info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	CHECK_VULKAN(vkCreateImage(device, &create_info, nullptr, &vt.sparse_image));
+
+	uint32_t num_reqs = 0;
+	vkGetImageSparseMemoryRequirements(device, vt.sparse_image, &num_reqs, nullptr);
+	std::vector<VkSparseImageMemoryRequirements> sparse_reqs(num_reqs, VkSparseImageMemoryRequirements{});
+	vkGetImageSparseMemoryRequirements(device, vt.sparse_image, &num_reqs, sparse_reqs.data());
+	auto color_reqs = std::find_if(sparse_reqs.begin(), sparse_reqs.end(),
+		[](const VkSparseImageMemoryRequirements &r) {
+			return r.formatProperties.aspectMask & VK_IMAGE_ASPECT_COLOR_BIT;
+		});
+	if (color_reqs == sparse_reqs.end() || color_reqs->imageMipTailFirstLod + 1 < vt.num_mips) {
+		vkDestroyImage(device, vt.sparse_image, nullptr);
+		vt.sparse_image = VK_NULL_HANDLE;
+		return false;
+	}
+
+	VkMemoryRequirements mem_reqs = {};
+	vkGetImageMemoryRequirements(device, vt.sparse_image, &mem_reqs);
+	const VkDeviceSize page_bytes = vt.params.page_size * vt.params.page_size * 4;
+	vt.page_stride = (page_bytes + mem_reqs.alignment - 1) / mem_reqs.alignment * mem_reqs.alignment;
+
+	VkMemoryRequirements pool_reqs = mem_reqs;
+	pool_reqs.size = vt.page_stride * vt.slot_pages.size();
+	vt.page_memory = allocate_memory(device, physical_device, pool_reqs, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+	mip_tail_bind = VkSparseMemoryBind{};
+	if (color_reqs->imageMipTailFirstLod < vt.num_mips) {
+		VkMemoryRequirements tail_reqs = mem_reqs;
+		tail_reqs.size = color_reqs->imageMipTailSize;
+		vt.mip_tail_memory = allocate_memory(device, physical_device, tail_reqs,
+				VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+		mip_tail_bind.resourceOffset = color_reqs->imageMipTailOffset;
+		mip_tail_bind.size = color_reqs->imageMipTailSize;
+		mip_tail_bind.memory = vt.mip_tail_memory;
+	}
+
+	vt.sparse_view = create_image_view(device, vt.sparse_image, VK_IMAGE_VIEW_TYPE_2D, VK_FORMAT_R8G8B8A8_UNORM,
+			VK_IMAGE_ASPECT_COLOR_BIT, 0, 1);
+	return true;
+}
+
+VirtualTexture create_virtual_texture(VkDevice device, VkPhysicalDevice physical_device, VkQueue queue,
+		VkCommandPool command_pool, const VirtualTextureParams &params, uint32_t num_frames, bool use_sparse,
+		VirtualPageSource source)
+{
+	VirtualTexture vt;
+	vt.params = params;
+	while ((1u << vt.num_mips) <= params.pages_wide) {
+		++vt.num_mips;
+	}
+	const uint32_t num_slots = params.atlas_pages_wide * params.atlas_pages_wide;
+	const VkDeviceSize page_bytes = params.page_size * params.page_size * 4;
+	vt.slot_pages.resize(num_slots, no_page);
+	vt.slot_last_used.resize(num_slots, 0);
+	vt.indirection_table.resize(indirection_mip_offset(vt, vt.num_mips), 0);
+
+	VkSparseMemoryBind mip_tail_bind = {};
+	if (use_sparse) {
+		vt.sparse = create_sparse_image(device, physical_device, vt, mip_tail_bind);
+		if (!vt.sparse) {
+			std::cout << "Virtual texture: the sparse image's mip tail is too large, using an atlas\n";
+		}
+	}
+	if (!vt.sparse) {
+		const uint32_t atlas_size = params.atlas_pages_wide * params.page_size;
+		vt.atlas = create_image(device, physical_device, VkExtent2D{ atlas_size, atlas_size }, 1,
+				VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT,
+				VK_IMAGE_ASPECT_COLOR_BIT);
+	}
+	vt.indirection = create_image(device, physical_device, VkExtent2D{ params.pages_wide, params.pages_wide }, 1,
+			VK_FORMAT_R8G8B8A8_UINT, VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT,
+			VK_IMAGE_ASPECT_COLOR_BIT, VK_SAMPLE_COUNT_1_BIT, vt.num_mips);
+
+	{
+		VkSamplerCreateInfo info = {};
+		info.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+		info.magFilter = VK_FILTER_NEAREST;
+		info.minFilter = VK_FILTER_NEAREST;
+		info.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+		info.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		info.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		info.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		info.maxLod = float(vt.num_mips);
+		vt.indirection_sampler = get_sampler(device, info);
+
+		// The mip is chosen in the shader from the resident pages, so mips aren't blended
+		info.magFilter = VK_FILTER_LINEAR;
+		info.minFilter = VK_FILTER_LINEAR;
+		vt.page_sampler = get_sampler(device, info);
+	}
+
+	const VkDeviceSize staging_size = params.max_uploads_per_frame * page_bytes
+		+ vt.indirection_table.size() * sizeof(uint32_t);
+	vt.frames.resize(num_frames);
+	for (auto &f : vt.frames) {
+		f.staging = create_buffer(device, physical_device, staging_size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+		void *mapping = nullptr;
+		CHECK_VULKAN(vkMapMemory(device, f.staging.mem, 0, VK_WHOLE_SIZE, 0, &mapping));
+		f.staging_data = reinterpret_cast<uint8_t*>(mapping);
+
+		VkSemaphoreCreateInfo semaphore_info = {};
+		semaphore_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+		CHECK_VULKAN(vkCreateSemaphore(device, &semaphore_info, nullptr, &f.bind_semaphore));
+	}
+
+	// The coarsest page covers the whole texture, so every page falls back to it. It's in the
+	// mip tail if the sparse image has one, otherwise it takes the first slot
+	const VirtualPage top = unpack_page(pack_page(0, 0, vt.num_mips - 1));
+	const uint32_t top_slot = mip_tail_bind.memory != VK_NULL_HANDLE ? mip_tail_slot : 0;
+	vt.resident[pack_page(top.x, top.y, top.mip)] = top_slot;
+	if (top_slot != mip_tail_slot) {
+		vt.slot_pages[top_slot] = pack_page(top.x, top.y, top.mip);
+		vt.slot_last_used[top_slot] = pinned;
+	}
+	if (vt.sparse) {
+		VkSparseImageOpaqueMemoryBindInfo opaque_info = {};
+		opaque_info.image = vt.sparse_image;
+		opaque_info.bindCount = 1;
+		opaque_info.pBinds = &mip_tail_bind;
+
+		const VkSparseImageMemoryBind bind = page_bind(vt, top, top_slot);
+		VkSparseImageMemoryBindInfo image_info = {};
+		image_info.image = vt.sparse_image;
+		image_info.bindCount = 1;
+		image_info.pBinds = &bind;
+
+		VkBindSparseInfo bind_info = {};
+		bind_info.sType = VK_STRUCTURE_TYPE_BIND_SPARSE_INFO;
+		if (top_slot == mip_tail_slot) {
+			bind_info.imageOpaqueBindCount = 1;
+			bind_info.pImageOpaqueBinds = &opaque_info;
+		} else {
+			bind_info.imageBindCount = 1;
+			bind_info.pImageBinds = &image_info;
+		}
+
+		VkFenceCreateInfo fence_info = {};
+		fence_info.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+		VkFence fence = VK_NULL_HANDLE;
+		CHECK_VULKAN(vkCreateFence(device, &fence_info, nullptr, &fence));
+		CHECK_VULKAN(vkQueueBindSparse(queue, 1, &bind_info, fence));
+		CHECK_VULKAN(vkWaitForFences(device, 1, &fence, VK_TRUE, std::numeric_limits<uint64_t>::max()));
+		vkDestroyFence(device, fence, nullptr);
+	}
+
+	{
+		VirtualTextureFrame &f = vt.frames[0];
+		source(top, params, f.staging_data);
+		build_indirection_table(vt);
+		std::memcpy(f.staging_data + page_bytes, vt.indirection_table.data(),
+				vt.indirection_table.size() * sizeof(uint32_t));
+		vt.indirection_dirty = false;
+
+		VkCommandBuffer cmd_buf = begin_one_time_commands(device, command_pool);
+		image_barrier(cmd_buf, page_image(vt), VK_IMAGE_ASPECT_COLOR_BIT,
+				VK_IMAGE_LAYOUT_UNDEFINED, page_upload_layout(vt),
+				0, VK_ACCESS_TRANSFER_WRITE_BIT,
+				VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+		const VkBufferImageCopy copy = page_copy(vt, top, top_slot, 0);
+		vkCmdCopyBufferToImage(cmd_buf, f.staging.buffer, page_image(vt), page_upload_layout(vt), 1, &copy);
+		image_barrier(cmd_buf, page_image(vt), VK_IMAGE_ASPECT_COLOR_BIT,
+				page_upload_layout(vt), page_image_layout(vt),
+				VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT,
+				VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+		record_indirection_upload(vt, cmd_buf, f.staging.buffer, page_bytes);
+		end_one_time_commands(device, queue, command_pool, cmd_buf);
+	}
+
+	vt.streamer = std::make_shared<PageStreamer>();
+	vt.streamer->source = source;
+	vt.streamer->params = params;
+	PageStreamer *streamer = vt.streamer.get();
+	vt.streamer->thread = std::thread([streamer]() { stream_pages(*streamer); });
+
+	{
+		std::array<VkDescriptorSetLayoutBinding, 2> bindings = {};
+		for (uint32_t i = 0; i < bindings.size(); ++i) {
+			bindings[i].binding = i;
+			bindings[i].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+			bindings[i].descriptorCount = 1;
+			bindings[i].stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+		}
+		VkDescriptorSetLayoutCreateInfo info = {};
+		info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+		info.bindingCount = bindings.size();
+		info.pBindings = bindings.data();
+		CHECK_VULKAN(vkCreateDescriptorSetLayout(device, &info, nullptr, &vt.desc_layout));
+	}
+	{
+		VkDescriptorPoolSize pool_size = {};
+		pool_size.type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+		pool_size.descriptorCount = 2;
+
+		VkDescriptorPoolCreateInfo info = {};
+		info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+		info.maxSets = 1;
+		info.poolSizeCount = 1;
+		info.pPoolSizes = &pool_size;
+		CHECK_VULKAN(vkCreateDescriptorPool(device, &info, nullptr, &vt.desc_pool));
+
+		VkDescriptorSetAllocateInfo alloc_info = {};
+		alloc_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+		alloc_info.descriptorPool = vt.desc_pool;
+		alloc_info.descriptorSetCount = 1;
+		alloc_info.pSetLayouts = &vt.desc_layout;
+		CHECK_VULKAN(vkAllocateDescriptorSets(device, &alloc_info, &vt.desc_set));
+
+		std::array<VkDescriptorImageInfo, 2> img_infos = {};
+		img_infos[0].sampler = vt.indirection_sampler;
+		img_infos[0].imageView = vt.indirection.view;
+		img_infos[0].imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		img_infos[1].sampler = vt.page_sampler;
+		img_infos[1].imageView = vt.sparse ? vt.sparse_view : vt.atlas.view;
+		img_infos[1].imageLayout = page_image_layout(vt);
+
+		std::array<VkWriteDescriptorSet, 2> writes = {};
+		for (uint32_t i = 0; i < writes.size(); ++i) {
+			writes[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+			writes[i].dstSet = vt.desc_set;
+			writes[i].dstBinding = i;
+			writes[i].descriptorCount = 1;
+			writes[i].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+			writes[i].pImageInfo = &img_infos[i];
+		}
+		vkUpdateDescriptorSets(device, writes.size(), writes.data(), 0, nullptr);
+	}
+	{
+		VkPushConstantRange push_range = {};
+		push_range.stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
+		push_range.size = sizeof(VirtualTexturePushParams);
+
+		VkPipelineLayoutCreateInfo info = {};
+		info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+		info.setLayoutCount = 1;
+		info.pSetLayouts = &vt.desc_layout;
+		info.pushConstantRangeCount = 1;
+		info.pPushConstantRanges = &push_range;
+		CHECK_VULKAN(vkCreatePipelineLayout(device, &info, nullptr, &vt.pipeline_layout));
+	}
+
+	// The feedback is cleared to no page, rendered and copied out each frame
+	{
+		VkAttachmentDescription attachment = {};
+		attachment.format = VK_FORMAT_R32_UINT;
+		attachment.samples = VK_SAMPLE_COUNT_1_BIT;
+		attachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+		attachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+		attachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+		attachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+		attachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		attachment.finalLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+
+		VkAttachmentReference attachment_ref = {};
+		attachment_ref.attachment = 0;
+		attachment_ref.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+		VkSubpassDescription subpass = {};
+		subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+		subpass.colorAttachmentCount = 1;
+		subpass.pColorAttachments = &attachment_ref;
+
+		// Wait for the previous frame's copy of the feedback before overwriting it, and
+		// finish writing it before this frame's copy
+		std::array<VkSubpassDependency, 2> dependencies = {};
+		dependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
+		dependencies[0].dstSubpass = 0;
+		dependencies[0].srcStageMask = VK_PIPELINE_STAGE_TRANSFER_BIT;
+		dependencies[0].dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+		dependencies[0].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+		dependencies[1].srcSubpass = 0;
+		dependencies[1].dstSubpass = VK_SUBPASS_EXTERNAL;
+		dependencies[1].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+		dependencies[1].dstStageMask = VK_PIPELINE_STAGE_TRANSFER_BIT;
+		dependencies[1].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+		dependencies[1].dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+
+		VkRenderPassCreateInfo info = {};
+		info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+		info.attachmentCount = 1;
+		info.pAttachments = &attachment;
+		info.subpassCount = 1;
+		info.pSubpasses = &subpass;
+		info.dependencyCount = dependencies.size();
+		info.pDependencies = dependencies.data();
+		CHECK_VULKAN(vkCreateRenderPass(device, &info, nullptr, &vt.feedback_pass));
+	}
+
+	std::cout << "Virtual texture: " << params.pages_wide * params.page_size << "^2 texels in "
+		<< params.page_size << "^2 pages, " << vt.num_mips << " mips, " << num_slots << " resident pages in "
+		<< (vt.sparse ? "a sparse image" : "an atlas") << "\n";
+	return vt;
+}
+
+static VkPipeline create_virtual_texture_pipeline(VkDevice device, VkPipelineLayout layout,
+		VkRenderPass render_pass, VkSampleCountFlagBits samples, VkExtent2D extent,
+		VkShaderModule vertex_shader_module, VkShaderModule fragment_shader_module)
+{
+	VkPipelineShaderStageCreateInfo vertex_stage = {};
+	vertex_stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	vertex_stage.stage = VK_SHADER_STAGE_VERTEX_BIT;
+	vertex_stage.module = vertex_shader_module;
+	vertex_stage.pName = "main";
+
+	VkPipelineShaderStageCreateInfo fragment_stage = {};
+	fragment_stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	fragment_stage.stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+	fragment_stage.module = fragment_shader_module;
+	fragment_stage.pName = "main";
+
+	std::array<VkPipelineShaderStageCreateInfo, 2> shader_stages = { vertex_stage, fragment_stage };
+
+	// The terrain square is expanded from the vertex index, no vertex buffers
+	VkPipelineVertexInputStateCreateInfo vertex_input_info = {};
+	vertex_input_info.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+
+	VkPipelineInputAssemblyStateCreateInfo input_assembly = {};
+	input_assembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+	input_assembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+	input_assembly.primitiveRestartEnable = VK_FALSE;
+
+	VkViewport viewport = {};
+	viewport.x = 0.0f;
+	viewport.y = 0.0f;
+	viewport.width = extent.width;
+	viewport.height = extent.height;
+	viewport.minDepth = 0.0f;
+	viewport.maxDepth = 1.0f;
+
+	VkRect2D scissor = {};
+	scissor.extent = extent;
+
+	VkPipelineViewportStateCreateInfo viewport_state_info = {};
+	viewport_state_info.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+	viewport_state_info.viewportCount = 1;
+	viewport_state_info.pViewports = &viewport;
+	viewport_state_info.scissorCount = 1;
+	viewport_state_info.pScissors = &scissor;
+
+	VkPipelineRasterizationStateCreateInfo rasterizer_info = {};
+	rasterizer_info.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+	rasterizer_info.depthClampEnable = VK_FALSE;
+	rasterizer_info.rasterizerDiscardEnable = VK_FALSE;
+	rasterizer_info.polygonMode = VK_POLYGON_MODE_FILL;
+	rasterizer_info.lineWidth = 1.f;
+	rasterizer_info.cullMode = VK_CULL_MODE_NONE;
+	rasterizer_info.frontFace = VK_FRONT_FACE_CLOCKWISE;
+	rasterizer_info.depthBiasEnable = VK_FALSE;
+
+	VkPipelineMultisampleStateCreateInfo multisampling = {};
+	multisampling.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+	multisampling.sampleShadingEnable = VK_FALSE;
+	multisampling.rasterizationSamples = samples;
+
+	VkPipelineColorBlendAttachmentState blend_mode = {};
+	blend_mode.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+	blend_mode.blendEnable = VK_FALSE;
+
+	VkPipelineColorBlendStateCreateInfo blend_info = {};
+	blend_info.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+	blend_info.logicOpEnable = VK_FALSE;
+	blend_info.attachmentCount = 1;
+	blend_info.pAttachments = &blend_mode;
+
+	VkGraphicsPipelineCreateInfo graphics_pipeline_info = {};
+	graphics_pipeline_info.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+	graphics_pipeline_info.stageCount = shader_stages.size();
+	graphics_pipeline_info.pStages = shader_stages.data();
+	graphics_pipeline_info.pVertexInputState = &vertex_input_info;
+	graphics_pipeline_info.pInputAssemblyState = &input_assembly;
+	graphics_pipeline_info.pViewportState = &viewport_state_info;
+	graphics_pipeline_info.pRasterizationState = &rasterizer_info;
+	graphics_pipeline_info.pMultisampleState = &multisampling;
+	graphics_pipeline_info.pColorBlendState = &blend_info;
+	graphics_pipeline_info.layout = layout;
+	graphics_pipeline_info.renderPass = render_pass;
+	graphics_pipeline_info.subpass = 0;
+	VkPipeline pipeline = VK_NULL_HANDLE;
+	CHECK_VULKAN(vkCreateGraphicsPipelines(device, pipeline_cache(), 1, &graphics_pipeline_info, nullptr, &pipeline));
+	return pipeline;
+}
+
+static void destroy_feedback_target(VkDevice device, VirtualTexture &vt) {
+	if (vt.feedback_framebuffer == VK_NULL_HANDLE) {
+		return;
+	}
+	vkDestroyFramebuffer(device, vt.feedback_framebuffer, nullptr);
+	destroy_image(device, vt.feedback_target);
+	for (auto &f : vt.frames) {
+		destroy_buffer(device, f.feedback_readback);
+		f.feedback_data = nullptr;
+		f.feedback_written = false;
+	}
+	vt.feedback_framebuffer = VK_NULL_HANDLE;
+}
+
+void create_virtual_texture_pipelines(VkDevice device, VkPhysicalDevice physical_device, VirtualTexture &vt,
+		VkRenderPass render_pass, VkSampleCountFlagBits samples, VkExtent2D extent)
+{
+	destroy_feedback_target(device, vt);
+	vkDestroyPipeline(device, vt.feedback_pipeline, nullptr);
+	vkDestroyPipeline(device, vt.draw_pipeline, nullptr);
+
+	vt.feedback_extent.width = std::max(extent.width / vt.params.feedback_scale, 1u);
+	vt.feedback_extent.height = std::max(extent.height / vt.params.feedback_scale, 1u);
+	vt.feedback_target = create_image(device, physical_device, vt.feedback_extent, 1, VK_FORMAT_R32_UINT,
+			VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT, VK_IMAGE_ASPECT_COLOR_BIT);
+	{
+		VkFramebufferCreateInfo info = {};
+		info.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+		info.renderPass = vt.feedback_pass;
+		info.attachmentCount = 1;
+		info.pAttachments = &vt.feedback_target.view;
+		info.width = vt.feedback_extent.width;
+		info.height = vt.feedback_extent.height;
+		info.layers = 1;
+		CHECK_VULKAN(vkCreateFramebuffer(device, &info, nullptr, &vt.feedback_framebuffer));
+	}
+	const VkDeviceSize feedback_bytes = vt.feedback_extent.width * vt.feedback_extent.height * sizeof(uint32_t);
+	for (auto &f : vt.frames) {
+		f.feedback_readback = create_buffer(device, physical_device, feedback_bytes,
+				VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+		void *mapping = nullptr;
+		CHECK_VULKAN(vkMapMemory(device, f.feedback_readback.mem, 0, VK_WHOLE_SIZE, 0, &mapping));
+		f.feedback_data = reinterpret_cast<const uint32_t*>(mapping);
+	}
+
+	VkShaderModule vertex_shader_module = create_shader_module(device, vt_terrain_spv, sizeof(vt_terrain_spv));
+	VkShaderModule feedback_module = create_shader_module(device, vt_feedback_spv, sizeof(vt_feedback_spv));
+	VkShaderModule terrain_module = vt.sparse
+		? create_shader_module(device, vt_terrain_sparse_spv, sizeof(vt_terrain_sparse_spv))
+		: create_shader_module(device, vt_terrain_atlas_spv, sizeof(vt_terrain_atlas_spv));
+	vt.feedback_pipeline = create_virtual_texture_pipeline(device, vt.pipeline_layout, vt.feedback_pass,
+			VK_SAMPLE_COUNT_1_BIT, vt.feedback_extent, vertex_shader_module, feedback_module);
+	vt.draw_pipeline = create_virtual_texture_pipeline(device, vt.pipeline_layout, render_pass, samples, extent,
+			vertex_shader_module, terrain_module);
+	vkDestroyShaderModule(device, vertex_shader_module, nullptr);
+	vkDestroyShaderModule(device, feedback_module, nullptr);
+	vkDestroyShaderModule(device, terrain_module, nullptr);
+}
+
+VkSemaphore update_virtual_texture(VirtualTexture &vt, SubmitScheduler &scheduler, VkCommandBuffer cmd_buf,
+		uint32_t frame)
+{
+	VirtualTextureFrame &f = vt.frames[frame];
+	++vt.frame_number;
+
+	// Mark the pages the frame drew with as used and request the missing ones, coarsest first
+	// so the fallbacks improve quickly. The parents are requested too so moving away from a
+	// page has something closer to fall back to
+	if (f.feedback_written) {
+		std::vector<uint32_t> pages(f.feedback_data,
+				f.feedback_data + vt.feedback_extent.width * vt.feedback_extent.height);
+		std::sort(pages.begin(), pages.end());
+		pages.erase(std::unique(pages.begin(), pages.end()), pages.end());
+
+		std::vector<uint32_t> missing;
+		for (const uint32_t id : pages) {
+			VirtualPage page = unpack_page(id);
+			if (id == no_page || page.mip >= vt.num_mips || page.x >= (vt.params.pages_wide >> page.mip)
+					|| page.y >= (vt.params.pages_wide >> page.mip))
+			{
+				continue;
+			}
+			const uint32_t pages_wide = vt.params.pages_wide >> page.mip;
+			const uint32_t entry = vt.indirection_table[indirection_mip_offset(vt, page.mip)
+				+ page.y * pages_wide + page.x];
+			const uint32_t slot = (entry & 0xff) + ((entry >> 8) & 0xff) * vt.params.atlas_pages_wide;
+			if ((entry & 0xff) != 0xff && slot < vt.slot_last_used.size() && vt.slot_last_used[slot] != pinned) {
+				vt.slot_last_used[slot] = vt.frame_number;
+			}
+
+			while (page.mip < vt.num_mips) {
+				const uint32_t page_id = pack_page(page.x, page.y, page.mip);
+				if (vt.resident.count(page_id) || vt.pending.count(page_id)) {
+					break;
+				}
+				vt.pending.insert(page_id);
+				missing.push_back(page_id);
+				page.x /= 2;
+				page.y /= 2;
+				++page.mip;
+			}
+		}
+		std::sort(missing.begin(), missing.end(), [](uint32_t a, uint32_t b) { return (a >> 28) > (b >> 28); });
+		if (!missing.empty()) {
+			std::lock_guard<std::mutex> lock(vt.streamer->mutex);
+			vt.streamer->requests.insert(vt.streamer->requests.end(), missing.begin(), missing.end());
+			vt.streamer->cv.notify_one();
+		}
+		vt.stats.pages_requested += missing.size();
+		f.feedback_written = false;
+	}
+
+	std::vector<std::pair<uint32_t, std::vector<uint8_t>>> streamed;
+	{
+		std::lock_guard<std::mutex> lock(vt.streamer->mutex);
+		while (!vt.streamer->done.empty() && streamed.size() < vt.params.max_uploads_per_frame) {
+			streamed.push_back(std::move(vt.streamer->done.front()));
+			vt.streamer->done.pop_front();
+		}
+	}
+
+	const VkDeviceSize page_bytes = vt.params.page_size * vt.params.page_size * 4;
+	std::vector<VkBufferImageCopy> copies;
+	std::vector<VkSparseImageMemoryBind> binds;
+	for (size_t i = 0; i < streamed.size(); ++i) {
+		const uint32_t slot = find_page_slot(vt);
+		if (slot == vt.slot_pages.size()) {
+			// Every slot is in use, try again next frame
+			std::lock_guard<std::mutex> lock(vt.streamer->mutex);
+			for (size_t j = streamed.size(); j-- > i;) {
+				vt.streamer->done.push_front(std::move(streamed[j]));
+			}
+			break;
+		}
+		if (vt.slot_pages[slot] != no_page) {
+			vt.resident.erase(vt.slot_pages[slot]);
+			++vt.stats.pages_evicted;
+		}
+		const uint32_t id = streamed[i].first;
+		vt.slot_pages[slot] = id;
+		vt.slot_last_used[slot] = vt.frame_number;
+		vt.resident[id] = slot;
+		vt.pending.erase(id);
+
+		const VkDeviceSize offset = copies.size() * page_bytes;
+		std::memcpy(f.staging_data + offset, streamed[i].second.data(), page_bytes);
+		copies.push_back(page_copy(vt, unpack_page(id), slot, offset));
+		if (vt.sparse) {
+			// The slot's memory may still be bound to the evicted page as well, which is never
+			// sampled again since the indirection no longer points to it
+			binds.push_back(page_bind(vt, unpack_page(id), slot));
+		}
+		++vt.stats.pages_uploaded;
+		vt.indirection_dirty = true;
+	}
+
+	VkSemaphore wait_semaphore = VK_NULL_HANDLE;
+	if (!binds.empty()) {
+		SparseBindBatch batch;
+		batch.image = vt.sparse_image;
+		batch.binds = std::move(binds);
+		batch.signals.push_back(f.bind_semaphore);
+		schedule_sparse_bind(scheduler, batch);
+		wait_semaphore = f.bind_semaphore;
+	}
+
+	if (!copies.empty()) {
+		image_barrier(cmd_buf, page_image(vt), VK_IMAGE_ASPECT_COLOR_BIT,
+				page_image_layout(vt), page_upload_layout(vt),
+				VK_ACCESS_SHADER_READ_BIT, VK_ACCESS_TRANSFER_WRITE_BIT,
+				VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+		vkCmdCopyBufferToImage(cmd_buf, f.staging.buffer, page_image(vt), page_upload_layout(vt),
+				copies.size(), copies.data());
+		image_barrier(cmd_buf, page_image(vt), VK_IMAGE_ASPECT_COLOR_BIT,
+				page_upload_layout(vt), page_image_layout(vt),
+				VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT,
+				VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+	}
+
+	if (vt.indirection_dirty) {
+		build_indirection_table(vt);
+		const VkDeviceSize offset = vt.params.max_uploads_per_frame * page_bytes;
+		std::memcpy(f.staging_data + offset, vt.indirection_table.data(),
+				vt.indirection_table.size() * sizeof(uint32_t));
+		record_indirection_upload(vt, cmd_buf, f.staging.buffer, offset);
+		vt.indirection_dirty = false;
+	}
+	return wait_semaphore;
+}
+
+void record_virtual_texture_feedback(VirtualTexture &vt, VkCommandBuffer cmd_buf, uint32_t frame,
+		const Camera &camera)
+{
+	VirtualTextureFrame &f = vt.frames[frame];
+
+	VkRenderPassBeginInfo render_pass_info = {};
+	render_pass_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+	render_pass_info.renderPass = vt.feedback_pass;
+	render_pass_info.framebuffer = vt.feedback_framebuffer;
+	render_pass_info.renderArea.extent = vt.feedback_extent;
+	VkClearValue clear_value = {};
+	clear_value.color.uint32[0] = no_page;
+	render_pass_info.clearValueCount = 1;
+	render_pass_info.pClearValues = &clear_value;
+	vkCmdBeginRenderPass(cmd_buf, &render_pass_info, VK_SUBPASS_CONTENTS_INLINE);
+
+	const VirtualTexturePushParams push = virtual_texture_push_params(vt, camera,
+			-std::log2(float(vt.params.feedback_scale)));
+	vkCmdBindPipeline(cmd_buf, VK_PIPELINE_BIND_POINT_GRAPHICS, vt.feedback_pipeline);
+	vkCmdPushConstants(cmd_buf, vt.pipeline_layout, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT,
+			0, sizeof(push), &push);
+	vkCmdDraw(cmd_buf, 6, 1, 0, 0);
+	vkCmdEndRenderPass(cmd_buf);
+
+	VkBufferImageCopy copy = {};
+	copy.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	copy.imageSubresource.layerCount = 1;
+	copy.imageExtent.width = vt.feedback_extent.width;
+	copy.imageExtent.height = vt.feedback_extent.height;
+	copy.imageExtent.depth = 1;
+	vkCmdCopyImageToBuffer(cmd_buf, vt.feedback_target.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+			f.feedback_readback.buffer, 1, &copy);
+
+	VkMemoryBarrier barrier = {};
+	barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+	vkCmdPipelineBarrier(cmd_buf, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0,
+			1, &barrier, 0, nullptr, 0, nullptr);
+	f.feedback_written = true;
+}
+
+void draw_virtual_texture(const VirtualTexture &vt, VkCommandBuffer cmd_buf, const Camera &camera) {
+	const VirtualTexturePushParams push = virtual_texture_push_params(vt, camera, 0.f);
+	vkCmdBindPipeline(cmd_buf, VK_PIPELINE_BIND_POINT_GRAPHICS, vt.draw_pipeline);
+	vkCmdBindDescriptorSets(cmd_buf, VK_PIPELINE_BIND_POINT_GRAPHICS, vt.pipeline_layout, 0, 1,
+			&vt.desc_set, 0, nullptr);
+	vkCmdPushConstants(cmd_buf, vt.pipeline_layout, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT,
+			0, sizeof(push), &push);
+	vkCmdDraw(cmd_buf, 6, 1, 0, 0);
+}
+
+void destroy_virtual_texture(VkDevice device, VirtualTexture &vt) {
+	if (vt.streamer) {
+		{
+			std::lock_guard<std::mutex> lock(vt.streamer->mutex);
+			vt.streamer->quit = true;
+			vt.streamer->cv.notify_one();
+		}
+		vt.streamer->thread.join();
+	}
+
+	destroy_feedback_target(device, vt);
+	vkDestroyPipeline(device, vt.feedback_pipeline, nullptr);
+	vkDestroyPipeline(device, vt.draw_pipeline, nullptr);
+	vkDestroyPipelineLayout(device, vt.pipeline_layout, nullptr);
+	vkDestroyRenderPass(device, vt.feedback_pass, nullptr);
+	vkDestroyDescriptorPool(device, vt.desc_pool, nullptr);
+	vkDestroyDescriptorSetLayout(device, vt.desc_layout, nullptr);
+	for (auto &f : vt.frames) {
+		destroy_buffer(device, f.staging);
+		vkDestroySemaphore(device, f.bind_semaphore, nullptr);
+	}
+	destroy_image(device, vt.indirection);
+	if (vt.sparse) {
+		release_image_views(device, vt.sparse_image);
+		vkDestroyImage(device, vt.sparse_image, nullptr);
+		free_memory(device, vt.page_memory);
+		if (vt.mip_tail_memory != VK_NULL_HANDLE) {
+			free_memory(device, vt.mip_tail_memory);
+		}
+	} else {
+		destroy_image(device, vt.atlas);
+	}
+	vt = VirtualTexture();
+}
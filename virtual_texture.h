@@ -0,0 +1,150 @@
+#pragma once
+
+#include <functional>
+#include <memory>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include <vulkan/vulkan.h>
+#include "camera.h"
+#include "submit_scheduler.h"
+#include "vulkan_utils.h"
+
+// A virtual texture far larger than could be resident, split into square pages at each mip
+// level and streamed in on demand. A low resolution feedback pass writes the page each pixel
+// of the terrain needs, the CPU reads it back a few frames later, requests the missing pages
+// from a streaming thread and uploads the finished ones. The indirection texture maps every
+// page at every mip to the closest resident page covering it, so pages which aren't resident
+// yet fall back to a coarser one.
+//
+// Resident pages are either copied into slots of a physical atlas texture, or with sparse
+// residency bound to the slots of a memory pool in a sparse image the size of the virtual
+// texture, which filters across neighboring resident pages without seams.
+
+struct VirtualTextureParams {
+	// Texels per page side, a power of two. With sparse residency it must match the device's
+	// sparse block size for the format, 128 for RGBA8 with the standard block shapes
+	uint32_t page_size = 128;
+	// Pages per side of the full resolution mip, a power of two. The mip chain stops at one page
+	uint32_t pages_wide = 256;
+	// Pages per side of the physical atlas or sparse memory pool
+	uint32_t atlas_pages_wide = 32;
+	uint32_t max_uploads_per_frame = 16;
+	// The feedback is rendered at 1/feedback_scale of the resolution
+	uint32_t feedback_scale = 8;
+	// The terrain is a square in the xz plane
+	float plane_half_size = 256.f;
+	float plane_height = -1.f;
+};
+
+struct VirtualPage {
+	uint32_t x = 0;
+	uint32_t y = 0;
+	uint32_t mip = 0;
+};
+
+// Fill the page's page_size * page_size RGBA8 texels. Called from the streaming thread
+using VirtualPageSource = std::function<void(const VirtualPage &page, const VirtualTextureParams &params,
+		uint8_t *rgba)>;
+
+// Procedural terrain colored by height, standing in for terrain and map data read from disk
+void generate_terrain_page(const VirtualPage &page, const VirtualTextureParams &params, uint8_t *rgba);
+
+struct VirtualTextureStats {
+	uint64_t pages_requested = 0;
+	uint64_t pages_uploaded = 0;
+	uint64_t pages_evicted = 0;
+};
+
+struct PageStreamer;
+
+struct VirtualTextureFrame {
+	// Page data and the indirection table uploaded by the frame
+	Buffer staging;
+	uint8_t *staging_data = nullptr;
+	// The frame's feedback, read back when the frame is reused
+	Buffer feedback_readback;
+	const uint32_t *feedback_data = nullptr;
+	bool feedback_written = false;
+	// Signaled by the frame's sparse binds, which its uploads wait on
+	VkSemaphore bind_semaphore = VK_NULL_HANDLE;
+};
+
+struct VirtualTexture {
+	VirtualTextureParams params;
+	uint32_t num_mips = 0;
+	bool sparse = false;
+
+	// The atlas, or the sparse image with its pool of page memory and the mip tail
+	Image atlas;
+	VkImage sparse_image = VK_NULL_HANDLE;
+	VkImageView sparse_view = VK_NULL_HANDLE;
+	VkDeviceMemory page_memory = VK_NULL_HANDLE;
+	VkDeviceMemory mip_tail_memory = VK_NULL_HANDLE;
+	VkDeviceSize page_stride = 0;
+
+	// RGBA8 uint with a mip level per page mip: the resident page's slot x and y and its mip
+	Image indirection;
+	VkSampler indirection_sampler = VK_NULL_HANDLE;
+	VkSampler page_sampler = VK_NULL_HANDLE;
+
+	// Packed page to its slot, and each slot's page and the frame it was last used
+	std::unordered_map<uint32_t, uint32_t> resident;
+	std::vector<uint32_t> slot_pages;
+	std::vector<uint64_t> slot_last_used;
+	// Requested and not uploaded yet
+	std::unordered_set<uint32_t> pending;
+	// The indirection table for all mips, from the full resolution mip down
+	std::vector<uint32_t> indirection_table;
+	bool indirection_dirty = true;
+	std::shared_ptr<PageStreamer> streamer;
+	uint64_t frame_number = 0;
+	VirtualTextureStats stats;
+
+	std::vector<VirtualTextureFrame> frames;
+
+	// The feedback pass, sized for the swapchain
+	VkExtent2D feedback_extent = {};
+	Image feedback_target;
+	VkRenderPass feedback_pass = VK_NULL_HANDLE;
+	VkFramebuffer feedback_framebuffer = VK_NULL_HANDLE;
+
+	VkDescriptorSetLayout desc_layout = VK_NULL_HANDLE;
+	VkDescriptorPool desc_pool = VK_NULL_HANDLE;
+	VkDescriptorSet desc_set = VK_NULL_HANDLE;
+	VkPipelineLayout pipeline_layout = VK_NULL_HANDLE;
+	VkPipeline feedback_pipeline = VK_NULL_HANDLE;
+	VkPipeline draw_pipeline = VK_NULL_HANDLE;
+};
+
+// Whether the device supports sparse residency for the virtual texture on the queue family.
+// The device must then be created with the sparseBinding and sparseResidencyImage2D features
+bool virtual_texture_sparse_supported(VkPhysicalDevice physical_device, uint32_t queue_family,
+		const VirtualTextureParams &params);
+
+// Falls back to the atlas if the sparse image's mip tail would cover more than the last mip.
+// The coarsest page is made resident before returning and is never evicted
+VirtualTexture create_virtual_texture(VkDevice device, VkPhysicalDevice physical_device, VkQueue queue,
+		VkCommandPool command_pool, const VirtualTextureParams &params, uint32_t num_frames, bool use_sparse,
+		VirtualPageSource source = generate_terrain_page);
+
+// (Re)create the feedback pass for the extent and the terrain pipeline for the render pass
+void create_virtual_texture_pipelines(VkDevice device, VkPhysicalDevice physical_device, VirtualTexture &vt,
+		VkRenderPass render_pass, VkSampleCountFlagBits samples, VkExtent2D extent);
+
+// Read the frame's previous feedback, request the missing pages and record the uploads of
+// streamed pages and the indirection table, outside a render pass. The sparse binds of the
+// streamed pages are scheduled on the scheduler, the frame's previous use must be finished.
+// Returns a semaphore the command buffer's batch must wait on at the transfer stage, or
+// VK_NULL_HANDLE if there were no sparse binds
+VkSemaphore update_virtual_texture(VirtualTexture &vt, SubmitScheduler &scheduler, VkCommandBuffer cmd_buf,
+		uint32_t frame);
+
+// Render the feedback and copy it for reading back, outside a render pass
+void record_virtual_texture_feedback(VirtualTexture &vt, VkCommandBuffer cmd_buf, uint32_t frame,
+		const Camera &camera);
+
+// Draw the textured terrain in the current render pass
+void draw_virtual_texture(const VirtualTexture &vt, VkCommandBuffer cmd_buf, const Camera &camera);
+
+void destroy_virtual_texture(VkDevice device, VirtualTexture &vt);
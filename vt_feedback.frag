@@ -0,0 +1,25 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+// Write the page needed at the pixel, packed as mip << 28 | y << 14 | x. The lod bias
+// corrects for the feedback's lower resolution
+layout(push_constant) uniform VirtualTextureParams {
+	mat4 view_proj;
+	vec4 plane;
+	vec4 vt_params;
+};
+
+layout(location = 0) in vec2 frag_uv;
+
+layout(location = 0) out uint page;
+
+void main() {
+	const vec2 texel = frag_uv * vt_params.x * vt_params.y;
+	const vec2 dx = dFdx(texel);
+	const vec2 dy = dFdy(texel);
+	const float lod = 0.5 * log2(max(dot(dx, dx), dot(dy, dy))) + vt_params.w;
+	const uint mip = uint(clamp(floor(lod), 0.0, plane.z));
+	const uint pages = uint(vt_params.x) >> mip;
+	const uvec2 p = min(uvec2(frag_uv * float(pages)), uvec2(pages - 1));
+	page = (mip << 28) | (p.y << 14) | p.x;
+}
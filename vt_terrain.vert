@@ -0,0 +1,29 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+// The virtual textured terrain square, expanded from 6 vertices
+layout(push_constant) uniform VirtualTextureParams {
+	mat4 view_proj;
+	// half size, height, last mip
+	vec4 plane;
+	// pages wide, page size, atlas pages wide, lod bias
+	vec4 vt_params;
+};
+
+layout(location = 0) out vec2 frag_uv;
+
+vec2 corners[6] = vec2[](
+	vec2(0.0, 0.0),
+	vec2(1.0, 0.0),
+	vec2(1.0, 1.0),
+	vec2(0.0, 0.0),
+	vec2(1.0, 1.0),
+	vec2(0.0, 1.0)
+);
+
+void main() {
+	const vec2 c = corners[gl_VertexIndex];
+	const vec2 xz = (c * 2.0 - 1.0) * plane.x;
+	gl_Position = view_proj * vec4(xz.x, plane.y, xz.y, 1.0);
+	frag_uv = c;
+}
@@ -0,0 +1,34 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+// Sample the virtual texture through the indirection texture, which gives the atlas slot of
+// the resident page covering the needed one. Pages have no borders so the lookup is kept
+// half a texel inside the page
+layout(set = 0, binding = 0) uniform usampler2D indirection;
+layout(set = 0, binding = 1) uniform sampler2D atlas;
+
+layout(push_constant) uniform VirtualTextureParams {
+	mat4 view_proj;
+	vec4 plane;
+	vec4 vt_params;
+};
+
+layout(location = 0) in vec2 frag_uv;
+
+layout(location = 0) out vec4 color;
+
+void main() {
+	const vec2 texel = frag_uv * vt_params.x * vt_params.y;
+	const vec2 dx = dFdx(texel);
+	const vec2 dy = dFdy(texel);
+	const float lod = 0.5 * log2(max(dot(dx, dx), dot(dy, dy))) + vt_params.w;
+	const uint mip = uint(clamp(floor(lod), 0.0, plane.z));
+	const uint pages = uint(vt_params.x) >> mip;
+	const ivec2 p = ivec2(min(uvec2(frag_uv * float(pages)), uvec2(pages - 1)));
+	const uvec4 entry = texelFetch(indirection, p, int(mip));
+
+	const float page_size = vt_params.y;
+	vec2 page_uv = fract(frag_uv * float(uint(vt_params.x) >> entry.z));
+	page_uv = clamp(page_uv, 0.5 / page_size, 1.0 - 0.5 / page_size);
+	color = textureLod(atlas, (vec2(entry.xy) + page_uv) / vt_params.z, 0.0);
+}
@@ -0,0 +1,159 @@
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <dlfcn.h>
+#endif
+#include <atomic>
+#include <iostream>
+#include "vulkan_dispatch.h"
+
+PFN_vkGetInstanceProcAddr vkGetInstanceProcAddr = nullptr;
+#define VULKAN_DEFINE_FUNCTION(name) PFN_##name name = nullptr;
+VULKAN_GLOBAL_FUNCTIONS(VULKAN_DEFINE_FUNCTION)
+VULKAN_INSTANCE_FUNCTIONS(VULKAN_DEFINE_FUNCTION)
+VULKAN_DEVICE_FUNCTIONS(VULKAN_DEFINE_FUNCTION)
+#undef VULKAN_DEFINE_FUNCTION
+
+enum CountedObject {
+#define VULKAN_COUNTED_INDEX(create, destroy, name) COUNTED_##create,
+	VULKAN_COUNTED_OBJECTS(VULKAN_COUNTED_INDEX)
+#undef VULKAN_COUNTED_INDEX
+	COUNTED_PIPELINES,
+	NUM_COUNTED_OBJECTS
+};
+
+// The loaded functions the counting ones call, and the live objects of each type. Objects can
+// be created and destroyed on any thread
+struct ObjectCounter {
+	PFN_vkVoidFunction create = nullptr;
+	PFN_vkVoidFunction destroy = nullptr;
+	std::atomic<int64_t> live{0};
+};
+
+static ObjectCounter counters[NUM_COUNTED_OBJECTS];
+static PFN_vkCreateGraphicsPipelines loaded_vkCreateGraphicsPipelines = nullptr;
+static PFN_vkCreateComputePipelines loaded_vkCreateComputePipelines = nullptr;
+
+// The create function's type is deduced from the pointer it's assigned to
+template<int type, typename... Args>
+static VKAPI_ATTR VkResult VKAPI_CALL counted_create(VkDevice device, Args... args) {
+	auto create = reinterpret_cast<VkResult (VKAPI_PTR *)(VkDevice, Args...)>(counters[type].create);
+	const VkResult result = create(device, args...);
+	if (result == VK_SUCCESS) {
+		++counters[type].live;
+	}
+	return result;
+}
+
+template<int type, typename T>
+static VKAPI_ATTR void VKAPI_CALL counted_destroy(VkDevice device, T object, const VkAllocationCallbacks *allocator) {
+	if (object != VK_NULL_HANDLE) {
+		--counters[type].live;
+	}
+	auto destroy = reinterpret_cast<void (VKAPI_PTR *)(VkDevice, T, const VkAllocationCallbacks*)>(
+			counters[type].destroy);
+	destroy(device, object, allocator);
+}
+
+// Failed creations leave their pipelines null
+static void count_pipelines(uint32_t count, const VkPipeline *pipelines) {
+	for (uint32_t i = 0; i < count; ++i) {
+		if (pipelines[i] != VK_NULL_HANDLE) {
+			++counters[COUNTED_PIPELINES].live;
+		}
+	}
+}
+
+static VKAPI_ATTR VkResult VKAPI_CALL counted_create_graphics_pipelines(VkDevice device, VkPipelineCache cache,
+		uint32_t count, const VkGraphicsPipelineCreateInfo *infos, const VkAllocationCallbacks *allocator,
+		VkPipeline *pipelines)
+{
+	const VkResult result = loaded_vkCreateGraphicsPipelines(device, cache, count, infos, allocator, pipelines);
+	count_pipelines(count, pipelines);
+	return result;
+}
+
+static VKAPI_ATTR VkResult VKAPI_CALL counted_create_compute_pipelines(VkDevice device, VkPipelineCache cache,
+		uint32_t count, const VkComputePipelineCreateInfo *infos, const VkAllocationCallbacks *allocator,
+		VkPipeline *pipelines)
+{
+	const VkResult result = loaded_vkCreateComputePipelines(device, cache, count, infos, allocator, pipelines);
+	count_pipelines(count, pipelines);
+	return result;
+}
+
+// Put the counting functions in front of the freshly loaded ones, the counts carry over from
+// the functions loaded before. Functions of extensions which aren't enabled stay null
+static void count_vulkan_objects() {
+#define VULKAN_COUNT_OBJECTS(create_fn, destroy_fn, name) \
+	if (create_fn && destroy_fn) { \
+		counters[COUNTED_##create_fn].create = reinterpret_cast<PFN_vkVoidFunction>(create_fn); \
+		counters[COUNTED_##create_fn].destroy = reinterpret_cast<PFN_vkVoidFunction>(destroy_fn); \
+		create_fn = counted_create<COUNTED_##create_fn>; \
+		destroy_fn = counted_destroy<COUNTED_##create_fn>; \
+	}
+	VULKAN_COUNTED_OBJECTS(VULKAN_COUNT_OBJECTS)
+#undef VULKAN_COUNT_OBJECTS
+	loaded_vkCreateGraphicsPipelines = vkCreateGraphicsPipelines;
+	loaded_vkCreateComputePipelines = vkCreateComputePipelines;
+	counters[COUNTED_PIPELINES].destroy = reinterpret_cast<PFN_vkVoidFunction>(vkDestroyPipeline);
+	vkCreateGraphicsPipelines = counted_create_graphics_pipelines;
+	vkCreateComputePipelines = counted_create_compute_pipelines;
+	vkDestroyPipeline = counted_destroy<COUNTED_PIPELINES>;
+}
+
+bool load_vulkan() {
+	// The library is kept open until the process exits
+#if defined(_WIN32)
+	HMODULE library = LoadLibraryA("vulkan-1.dll");
+	if (library) {
+		vkGetInstanceProcAddr = reinterpret_cast<PFN_vkGetInstanceProcAddr>(
+				GetProcAddress(library, "vkGetInstanceProcAddr"));
+	}
+#else
+#if defined(__APPLE__)
+	const char *names[] = { "libvulkan.1.dylib", "libvulkan.dylib", "libMoltenVK.dylib" };
+#else
+	const char *names[] = { "libvulkan.so.1", "libvulkan.so" };
+#endif
+	void *library = nullptr;
+	for (size_t i = 0; i < sizeof(names) / sizeof(names[0]) && !library; ++i) {
+		library = dlopen(names[i], RTLD_NOW | RTLD_LOCAL);
+	}
+	if (library) {
+		vkGetInstanceProcAddr = reinterpret_cast<PFN_vkGetInstanceProcAddr>(dlsym(library, "vkGetInstanceProcAddr"));
+	}
+#endif
+	if (!vkGetInstanceProcAddr) {
+		std::cout << "Failed to load the Vulkan loader library\n";
+		return false;
+	}
+#define VULKAN_LOAD_FUNCTION(name) name = reinterpret_cast<PFN_##name>(vkGetInstanceProcAddr(VK_NULL_HANDLE, #name));
+	VULKAN_GLOBAL_FUNCTIONS(VULKAN_LOAD_FUNCTION)
+#undef VULKAN_LOAD_FUNCTION
+	return true;
+}
+
+void load_vulkan_instance(VkInstance instance) {
+#define VULKAN_LOAD_FUNCTION(name) name = reinterpret_cast<PFN_##name>(vkGetInstanceProcAddr(instance, #name));
+	VULKAN_INSTANCE_FUNCTIONS(VULKAN_LOAD_FUNCTION)
+	VULKAN_DEVICE_FUNCTIONS(VULKAN_LOAD_FUNCTION)
+#undef VULKAN_LOAD_FUNCTION
+	count_vulkan_objects();
+}
+
+void load_vulkan_device(VkDevice device) {
+#define VULKAN_LOAD_FUNCTION(name) name = reinterpret_cast<PFN_##name>(vkGetDeviceProcAddr(device, #name));
+	VULKAN_DEVICE_FUNCTIONS(VULKAN_LOAD_FUNCTION)
+#undef VULKAN_LOAD_FUNCTION
+	count_vulkan_objects();
+}
+
+std::vector<std::pair<const char*, int64_t>> live_vulkan_objects() {
+	std::vector<std::pair<const char*, int64_t>> live;
+#define VULKAN_LIVE_OBJECTS(create, destroy, name) live.emplace_back(name, counters[COUNTED_##create].live.load());
+	VULKAN_COUNTED_OBJECTS(VULKAN_LIVE_OBJECTS)
+#undef VULKAN_LIVE_OBJECTS
+	live.emplace_back("pipelines", counters[COUNTED_PIPELINES].live.load());
+	return live;
+}
@@ -0,0 +1,184 @@
+#pragma once
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+#include <vulkan/vulkan.h>
+
+// The Vulkan entry points, loaded at runtime like volk does instead of linking against the
+// loader. The project is built with VK_NO_PROTOTYPES so every vk* call goes through these
+// pointers: the global functions come from the loader library, the instance functions from
+// the instance, and once the device is created the device functions come straight from its
+// driver through vkGetDeviceProcAddr. Hot calls like vkCmdDraw*, vkCmdBindPipeline and
+// vkQueueSubmit then skip the loader's trampoline, which looks up the handle's dispatch table
+// on every call.
+//
+// Until load_vulkan_device is called the device functions are the loader's trampolines,
+// which work with any device of the instance. Afterwards they belong to that device's driver,
+// so only one device per process is supported: calling them with another device would go to
+// the wrong driver without any error. Extension functions which are only used by one module,
+// e.g. the external memory ones, are still loaded there with vkGetDeviceProcAddr.
+
+#define VULKAN_GLOBAL_FUNCTIONS(X) \
+	X(vkCreateInstance) \
+	X(vkEnumerateInstanceExtensionProperties)
+
+#define VULKAN_INSTANCE_FUNCTIONS(X) \
+	X(vkDestroyInstance) \
+	X(vkEnumeratePhysicalDevices) \
+	X(vkGetPhysicalDeviceProperties) \
+	X(vkGetPhysicalDeviceProperties2) \
+	X(vkGetPhysicalDeviceFeatures) \
+	X(vkGetPhysicalDeviceFeatures2) \
+	X(vkGetPhysicalDeviceMemoryProperties) \
+	X(vkGetPhysicalDeviceQueueFamilyProperties) \
+	X(vkGetPhysicalDeviceFormatProperties) \
+	X(vkGetPhysicalDeviceImageFormatProperties2) \
+	X(vkGetPhysicalDeviceSparseImageFormatProperties) \
+	X(vkGetPhysicalDeviceExternalSemaphoreProperties) \
+	X(vkEnumerateDeviceExtensionProperties) \
+	X(vkCreateDevice) \
+	X(vkGetDeviceProcAddr) \
+	X(vkDestroySurfaceKHR) \
+	X(vkGetPhysicalDeviceSurfaceSupportKHR) \
+	X(vkGetPhysicalDeviceSurfaceCapabilitiesKHR) \
+	X(vkGetPhysicalDeviceSurfacePresentModesKHR)
+
+#define VULKAN_DEVICE_FUNCTIONS(X) \
+	X(vkDestroyDevice) \
+	X(vkGetDeviceQueue) \
+	X(vkDeviceWaitIdle) \
+	X(vkQueueSubmit) \
+	X(vkQueueWaitIdle) \
+	X(vkQueueBindSparse) \
+	X(vkAllocateMemory) \
+	X(vkFreeMemory) \
+	X(vkMapMemory) \
+	X(vkUnmapMemory) \
+	X(vkInvalidateMappedMemoryRanges) \
+	X(vkCreateBuffer) \
+	X(vkDestroyBuffer) \
+	X(vkGetBufferMemoryRequirements) \
+	X(vkBindBufferMemory) \
+	X(vkCreateImage) \
+	X(vkDestroyImage) \
+	X(vkGetImageMemoryRequirements) \
+	X(vkGetImageSparseMemoryRequirements) \
+	X(vkBindImageMemory) \
+	X(vkCreateImageView) \
+	X(vkDestroyImageView) \
+	X(vkCreateSampler) \
+	X(vkDestroySampler) \
+	X(vkCreateFence) \
+	X(vkDestroyFence) \
+	X(vkWaitForFences) \
+	X(vkResetFences) \
+	X(vkCreateSemaphore) \
+	X(vkDestroySemaphore) \
+	X(vkCreateQueryPool) \
+	X(vkDestroyQueryPool) \
+	X(vkGetQueryPoolResults) \
+	X(vkCreateShaderModule) \
+	X(vkDestroyShaderModule) \
+	X(vkCreatePipelineCache) \
+	X(vkDestroyPipelineCache) \
+	X(vkGetPipelineCacheData) \
+	X(vkCreateGraphicsPipelines) \
+	X(vkCreateComputePipelines) \
+	X(vkDestroyPipeline) \
+	X(vkCreatePipelineLayout) \
+	X(vkDestroyPipelineLayout) \
+	X(vkCreateDescriptorSetLayout) \
+	X(vkDestroyDescriptorSetLayout) \
+	X(vkCreateDescriptorPool) \
+	X(vkDestroyDescriptorPool) \
+	X(vkResetDescriptorPool) \
+	X(vkAllocateDescriptorSets) \
+	X(vkUpdateDescriptorSets) \
+	X(vkCreateRenderPass) \
+	X(vkDestroyRenderPass) \
+	X(vkCreateFramebuffer) \
+	X(vkDestroyFramebuffer) \
+	X(vkCreateCommandPool) \
+	X(vkDestroyCommandPool) \
+	X(vkResetCommandPool) \
+	X(vkAllocateCommandBuffers) \
+	X(vkFreeCommandBuffers) \
+	X(vkBeginCommandBuffer) \
+	X(vkEndCommandBuffer) \
+	X(vkResetCommandBuffer) \
+	X(vkCmdBindPipeline) \
+	X(vkCmdBindDescriptorSets) \
+	X(vkCmdBindVertexBuffers) \
+	X(vkCmdBindIndexBuffer) \
+	X(vkCmdPushConstants) \
+	X(vkCmdSetDepthBias) \
+	X(vkCmdDraw) \
+	X(vkCmdDrawIndexed) \
+	X(vkCmdDrawIndirect) \
+	X(vkCmdDispatch) \
+	X(vkCmdBeginRenderPass) \
+	X(vkCmdNextSubpass) \
+	X(vkCmdEndRenderPass) \
+	X(vkCmdExecuteCommands) \
+	X(vkCmdPipelineBarrier) \
+	X(vkCmdCopyBuffer) \
+	X(vkCmdCopyImage) \
+	X(vkCmdCopyBufferToImage) \
+	X(vkCmdCopyImageToBuffer) \
+	X(vkCmdBlitImage) \
+	X(vkCmdClearColorImage) \
+	X(vkCmdFillBuffer) \
+	X(vkCmdUpdateBuffer) \
+	X(vkCmdResetQueryPool) \
+	X(vkCmdWriteTimestamp) \
+	X(vkCreateSwapchainKHR) \
+	X(vkDestroySwapchainKHR) \
+	X(vkGetSwapchainImagesKHR) \
+	X(vkAcquireNextImageKHR) \
+	X(vkQueuePresentKHR)
+
+// The object types whose creations and destructions are counted for reporting leaks, by the
+// functions creating and destroying them. Pipelines are counted too, the command buffers and
+// descriptor sets owned by their pools aren't
+#define VULKAN_COUNTED_OBJECTS(X) \
+	X(vkAllocateMemory, vkFreeMemory, "device memory allocations") \
+	X(vkCreateBuffer, vkDestroyBuffer, "buffers") \
+	X(vkCreateImage, vkDestroyImage, "images") \
+	X(vkCreateImageView, vkDestroyImageView, "image views") \
+	X(vkCreateSampler, vkDestroySampler, "samplers") \
+	X(vkCreateFence, vkDestroyFence, "fences") \
+	X(vkCreateSemaphore, vkDestroySemaphore, "semaphores") \
+	X(vkCreateQueryPool, vkDestroyQueryPool, "query pools") \
+	X(vkCreateShaderModule, vkDestroyShaderModule, "shader modules") \
+	X(vkCreatePipelineCache, vkDestroyPipelineCache, "pipeline caches") \
+	X(vkCreatePipelineLayout, vkDestroyPipelineLayout, "pipeline layouts") \
+	X(vkCreateDescriptorSetLayout, vkDestroyDescriptorSetLayout, "descriptor set layouts") \
+	X(vkCreateDescriptorPool, vkDestroyDescriptorPool, "descriptor pools") \
+	X(vkCreateRenderPass, vkDestroyRenderPass, "render passes") \
+	X(vkCreateFramebuffer, vkDestroyFramebuffer, "framebuffers") \
+	X(vkCreateCommandPool, vkDestroyCommandPool, "command pools") \
+	X(vkCreateSwapchainKHR, vkDestroySwapchainKHR, "swapchains")
+
+#define VULKAN_DECLARE_FUNCTION(name) extern PFN_##name name;
+extern PFN_vkGetInstanceProcAddr vkGetInstanceProcAddr;
+VULKAN_GLOBAL_FUNCTIONS(VULKAN_DECLARE_FUNCTION)
+VULKAN_INSTANCE_FUNCTIONS(VULKAN_DECLARE_FUNCTION)
+VULKAN_DEVICE_FUNCTIONS(VULKAN_DECLARE_FUNCTION)
+#undef VULKAN_DECLARE_FUNCTION
+
+// Open the loader library and load vkGetInstanceProcAddr and the global functions. Returns
+// false if the library or its vkGetInstanceProcAddr isn't found, e.g. with no Vulkan installed
+bool load_vulkan();
+
+// Load the instance functions, and the device functions as the loader's trampolines
+void load_vulkan_instance(VkInstance instance);
+
+// Load the device's functions from its driver into the global pointers, skipping the loader.
+// They can then only be used with this device, and functions of extensions which aren't
+// enabled are null
+void load_vulkan_device(VkDevice device);
+
+// The number of objects of each counted type created and not destroyed yet, by the type's
+// name. The counting functions wrap the loaded ones, so they count the objects of every module
+std::vector<std::pair<const char*, int64_t>> live_vulkan_objects();
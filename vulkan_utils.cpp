@@ -0,0 +1,285 @@
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <unordered_map>
+#include <vector>
+#include "object_cache.h"
+#include "vulkan_utils.h"
+
+static MemoryStats stats;
+// Size and host visibility of each allocation, to update the stats when it's freed
+static std::unordered_map<VkDeviceMemory, std::pair<VkDeviceSize, bool>> allocations;
+
+static VkPipelineCache vk_pipeline_cache = VK_NULL_HANDLE;
+static std::string pipeline_cache_path;
+
+VkDeviceMemory allocate_memory(VkDevice device, VkPhysicalDevice physical_device,
+		const VkMemoryRequirements &mem_reqs, VkMemoryPropertyFlags props, const void *next)
+{
+	VkMemoryAllocateInfo alloc_info = {};
+	alloc_info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+	alloc_info.pNext = next;
+	alloc_info.allocationSize = mem_reqs.size;
+	alloc_info.memoryTypeIndex = find_memory_type(physical_device, mem_reqs.memoryTypeBits, props);
+	VkDeviceMemory mem = VK_NULL_HANDLE;
+	CHECK_VULKAN(vkAllocateMemory(device, &alloc_info, nullptr, &mem));
+
+	const bool host_visible = props & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT;
+	allocations[mem] = std::make_pair(mem_reqs.size, host_visible);
+	if (host_visible) {
+		stats.host_bytes += mem_reqs.size;
+	} else {
+		stats.device_bytes += mem_reqs.size;
+	}
+	++stats.num_allocations;
+	return mem;
+}
+
+void free_memory(VkDevice device, VkDeviceMemory mem) {
+	auto fnd = allocations.find(mem);
+	if (fnd != allocations.end()) {
+		if (fnd->second.second) {
+			stats.host_bytes -= fnd->second.first;
+		} else {
+			stats.device_bytes -= fnd->second.first;
+		}
+		--stats.num_allocations;
+		allocations.erase(fnd);
+	}
+	vkFreeMemory(device, mem, nullptr);
+}
+
+const MemoryStats& memory_stats() {
+	return stats;
+}
+
+uint32_t find_memory_type(VkPhysicalDevice physical_device, uint32_t type_filter, VkMemoryPropertyFlags props) {
+	VkPhysicalDeviceMemoryProperties mem_props = {};
+	vkGetPhysicalDeviceMemoryProperties(physical_device, &mem_props);
+	for (uint32_t i = 0; i < mem_props.memoryTypeCount; ++i) {
+		if ((type_filter & (1 << i)) && (mem_props.memoryTypes[i].propertyFlags & props) == props) {
+			return i;
+		}
+	}
+	throw std::runtime_error("Failed to find a suitable memory type");
+}
+
+VkShaderModule create_shader_module(VkDevice device, const uint32_t *code, size_t code_size) {
+	VkShaderModuleCreateInfo create_info = {};
+	create_info.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+	create_info.codeSize = code_size;
+	create_info.pCode = code;
+
+	VkShaderModule shader_module = VK_NULL_HANDLE;
+	CHECK_VULKAN(vkCreateShaderModule(device, &create_info, nullptr, &shader_module));
+	return shader_module;
+}
+
+void create_pipeline_cache(VkDevice device, const std::string &path) {
+	std::vector<char> data;
+	std::ifstream fin(path.c_str(), std::ios::binary);
+	if (fin) {
+		data.assign(std::istreambuf_iterator<char>(fin), std::istreambuf_iterator<char>());
+		std::cout << "Loaded " << data.size() << " bytes of pipeline cache from " << path << "\n";
+	}
+
+	create_pipeline_cache(device, data.empty() ? nullptr : data.data(), data.size());
+	pipeline_cache_path = path;
+}
+
+void create_pipeline_cache(VkDevice device, const void *data, size_t size) {
+	VkPipelineCacheCreateInfo info = {};
+	info.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+	info.initialDataSize = size;
+	info.pInitialData = data;
+	CHECK_VULKAN(vkCreatePipelineCache(device, &info, nullptr, &vk_pipeline_cache));
+	pipeline_cache_path.clear();
+}
+
+std::vector<uint8_t> pipeline_cache_data(VkDevice device) {
+	size_t size = 0;
+	CHECK_VULKAN(vkGetPipelineCacheData(device, vk_pipeline_cache, &size, nullptr));
+	std::vector<uint8_t> data(size, 0);
+	CHECK_VULKAN(vkGetPipelineCacheData(device, vk_pipeline_cache, &size, data.data()));
+	data.resize(size);
+	return data;
+}
+
+VkPipelineCache pipeline_cache() {
+	return vk_pipeline_cache;
+}
+
+void destroy_pipeline_cache(VkDevice device) {
+	if (vk_pipeline_cache == VK_NULL_HANDLE) {
+		return;
+	}
+	if (!pipeline_cache_path.empty()) {
+		const std::vector<uint8_t> data = pipeline_cache_data(device);
+		std::ofstream fout(pipeline_cache_path.c_str(), std::ios::binary);
+		if (fout.write(reinterpret_cast<const char*>(data.data()), data.size())) {
+			std::cout << "Saved " << data.size() << " bytes of pipeline cache to " << pipeline_cache_path << "\n";
+		} else {
+			std::cout << "Failed to save the pipeline cache to " << pipeline_cache_path << "\n";
+		}
+	}
+	vkDestroyPipelineCache(device, vk_pipeline_cache, nullptr);
+	vk_pipeline_cache = VK_NULL_HANDLE;
+}
+
+VkCommandBuffer begin_one_time_commands(VkDevice device, VkCommandPool command_pool) {
+	VkCommandBufferAllocateInfo info = {};
+	info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+	info.commandPool = command_pool;
+	info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+	info.commandBufferCount = 1;
+	VkCommandBuffer cmd_buf = VK_NULL_HANDLE;
+	CHECK_VULKAN(vkAllocateCommandBuffers(device, &info, &cmd_buf));
+
+	VkCommandBufferBeginInfo begin_info = {};
+	begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+	CHECK_VULKAN(vkBeginCommandBuffer(cmd_buf, &begin_info));
+	return cmd_buf;
+}
+
+void end_one_time_commands(VkDevice device, VkQueue queue, VkCommandPool command_pool, VkCommandBuffer cmd_buf) {
+	CHECK_VULKAN(vkEndCommandBuffer(cmd_buf));
+
+	VkSubmitInfo submit_info = {};
+	submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+	submit_info.commandBufferCount = 1;
+	submit_info.pCommandBuffers = &cmd_buf;
+	CHECK_VULKAN(vkQueueSubmit(queue, 1, &submit_info, VK_NULL_HANDLE));
+	CHECK_VULKAN(vkQueueWaitIdle(queue));
+	vkFreeCommandBuffers(device, command_pool, 1, &cmd_buf);
+}
+
+Buffer create_buffer(VkDevice device, VkPhysicalDevice physical_device, VkDeviceSize size,
+		VkBufferUsageFlags usage, VkMemoryPropertyFlags mem_props)
+{
+	Buffer buf;
+	buf.size = size;
+
+	VkBufferCreateInfo create_info = {};
+	create_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+	create_info.size = size;
+	create_info.usage = usage;
+	create_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+	CHECK_VULKAN(vkCreateBuffer(device, &create_info, nullptr, &buf.buffer));
+
+	VkMemoryRequirements mem_reqs = {};
+	vkGetBufferMemoryRequirements(device, buf.buffer, &mem_reqs);
+
+	buf.mem = allocate_memory(device, physical_device, mem_reqs, mem_props);
+	CHECK_VULKAN(vkBindBufferMemory(device, buf.buffer, buf.mem, 0));
+	return buf;
+}
+
+Buffer create_host_buffer(VkDevice device, VkPhysicalDevice physical_device, const void *data,
+		VkDeviceSize size, VkBufferUsageFlags usage)
+{
+	Buffer buf = create_buffer(device, physical_device, size, usage,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+	void *mapping = nullptr;
+	CHECK_VULKAN(vkMapMemory(device, buf.mem, 0, size, 0, &mapping));
+	std::memcpy(mapping, data, size);
+	vkUnmapMemory(device, buf.mem);
+	return buf;
+}
+
+void destroy_buffer(VkDevice device, Buffer &buf) {
+	vkDestroyBuffer(device, buf.buffer, nullptr);
+	free_memory(device, buf.mem);
+	buf = Buffer();
+}
+
+Image create_image(VkDevice device, VkPhysicalDevice physical_device, VkExtent2D extent, uint32_t layers,
+		VkFormat format, VkImageUsageFlags usage, VkImageAspectFlags aspect, VkSampleCountFlagBits samples,
+		uint32_t mip_levels)
+{
+	Image img;
+	img.format = format;
+	img.extent = extent;
+	img.layers = layers;
+	img.mip_levels = mip_levels;
+
+	VkImageCreateInfo create_info = {};
+	create_info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+	create_info.imageType = VK_IMAGE_TYPE_2D;
+	create_info.format = format;
+	create_info.extent.width = extent.width;
+	create_info.extent.height = extent.height;
+	create_info.extent.depth = 1;
+	create_info.mipLevels = mip_levels;
+	create_info.arrayLayers = layers;
+	create_info.samples = samples;
+	create_info.tiling = VK_IMAGE_TILING_OPTIMAL;
+	create_info.usage = usage;
+	create_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+	create_info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	CHECK_VULKAN(vkCreateImage(device, &create_info, nullptr, &img.image));
+
+	VkMemoryRequirements mem_reqs = {};
+	vkGetImageMemoryRequirements(device, img.image, &mem_reqs);
+
+	img.mem = allocate_memory(device, physical_device, mem_reqs, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+	CHECK_VULKAN(vkBindImageMemory(device, img.image, img.mem, 0));
+
+	img.view = create_image_view(device, img.image,
+			layers > 1 ? VK_IMAGE_VIEW_TYPE_2D_ARRAY : VK_IMAGE_VIEW_TYPE_2D, format, aspect, 0, layers);
+	return img;
+}
+
+void destroy_image(VkDevice device, Image &img) {
+	release_image_views(device, img.image);
+	vkDestroyImage(device, img.image, nullptr);
+	free_memory(device, img.mem);
+	img = Image();
+}
+
+VkImageView create_image_view(VkDevice device, VkImage image, VkImageViewType view_type, VkFormat format,
+		VkImageAspectFlags aspect, uint32_t base_layer, uint32_t layer_count)
+{
+	VkImageViewCreateInfo view_create_info = {};
+	view_create_info.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+	view_create_info.image = image;
+	view_create_info.viewType = view_type;
+	view_create_info.format = format;
+
+	view_create_info.components.r = VK_COMPONENT_SWIZZLE_IDENTITY;
+	view_create_info.components.g = VK_COMPONENT_SWIZZLE_IDENTITY;
+	view_create_info.components.b = VK_COMPONENT_SWIZZLE_IDENTITY;
+	view_create_info.components.a = VK_COMPONENT_SWIZZLE_IDENTITY;
+
+	view_create_info.subresourceRange.aspectMask = aspect;
+	view_create_info.subresourceRange.baseMipLevel = 0;
+	view_create_info.subresourceRange.levelCount = VK_REMAINING_MIP_LEVELS;
+	view_create_info.subresourceRange.baseArrayLayer = base_layer;
+	view_create_info.subresourceRange.layerCount = layer_count;
+
+	return get_image_view(device, view_create_info);
+}
+
+void image_barrier(VkCommandBuffer cmd_buf, VkImage img, VkImageAspectFlags aspect,
+		VkImageLayout old_layout, VkImageLayout new_layout,
+		VkAccessFlags src_access, VkAccessFlags dst_access,
+		VkPipelineStageFlags src_stage, VkPipelineStageFlags dst_stage,
+		uint32_t base_layer, uint32_t layer_count)
+{
+	VkImageMemoryBarrier barrier = {};
+	barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+	barrier.srcAccessMask = src_access;
+	barrier.dstAccessMask = dst_access;
+	barrier.oldLayout = old_layout;
+	barrier.newLayout = new_layout;
+	barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.image = img;
+	barrier.subresourceRange.aspectMask = aspect;
+	barrier.subresourceRange.baseMipLevel = 0;
+	barrier.subresourceRange.levelCount = VK_REMAINING_MIP_LEVELS;
+	barrier.subresourceRange.baseArrayLayer = base_layer;
+	barrier.subresourceRange.layerCount = layer_count;
+	vkCmdPipelineBarrier(cmd_buf, src_stage, dst_stage, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+}
+
@@ -0,0 +1,105 @@
+#pragma once
+
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <vulkan/vulkan.h>
+#include "vulkan_dispatch.h"
+
+#define CHECK_VULKAN(FN) \
+	{ \
+		VkResult r = FN; \
+		if (r != VK_SUCCESS) {\
+			std::cout << #FN << " failed\n" << std::flush; \
+			throw std::runtime_error(#FN " failed!");  \
+		} \
+	}
+
+// Find a memory type matching the type filter from the memory requirements that has the desired properties
+uint32_t find_memory_type(VkPhysicalDevice physical_device, uint32_t type_filter, VkMemoryPropertyFlags props);
+
+VkShaderModule create_shader_module(VkDevice device, const uint32_t *code, size_t code_size);
+
+// Create the pipeline cache all pipelines are created through, starting from the contents of
+// the file if it exists. The driver ignores data saved by a different device or driver
+void create_pipeline_cache(VkDevice device, const std::string &path);
+
+// Create the pipeline cache from data saved by an earlier run, e.g. in a snapshot. It isn't
+// saved to a file when destroyed
+void create_pipeline_cache(VkDevice device, const void *data, size_t size);
+
+// The pipeline cache's current contents, for saving
+std::vector<uint8_t> pipeline_cache_data(VkDevice device);
+
+// The pipeline cache, or VK_NULL_HANDLE if it wasn't created
+VkPipelineCache pipeline_cache();
+
+// Save the pipeline cache to the file it was loaded from and destroy it
+void destroy_pipeline_cache(VkDevice device);
+
+// Device memory allocated through the buffer and image helpers, split by whether it's host visible
+struct MemoryStats {
+	VkDeviceSize device_bytes = 0;
+	VkDeviceSize host_bytes = 0;
+	uint32_t num_allocations = 0;
+};
+
+const MemoryStats& memory_stats();
+
+// Allocate and free memory directly, counted in the memory stats, for memory not owned by a
+// single buffer or image. next is chained to the allocate info, e.g. to export or import it
+VkDeviceMemory allocate_memory(VkDevice device, VkPhysicalDevice physical_device,
+		const VkMemoryRequirements &mem_reqs, VkMemoryPropertyFlags props, const void *next = nullptr);
+
+void free_memory(VkDevice device, VkDeviceMemory mem);
+
+// Allocate and begin a command buffer for setup work, end_one_time_commands submits it, waits
+// for it to finish and frees it
+VkCommandBuffer begin_one_time_commands(VkDevice device, VkCommandPool command_pool);
+
+void end_one_time_commands(VkDevice device, VkQueue queue, VkCommandPool command_pool, VkCommandBuffer cmd_buf);
+
+// A buffer with its own memory allocation
+struct Buffer {
+	VkBuffer buffer = VK_NULL_HANDLE;
+	VkDeviceMemory mem = VK_NULL_HANDLE;
+	VkDeviceSize size = 0;
+};
+
+Buffer create_buffer(VkDevice device, VkPhysicalDevice physical_device, VkDeviceSize size,
+		VkBufferUsageFlags usage, VkMemoryPropertyFlags mem_props);
+
+// Create a host visible buffer and fill it with the data
+Buffer create_host_buffer(VkDevice device, VkPhysicalDevice physical_device, const void *data,
+		VkDeviceSize size, VkBufferUsageFlags usage);
+
+void destroy_buffer(VkDevice device, Buffer &buf);
+
+// An image with its own memory allocation and a view covering all of its layers and mip levels
+struct Image {
+	VkImage image = VK_NULL_HANDLE;
+	VkDeviceMemory mem = VK_NULL_HANDLE;
+	VkImageView view = VK_NULL_HANDLE;
+	VkFormat format = VK_FORMAT_UNDEFINED;
+	VkExtent2D extent = {};
+	uint32_t layers = 1;
+	uint32_t mip_levels = 1;
+};
+
+Image create_image(VkDevice device, VkPhysicalDevice physical_device, VkExtent2D extent, uint32_t layers,
+		VkFormat format, VkImageUsageFlags usage, VkImageAspectFlags aspect,
+		VkSampleCountFlagBits samples = VK_SAMPLE_COUNT_1_BIT, uint32_t mip_levels = 1);
+
+void destroy_image(VkDevice device, Image &img);
+
+VkImageView create_image_view(VkDevice device, VkImage image, VkImageViewType view_type, VkFormat format,
+		VkImageAspectFlags aspect, uint32_t base_layer, uint32_t layer_count);
+
+// Record a layout transition barrier on all mip levels of the given layers of an image
+void image_barrier(VkCommandBuffer cmd_buf, VkImage img, VkImageAspectFlags aspect,
+		VkImageLayout old_layout, VkImageLayout new_layout,
+		VkAccessFlags src_access, VkAccessFlags dst_access,
+		VkPipelineStageFlags src_stage, VkPipelineStageFlags dst_stage,
+		uint32_t base_layer = 0, uint32_t layer_count = VK_REMAINING_ARRAY_LAYERS);
+
@@ -0,0 +1,59 @@
+#include "worker_pool.h"
+
+static void worker_main(WorkerPool &pool, uint32_t index) {
+	uint64_t seen_generation = 0;
+	while (true) {
+		std::function<void(uint32_t)> job;
+		{
+			std::unique_lock<std::mutex> lock(pool.mutex);
+			pool.start_cv.wait(lock, [&]() { return pool.quit || pool.generation != seen_generation; });
+			if (pool.quit) {
+				return;
+			}
+			seen_generation = pool.generation;
+			job = pool.job;
+		}
+		job(index);
+		{
+			std::lock_guard<std::mutex> lock(pool.mutex);
+			if (--pool.num_running == 0) {
+				pool.done_cv.notify_one();
+			}
+		}
+	}
+}
+
+void start_workers(WorkerPool &pool, uint32_t num_threads) {
+	for (uint32_t i = 1; i < num_threads; ++i) {
+		pool.threads.emplace_back(worker_main, std::ref(pool), i);
+	}
+}
+
+uint32_t worker_count(const WorkerPool &pool) {
+	return pool.threads.size() + 1;
+}
+
+void run_on_workers(WorkerPool &pool, const std::function<void(uint32_t)> &job) {
+	{
+		std::lock_guard<std::mutex> lock(pool.mutex);
+		pool.job = job;
+		pool.num_running = pool.threads.size();
+		++pool.generation;
+	}
+	pool.start_cv.notify_all();
+	job(0);
+	std::unique_lock<std::mutex> lock(pool.mutex);
+	pool.done_cv.wait(lock, [&]() { return pool.num_running == 0; });
+}
+
+void stop_workers(WorkerPool &pool) {
+	{
+		std::lock_guard<std::mutex> lock(pool.mutex);
+		pool.quit = true;
+	}
+	pool.start_cv.notify_all();
+	for (auto &t : pool.threads) {
+		t.join();
+	}
+	pool.threads.clear();
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Runs each job on the calling thread and the workers, passing each its thread index
+struct WorkerPool {
+	std::vector<std::thread> threads;
+	std::mutex mutex;
+	std::condition_variable start_cv;
+	std::condition_variable done_cv;
+	std::function<void(uint32_t)> job;
+	uint64_t generation = 0;
+	uint32_t num_running = 0;
+	bool quit = false;
+};
+
+// Start the workers, the calling thread is thread 0 so num_threads - 1 are started
+void start_workers(WorkerPool &pool, uint32_t num_threads);
+
+// The number of threads jobs run on, including the calling thread
+uint32_t worker_count(const WorkerPool &pool);
+
+// Run the job on all threads and wait for it to finish
+void run_on_workers(WorkerPool &pool, const std::function<void(uint32_t)> &job);
+
+void stop_workers(WorkerPool &pool);